@@ -0,0 +1,67 @@
+/*
+ * Copyright 2024 Max Planck Institute for Software Systems, and
+ * National University of Singapore
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+
+#include "lib/simbricks/base/affinity.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+
+int SimbricksParseCpuList(const char *str, int *cpus, size_t max) {
+  const char *p = str;
+  size_t n = 0;
+  while (*p) {
+    char *end;
+    long first = strtol(p, &end, 10);
+    long last = first;
+    if (end == p || first < 0)
+      return -1;
+    if (*end == '-') {
+      p = end + 1;
+      last = strtol(p, &end, 10);
+      if (end == p || last < first)
+        return -1;
+    }
+    for (long c = first; c <= last; c++) {
+      if (n == max)
+        return -1;
+      cpus[n++] = c;
+    }
+    if (*end == ',')
+      end++;
+    else if (*end != 0)
+      return -1;
+    p = end;
+  }
+  return (n > 0 ? (int)n : -1);
+}
+
+int SimbricksPinThread(int cpu) {
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  CPU_SET(cpu, &cpus);
+  return pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+}
@@ -0,0 +1,42 @@
+/*
+ * Copyright 2024 Max Planck Institute for Software Systems, and
+ * National University of Singapore
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef SIMBRICKS_BASE_AFFINITY_H_
+#define SIMBRICKS_BASE_AFFINITY_H_
+
+#include <stddef.h>
+
+/**
+ * Parse a CPU list such as "0-3,8" into `cpus`. Returns the number of CPUs, or
+ * -1 if the list is empty, malformed, or holds more than `max` CPUs.
+ */
+int SimbricksParseCpuList(const char *str, int *cpus, size_t max);
+
+/**
+ * Pin the calling thread to `cpu`. Returns 0 on success, an error number
+ * otherwise.
+ */
+int SimbricksPinThread(int cpu);
+
+#endif  // SIMBRICKS_BASE_AFFINITY_H_
@@ -37,7 +37,10 @@
 #define _Atomic(T) std::atomic<T>
 using std::atomic_load_explicit;
 using std::atomic_store_explicit;
+using std::atomic_thread_fence;
 using std::memory_order_acquire;
+using std::memory_order_relaxed;
 using std::memory_order_release;
+using std::memory_order_seq_cst;
 
 #endif  // SIMBRICKS_BASE_CXXATOMICFIX_H_
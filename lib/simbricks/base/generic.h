@@ -35,14 +35,20 @@
  * Generates the following function with the specified prefix:
  *  - In: prefixInPeek (wraps `SimbricksBaseIfInPeek`)
  *  - In: prefixInPoll (wraps `SimbricksBaseIfInPoll`)
+ *  - In: prefixInPollBurst (wraps `SimbricksBaseIfInPollBurst`)
  *  - In: prefixInType (wraps `SimbricksBaseIfInType`)
  *  - In: prefixInDone (wraps `SimbricksBaseIfInDone`)
+ *  - In: prefixInDoneBurst (wraps `SimbricksBaseIfInDoneBurst`)
  *  - In: prefixInTimestamp (wraps `SimbricksBaseIfInTimestamp`)
  *  - Out: prefixOutAlloc (wraps `SimbricksBaseIfOutAlloc`)
+ *  - Out: prefixOutAllocBurst (wraps `SimbricksBaseIfOutAllocBurst`)
+ *  - Out: prefixOutAllocLen (wraps `SimbricksBaseIfOutAllocLen`)
  *  - Out: prefixOutSend (wraps `SimbricksBaseIfOutSend`)
+ *  - Out: prefixOutSendBurst (wraps `SimbricksBaseIfOutSendBurst`)
  *  - Out: prefixOutSync (wraps `SimbricksBaseIfOutSync`)
  *  - Out: prefixOutNextSync (wraps `SimbricksBaseIfOutNextSync`)
  *  - Out: prefixOutMsgLen (wraps `SimBricksBaseIfOutMsgLen`)
+ *  - Out: prefixOutMaxMsgLen (wraps `SimBricksBaseIfOutMaxMsgLen`)
  *
  * @param prefix    Name prefix for all the functions
  * @param msg_union Union name for the message type of the protocol. (not
@@ -64,6 +70,14 @@
                                                              ts);              \
   }                                                                            \
                                                                                \
+  static inline size_t prefix##InPollBurst(                                    \
+      struct if_struct *base_if, uint64_t ts, volatile union msg_union **msgs, \
+      size_t max) {                                                            \
+    return SimbricksBaseIfInPollBurst(                                         \
+        &base_if->base, ts, (volatile union SimbricksProtoBaseMsg **)msgs,     \
+        max);                                                                  \
+  }                                                                            \
+                                                                               \
   static inline uint8_t prefix##InType(struct if_struct *base_if,              \
                                        volatile union msg_union *msg) {        \
     return SimbricksBaseIfInType(&base_if->base, &msg->base);                  \
@@ -74,6 +88,14 @@
     SimbricksBaseIfInDone(&base_if->base, &msg->base);                         \
   }                                                                            \
                                                                                \
+  static inline void prefix##InDoneBurst(                                      \
+      struct if_struct *base_if, volatile union msg_union *const *msgs,        \
+      size_t n) {                                                              \
+    SimbricksBaseIfInDoneBurst(                                                \
+        &base_if->base, (volatile union SimbricksProtoBaseMsg *const *)msgs,   \
+        n);                                                                    \
+  }                                                                            \
+                                                                               \
   static inline uint64_t prefix##InTimestamp(struct if_struct *base_if) {      \
     return SimbricksBaseIfInTimestamp(&base_if->base);                         \
   }                                                                            \
@@ -84,12 +106,34 @@
                                                                timestamp);     \
   }                                                                            \
                                                                                \
+  static inline size_t prefix##OutAllocBurst(                                  \
+      struct if_struct *base_if, uint64_t timestamp,                           \
+      volatile union msg_union **msgs, size_t max) {                           \
+    return SimbricksBaseIfOutAllocBurst(                                       \
+        &base_if->base, timestamp,                                             \
+        (volatile union SimbricksProtoBaseMsg **)msgs, max);                   \
+  }                                                                            \
+                                                                               \
+  static inline volatile union msg_union *prefix##OutAllocLen(                 \
+      struct if_struct *base_if, uint64_t timestamp, size_t len) {             \
+    return (volatile union msg_union *)SimbricksBaseIfOutAllocLen(             \
+        &base_if->base, timestamp, len);                                       \
+  }                                                                            \
+                                                                               \
   static inline void prefix##OutSend(struct if_struct *base_if,                \
                                      volatile union msg_union *msg,            \
                                      uint8_t msg_type) {                       \
     SimbricksBaseIfOutSend(&base_if->base, &msg->base, msg_type);              \
   }                                                                            \
                                                                                \
+  static inline void prefix##OutSendBurst(                                     \
+      struct if_struct *base_if, volatile union msg_union *const *msgs,        \
+      size_t n, uint8_t msg_type) {                                            \
+    SimbricksBaseIfOutSendBurst(                                               \
+        &base_if->base, (volatile union SimbricksProtoBaseMsg *const *)msgs,   \
+        n, msg_type);                                                          \
+  }                                                                            \
+                                                                               \
   static inline int prefix##OutSync(struct if_struct *base_if,                 \
                                     uint64_t timestamp) {                      \
     return SimbricksBaseIfOutSync(&base_if->base, timestamp);                  \
@@ -101,6 +145,10 @@
                                                                                \
   static inline size_t prefix##OutMsgLen(struct if_struct *base_if) {          \
     return SimbricksBaseIfOutMsgLen(&base_if->base);                           \
+  }                                                                            \
+                                                                               \
+  static inline size_t prefix##OutMaxMsgLen(struct if_struct *base_if) {       \
+    return SimbricksBaseIfOutMaxMsgLen(&base_if->base);                        \
   }
 
 #endif  // SIMBRICKS_BASE_GENERIC_H_
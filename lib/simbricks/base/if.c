@@ -29,16 +29,20 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <poll.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/eventfd.h>
 #include <sys/mman.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/un.h>
+#include <time.h>
 #include <unistd.h>
 
 #include <simbricks/base/proto.h>
+#include <simbricks/base/record.h>
 
 enum ConnState {
   kConnClosed = 0,
@@ -50,15 +54,343 @@ enum ConnState {
   kConnOpen,
 };
 
+#ifndef MFD_HUGE_2MB
+/* from linux/memfd.h: log2(page size) << MFD_HUGE_SHIFT (26) */
+#define MFD_HUGE_2MB (21U << 26)
+#endif
+
+#define SHM_HUGE_PAGE_SIZE (2ULL * 1024 * 1024)
+
+#define INTRO_BUF_SIZE 2048
+#define INPROC_PREFIX "inproc:"
+
+/* intro posted for the peer of an in-process connection */
+struct InprocIntro {
+  bool valid;
+  size_t len;
+  uint8_t buf[INTRO_BUF_SIZE];
+  int fds[2];
+  size_t n_fds;
+};
+
+/*
+ * In-process connection: registered under its path by the listener until a
+ * connecter picks it up, then shared by both. Index 0 of the arrays is for the
+ * listener, 1 for the connecter.
+ */
+struct SimbricksBaseIfInproc {
+  struct SimbricksBaseIfInproc *next;
+  char *path;
+  struct SimbricksBaseIfSHMPool *shm;
+  bool connected;
+  unsigned refs;
+  /* eventfds signalled when there is news for the listener/connecter */
+  int efds[2];
+  /* intros for the listener/connecter */
+  struct InprocIntro intros[2];
+};
+
+static pthread_mutex_t inproc_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t inproc_cond = PTHREAD_COND_INITIALIZER;
+static struct SimbricksBaseIfInproc *inproc_listeners = NULL;
+
+static const char *SHMBackendName(enum SimbricksBaseIfSHMBackend backend) {
+  switch (backend) {
+    case kSimbricksBaseIfSHMFile:
+      return "file";
+    case kSimbricksBaseIfSHMMemfd:
+      return "memfd";
+    case kSimbricksBaseIfSHMHugetlb:
+      return "hugetlb";
+    case kSimbricksBaseIfSHMHeap:
+      return "heap";
+    default:
+      return "unknown";
+  }
+}
+
+static uint64_t SHMTimeNs(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static bool IsInprocPath(const char *path) {
+  return path != NULL &&
+         strncmp(path, INPROC_PREFIX, sizeof(INPROC_PREFIX) - 1) == 0;
+}
+
+/* find registered listener, called with inproc_lock held */
+static struct SimbricksBaseIfInproc **InprocFind(const char *path) {
+  struct SimbricksBaseIfInproc **pip;
+  for (pip = &inproc_listeners; *pip != NULL; pip = &(*pip)->next) {
+    if (!strcmp((*pip)->path, path))
+      return pip;
+  }
+  return NULL;
+}
+
+static void InprocSignal(int efd) {
+  uint64_t val = 1;
+  (void)!write(efd, &val, sizeof(val));
+}
+
+static void InprocFree(struct SimbricksBaseIfInproc *ip) {
+  size_t i, j;
+  for (i = 0; i < 2; i++) {
+    if (ip->efds[i] >= 0)
+      close(ip->efds[i]);
+    if (ip->intros[i].valid) {
+      for (j = 0; j < ip->intros[i].n_fds; j++)
+        close(ip->intros[i].fds[j]);
+    }
+  }
+  free(ip->path);
+  free(ip);
+}
+
+/* register listening interface, the queues must already be set up */
+static int InprocListen(struct SimbricksBaseIf *base_if) {
+  struct SimbricksBaseIfInproc *ip;
+
+  if ((ip = calloc(1, sizeof(*ip))) == NULL) {
+    perror("InprocListen: calloc failed");
+    return -1;
+  }
+  ip->shm = base_if->shm;
+  ip->refs = 1;
+  ip->path = strdup(base_if->params.sock_path);
+  ip->efds[0] = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  ip->efds[1] = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (ip->path == NULL || ip->efds[0] < 0 || ip->efds[1] < 0) {
+    perror("InprocListen: allocating connection failed");
+    InprocFree(ip);
+    return -1;
+  }
+
+  pthread_mutex_lock(&inproc_lock);
+  if (InprocFind(ip->path) != NULL) {
+    pthread_mutex_unlock(&inproc_lock);
+    fprintf(stderr, "InprocListen: %s is already in use\n", ip->path);
+    InprocFree(ip);
+    errno = EADDRINUSE;
+    return -1;
+  }
+  ip->next = inproc_listeners;
+  inproc_listeners = ip;
+  base_if->inproc = ip;
+  pthread_cond_broadcast(&inproc_cond);
+  pthread_mutex_unlock(&inproc_lock);
+  return 0;
+}
+
+/* check if a connecter picked up our connection, blocking if configured */
+static int InprocAccept(struct SimbricksBaseIf *base_if) {
+  struct SimbricksBaseIfInproc *ip = base_if->inproc;
+  uint64_t val;
+
+  pthread_mutex_lock(&inproc_lock);
+  while (!ip->connected && base_if->params.blocking_conn)
+    pthread_cond_wait(&inproc_cond, &inproc_lock);
+  if (!ip->connected) {
+    pthread_mutex_unlock(&inproc_lock);
+    return 1;
+  }
+
+  /* consume the connect notification but keep a pending intro signalled */
+  (void)!read(ip->efds[0], &val, sizeof(val));
+  if (ip->intros[0].valid)
+    InprocSignal(ip->efds[0]);
+  base_if->conn_state = kConnAwaitHandshakeRxTx;
+  pthread_mutex_unlock(&inproc_lock);
+  return 0;
+}
+
+/* pick up the connection registered by the listener, waiting for it to show
+ * up if blocking */
+static int InprocConnect(struct SimbricksBaseIf *base_if) {
+  struct SimbricksBaseIfInproc **pip, *ip;
+
+  pthread_mutex_lock(&inproc_lock);
+  while ((pip = InprocFind(base_if->params.sock_path)) == NULL &&
+         base_if->params.blocking_conn)
+    pthread_cond_wait(&inproc_cond, &inproc_lock);
+  if (pip == NULL) {
+    pthread_mutex_unlock(&inproc_lock);
+    fprintf(stderr, "InprocConnect: no listener on %s\n",
+            base_if->params.sock_path);
+    base_if->conn_state = kConnClosed;
+    errno = ECONNREFUSED;
+    return -1;
+  }
+
+  ip = *pip;
+  *pip = ip->next;
+  ip->next = NULL;
+  ip->connected = true;
+  ip->refs++;
+  base_if->inproc = ip;
+  base_if->conn_state = kConnAwaitHandshakeRxTx;
+  InprocSignal(ip->efds[0]);
+  pthread_cond_broadcast(&inproc_cond);
+  pthread_mutex_unlock(&inproc_lock);
+  return 0;
+}
+
+/* post intro for the peer, duplicating the file descriptors to pass along */
+static ssize_t InprocSend(struct SimbricksBaseIf *base_if,
+                          const struct iovec *iov, size_t iovcnt,
+                          const int *fds, size_t n_fds) {
+  struct SimbricksBaseIfInproc *ip = base_if->inproc;
+  size_t peer = (base_if->listener ? 1 : 0);
+  struct InprocIntro *intro = &ip->intros[peer];
+  size_t i;
+
+  pthread_mutex_lock(&inproc_lock);
+  intro->len = 0;
+  for (i = 0; i < iovcnt; i++) {
+    if (intro->len + iov[i].iov_len > sizeof(intro->buf)) {
+      pthread_mutex_unlock(&inproc_lock);
+      errno = EMSGSIZE;
+      return -1;
+    }
+    memcpy(intro->buf + intro->len, iov[i].iov_base, iov[i].iov_len);
+    intro->len += iov[i].iov_len;
+  }
+  for (intro->n_fds = 0; intro->n_fds < n_fds; intro->n_fds++)
+    intro->fds[intro->n_fds] = fcntl(fds[intro->n_fds], F_DUPFD_CLOEXEC, 0);
+  intro->valid = true;
+  InprocSignal(ip->efds[peer]);
+  pthread_mutex_unlock(&inproc_lock);
+  return intro->len;
+}
+
+/* take intro posted by the peer, fails with EAGAIN if there is none yet */
+static ssize_t InprocRecv(struct SimbricksBaseIf *base_if, void *buf,
+                          size_t len, int *fds, size_t *n_fds) {
+  struct SimbricksBaseIfInproc *ip = base_if->inproc;
+  size_t own = (base_if->listener ? 0 : 1);
+  struct InprocIntro *intro = &ip->intros[own];
+  uint64_t val;
+
+  pthread_mutex_lock(&inproc_lock);
+  (void)!read(ip->efds[own], &val, sizeof(val));
+  if (!intro->valid) {
+    pthread_mutex_unlock(&inproc_lock);
+    errno = EAGAIN;
+    return -1;
+  }
+
+  ssize_t ret = (intro->len < len ? intro->len : len);
+  memcpy(buf, intro->buf, ret);
+  memcpy(fds, intro->fds, intro->n_fds * sizeof(int));
+  *n_fds = intro->n_fds;
+  intro->valid = false;
+  pthread_mutex_unlock(&inproc_lock);
+  return ret;
+}
+
+static void InprocClose(struct SimbricksBaseIf *base_if) {
+  struct SimbricksBaseIfInproc *ip = base_if->inproc;
+  struct SimbricksBaseIfInproc **pip;
+
+  pthread_mutex_lock(&inproc_lock);
+  if (!ip->connected && (pip = InprocFind(ip->path)) != NULL && *pip == ip)
+    *pip = ip->next;
+  bool last = (--ip->refs == 0);
+  pthread_mutex_unlock(&inproc_lock);
+
+  base_if->inproc = NULL;
+  if (last)
+    InprocFree(ip);
+}
+
 int SimbricksBaseIfSHMPoolCreate(struct SimbricksBaseIfSHMPool *pool,
                                  const char *path, size_t pool_size) {
+  enum SimbricksBaseIfSHMBackend backend = kSimbricksBaseIfSHMFile;
+  const char *env = getenv("SIMBRICKS_SHM_BACKEND");
+
+  if (env == NULL || !strcmp(env, "") || !strcmp(env, "file")) {
+    backend = kSimbricksBaseIfSHMFile;
+  } else if (!strcmp(env, "memfd")) {
+    backend = kSimbricksBaseIfSHMMemfd;
+  } else if (!strcmp(env, "hugetlb")) {
+    backend = kSimbricksBaseIfSHMHugetlb;
+  } else if (!strcmp(env, "heap")) {
+    backend = kSimbricksBaseIfSHMHeap;
+  } else {
+    fprintf(stderr,
+            "SimbricksBaseIfSHMPoolCreate: unknown SIMBRICKS_SHM_BACKEND "
+            "(%s)\n",
+            env);
+    return -1;
+  }
+  if (IsInprocPath(path))
+    backend = kSimbricksBaseIfSHMHeap;
+
+  return SimbricksBaseIfSHMPoolCreateBackend(pool, path, pool_size, backend);
+}
+
+int SimbricksBaseIfSHMPoolCreateBackend(
+    struct SimbricksBaseIfSHMPool *pool, const char *path, size_t pool_size,
+    enum SimbricksBaseIfSHMBackend backend) {
+  uint64_t start = SHMTimeNs();
+
   pool->path = path;
-  pool->size = pool_size;
   pool->pos = 0;
+  /* room for the pool header in front of the interfaces */
+  pool_size += SIMBRICKS_PROTO_POOL_HDR_SIZE;
+
+  if (backend == kSimbricksBaseIfSHMHugetlb) {
+    const char *name = strrchr(path, '/');
+    name = (name ? name + 1 : path);
+    pool->fd = memfd_create(name, MFD_CLOEXEC | MFD_HUGETLB | MFD_HUGE_2MB);
+    if (pool->fd >= 0) {
+      pool_size = (pool_size + SHM_HUGE_PAGE_SIZE - 1) &
+                  ~(SHM_HUGE_PAGE_SIZE - 1);
+      if (ftruncate(pool->fd, pool_size) == 0) {
+        pool->base = mmap(NULL, pool_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                          pool->fd, 0);
+        if (pool->base != MAP_FAILED)
+          goto out_mapped;
+      }
+      close(pool->fd);
+    }
+    perror("SimbricksBaseIfSHMPoolCreate: hugetlb memfd failed, falling back "
+           "to memfd");
+    backend = kSimbricksBaseIfSHMMemfd;
+  }
 
-  if ((pool->fd = open(path, O_CREAT | O_RDWR, 0666)) == -1) {
-    perror("SimbricksBaseIfSHMPoolCreate: open failed");
-    return -1;
+  if (backend == kSimbricksBaseIfSHMHeap) {
+    /* never shared with other processes, so no file descriptor needed */
+    pool->fd = -1;
+    pool->base = mmap(NULL, pool_size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (pool->base == MAP_FAILED) {
+      perror("SimbricksBaseIfSHMPoolCreate: mmap failed");
+      return -1;
+    }
+    goto out_mapped;
+  }
+
+  if (backend == kSimbricksBaseIfSHMMemfd) {
+    const char *name = strrchr(path, '/');
+    name = (name ? name + 1 : path);
+    if ((pool->fd = memfd_create(name, MFD_CLOEXEC)) == -1) {
+      perror("SimbricksBaseIfSHMPoolCreate: memfd_create failed");
+      return -1;
+    }
+  } else {
+    /* replace existing files instead of truncating them, so the pool starts
+     * out zeroed and a peer still mapping a stale file keeps its pages */
+    if (unlink(path) != 0 && errno != ENOENT) {
+      perror("SimbricksBaseIfSHMPoolCreate: unlink failed");
+      return -1;
+    }
+    if ((pool->fd = open(path, O_CREAT | O_EXCL | O_RDWR, 0666)) == -1) {
+      perror("SimbricksBaseIfSHMPoolCreate: open failed");
+      return -1;
+    }
   }
 
   if (ftruncate(pool->fd, pool_size) != 0) {
@@ -67,14 +399,31 @@ int SimbricksBaseIfSHMPoolCreate(struct SimbricksBaseIfSHMPool *pool,
     return -1;
   }
 
-  pool->base = mmap(NULL, pool_size, PROT_READ | PROT_WRITE,
-                    MAP_SHARED | MAP_POPULATE, pool->fd, 0);
-  if (pool->base == (void *)-1) {
+  pool->base =
+      mmap(NULL, pool_size, PROT_READ | PROT_WRITE, MAP_SHARED, pool->fd, 0);
+  if (pool->base == MAP_FAILED) {
     perror("SimbricksBaseIfSHMPoolCreate: mmap failed");
+    close(pool->fd);
     return -1;
   }
 
-  memset(pool->base, 0, pool_size);
+out_mapped:
+  pool->size = pool_size;
+  if (backend != kSimbricksBaseIfSHMFile)
+    pool->path = NULL;
+  /* no memset needed: fresh memfds and files read as zero, and pages are only
+   * allocated once touched */
+
+  struct SimbricksProtoPoolHeader *hdr = pool->base;
+  hdr->pid = getpid();
+  hdr->magic = SIMBRICKS_PROTO_POOL_MAGIC;
+  pool->pos = SIMBRICKS_PROTO_POOL_HDR_SIZE;
+
+  if (getenv("SIMBRICKS_SHM_TIMING") != NULL)
+    fprintf(stderr,
+            "SimbricksBaseIfSHMPoolCreate: %s pool of %zu bytes ready in %lu "
+            "us\n",
+            SHMBackendName(backend), pool_size, (SHMTimeNs() - start) / 1000);
   return 0;
 }
 
@@ -122,7 +471,8 @@ int SimbricksBaseIfSHMPoolUnmap(struct SimbricksBaseIfSHMPool *pool) {
     perror("SimbricksBaseIfSHMPoolUnmap: unmap failed");
     return -1;
   }
-  close(pool->fd);
+  if (pool->fd >= 0)
+    close(pool->fd);
 
   pool->fd = -1;
   pool->base = NULL;
@@ -131,6 +481,9 @@ int SimbricksBaseIfSHMPoolUnmap(struct SimbricksBaseIfSHMPool *pool) {
 }
 
 int SimbricksBaseIfSHMPoolUnlink(struct SimbricksBaseIfSHMPool *pool) {
+  /* memfd pools have no path and disappear with the last reference */
+  if (pool->path == NULL)
+    return 0;
   return unlink(pool->path);
 }
 
@@ -143,11 +496,67 @@ void SimbricksBaseIfDefaultParams(struct SimbricksBaseIfParams *params) {
   params->in_entries_size = params->out_entries_size = 2048;
   params->blocking_conn = false;
   params->upper_layer_proto = SIMBRICKS_PROTO_ID_BASE;
+  params->multi_slot = false;
+
+  const char *env = getenv("SIMBRICKS_DOORBELL");
+  params->doorbell = (env != NULL);
+  params->doorbell_spin = (env != NULL ? strtoull(env, NULL, 0) : 0);
+  params->ring_v2 = (getenv("SIMBRICKS_RING_V2") != NULL);
+  params->adaptive_sync = false;
+  params->sync_switch = false;
+
+  env = getenv("SIMBRICKS_STATS");
+  params->stats = (env != NULL && strcmp(env, "0") != 0);
+
+  params->record_dir = getenv("SIMBRICKS_RECORD_DIR");
+  params->record_len = NULL;
+}
+
+static size_t CtlSize(struct SimbricksBaseIfParams *params) {
+  size_t len = 0;
+  if (params->doorbell || params->ring_v2)
+    len += sizeof(struct SimbricksProtoBaseIfCtl);
+  if (params->ring_v2)
+    len += (params->in_num_entries + params->out_num_entries) *
+           sizeof(struct SimbricksProtoBaseSlotMeta);
+  return len;
 }
 
 size_t SimbricksBaseIfSHMSize(struct SimbricksBaseIfParams *params) {
   return params->in_num_entries * params->in_entries_size +
-         params->out_num_entries * params->out_entries_size;
+         params->out_num_entries * params->out_entries_size + CtlSize(params);
+}
+
+static bool IsPow2(size_t x) {
+  return x != 0 && (x & (x - 1)) == 0;
+}
+
+/* v2 layout requires power-of-two queue lengths and entry sizes */
+static bool RingV2Possible(struct SimbricksBaseIf *base_if) {
+  return base_if->params.ring_v2 && base_if->ctl != NULL &&
+         IsPow2(base_if->in_enum) && IsPow2(base_if->out_enum) &&
+         IsPow2(base_if->in_elen) && IsPow2(base_if->out_elen);
+}
+
+/* point the v2 meta data and head pointers at the control block */
+static void RingV2Setup(struct SimbricksBaseIf *base_if, size_t l2c_nentries) {
+  volatile struct SimbricksProtoBaseSlotMeta *l2c_meta =
+      (volatile struct SimbricksProtoBaseSlotMeta *)(base_if->ctl + 1);
+  volatile struct SimbricksProtoBaseSlotMeta *c2l_meta =
+      l2c_meta + l2c_nentries;
+
+  if (base_if->listener) {
+    base_if->in_meta = c2l_meta;
+    base_if->out_meta = l2c_meta;
+    base_if->in_head = &base_if->ctl->c2l_head;
+    base_if->out_head = &base_if->ctl->l2c_head;
+  } else {
+    base_if->in_meta = l2c_meta;
+    base_if->out_meta = c2l_meta;
+    base_if->in_head = &base_if->ctl->l2c_head;
+    base_if->out_head = &base_if->ctl->c2l_head;
+  }
+  base_if->ring_v2 = true;
 }
 
 int SimbricksBaseIfInit(struct SimbricksBaseIf *base_if,
@@ -163,9 +572,30 @@ int SimbricksBaseIfInit(struct SimbricksBaseIf *base_if,
   }
   memset(base_if, 0, sizeof(*base_if));
   base_if->params = *params;
+  base_if->in_efd = -1;
+  base_if->out_efd = -1;
   return 0;
 }
 
+/* add listening interface to the pool header and set up its statistics */
+static void PoolRegister(struct SimbricksBaseIf *base_if) {
+  struct SimbricksProtoPoolHeader *hdr = base_if->shm->base;
+  struct SimbricksBaseIfParams *params = &base_if->params;
+
+  if (!params->stats || base_if->shm->size < SIMBRICKS_PROTO_POOL_HDR_SIZE ||
+      hdr->magic != SIMBRICKS_PROTO_POOL_MAGIC ||
+      hdr->num_ifs >= SIMBRICKS_PROTO_POOL_MAX_IFS)
+    return;
+
+  struct SimbricksProtoPoolIf *pif = &hdr->ifs[hdr->num_ifs];
+  strncpy(pif->sock_path, params->sock_path, sizeof(pif->sock_path) - 1);
+  pif->upper_layer_proto = params->upper_layer_proto;
+  pif->link_latency = params->link_latency;
+  base_if->stats = &pif->stats[0];
+  atomic_store_explicit((volatile _Atomic(uint32_t) *)&hdr->num_ifs,
+                        hdr->num_ifs + 1, memory_order_release);
+}
+
 static int AcceptOnBaseIf(struct SimbricksBaseIf *base_if) {
   int flags = (!base_if->params.blocking_conn ? SOCK_NONBLOCK : 0);
   base_if->conn_fd = accept4(base_if->listen_fd, NULL, NULL, flags);
@@ -190,9 +620,10 @@ int SimbricksBaseIfListen(struct SimbricksBaseIf *base_if,
   struct sockaddr_un saun;
   int flags;
   struct SimbricksBaseIfParams *params = &base_if->params;
+  bool inproc = IsInprocPath(params->sock_path);
 
   /* make sure the socket path does not exceed the limits of saun.sun_path */
-  if (strlen(params->sock_path) >= sizeof(saun.sun_path)) {
+  if (!inproc && strlen(params->sock_path) >= sizeof(saun.sun_path)) {
     fprintf(stderr,
             "SimbricksBaseIfListen: socket path %s is too long "
             "(exceeding %lu characters)\n",
@@ -205,13 +636,25 @@ int SimbricksBaseIfListen(struct SimbricksBaseIf *base_if,
   base_if->shm = pool;
   size_t in_len = params->in_num_entries * params->in_entries_size;
   size_t out_len = params->out_num_entries * params->out_entries_size;
-  if (pool->pos + in_len + out_len > pool->size) {
+  size_t ctl_len = CtlSize(params);
+  if (pool->pos + in_len + out_len + ctl_len > pool->size) {
     fprintf(stderr,
             "SimbricksBaseIfListen: not enough memory available in "
             "pool");
     return -1;
   }
 
+  base_if->listen_fd = -1;
+  base_if->conn_fd = -1;
+  if (inproc)
+    goto out_queues;
+  if (pool->fd < 0) {
+    fprintf(stderr,
+            "SimbricksBaseIfListen: heap pools only support in-process "
+            "connections\n");
+    return -1;
+  }
+
   if ((base_if->listen_fd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1) {
     perror("SimbricksBaseIfListen: socket failed");
     return -1;
@@ -239,6 +682,7 @@ int SimbricksBaseIfListen(struct SimbricksBaseIf *base_if,
     goto out_error;
   }
 
+out_queues:
   /* initialize queues */
   base_if->in_queue = pool->base + pool->pos;
   base_if->in_pos = 0;
@@ -254,8 +698,18 @@ int SimbricksBaseIfListen(struct SimbricksBaseIf *base_if,
   base_if->out_timestamp = 0;
   pool->pos += out_len;
 
+  if (ctl_len > 0) {
+    base_if->ctl = pool->base + pool->pos;
+    base_if->in_waiting = &base_if->ctl->c2l_waiting;
+    base_if->out_waiting = &base_if->ctl->l2c_waiting;
+    pool->pos += ctl_len;
+  }
+  PoolRegister(base_if);
+
   base_if->conn_state = kConnListening;
   base_if->listener = true;
+  if (inproc)
+    return (InprocListen(base_if) < 0 || InprocAccept(base_if) < 0 ? -1 : 0);
   return (AcceptOnBaseIf(base_if) < 0 ? -1 : 0);
 
 out_error:
@@ -269,6 +723,13 @@ int SimbricksBaseIfConnect(struct SimbricksBaseIf *base_if) {
   int flags;
   struct SimbricksBaseIfParams *params = &base_if->params;
 
+  base_if->listener = false;
+  if (IsInprocPath(params->sock_path)) {
+    base_if->listen_fd = -1;
+    base_if->conn_fd = -1;
+    return InprocConnect(base_if);
+  }
+
   /* make sure the socket path does not exceed the limits of saun.sun_path */
   if (strlen(params->sock_path) >= sizeof(saun.sun_path)) {
     fprintf(stderr,
@@ -324,6 +785,8 @@ int SimbricksBaseIfConnected(struct SimbricksBaseIf *base_if) {
       return -1;
 
     case kConnListening:
+      if (base_if->inproc != NULL)
+        return InprocAccept(base_if);
       return AcceptOnBaseIf(base_if);
 
     case kConnConnecting: {
@@ -382,6 +845,8 @@ int SimbricksBaseIfConnected(struct SimbricksBaseIf *base_if) {
 
 int SimbricksBaseIfConnFd(struct SimbricksBaseIf *base_if) {
   if (base_if->conn_state == kConnListening) {
+    if (base_if->inproc != NULL)
+      return base_if->inproc->efds[0];
     return base_if->listen_fd;
   } else if (base_if->conn_state == kConnConnecting) {
     return base_if->conn_fd;
@@ -403,7 +868,7 @@ int SimbricksBaseIfConnsWait(struct SimbricksBaseIf **base_ifs, unsigned n) {
       switch (base_if->conn_state) {
         case kConnListening:
           ids[n_wait] = i;
-          pfds[n_wait].fd = base_if->listen_fd;
+          pfds[n_wait].fd = SimbricksBaseIfConnFd(base_if);
           pfds[n_wait].events = POLLIN;
           pfds[n_wait].revents = 0;
           n_wait++;
@@ -459,6 +924,18 @@ int SimbricksBaseIfConnsWait(struct SimbricksBaseIf **base_ifs, unsigned n) {
   return 0;
 }
 
+static int DoorbellInit(struct SimbricksBaseIf *base_if) {
+  if (base_if->in_efd >= 0)
+    return 0;
+
+  base_if->in_efd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (base_if->in_efd < 0) {
+    perror("DoorbellInit: eventfd failed");
+    return -1;
+  }
+  return 0;
+}
+
 /** Send intro. */
 int SimbricksBaseIfIntroSend(struct SimbricksBaseIf *base_if,
                              const void *payload, size_t payload_len) {
@@ -469,9 +946,12 @@ int SimbricksBaseIfIntroSend(struct SimbricksBaseIf *base_if,
 
   struct iovec iov[2];
   union {
-    char buf[CMSG_SPACE(sizeof(int))];
+    char buf[CMSG_SPACE(2 * sizeof(int))];
     struct cmsghdr align;
   } u;
+  int fds[2];
+  size_t n_fds = 0;
+  bool doorbell = base_if->params.doorbell && DoorbellInit(base_if) == 0;
   struct msghdr msg = {
       .msg_name = NULL,
       .msg_namelen = 0,
@@ -497,6 +977,18 @@ int SimbricksBaseIfIntroSend(struct SimbricksBaseIf *base_if,
                 (base_if->params.sync_mode == kSimbricksBaseIfSyncRequired
                      ? SIMBRICKS_PROTO_FLAGS_LI_SYNC_FORCE
                      : 0)));
+    if (base_if->params.multi_slot)
+      l_intro.flags |= SIMBRICKS_PROTO_FLAGS_LI_MULTI_SLOT;
+    if (doorbell && base_if->ctl != NULL)
+      l_intro.flags |= SIMBRICKS_PROTO_FLAGS_LI_DOORBELL;
+    if (RingV2Possible(base_if))
+      l_intro.flags |= SIMBRICKS_PROTO_FLAGS_LI_RING_V2;
+    if (base_if->params.adaptive_sync)
+      l_intro.flags |= SIMBRICKS_PROTO_FLAGS_LI_ADAPTIVE_SYNC;
+    if (base_if->params.sync_switch)
+      l_intro.flags |= SIMBRICKS_PROTO_FLAGS_LI_SYNC_SWITCH;
+    if (base_if->stats != NULL)
+      l_intro.flags |= SIMBRICKS_PROTO_FLAGS_LI_STATS;
 
     l_intro.l2c_offset = base_if->out_queue - base_if->shm->base;
     l_intro.l2c_elen = base_if->out_elen;
@@ -508,19 +1000,20 @@ int SimbricksBaseIfIntroSend(struct SimbricksBaseIf *base_if,
 
     l_intro.upper_layer_proto = base_if->params.upper_layer_proto;
     l_intro.upper_layer_intro_off = sizeof(l_intro);
+    l_intro.ctl_offset =
+        (base_if->ctl ? (void *)base_if->ctl - base_if->shm->base : 0);
+    l_intro.stats_offset =
+        (base_if->stats ? (void *)base_if->stats - base_if->shm->base : 0);
 
     iov[0].iov_base = &l_intro;
     iov[0].iov_len = sizeof(l_intro);
 
-    // listeners will also send the shm fd attached
-    msg.msg_control = u.buf;
-    msg.msg_controllen = sizeof(u.buf);
-
-    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
-    cmsg->cmsg_level = SOL_SOCKET;
-    cmsg->cmsg_type = SCM_RIGHTS;
-    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
-    *(int *)CMSG_DATA(cmsg) = base_if->shm->fd;
+    // listeners will also send the shm fd attached, followed by the eventfd,
+    // in-process connecters share the pool directly
+    if (base_if->inproc == NULL)
+      fds[n_fds++] = base_if->shm->fd;
+    if (l_intro.flags & SIMBRICKS_PROTO_FLAGS_LI_DOORBELL)
+      fds[n_fds++] = base_if->in_efd;
   } else {
     c_intro.version = SIMBRICKS_PROTO_VERSION;
     c_intro.flags =
@@ -530,6 +1023,18 @@ int SimbricksBaseIfIntroSend(struct SimbricksBaseIf *base_if,
                 (base_if->params.sync_mode == kSimbricksBaseIfSyncRequired
                      ? SIMBRICKS_PROTO_FLAGS_CO_SYNC_FORCE
                      : 0)));
+    if (base_if->params.multi_slot)
+      c_intro.flags |= SIMBRICKS_PROTO_FLAGS_CO_MULTI_SLOT;
+    if (doorbell) {
+      c_intro.flags |= SIMBRICKS_PROTO_FLAGS_CO_DOORBELL;
+      fds[n_fds++] = base_if->in_efd;
+    }
+    if (base_if->params.ring_v2)
+      c_intro.flags |= SIMBRICKS_PROTO_FLAGS_CO_RING_V2;
+    if (base_if->params.adaptive_sync)
+      c_intro.flags |= SIMBRICKS_PROTO_FLAGS_CO_ADAPTIVE_SYNC;
+    if (base_if->params.sync_switch)
+      c_intro.flags |= SIMBRICKS_PROTO_FLAGS_CO_SYNC_SWITCH;
     c_intro.upper_layer_proto = base_if->params.upper_layer_proto;
     c_intro.upper_layer_intro_off = sizeof(c_intro);
 
@@ -537,6 +1042,26 @@ int SimbricksBaseIfIntroSend(struct SimbricksBaseIf *base_if,
     iov[0].iov_len = sizeof(c_intro);
   }
 
+  if (base_if->inproc != NULL) {
+    ssize_t ret = InprocSend(base_if, iov, msg.msg_iovlen, fds, n_fds);
+    if (ret < 0) {
+      perror("SimbricksBaseIfIntroSend: posting in-process intro failed");
+      return -1;
+    }
+    goto out_sent;
+  }
+
+  if (n_fds > 0) {
+    msg.msg_control = u.buf;
+    msg.msg_controllen = CMSG_SPACE(n_fds * sizeof(int));
+
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(n_fds * sizeof(int));
+    memcpy(CMSG_DATA(cmsg), fds, n_fds * sizeof(int));
+  }
+
   ssize_t ret = sendmsg(base_if->conn_fd, &msg, 0);
   if (ret < 0) {
     perror("SimbricksBaseIfIntroSend: sendmsg failed");
@@ -548,6 +1073,7 @@ int SimbricksBaseIfIntroSend(struct SimbricksBaseIf *base_if,
     return -1;
   }
 
+out_sent:
   if (base_if->conn_state == kConnAwaitHandshakeTx) {
     base_if->conn_state = kConnOpen;
   } else if (base_if->conn_state == kConnAwaitHandshakeRxTx) {
@@ -570,7 +1096,9 @@ int SimbricksBaseIfIntroRecv(struct SimbricksBaseIf *base_if, void *payload,
     return -1;
   }
 
-  uint8_t intro_buf[2048];
+  uint8_t intro_buf[INTRO_BUF_SIZE];
+  int fds[2];
+  size_t n_fds = 0;
 
   struct iovec iov;
   iov.iov_base = intro_buf;
@@ -578,27 +1106,26 @@ int SimbricksBaseIfIntroRecv(struct SimbricksBaseIf *base_if, void *payload,
 
   struct cmsghdr *cmsg;
   union {
-    char buf[CMSG_SPACE(sizeof(int))];
+    char buf[CMSG_SPACE(2 * sizeof(int))];
     struct cmsghdr align;
   } u;
 
+  // connectors receive the shm fd, and both may receive the peer's eventfd
   struct msghdr msg = {
       .msg_name = NULL,
       .msg_namelen = 0,
       .msg_iov = &iov,
       .msg_iovlen = 1,
-      .msg_control = NULL,
-      .msg_controllen = 0,
+      .msg_control = u.buf,
+      .msg_controllen = sizeof(u.buf),
       .msg_flags = 0,
   };
 
-  if (!base_if->listener) {
-    // connectors will also receive the shm fd attached
-    msg.msg_control = u.buf;
-    msg.msg_controllen = sizeof(u.buf);
-  }
-
-  ssize_t ret = recvmsg(base_if->conn_fd, &msg, 0);
+  ssize_t ret;
+  if (base_if->inproc != NULL)
+    ret = InprocRecv(base_if, intro_buf, sizeof(intro_buf), fds, &n_fds);
+  else
+    ret = recvmsg(base_if->conn_fd, &msg, 0);
   if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
     // no handshake available yet
     return 1;
@@ -608,13 +1135,28 @@ int SimbricksBaseIfIntroRecv(struct SimbricksBaseIf *base_if, void *payload,
   }
 
   uint64_t version, upper_proto, upper_off;
-  bool sync, sync_force;
+  bool sync, sync_force, multi_slot, doorbell, ring_v2, adaptive_sync;
+  bool sync_switch;
+
+  cmsg = (base_if->inproc == NULL ? CMSG_FIRSTHDR(&msg) : NULL);
+  if (cmsg != NULL && cmsg->cmsg_level == SOL_SOCKET &&
+      cmsg->cmsg_type == SCM_RIGHTS) {
+    n_fds = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+    if (n_fds > 2)
+      n_fds = 2;
+    memcpy(fds, CMSG_DATA(cmsg), n_fds * sizeof(int));
+  }
 
   if (base_if->listener) {
     struct SimbricksProtoConnecterIntro *c_intro =
         (struct SimbricksProtoConnecterIntro *)intro_buf;
     sync = c_intro->flags & SIMBRICKS_PROTO_FLAGS_CO_SYNC;
     sync_force = c_intro->flags & SIMBRICKS_PROTO_FLAGS_CO_SYNC_FORCE;
+    multi_slot = c_intro->flags & SIMBRICKS_PROTO_FLAGS_CO_MULTI_SLOT;
+    doorbell = c_intro->flags & SIMBRICKS_PROTO_FLAGS_CO_DOORBELL;
+    ring_v2 = c_intro->flags & SIMBRICKS_PROTO_FLAGS_CO_RING_V2;
+    adaptive_sync = c_intro->flags & SIMBRICKS_PROTO_FLAGS_CO_ADAPTIVE_SYNC;
+    sync_switch = c_intro->flags & SIMBRICKS_PROTO_FLAGS_CO_SYNC_SWITCH;
     version = c_intro->version;
     upper_proto = c_intro->upper_layer_proto;
     upper_off = c_intro->upper_layer_intro_off;
@@ -624,6 +1166,11 @@ int SimbricksBaseIfIntroRecv(struct SimbricksBaseIf *base_if, void *payload,
 
     sync = l_intro->flags & SIMBRICKS_PROTO_FLAGS_LI_SYNC;
     sync_force = l_intro->flags & SIMBRICKS_PROTO_FLAGS_LI_SYNC_FORCE;
+    multi_slot = l_intro->flags & SIMBRICKS_PROTO_FLAGS_LI_MULTI_SLOT;
+    doorbell = l_intro->flags & SIMBRICKS_PROTO_FLAGS_LI_DOORBELL;
+    ring_v2 = l_intro->flags & SIMBRICKS_PROTO_FLAGS_LI_RING_V2;
+    adaptive_sync = l_intro->flags & SIMBRICKS_PROTO_FLAGS_LI_ADAPTIVE_SYNC;
+    sync_switch = l_intro->flags & SIMBRICKS_PROTO_FLAGS_LI_SYNC_SWITCH;
     version = l_intro->version;
     upper_proto = l_intro->upper_layer_proto;
     upper_off = l_intro->upper_layer_intro_off;
@@ -659,6 +1206,10 @@ int SimbricksBaseIfIntroRecv(struct SimbricksBaseIf *base_if, void *payload,
   } else {
     base_if->sync = sync || sync_force;
   }
+  base_if->multi_slot = multi_slot && base_if->params.multi_slot;
+  base_if->sync_switch = sync_switch && base_if->params.sync_switch;
+  base_if->adaptive_sync = (base_if->sync || base_if->sync_switch) &&
+                           adaptive_sync && base_if->params.adaptive_sync;
 
   size_t upper_layer_len = (size_t)ret - upper_off;
   if (*payload_len < upper_layer_len) {
@@ -675,16 +1226,21 @@ int SimbricksBaseIfIntroRecv(struct SimbricksBaseIf *base_if, void *payload,
     struct SimbricksProtoListenerIntro *l_intro =
         (struct SimbricksProtoListenerIntro *)intro_buf;
 
-    cmsg = CMSG_FIRSTHDR(&msg);
-    if (msg.msg_controllen <= 0 || cmsg->cmsg_len != CMSG_LEN(sizeof(int))) {
+    if (base_if->inproc != NULL) {
+      // in-process connecters use the listener's pool directly
+      base_if->shm = base_if->inproc->shm;
+      goto out_shm;
+    }
+
+    if (n_fds < 1) {
       /* TODO fix error handling (leaking fds) */
       fprintf(stderr,
               "SimbricksBaseIfIntroRecv: getting shm fd failed (%zu) "
-              "(%p != %zu)\n",
-              msg.msg_controllen, cmsg, CMSG_LEN(sizeof(int)));
+              "(%p)\n",
+              msg.msg_controllen, cmsg);
       return -1;
     }
-    int shmfd = *(int *)CMSG_DATA(cmsg);
+    int shmfd = fds[0];
     if ((base_if->shm = calloc(1, sizeof(*base_if->shm))) == NULL) {
       fprintf(stderr, "SimbricksBaseIfIntroRecv: getting shm fd failed\n");
       return -1;
@@ -697,6 +1253,7 @@ int SimbricksBaseIfIntroRecv(struct SimbricksBaseIf *base_if, void *payload,
       return -1;
     }
 
+  out_shm:
     base_if->out_queue = base_if->shm->base + l_intro->c2l_offset;
     base_if->out_elen = l_intro->c2l_elen;
     base_if->out_enum = l_intro->c2l_nentries;
@@ -704,6 +1261,40 @@ int SimbricksBaseIfIntroRecv(struct SimbricksBaseIf *base_if, void *payload,
     base_if->in_queue = base_if->shm->base + l_intro->l2c_offset;
     base_if->in_elen = l_intro->l2c_elen;
     base_if->in_enum = l_intro->l2c_nentries;
+
+    if (doorbell || ring_v2) {
+      base_if->ctl = base_if->shm->base + l_intro->ctl_offset;
+      base_if->in_waiting = &base_if->ctl->l2c_waiting;
+      base_if->out_waiting = &base_if->ctl->c2l_waiting;
+    }
+
+    /* our statistics block follows the listener's; listeners that do not
+     * set the flag may not even have a stats_offset field in their intro */
+    if ((l_intro->flags & SIMBRICKS_PROTO_FLAGS_LI_STATS) &&
+        base_if->params.stats)
+      base_if->stats = (volatile struct SimbricksProtoBaseIfStats *)(
+                           base_if->shm->base + l_intro->stats_offset) +
+                       1;
+  }
+
+  if (ring_v2 && RingV2Possible(base_if))
+    RingV2Setup(base_if, (base_if->listener ? base_if->out_enum
+                                            : base_if->in_enum));
+
+  // the peer's eventfd follows the shm fd for socket connecters
+  size_t efd_idx = (base_if->listener || base_if->inproc != NULL ? 0 : 1);
+  if (doorbell && n_fds > efd_idx && base_if->params.doorbell &&
+      base_if->ctl != NULL && DoorbellInit(base_if) == 0) {
+    base_if->out_efd = fds[efd_idx];
+    base_if->doorbell = true;
+  } else if (n_fds > efd_idx) {
+    close(fds[efd_idx]);
+  }
+
+  if (base_if->params.record_dir != NULL &&
+      SimbricksBaseIfRecordOpen(base_if, payload, upper_layer_len) != 0) {
+    fprintf(stderr, "SimbricksBaseIfIntroRecv: starting recording failed\n");
+    return -1;
   }
 
   if (base_if->conn_state == kConnAwaitHandshakeRx) {
@@ -726,6 +1317,8 @@ int SimbricksBaseIfIntroFd(struct SimbricksBaseIf *base_if) {
     case kConnAwaitHandshakeRxTx: /* FALLTRHOUGH */
     case kConnAwaitHandshakeRx:   /* FALLTRHOUGH */
     case kConnAwaitHandshakeTx:
+      if (base_if->inproc != NULL)
+        return base_if->inproc->efds[base_if->listener ? 0 : 1];
       return base_if->conn_fd;
 
     default:
@@ -825,7 +1418,10 @@ int SimBricksBaseIfEstablish(struct SimBricksBaseIfEstablishData *ifs,
 
 void SimbricksBaseIfClose(struct SimbricksBaseIf *base_if) {
   if (base_if->conn_state == kConnListening) {
-    close(base_if->listen_fd);
+    if (base_if->inproc != NULL)
+      InprocClose(base_if);
+    else
+      close(base_if->listen_fd);
     base_if->listen_fd = -1;
     base_if->conn_state = kConnClosed;
     return;
@@ -841,13 +1437,219 @@ void SimbricksBaseIfClose(struct SimbricksBaseIf *base_if) {
     SimbricksBaseIfOutSend(base_if, msg, SIMBRICKS_PROTO_MSG_TYPE_TERMINATE);
   }
 
-  close(base_if->conn_fd);
+  if (base_if->inproc != NULL)
+    InprocClose(base_if);
+  else
+    close(base_if->conn_fd);
   base_if->conn_fd = -1;
   base_if->conn_state = kConnClosed;
+  SimbricksBaseIfRecordClose(base_if);
+
+  base_if->doorbell = false;
+  if (base_if->in_efd >= 0) {
+    close(base_if->in_efd);
+    base_if->in_efd = -1;
+  }
+  if (base_if->out_efd >= 0) {
+    close(base_if->out_efd);
+    base_if->out_efd = -1;
+  }
 
   // TODO: if connecting end might need to unmap and free shm
 }
 
+void SimbricksBaseIfDoorbellRing(struct SimbricksBaseIf *base_if) {
+  uint64_t val = 1;
+  /* EAGAIN means the counter is saturated, the peer will wake up anyways */
+  if (write(base_if->out_efd, &val, sizeof(val)) < 0 && errno != EAGAIN)
+    perror("SimbricksBaseIfDoorbellRing: write failed");
+}
+
+static bool WaitInReady(struct SimbricksBaseIf *base_if) {
+  if (base_if->ring_v2) {
+    uint32_t seq = atomic_load_explicit(
+        (volatile _Atomic(uint32_t) *)&base_if->in_meta[base_if->in_pos].seq,
+        memory_order_acquire);
+    return seq == (uint32_t)(base_if->in_seq + 1);
+  }
+
+  volatile union SimbricksProtoBaseMsg *msg =
+      (volatile union SimbricksProtoBaseMsg *)(void *)((uint8_t *)
+                                                           base_if->in_queue +
+                                                       base_if->in_pos *
+                                                           base_if->in_elen);
+  uint8_t own_type = atomic_load_explicit(
+      (volatile _Atomic(uint8_t) *)&msg->header.own_type, memory_order_acquire);
+  return (own_type & SIMBRICKS_PROTO_MSG_OWN_MASK) ==
+         SIMBRICKS_PROTO_MSG_OWN_CON;
+}
+
+static bool WaitAnyReady(struct SimbricksBaseIf **base_ifs, size_t n) {
+  size_t i;
+  for (i = 0; i < n; i++) {
+    if (!base_ifs[i]->in_terminated && WaitInReady(base_ifs[i]))
+      return true;
+  }
+  return false;
+}
+
+int SimbricksBaseIfWaitAny(struct SimbricksBaseIf **base_ifs, size_t n,
+                           uint64_t spin_ns) {
+  struct pollfd pfds[n];
+  size_t i, n_pfd = 0;
+  uint64_t start = SHMTimeNs();
+
+  do {
+    if (WaitAnyReady(base_ifs, n))
+      return 0;
+  } while (SHMTimeNs() - start < spin_ns);
+
+  for (i = 0; i < n; i++) {
+    struct SimbricksBaseIf *bif = base_ifs[i];
+    if (bif->in_terminated)
+      continue;
+    if (!bif->doorbell)
+      return 1;
+
+    pfds[n_pfd].fd = bif->in_efd;
+    pfds[n_pfd].events = POLLIN;
+    pfds[n_pfd].revents = 0;
+    n_pfd++;
+  }
+  if (n_pfd == 0)
+    return 1;
+
+  for (i = 0; i < n; i++) {
+    if (!base_ifs[i]->in_terminated)
+      atomic_store_explicit(
+          (volatile _Atomic(uint32_t) *)base_ifs[i]->in_waiting, 1,
+          memory_order_relaxed);
+  }
+
+  /* pairs with the fence in SimbricksBaseIfOutDoorbell */
+  atomic_thread_fence(memory_order_seq_cst);
+
+  int ret = 0;
+  if (!WaitAnyReady(base_ifs, n))
+    ret = poll(pfds, n_pfd, -1);
+
+  for (i = 0; i < n; i++) {
+    if (!base_ifs[i]->in_terminated)
+      atomic_store_explicit(
+          (volatile _Atomic(uint32_t) *)base_ifs[i]->in_waiting, 0,
+          memory_order_relaxed);
+  }
+  for (i = 0; i < n_pfd; i++) {
+    uint64_t val;
+    if (pfds[i].revents & POLLIN)
+      (void)!read(pfds[i].fd, &val, sizeof(val));
+  }
+
+  if (ret < 0 && errno != EINTR) {
+    perror("SimbricksBaseIfWaitAny: poll failed");
+    return -1;
+  }
+  return (WaitAnyReady(base_ifs, n) ? 0 : 1);
+}
+
+static void SyncSwitchApply(struct SimbricksBaseIf *base_if, bool enable,
+                            uint64_t switch_ts) {
+  base_if->sync = enable;
+  /* the peer sends nothing stamped before the switch from now on */
+  uint64_t in_ts = switch_ts + base_if->params.link_latency;
+  if (enable && base_if->in_timestamp < in_ts)
+    base_if->in_timestamp = in_ts;
+}
+
+int SimbricksBaseIfSyncSwitch(struct SimbricksBaseIf *base_if, bool enable,
+                              uint64_t timestamp) {
+  if (!base_if->sync_switch) {
+    fprintf(stderr,
+            "SimbricksBaseIfSyncSwitch: runtime switches not supported by "
+            "both peers\n");
+    return -1;
+  } else if (base_if->sync_switch_pending) {
+    return -1;
+  } else if (!enable &&
+             base_if->params.sync_mode == kSimbricksBaseIfSyncRequired) {
+    fprintf(stderr,
+            "SimbricksBaseIfSyncSwitch: sync required locally, cannot "
+            "disable it\n");
+    return -1;
+  }
+
+  volatile union SimbricksProtoBaseMsg *msg =
+      SimbricksBaseIfOutAlloc(base_if, timestamp);
+  if (msg == NULL)
+    return -1;
+  msg->sync_mode.switch_ts = timestamp;
+  msg->sync_mode.flags = (enable ? SIMBRICKS_PROTO_SYNC_MODE_ENABLE : 0);
+  SimbricksBaseIfOutSend(base_if, msg, SIMBRICKS_PROTO_MSG_TYPE_SYNC_MODE);
+  base_if->sync_switch_pending = true;
+  return 0;
+}
+
+int SimbricksBaseIfSyncSwitchAck(struct SimbricksBaseIf *base_if,
+                                 uint64_t timestamp) {
+  volatile union SimbricksProtoBaseMsg *msg =
+      SimbricksBaseIfOutAlloc(base_if, timestamp);
+  if (msg == NULL)
+    return -1;
+
+  /* we may have gotten past the proposed time in the meantime */
+  bool enable = base_if->sync_switch_ack_enable;
+  msg->sync_mode.switch_ts = timestamp;
+  msg->sync_mode.flags = SIMBRICKS_PROTO_SYNC_MODE_ACK |
+                         (enable ? SIMBRICKS_PROTO_SYNC_MODE_ENABLE : 0);
+  SimbricksBaseIfOutSend(base_if, msg, SIMBRICKS_PROTO_MSG_TYPE_SYNC_MODE);
+  base_if->sync_switch_ack_due = false;
+  SyncSwitchApply(base_if, enable, timestamp);
+  return 0;
+}
+
+uint64_t SimbricksBaseIfSyncSwitchHandle(
+    struct SimbricksBaseIf *base_if, volatile union SimbricksProtoBaseMsg *msg,
+    uint64_t timestamp) {
+  bool enable = msg->sync_mode.flags & SIMBRICKS_PROTO_SYNC_MODE_ENABLE;
+  uint64_t switch_ts = msg->sync_mode.switch_ts;
+  if (switch_ts < timestamp)
+    switch_ts = timestamp;
+
+  if (!base_if->sync_switch) {
+    fprintf(stderr,
+            "SimbricksBaseIfSyncSwitchHandle: unexpected sync mode message\n");
+    return timestamp;
+  }
+
+  if (msg->sync_mode.flags & SIMBRICKS_PROTO_SYNC_MODE_ACK) {
+    if (!base_if->sync_switch_pending) {
+      fprintf(stderr,
+              "SimbricksBaseIfSyncSwitchHandle: unexpected acknowledgement\n");
+      return timestamp;
+    }
+    base_if->sync_switch_pending = false;
+    SyncSwitchApply(base_if, enable, switch_ts);
+    return switch_ts;
+  }
+
+  /* concurrent requests: the listener's wins, the connecter's is ignored */
+  if (base_if->sync_switch_pending) {
+    if (base_if->listener)
+      return timestamp;
+    base_if->sync_switch_pending = false;
+  }
+
+  /* refuse to turn off sync if we require it, the ack tells the peer */
+  if (!enable && base_if->params.sync_mode == kSimbricksBaseIfSyncRequired)
+    enable = true;
+
+  /* switch and ack from SimbricksBaseIfOutSync once we get there */
+  base_if->sync_switch_ack_due = true;
+  base_if->sync_switch_ack_enable = enable;
+  base_if->sync_switch_ack_ts = switch_ts;
+  return switch_ts;
+}
+
 void SimbricksBaseIfUnlink(struct SimbricksBaseIf *base_if) {
   // TODO
 }
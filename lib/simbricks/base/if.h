@@ -38,6 +38,9 @@
 
 #include <simbricks/base/proto.h>
 
+/** Number of empty polls accumulated before updating the statistics. */
+#define SIMBRICKS_BASE_IF_STAT_POLL_BATCH 1024
+
 /** Handle for a SHM pool. Treat as opaque. */
 struct SimbricksBaseIfSHMPool {
   const char *path;
@@ -47,6 +50,18 @@ struct SimbricksBaseIfSHMPool {
   size_t pos;
 };
 
+/** Backing memory for SHM pools. */
+enum SimbricksBaseIfSHMBackend {
+  /** Regular file at the pool path (e.g. on tmpfs). */
+  kSimbricksBaseIfSHMFile,
+  /** Anonymous memfd, only shared through the unix socket. */
+  kSimbricksBaseIfSHMMemfd,
+  /** Anonymous memfd backed by 2MB huge pages, falls back to memfd. */
+  kSimbricksBaseIfSHMHugetlb,
+  /** Private anonymous memory, only usable for in-process connections. */
+  kSimbricksBaseIfSHMHeap,
+};
+
 enum SimbricksBaseIfSyncMode {
   /** No synchronization enabled. */
   kSimbricksBaseIfSyncDisabled,
@@ -56,13 +71,19 @@ enum SimbricksBaseIfSyncMode {
   kSimbricksBaseIfSyncRequired,
 };
 
+struct SimbricksBaseIf;
+
 /** Parameters for a SimBricks interface */
 struct SimbricksBaseIfParams {
   /** Link latency/propagation delay [picoseconds] */
   uint64_t link_latency;
   /** Maximum gap between sync messages [picoseconds] */
   uint64_t sync_interval;
-  /** Unix socket path to listen on/connect to */
+  /**
+   * Unix socket path to listen on/connect to. Paths starting with "inproc:"
+   * instead name an in-process connection between two interfaces in the same
+   * process, established without sockets.
+   */
   const char *sock_path;
   /** Synchronization mode: disabled, optional, required */
   enum SimbricksBaseIfSyncMode sync_mode;
@@ -80,6 +101,72 @@ struct SimbricksBaseIfParams {
   size_t out_entries_size;
 
   uint64_t upper_layer_proto;
+
+  /**
+   * Allow messages spanning multiple consecutive queue slots. Only enabled if
+   * the peer supports it too. Messages longer than one slot must then be
+   * allocated with `SimbricksBaseIfOutAllocLen`.
+   */
+  bool multi_slot;
+
+  /**
+   * Allow blocking in `SimbricksBaseIfWaitAny` when idle, with the peer waking
+   * us up through an eventfd doorbell. Only enabled if the peer supports it
+   * too. Defaults to on if the SIMBRICKS_DOORBELL environment variable is set.
+   */
+  bool doorbell;
+  /**
+   * Time to spin in `SimbricksBaseIfWaitAny` before blocking [nanoseconds].
+   * Defaults to the value of SIMBRICKS_DOORBELL if set.
+   */
+  uint64_t doorbell_spin;
+
+  /**
+   * Use the v2 queue layout, with the ownership handover and timestamps kept
+   * separate from the message slots and a consumer-published head index. Only
+   * enabled if the peer supports it too and queue lengths and entry sizes are
+   * powers of two. Defaults to on if the SIMBRICKS_RING_V2 environment variable
+   * is set.
+   */
+  bool ring_v2;
+
+  /**
+   * Adaptive synchronization: sync messages carry a promise that no messages
+   * will be sent before the lookahead declared with
+   * `SimbricksBaseIfOutLookahead`, and further syncs are only sent once the
+   * promise runs out. Only enabled if the peer supports it too.
+   */
+  bool adaptive_sync;
+  /**
+   * Allow switching synchronization on and off at runtime with
+   * `SimbricksBaseIfSyncSwitch`, starting out in the mode negotiated at
+   * connection time. Only enabled if the peer supports it too. Received
+   * `SIMBRICKS_PROTO_MSG_TYPE_SYNC_MODE` messages must then be passed to
+   * `SimbricksBaseIfSyncSwitchHandle`.
+   */
+  bool sync_switch;
+
+  /**
+   * Maintain queue statistics in the pool header, for external monitoring
+   * tools such as simbricks-top. Defaults to on if the SIMBRICKS_STATS
+   * environment variable is set to anything but 0.
+   */
+  bool stats;
+
+  /**
+   * Record all messages received and sent on this interface to a file in this
+   * directory, for replay with simbricks-replay. Defaults to the value of the
+   * SIMBRICKS_RECORD_DIR environment variable, NULL to disable.
+   */
+  const char *record_dir;
+  /**
+   * Total length in bytes of a message of type `type` to record, including the
+   * header. Set by the upper layer protocols. NULL or a return value of 0
+   * records all slots occupied by the message.
+   */
+  size_t (*record_len)(struct SimbricksBaseIf *base_if,
+                       volatile union SimbricksProtoBaseMsg *msg, uint8_t type,
+                       bool out);
 };
 
 /** Handle for a SimBricks base interface. Treat as opaque. */
@@ -95,8 +182,64 @@ struct SimbricksBaseIf {
   size_t out_elen;
   size_t out_enum;
   uint64_t out_timestamp;
+  /* multi-slot: number of slots starting at out_pos known to be free */
+  size_t out_free;
 
   bool in_terminated;
+  bool multi_slot;
+
+  /* ring v2: enabled if both peers support it */
+  bool ring_v2;
+  /* slot meta data arrays in shared memory */
+  volatile struct SimbricksProtoBaseSlotMeta *in_meta;
+  volatile struct SimbricksProtoBaseSlotMeta *out_meta;
+  /* our and the peer's published number of released slots */
+  volatile uint64_t *in_head;
+  volatile uint64_t *out_head;
+  /* number of slots received/released so far */
+  uint64_t in_seq;
+  uint64_t in_released;
+  /* number of slots allocated so far/last known released by the peer */
+  uint64_t out_seq;
+  uint64_t out_released;
+
+  /* adaptive sync: enabled if both peers support it */
+  bool adaptive_sync;
+  /* declared lookahead and last promise sent */
+  uint64_t out_lookahead;
+  uint64_t out_promised;
+  /* last time a sync would have been sent without adaptive sync */
+  uint64_t out_suppressed_ts;
+  /* number of syncs sent and suppressed */
+  uint64_t syncs_sent;
+  uint64_t syncs_suppressed;
+
+  /* runtime sync switches: enabled if both peers support it */
+  bool sync_switch;
+  /* our switch request is waiting for the peer's acknowledgement */
+  bool sync_switch_pending;
+  /* peer's request is to be acknowledged once we reach the switch time */
+  bool sync_switch_ack_due;
+  bool sync_switch_ack_enable;
+  uint64_t sync_switch_ack_ts;
+
+  /* our statistics block in the pool header, NULL if disabled */
+  volatile struct SimbricksProtoBaseIfStats *stats;
+  /* empty polls not yet added to stats->polls_empty */
+  uint64_t polls_empty;
+  /* message recording, NULL if disabled */
+  struct SimbricksBaseIfRecorder *record;
+
+  /* doorbells: enabled if both peers support it */
+  bool doorbell;
+  /* eventfd we block on for incoming messages */
+  int in_efd;
+  /* peer's eventfd to ring after sending */
+  int out_efd;
+  /* shared control block and our/the peer's waiting flags in it */
+  struct SimbricksProtoBaseIfCtl *ctl;
+  volatile uint32_t *in_waiting;
+  volatile uint32_t *out_waiting;
 
   int conn_state;
   int sync;
@@ -105,6 +248,8 @@ struct SimbricksBaseIf {
   int listen_fd;
   int conn_fd;
   bool listener;
+  /* in-process connection, NULL for unix sockets */
+  struct SimbricksBaseIfInproc *inproc;
 };
 
 struct SimBricksBaseIfEstablishData {
@@ -117,9 +262,25 @@ struct SimBricksBaseIfEstablishData {
   size_t rx_intro_len;
 };
 
-/** Create and map a new shared memory pool with the specified path and size. */
+/**
+ * Create and map a new shared memory pool with the specified path and size.
+ * Uses the backend specified in the SIMBRICKS_SHM_BACKEND environment variable
+ * ("file", "memfd", "hugetlb", or "heap"), and a file by default. Paths
+ * starting with "inproc:" always use the heap backend.
+ *
+ * If the SIMBRICKS_SHM_TIMING environment variable is set, the backend and the
+ * time the pool took to be ready are reported on stderr.
+ */
 int SimbricksBaseIfSHMPoolCreate(struct SimbricksBaseIfSHMPool *pool,
                                  const char *path, size_t pool_size);
+/**
+ * Create and map a new shared memory pool with a specific backend. For the
+ * memfd backends the path is only used as the name of the memfd, the pool is
+ * shared with peers through the file descriptor passed along with the intro.
+ */
+int SimbricksBaseIfSHMPoolCreateBackend(struct SimbricksBaseIfSHMPool *pool,
+                                        const char *path, size_t pool_size,
+                                        enum SimbricksBaseIfSHMBackend backend);
 /** Map existing shared memory pool by file descriptor. */
 int SimbricksBaseIfSHMPoolMapFd(struct SimbricksBaseIfSHMPool *pool, int fd);
 /** Map existing shared memory pool by path. */
@@ -177,6 +338,68 @@ int SimBricksBaseIfEstablish(struct SimBricksBaseIfEstablishData *ifs,
 void SimbricksBaseIfClose(struct SimbricksBaseIf *base_if);
 void SimbricksBaseIfUnlink(struct SimbricksBaseIf *base_if);
 
+/**
+ * Wait till at least one of the interfaces has a message available (ignoring
+ * timestamps). Spins for `spin_ns` first, and then blocks on the interfaces'
+ * doorbells, if all of them have doorbells enabled. Otherwise this returns
+ * after spinning. Blocking is interrupted by signals. Terminated interfaces
+ * are ignored.
+ *
+ * @param base_ifs Base interfaces to wait on (connected).
+ * @param n        Number of interfaces.
+ * @param spin_ns  Time to spin before blocking [nanoseconds].
+ * @return 0 if a message is available, 1 if none is, -1 on error.
+ */
+int SimbricksBaseIfWaitAny(struct SimbricksBaseIf **base_ifs, size_t n,
+                           uint64_t spin_ns);
+
+/** Doorbell slow path for `SimbricksBaseIfOutSend`: wake up blocked peer. */
+void SimbricksBaseIfDoorbellRing(struct SimbricksBaseIf *base_if);
+
+/** Sync switch slow path for `SimbricksBaseIfOutSync`: switch and ack. */
+int SimbricksBaseIfSyncSwitchAck(struct SimbricksBaseIf *base_if,
+                                 uint64_t timestamp);
+
+/** Recording slow path: append message to the recording. */
+void SimbricksBaseIfRecordMsg(struct SimbricksBaseIf *base_if,
+                              volatile union SimbricksProtoBaseMsg *msg,
+                              uint8_t type, bool out);
+
+/** Add to a statistics counter, only ever written by us. */
+static inline void SimbricksBaseIfStatAdd(volatile uint64_t *ctr, uint64_t n) {
+  atomic_store_explicit((volatile _Atomic(uint64_t) *)ctr, *ctr + n,
+                        memory_order_relaxed);
+}
+
+/** Update a statistics value, only ever written by us. */
+static inline void SimbricksBaseIfStatSet(volatile uint64_t *ctr, uint64_t v) {
+  atomic_store_explicit((volatile _Atomic(uint64_t) *)ctr, v,
+                        memory_order_relaxed);
+}
+
+/** Account for an empty poll in the statistics, in batches. */
+static inline void SimbricksBaseIfStatPollEmpty(
+    struct SimbricksBaseIf *base_if) {
+  if (++base_if->polls_empty == SIMBRICKS_BASE_IF_STAT_POLL_BATCH) {
+    SimbricksBaseIfStatAdd(&base_if->stats->polls_empty,
+                           SIMBRICKS_BASE_IF_STAT_POLL_BATCH);
+    base_if->polls_empty = 0;
+  }
+}
+
+/** Account for a received message in the statistics. */
+static inline void SimbricksBaseIfStatIn(
+    struct SimbricksBaseIf *base_if,
+    volatile union SimbricksProtoBaseMsg *msg) {
+  volatile struct SimbricksProtoBaseIfStats *stats = base_if->stats;
+  uint8_t type = msg->header.own_type & ~SIMBRICKS_PROTO_MSG_OWN_MASK;
+  if (type == SIMBRICKS_PROTO_MSG_TYPE_SYNC)
+    SimbricksBaseIfStatAdd(&stats->syncs_in, 1);
+  else
+    SimbricksBaseIfStatAdd(&stats->msgs_in, 1);
+  SimbricksBaseIfStatSet(&stats->in_timestamp, msg->header.timestamp);
+}
+
 /**
  * Read message type from received message.
  *
@@ -204,21 +427,75 @@ static inline volatile union SimbricksProtoBaseMsg *SimbricksBaseIfInPeek(
                                                            base_if->in_queue +
                                                        base_if->in_pos *
                                                            base_if->in_elen);
-  uint8_t own_type = atomic_load_explicit(
-      (volatile _Atomic(uint8_t) *)&msg->header.own_type, memory_order_acquire);
+  if (base_if->ring_v2) {
+    volatile struct SimbricksProtoBaseSlotMeta *meta =
+        &base_if->in_meta[base_if->in_pos];
+    uint32_t seq = atomic_load_explicit(
+        (volatile _Atomic(uint32_t) *)&meta->seq, memory_order_acquire);
 
-  /* message not ready */
-  if ((own_type & SIMBRICKS_PROTO_MSG_OWN_MASK) != SIMBRICKS_PROTO_MSG_OWN_CON)
-    return NULL;
+    /* message not ready */
+    if (seq != (uint32_t)(base_if->in_seq + 1))
+      return NULL;
+    base_if->in_timestamp = meta->timestamp;
+  } else {
+    uint8_t own_type =
+        atomic_load_explicit((volatile _Atomic(uint8_t) *)&msg->header.own_type,
+                             memory_order_acquire);
+
+    /* message not ready */
+    if ((own_type & SIMBRICKS_PROTO_MSG_OWN_MASK) !=
+        SIMBRICKS_PROTO_MSG_OWN_CON)
+      return NULL;
+    base_if->in_timestamp = msg->header.timestamp;
+  }
+
+  /* an adaptive sync only becomes due once its promise has been reached, the
+   * next message cannot carry an earlier timestamp */
+  if (base_if->adaptive_sync &&
+      SimbricksBaseIfInType(base_if, msg) == SIMBRICKS_PROTO_MSG_TYPE_SYNC &&
+      msg->sync.promise > base_if->in_timestamp)
+    base_if->in_timestamp = msg->sync.promise;
 
   /* if in sync mode, wait till message is ready */
-  base_if->in_timestamp = msg->header.timestamp;
   if (base_if->sync && base_if->in_timestamp > timestamp)
     return NULL;
 
   return msg;
 }
 
+/**
+ * Advance the input position past a message returned by
+ * `SimbricksBaseIfInPeek` and handle terminate messages.
+ */
+static inline void SimbricksBaseIfInAdvance(
+    struct SimbricksBaseIf *base_if,
+    volatile union SimbricksProtoBaseMsg *msg) {
+  size_t slots = 1;
+  if (base_if->multi_slot)
+    slots += msg->header.cont_slots;
+  if (base_if->ring_v2) {
+    base_if->in_seq += slots;
+    base_if->in_pos = base_if->in_seq & (base_if->in_enum - 1);
+  } else {
+    base_if->in_pos += slots;
+    if (base_if->in_pos >= base_if->in_enum)
+      base_if->in_pos -= base_if->in_enum;
+  }
+
+  if (base_if->stats)
+    SimbricksBaseIfStatIn(base_if, msg);
+
+  uint8_t type = SimbricksBaseIfInType(base_if, msg);
+  if (base_if->record)
+    SimbricksBaseIfRecordMsg(base_if, msg, type, false);
+  if (type == SIMBRICKS_PROTO_MSG_TYPE_TERMINATE) {
+    base_if->in_terminated = true;
+    base_if->sync = false;
+    base_if->in_timestamp = UINT64_MAX;
+    base_if->out_timestamp = UINT64_MAX;
+  }
+}
+
 /**
  * Poll for an incoming message. After processing the message must be freed by
  * calling `SimbricksBaseIfInDone`.
@@ -232,23 +509,16 @@ static inline volatile union SimbricksProtoBaseMsg *SimbricksBaseIfInPoll(
   volatile union SimbricksProtoBaseMsg *msg =
       SimbricksBaseIfInPeek(base_if, timestamp);
 
-  if (msg != NULL) {
-    base_if->in_pos = (base_if->in_pos + 1) % base_if->in_enum;
-
-    if (SimbricksBaseIfInType(base_if, msg) ==
-        SIMBRICKS_PROTO_MSG_TYPE_TERMINATE) {
-      base_if->in_terminated = true;
-      base_if->sync = false;
-      base_if->in_timestamp = UINT64_MAX;
-      base_if->out_timestamp = UINT64_MAX;
-    }
-  }
+  if (msg != NULL)
+    SimbricksBaseIfInAdvance(base_if, msg);
+  else if (base_if->stats)
+    SimbricksBaseIfStatPollEmpty(base_if);
   return msg;
 }
 
 /**
  * Mark received message as processed and pass ownership of the slot back to the
- * sender.
+ * sender. With the v2 queue layout messages must be released in receive order.
  *
  * @param base_if  Base interface handle (connected).
  * @param msg      Pointer to the previously received message.
@@ -256,6 +526,15 @@ static inline volatile union SimbricksProtoBaseMsg *SimbricksBaseIfInPoll(
 static inline void SimbricksBaseIfInDone(
     struct SimbricksBaseIf *base_if,
     volatile union SimbricksProtoBaseMsg *msg) {
+  if (base_if->ring_v2) {
+    base_if->in_released += 1;
+    if (base_if->multi_slot)
+      base_if->in_released += msg->header.cont_slots;
+    atomic_store_explicit((volatile _Atomic(uint64_t) *)base_if->in_head,
+                          base_if->in_released, memory_order_release);
+    return;
+  }
+
   atomic_store_explicit(
       (volatile _Atomic(uint8_t) *)&msg->header.own_type,
       (uint8_t)((msg->header.own_type & ~SIMBRICKS_PROTO_MSG_OWN_MASK) |
@@ -263,6 +542,120 @@ static inline void SimbricksBaseIfInDone(
       memory_order_release);
 }
 
+/**
+ * Poll for up to `max` consecutive incoming messages at once. Messages are
+ * returned in queue order and the same rules as for `SimbricksBaseIfInPoll`
+ * apply to each of them: the burst ends at the first slot that is not ready yet
+ * or, in sync mode, carries a future timestamp (`SimbricksBaseIfInTimestamp`
+ * then reports that timestamp). A terminate message ends the burst and is
+ * included as the last message. All returned messages must be freed, in order,
+ * with `SimbricksBaseIfInDone` or `SimbricksBaseIfInDoneBurst`.
+ *
+ * @param base_if   Base interface handle (connected).
+ * @param timestamp Current timestamp (in picoseconds).
+ * @param msgs      Array to store pointers to the received messages in.
+ * @param max       Maximal number of messages to receive (size of `msgs`).
+ * @return Number of messages received.
+ */
+static inline size_t SimbricksBaseIfInPollBurst(
+    struct SimbricksBaseIf *base_if, uint64_t timestamp,
+    volatile union SimbricksProtoBaseMsg **msgs, size_t max) {
+  size_t n;
+  size_t pos = base_if->in_pos;
+
+  if (base_if->ring_v2) {
+    for (n = 0; n < max; n++) {
+      if ((msgs[n] = SimbricksBaseIfInPeek(base_if, timestamp)) == NULL)
+        break;
+      SimbricksBaseIfInAdvance(base_if, msgs[n]);
+      if (base_if->in_terminated) {
+        n++;
+        break;
+      }
+    }
+    goto out_stats;
+  }
+
+  for (n = 0; n < max; n++) {
+    volatile union SimbricksProtoBaseMsg *msg =
+        (volatile union SimbricksProtoBaseMsg *)(void *)((uint8_t *)base_if
+                                                             ->in_queue +
+                                                         pos *
+                                                             base_if->in_elen);
+    uint8_t own_type =
+        atomic_load_explicit((volatile _Atomic(uint8_t) *)&msg->header.own_type,
+                             memory_order_acquire);
+    if ((own_type & SIMBRICKS_PROTO_MSG_OWN_MASK) !=
+        SIMBRICKS_PROTO_MSG_OWN_CON)
+      break;
+
+    uint8_t type = own_type & ~SIMBRICKS_PROTO_MSG_OWN_MASK;
+    base_if->in_timestamp = msg->header.timestamp;
+    if (base_if->adaptive_sync && type == SIMBRICKS_PROTO_MSG_TYPE_SYNC &&
+        msg->sync.promise > base_if->in_timestamp)
+      base_if->in_timestamp = msg->sync.promise;
+    if (base_if->sync && base_if->in_timestamp > timestamp)
+      break;
+
+    msgs[n] = msg;
+    pos += 1;
+    if (base_if->multi_slot)
+      pos += msg->header.cont_slots;
+    if (pos >= base_if->in_enum)
+      pos -= base_if->in_enum;
+    if (base_if->stats)
+      SimbricksBaseIfStatIn(base_if, msg);
+    if (base_if->record)
+      SimbricksBaseIfRecordMsg(base_if, msg, type, false);
+
+    if (type == SIMBRICKS_PROTO_MSG_TYPE_TERMINATE) {
+      base_if->in_terminated = true;
+      base_if->sync = false;
+      base_if->in_timestamp = UINT64_MAX;
+      base_if->out_timestamp = UINT64_MAX;
+      n++;
+      break;
+    }
+  }
+
+  base_if->in_pos = pos;
+
+out_stats:
+  if (n == 0 && base_if->stats)
+    SimbricksBaseIfStatPollEmpty(base_if);
+  return n;
+}
+
+/**
+ * Mark a burst of received messages as processed and pass ownership of the
+ * slots back to the sender.
+ *
+ * @param base_if  Base interface handle (connected).
+ * @param msgs     Messages previously received (in receive order).
+ * @param n        Number of messages in `msgs`.
+ */
+static inline void SimbricksBaseIfInDoneBurst(
+    struct SimbricksBaseIf *base_if,
+    volatile union SimbricksProtoBaseMsg *const *msgs, size_t n) {
+  size_t i;
+
+  if (base_if->ring_v2) {
+    if (n == 0)
+      return;
+    base_if->in_released += n;
+    if (base_if->multi_slot) {
+      for (i = 0; i < n; i++)
+        base_if->in_released += msgs[i]->header.cont_slots;
+    }
+    atomic_store_explicit((volatile _Atomic(uint64_t) *)base_if->in_head,
+                          base_if->in_released, memory_order_release);
+    return;
+  }
+
+  for (i = 0; i < n; i++)
+    SimbricksBaseIfInDone(base_if, msgs[i]);
+}
+
 /**
  * Message timestamp of the next. Valid only after a poll failed because of a
  * future timestamp.
@@ -284,6 +677,183 @@ static inline int SimbricksBaseIfInTerminated(struct SimbricksBaseIf *base_if) {
   return base_if->in_terminated;
 }
 
+/**
+ * Ring the peer's doorbell after handing over messages if it is about to block
+ * waiting for them.
+ *
+ * @param base_if  Base interface handle (connected).
+ */
+static inline void SimbricksBaseIfOutDoorbell(struct SimbricksBaseIf *base_if) {
+  if (!base_if->doorbell)
+    return;
+
+  /* pairs with the fence in SimbricksBaseIfWaitAny: either we see the waiting
+   * flag or the peer sees our messages before blocking */
+  atomic_thread_fence(memory_order_seq_cst);
+  if (atomic_load_explicit((volatile _Atomic(uint32_t) *)base_if->out_waiting,
+                           memory_order_relaxed))
+    SimbricksBaseIfDoorbellRing(base_if);
+}
+
+/**
+ * Hand a message over to the consumer, without ringing the doorbell.
+ */
+static inline void SimbricksBaseIfOutHandover(
+    struct SimbricksBaseIf *base_if, volatile union SimbricksProtoBaseMsg *msg,
+    uint8_t msg_type) {
+  if (base_if->stats) {
+    volatile struct SimbricksProtoBaseIfStats *stats = base_if->stats;
+    if (msg_type == SIMBRICKS_PROTO_MSG_TYPE_SYNC)
+      SimbricksBaseIfStatAdd(&stats->syncs_out, 1);
+    else
+      SimbricksBaseIfStatAdd(&stats->msgs_out, 1);
+    SimbricksBaseIfStatSet(&stats->out_timestamp, base_if->out_timestamp);
+  }
+  if (base_if->record)
+    SimbricksBaseIfRecordMsg(base_if, msg, msg_type, true);
+
+  if (!base_if->ring_v2) {
+    atomic_store_explicit((volatile _Atomic(uint8_t) *)&msg->header.own_type,
+                          (uint8_t)(msg_type | SIMBRICKS_PROTO_MSG_OWN_CON),
+                          memory_order_release);
+    return;
+  }
+
+  /* the message is one of the outstanding ones before out_pos, derive the
+   * sequence number of its first slot from the distance */
+  size_t pos = ((uintptr_t)msg - (uintptr_t)base_if->out_queue) >>
+               __builtin_ctzl(base_if->out_elen);
+  size_t dist = ((base_if->out_pos - pos - 1) & (base_if->out_enum - 1)) + 1;
+  uint64_t seq = base_if->out_seq - dist;
+
+  /* still set the ownership flag so SimbricksBaseIfInType works unchanged */
+  msg->header.own_type = (uint8_t)(msg_type | SIMBRICKS_PROTO_MSG_OWN_CON);
+  atomic_store_explicit(
+      (volatile _Atomic(uint32_t) *)&base_if->out_meta[pos].seq,
+      (uint32_t)(seq + 1), memory_order_release);
+}
+
+/**
+ * Send out a fully filled message. Sets the message type and ownership flag.
+ * Also acts as a compiler barrier to avoid other writes to the message being
+ * reordered after this.
+ *
+ * @param base_if  Base interface handle (connected).
+ * @param msg      Pointer to the previously allocated and fully initialized
+                   message (other than the type.).
+ * @param msg_type Message type to set (without ownership flag).
+ */
+static inline void SimbricksBaseIfOutSend(
+    struct SimbricksBaseIf *base_if, volatile union SimbricksProtoBaseMsg *msg,
+    uint8_t msg_type) {
+  SimbricksBaseIfOutHandover(base_if, msg, msg_type);
+  SimbricksBaseIfOutDoorbell(base_if);
+}
+
+/** Account for a failed allocation because of a full queue. */
+static inline void SimbricksBaseIfStatOutFull(struct SimbricksBaseIf *base_if) {
+  if (base_if->stats)
+    SimbricksBaseIfStatAdd(&base_if->stats->out_full, 1);
+}
+
+/**
+ * Multi-slot mode and v2 layout: make sure at least `slots` slots starting at
+ * the current output position are free. As only the first slot of a message
+ * carries a valid ownership flag, this walks the messages of the previous round
+ * through the queue in order. With the v2 layout this instead only re-reads
+ * the consumer's head index when the last known one does not leave enough
+ * room.
+ */
+static inline bool SimbricksBaseIfOutReclaim(struct SimbricksBaseIf *base_if,
+                                             size_t slots) {
+  if (base_if->ring_v2) {
+    if (base_if->out_enum - (base_if->out_seq - base_if->out_released) >= slots)
+      return true;
+    base_if->out_released =
+        atomic_load_explicit((volatile _Atomic(uint64_t) *)base_if->out_head,
+                             memory_order_acquire);
+    return base_if->out_enum - (base_if->out_seq - base_if->out_released) >=
+           slots;
+  }
+
+  while (base_if->out_free < slots) {
+    size_t pos = base_if->out_pos + base_if->out_free;
+    if (pos >= base_if->out_enum)
+      pos -= base_if->out_enum;
+
+    volatile union SimbricksProtoBaseMsg *msg =
+        (volatile union SimbricksProtoBaseMsg *)(void *)((uint8_t *)base_if
+                                                             ->out_queue +
+                                                         pos *
+                                                             base_if->out_elen);
+    uint8_t own_type =
+        atomic_load_explicit((volatile _Atomic(uint8_t) *)&msg->header.own_type,
+                             memory_order_acquire);
+    if ((own_type & SIMBRICKS_PROTO_MSG_OWN_MASK) !=
+        SIMBRICKS_PROTO_MSG_OWN_PRO)
+      return false;
+
+    base_if->out_free += 1 + msg->header.cont_slots;
+  }
+  return true;
+}
+
+/**
+ * Multi-slot mode and v2 layout: claim `slots` slots at the current output
+ * position, that have previously been reclaimed.
+ */
+static inline volatile union SimbricksProtoBaseMsg *SimbricksBaseIfOutClaim(
+    struct SimbricksBaseIf *base_if, uint64_t timestamp, size_t slots) {
+  volatile union SimbricksProtoBaseMsg *msg =
+      (volatile union SimbricksProtoBaseMsg *)(void *)((uint8_t *)
+                                                           base_if->out_queue +
+                                                       base_if->out_pos *
+                                                           base_if->out_elen);
+  uint64_t msg_ts = timestamp + base_if->params.link_latency;
+
+  msg->header.cont_slots = (uint8_t)(slots - 1);
+  msg->header.timestamp = msg_ts;
+  base_if->out_timestamp = timestamp;
+  if (base_if->ring_v2) {
+    base_if->out_meta[base_if->out_pos].timestamp = msg_ts;
+    base_if->out_seq += slots;
+    base_if->out_pos = base_if->out_seq & (base_if->out_enum - 1);
+  } else {
+    base_if->out_free -= slots;
+    base_if->out_pos += slots;
+    if (base_if->out_pos == base_if->out_enum)
+      base_if->out_pos = 0;
+  }
+  return msg;
+}
+
+/**
+ * Multi-slot mode and v2 layout: allocate `slots` contiguous slots. Pads the
+ * end of the queue with sync messages if the message would otherwise wrap
+ * around.
+ */
+static inline volatile union SimbricksProtoBaseMsg *
+SimbricksBaseIfOutAllocMultiSlot(struct SimbricksBaseIf *base_if,
+                                 uint64_t timestamp, size_t slots) {
+  while (base_if->out_pos + slots > base_if->out_enum) {
+    if (!SimbricksBaseIfOutReclaim(base_if, 1)) {
+      SimbricksBaseIfStatOutFull(base_if);
+      return NULL;
+    }
+
+    volatile union SimbricksProtoBaseMsg *msg =
+        SimbricksBaseIfOutClaim(base_if, timestamp, 1);
+    msg->sync.promise = 0;
+    SimbricksBaseIfOutSend(base_if, msg, SIMBRICKS_PROTO_MSG_TYPE_SYNC);
+  }
+
+  if (!SimbricksBaseIfOutReclaim(base_if, slots)) {
+    SimbricksBaseIfStatOutFull(base_if);
+    return NULL;
+  }
+  return SimbricksBaseIfOutClaim(base_if, timestamp, slots);
+}
+
 /**
  * Allocate a new message in the queue. Must be followed by a call to
  * `SimbricksBaseIfOutSend`.
@@ -294,6 +864,9 @@ static inline int SimbricksBaseIfInTerminated(struct SimbricksBaseIf *base_if) {
  */
 static inline volatile union SimbricksProtoBaseMsg *SimbricksBaseIfOutAlloc(
     struct SimbricksBaseIf *base_if, uint64_t timestamp) {
+  if (base_if->multi_slot || base_if->ring_v2)
+    return SimbricksBaseIfOutAllocMultiSlot(base_if, timestamp, 1);
+
   volatile union SimbricksProtoBaseMsg *msg =
       (volatile union SimbricksProtoBaseMsg *)(void *)((uint8_t *)
                                                            base_if->out_queue +
@@ -304,36 +877,169 @@ static inline volatile union SimbricksProtoBaseMsg *SimbricksBaseIfOutAlloc(
       (volatile _Atomic(uint8_t) *)&msg->header.own_type, memory_order_acquire);
   if ((own_type & SIMBRICKS_PROTO_MSG_OWN_MASK) !=
       SIMBRICKS_PROTO_MSG_OWN_PRO) {
+    SimbricksBaseIfStatOutFull(base_if);
     return NULL;
   }
 
   msg->header.timestamp = timestamp + base_if->params.link_latency;
   base_if->out_timestamp = timestamp;
 
-  base_if->out_pos = (base_if->out_pos + 1) % base_if->out_enum;
+  if (++base_if->out_pos == base_if->out_enum)
+    base_if->out_pos = 0;
   return msg;
 }
 
 /**
- * Send out a fully filled message. Sets the message type and ownership flag.
- * Also acts as a compiler barrier to avoid other writes to the message being
- * reordered after this.
+ * Maximal number of slots a single outgoing message can span.
+ *
+ * @param base_if Base interface handle (connected).
+ * @return Number of slots, 1 if multi-slot messages are not enabled.
+ */
+static inline size_t SimbricksBaseIfOutMaxSlots(
+    struct SimbricksBaseIf *base_if) {
+  if (!base_if->multi_slot)
+    return 1;
+  return (base_if->out_enum < SIMBRICKS_PROTO_MSG_MAX_SLOTS
+              ? base_if->out_enum
+              : SIMBRICKS_PROTO_MSG_MAX_SLOTS);
+}
+
+/**
+ * Allocate a new message spanning `slots` consecutive slots in the queue. The
+ * payload following the header is contiguous across all slots. Must be
+ * followed by a call to `SimbricksBaseIfOutSend`.
+ *
+ * @param base_if   Base interface handle (connected).
+ * @param timestamp Current timestamp (in picoseconds).
+ * @param slots     Number of slots to allocate (at most
+ *                  `SimbricksBaseIfOutMaxSlots`).
+ * @return Pointer to the message struct if successful, NULL otherwise.
+ */
+static inline volatile union SimbricksProtoBaseMsg *
+SimbricksBaseIfOutAllocSlots(struct SimbricksBaseIf *base_if,
+                             uint64_t timestamp, size_t slots) {
+  if (slots == 1)
+    return SimbricksBaseIfOutAlloc(base_if, timestamp);
+  if (slots == 0 || slots > SimbricksBaseIfOutMaxSlots(base_if))
+    return NULL;
+  return SimbricksBaseIfOutAllocMultiSlot(base_if, timestamp, slots);
+}
+
+/**
+ * Allocate a new message of `len` bytes in total (including the header),
+ * spanning as many slots as necessary. Must be followed by a call to
+ * `SimbricksBaseIfOutSend`.
+ *
+ * @param base_if   Base interface handle (connected).
+ * @param timestamp Current timestamp (in picoseconds).
+ * @param len       Total message length in bytes (at most
+ *                  `SimbricksBaseIfOutMaxMsgLen`).
+ * @return Pointer to the message struct if successful, NULL otherwise.
+ */
+static inline volatile union SimbricksProtoBaseMsg *SimbricksBaseIfOutAllocLen(
+    struct SimbricksBaseIf *base_if, uint64_t timestamp, size_t len) {
+  size_t slots = 1;
+  if (len > base_if->out_elen)
+    slots = (len + base_if->out_elen - 1) / base_if->out_elen;
+  return SimbricksBaseIfOutAllocSlots(base_if, timestamp, slots);
+}
+
+/**
+ * Allocate up to `max` consecutive messages in the queue at once, all with the
+ * same timestamp. Every allocated message must be passed to
+ * `SimbricksBaseIfOutSend` or `SimbricksBaseIfOutSendBurst` in allocation
+ * order, as the receiver processes the queue strictly in order.
+ *
+ * @param base_if   Base interface handle (connected).
+ * @param timestamp Current timestamp (in picoseconds).
+ * @param msgs      Array to store pointers to the allocated messages in.
+ * @param max       Maximal number of messages to allocate (size of `msgs`).
+ * @return Number of messages allocated, 0 if the queue is full.
+ */
+static inline size_t SimbricksBaseIfOutAllocBurst(
+    struct SimbricksBaseIf *base_if, uint64_t timestamp,
+    volatile union SimbricksProtoBaseMsg **msgs, size_t max) {
+  size_t n;
+  size_t pos = base_if->out_pos;
+  uint64_t msg_ts = timestamp + base_if->params.link_latency;
+
+  if (base_if->multi_slot || base_if->ring_v2) {
+    for (n = 0; n < max; n++) {
+      if ((msgs[n] = SimbricksBaseIfOutAllocMultiSlot(base_if, timestamp,
+                                                      1)) == NULL)
+        break;
+    }
+    return n;
+  }
+
+  for (n = 0; n < max; n++) {
+    volatile union SimbricksProtoBaseMsg *msg =
+        (volatile union SimbricksProtoBaseMsg *)(void *)((uint8_t *)base_if
+                                                             ->out_queue +
+                                                         pos *
+                                                             base_if->out_elen);
+    uint8_t own_type =
+        atomic_load_explicit((volatile _Atomic(uint8_t) *)&msg->header.own_type,
+                             memory_order_acquire);
+    if ((own_type & SIMBRICKS_PROTO_MSG_OWN_MASK) !=
+        SIMBRICKS_PROTO_MSG_OWN_PRO)
+      break;
+
+    msg->header.timestamp = msg_ts;
+    msgs[n] = msg;
+    if (++pos == base_if->out_enum)
+      pos = 0;
+  }
+
+  if (n > 0) {
+    base_if->out_timestamp = timestamp;
+    base_if->out_pos = pos;
+  }
+  if (n < max)
+    SimbricksBaseIfStatOutFull(base_if);
+  return n;
+}
+
+/**
+ * Send out a burst of fully filled messages, all with the same type. Messages
+ * are handed to the receiver in array order.
  *
  * @param base_if  Base interface handle (connected).
- * @param msg      Pointer to the previously allocated and fully initialized
-                   message (other than the type.).
+ * @param msgs     Previously allocated and fully initialized messages (in
+ *                 allocation order).
+ * @param n        Number of messages in `msgs`.
  * @param msg_type Message type to set (without ownership flag).
  */
-static inline void SimbricksBaseIfOutSend(
-    struct SimbricksBaseIf *base_if, volatile union SimbricksProtoBaseMsg *msg,
+static inline void SimbricksBaseIfOutSendBurst(
+    struct SimbricksBaseIf *base_if,
+    volatile union SimbricksProtoBaseMsg *const *msgs, size_t n,
     uint8_t msg_type) {
-  atomic_store_explicit((volatile _Atomic(uint8_t) *)&msg->header.own_type,
-                        (uint8_t)(msg_type | SIMBRICKS_PROTO_MSG_OWN_CON),
-                        memory_order_release);
+  size_t i;
+  for (i = 0; i < n; i++)
+    SimbricksBaseIfOutHandover(base_if, msgs[i], msg_type);
+  SimbricksBaseIfOutDoorbell(base_if);
+}
+
+/**
+ * Declare the lookahead for adaptive synchronization: no messages will be sent
+ * on this interface with a timestamp before `timestamp` (before adding the
+ * link latency). Typically the minimum of the next local event and the input
+ * timestamps of all interfaces that can trigger sends on this one. Must be
+ * updated before every call to `SimbricksBaseIfOutSync`, and must never be
+ * lowered below a value already passed to a sync.
+ *
+ * @param base_if   Base interface handle (connected).
+ * @param timestamp Earliest timestamp of the next message (in picoseconds).
+ */
+static inline void SimbricksBaseIfOutLookahead(struct SimbricksBaseIf *base_if,
+                                               uint64_t timestamp) {
+  base_if->out_lookahead = timestamp;
 }
 
 /**
- * Send a synchronization dummy message if necessary.
+ * Send a synchronization dummy message if necessary. With adaptive
+ * synchronization the sync carries the declared lookahead as a promise and the
+ * next sync is only due a sync interval after the promise.
  *
  * @param base_if   Base interface handle (connected).
  * @param timestamp Current timestamp (in picoseconds).
@@ -342,17 +1048,44 @@ static inline void SimbricksBaseIfOutSend(
  */
 static inline int SimbricksBaseIfOutSync(struct SimbricksBaseIf *base_if,
                                          uint64_t timestamp) {
+  if (base_if->sync_switch_ack_due &&
+      timestamp >= base_if->sync_switch_ack_ts &&
+      SimbricksBaseIfSyncSwitchAck(base_if, timestamp) != 0)
+    return -1;
+
   if (!base_if->sync ||
       (base_if->out_timestamp > 0 &&
        timestamp - base_if->out_timestamp < base_if->params.sync_interval))
     return 0;
 
+  if (base_if->adaptive_sync && base_if->out_timestamp > 0 &&
+      timestamp < base_if->out_promised + base_if->params.sync_interval) {
+    /* count one suppressed sync per interval that would have been sent */
+    if (timestamp - base_if->out_suppressed_ts >=
+        base_if->params.sync_interval) {
+      base_if->out_suppressed_ts = timestamp;
+      base_if->syncs_suppressed++;
+    }
+    return 0;
+  }
+
   volatile union SimbricksProtoBaseMsg *msg =
       SimbricksBaseIfOutAlloc(base_if, timestamp);
   if (!msg)
     return -1;
 
+  msg->sync.promise = 0;
+  if (base_if->adaptive_sync) {
+    uint64_t promise = (base_if->out_lookahead > timestamp
+                            ? base_if->out_lookahead
+                            : timestamp);
+    base_if->out_promised = promise;
+    base_if->out_suppressed_ts = timestamp;
+    msg->sync.promise = promise + base_if->params.link_latency;
+  }
+
   SimbricksBaseIfOutSend(base_if, msg, SIMBRICKS_PROTO_MSG_TYPE_SYNC);
+  base_if->syncs_sent++;
   return 0;
 }
 
@@ -366,9 +1099,33 @@ static inline uint64_t SimbricksBaseIfOutNextSync(
     struct SimbricksBaseIf *base_if) {
   if (base_if->out_timestamp == UINT64_MAX)
     return UINT64_MAX;
+  if (base_if->adaptive_sync && base_if->out_promised > base_if->out_timestamp)
+    return base_if->out_promised + base_if->params.sync_interval;
   return base_if->out_timestamp + base_if->params.sync_interval;
 }
 
+/**
+ * Number of sync messages sent so far.
+ *
+ * @param base_if Base interface handle (connected).
+ */
+static inline uint64_t SimbricksBaseIfOutSyncsSent(
+    struct SimbricksBaseIf *base_if) {
+  return base_if->syncs_sent;
+}
+
+/**
+ * Number of times a sync was due by the sync interval but skipped because an
+ * earlier adaptive sync promise still covered it (counted at most once per
+ * interval).
+ *
+ * @param base_if Base interface handle (connected).
+ */
+static inline uint64_t SimbricksBaseIfOutSyncsSuppressed(
+    struct SimbricksBaseIf *base_if) {
+  return base_if->syncs_suppressed;
+}
+
 /**
  * Retrieve maximal total message length for outgoing messages.
  *
@@ -380,7 +1137,36 @@ static inline size_t SimbricksBaseIfOutMsgLen(struct SimbricksBaseIf *base_if) {
 }
 
 /**
- * Check if synchronization is enabled for this connection.
+ * Retrieve maximal total message length for outgoing messages allocated with
+ * `SimbricksBaseIfOutAllocLen`, i.e. including multi-slot messages.
+ *
+ * @param base_if Base interface handle (connected).
+ * @return Maximal message length in bytes.
+ */
+static inline size_t SimbricksBaseIfOutMaxMsgLen(
+    struct SimbricksBaseIf *base_if) {
+  return base_if->out_elen * SimbricksBaseIfOutMaxSlots(base_if);
+}
+
+/**
+ * Retrieve maximal total message length the peer can send us, i.e. including
+ * multi-slot messages.
+ *
+ * @param base_if Base interface handle (connected).
+ * @return Maximal message length in bytes.
+ */
+static inline size_t SimbricksBaseIfInMaxMsgLen(
+    struct SimbricksBaseIf *base_if) {
+  if (!base_if->multi_slot)
+    return base_if->in_elen;
+  return base_if->in_elen * (base_if->in_enum < SIMBRICKS_PROTO_MSG_MAX_SLOTS
+                                 ? base_if->in_enum
+                                 : SIMBRICKS_PROTO_MSG_MAX_SLOTS);
+}
+
+/**
+ * Check if synchronization is enabled for this connection. Can change at
+ * runtime if sync switches are enabled (see `SimbricksBaseIfSyncSwitch`).
  *
  * @param base_if Base interface handle (connected).
  * @return true if synchronized, false otherwise.
@@ -389,4 +1175,76 @@ static inline bool SimbricksBaseIfSyncEnabled(struct SimbricksBaseIf *base_if) {
   return base_if->sync;
 }
 
+/**
+ * Request switching synchronization on or off at `timestamp`, the current
+ * time. The peer switches no earlier than that, and the switch takes effect
+ * locally once its acknowledgement is passed to
+ * `SimbricksBaseIfSyncSwitchHandle`. When switching on, the caller must not
+ * advance its clock until then, as it has to continue from the time the peer
+ * switched at. Messages in flight during the switch are processed at the
+ * receiver's current time.
+ *
+ * @param base_if   Base interface handle (connected).
+ * @param enable    Switch synchronization on or off.
+ * @param timestamp Current timestamp (in picoseconds).
+ * @return 0 if the request was sent, -1 if runtime switches are not enabled, a
+ * switch is already pending, the queue is full, or synchronization is required
+ * locally and `enable` is false.
+ */
+int SimbricksBaseIfSyncSwitch(struct SimbricksBaseIf *base_if, bool enable,
+                              uint64_t timestamp);
+
+/**
+ * Handle a received `SIMBRICKS_PROTO_MSG_TYPE_SYNC_MODE` message. For the
+ * acknowledgement of our own request, switches right away and returns the time
+ * the peer switched at, the caller should advance its clock to it if it can.
+ * For a request of the peer, returns the proposed switch time. The switch and
+ * the acknowledgement then happen in the first `SimbricksBaseIfOutSync` call
+ * at or after that time, with the time of that call. Callers that can jump
+ * ahead to the proposed time should do so right away. Callers can also hold
+ * back the acknowledgement by not calling `SimbricksBaseIfOutSync`, e.g. to
+ * first switch their other interfaces, as the peer waits for it.
+ *
+ * @param base_if   Base interface handle (connected).
+ * @param msg       Received sync mode message.
+ * @param timestamp Current timestamp (in picoseconds).
+ * @return Timestamp to continue at.
+ */
+uint64_t SimbricksBaseIfSyncSwitchHandle(
+    struct SimbricksBaseIf *base_if, volatile union SimbricksProtoBaseMsg *msg,
+    uint64_t timestamp);
+
+/**
+ * Check if runtime sync switches are enabled for this connection.
+ *
+ * @param base_if Base interface handle (connected).
+ */
+static inline bool SimbricksBaseIfSyncSwitchEnabled(
+    struct SimbricksBaseIf *base_if) {
+  return base_if->sync_switch;
+}
+
+/**
+ * Check if a switch requested with `SimbricksBaseIfSyncSwitch` still waits for
+ * the peer's acknowledgement.
+ *
+ * @param base_if Base interface handle (connected).
+ */
+static inline bool SimbricksBaseIfSyncSwitchPending(
+    struct SimbricksBaseIf *base_if) {
+  return base_if->sync_switch_pending;
+}
+
+/**
+ * Check if doorbells are enabled for this connection, i.e. if
+ * `SimbricksBaseIfWaitAny` can block on it.
+ *
+ * @param base_if Base interface handle (connected).
+ * @return true if doorbells are enabled, false otherwise.
+ */
+static inline bool SimbricksBaseIfDoorbellEnabled(
+    struct SimbricksBaseIf *base_if) {
+  return base_if->doorbell;
+}
+
 #endif  // SIMBRICKS_BASE_IF_H_
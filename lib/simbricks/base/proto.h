@@ -44,6 +44,33 @@
 #define SIMBRICKS_PROTO_FLAGS_LI_SYNC (1 << 0)
 /** Listener forces synchronization */
 #define SIMBRICKS_PROTO_FLAGS_LI_SYNC_FORCE (1 << 1)
+/** Listener supports messages spanning multiple queue slots */
+#define SIMBRICKS_PROTO_FLAGS_LI_MULTI_SLOT (1 << 2)
+/**
+ * Listener supports doorbells: the intro carries the listener's eventfd after
+ * the shm fd and ctl_offset points to a `SimbricksProtoBaseIfCtl` block.
+ */
+#define SIMBRICKS_PROTO_FLAGS_LI_DOORBELL (1 << 3)
+/**
+ * Listener supports the v2 queue layout (see `SimbricksProtoBaseSlotMeta`).
+ * Only offered for power-of-two queue lengths and entry sizes.
+ */
+#define SIMBRICKS_PROTO_FLAGS_LI_RING_V2 (1 << 4)
+/**
+ * Listener supports adaptive synchronization: sync messages carry a lookahead
+ * promise (see `SimbricksProtoBaseMsgSync`).
+ */
+#define SIMBRICKS_PROTO_FLAGS_LI_ADAPTIVE_SYNC (1 << 5)
+/**
+ * Listener supports switching synchronization on and off at runtime (see
+ * `SIMBRICKS_PROTO_MSG_TYPE_SYNC_MODE`).
+ */
+#define SIMBRICKS_PROTO_FLAGS_LI_SYNC_SWITCH (1 << 6)
+/**
+ * Listener keeps statistics: stats_offset points to the listener's
+ * `SimbricksProtoBaseIfStats` block, followed by one for the connecter.
+ */
+#define SIMBRICKS_PROTO_FLAGS_LI_STATS (1 << 7)
 
 /**
  * Welcome message that the listener sends to the connector on the unix socket.
@@ -77,12 +104,35 @@ struct SimbricksProtoListenerIntro {
   uint64_t upper_layer_proto;
   /** offset of upper layer intro from beginning of this message */
   uint64_t upper_layer_intro_off;
+
+  /**
+   * offset of the interface control block in shared memory region (only valid
+   * with SIMBRICKS_PROTO_FLAGS_LI_DOORBELL or SIMBRICKS_PROTO_FLAGS_LI_RING_V2)
+   */
+  uint64_t ctl_offset;
+
+  /**
+   * offset of the listener's statistics block in the pool header, the
+   * connecter's block directly follows it (only valid with
+   * SIMBRICKS_PROTO_FLAGS_LI_STATS)
+   */
+  uint64_t stats_offset;
 } __attribute__((packed));
 
 /** Connecter has synchronization enabled */
 #define SIMBRICKS_PROTO_FLAGS_CO_SYNC (1 << 0)
 /** Connecter forces synchronization */
 #define SIMBRICKS_PROTO_FLAGS_CO_SYNC_FORCE (1 << 1)
+/** Connecter supports messages spanning multiple queue slots */
+#define SIMBRICKS_PROTO_FLAGS_CO_MULTI_SLOT (1 << 2)
+/** Connecter supports doorbells, the intro carries the connecter's eventfd */
+#define SIMBRICKS_PROTO_FLAGS_CO_DOORBELL (1 << 3)
+/** Connecter supports the v2 queue layout */
+#define SIMBRICKS_PROTO_FLAGS_CO_RING_V2 (1 << 4)
+/** Connecter supports adaptive synchronization */
+#define SIMBRICKS_PROTO_FLAGS_CO_ADAPTIVE_SYNC (1 << 5)
+/** Connecter supports switching synchronization at runtime */
+#define SIMBRICKS_PROTO_FLAGS_CO_SYNC_SWITCH (1 << 6)
 
 struct SimbricksProtoConnecterIntro {
   /** simbricks protocol version */
@@ -97,6 +147,120 @@ struct SimbricksProtoConnecterIntro {
   uint64_t upper_layer_intro_off;
 } __attribute__((packed));
 
+/**
+ * Per-interface control block in the shared memory region, shared by both
+ * peers. The waiting flags are set by the consumer of the respective queue
+ * before it blocks on its eventfd, producers then ring the doorbell after
+ * handing over messages. Fields are on separate cache lines as they are
+ * written by different peers.
+ *
+ * With the v2 queue layout, the control block is followed by the slot meta
+ * data arrays for the listener-to-connecter and then the connecter-to-listener
+ * queue.
+ */
+struct SimbricksProtoBaseIfCtl {
+  /** consumer of the listener-to-connecter queue is about to block */
+  uint32_t l2c_waiting;
+  uint8_t pad0[60];
+  /** consumer of the connecter-to-listener queue is about to block */
+  uint32_t c2l_waiting;
+  uint8_t pad1[60];
+  /** v2: number of slots released by the listener-to-connecter consumer */
+  uint64_t l2c_head;
+  uint8_t pad2[56];
+  /** v2: number of slots released by the connecter-to-listener consumer */
+  uint64_t c2l_head;
+  uint8_t pad3[56];
+};
+static_assert(sizeof(struct SimbricksProtoBaseIfCtl) == 256,
+              "SimBricks control block size check failed");
+
+/**
+ * v2 queue layout: per-slot meta data, kept in an array separate from the
+ * message slots. A message is handed to the consumer by writing its timestamp
+ * and then the sequence number of its first slot plus one to the entry of that
+ * slot, the ownership bit in the message header is not used for handing over.
+ * Instead of passing individual slots back, the consumer publishes the number
+ * of slots it has released so far in the control block.
+ */
+struct SimbricksProtoBaseSlotMeta {
+  /** message timestamp */
+  uint64_t timestamp;
+  /** lower bits of the slot sequence number + 1, written last */
+  uint32_t seq;
+  uint32_t pad;
+};
+static_assert(sizeof(struct SimbricksProtoBaseSlotMeta) == 16,
+              "SimBricks slot meta data size check failed");
+
+/**
+ * Statistics one side of an interface keeps about its queues. Each block is
+ * only ever written by the process that owns that side, with relaxed atomic
+ * stores, and can be read by external monitoring tools at any time.
+ */
+struct SimbricksProtoBaseIfStats {
+  /** non-sync messages received */
+  uint64_t msgs_in;
+  /** non-sync messages sent */
+  uint64_t msgs_out;
+  /** sync messages received */
+  uint64_t syncs_in;
+  /** sync messages sent */
+  uint64_t syncs_out;
+  /** allocations that failed because the outgoing queue was full */
+  uint64_t out_full;
+  /**
+   * polls that returned no message, poll attempts are these plus the messages
+   * received. Updated in batches, so it lags behind by up to 1023 polls.
+   */
+  uint64_t polls_empty;
+  /** timestamp of the last message received */
+  uint64_t in_timestamp;
+  /** timestamp of the last message sent (before adding the link latency) */
+  uint64_t out_timestamp;
+  uint8_t pad[64];
+};
+static_assert(sizeof(struct SimbricksProtoBaseIfStats) == 128,
+              "SimBricks statistics block size check failed");
+
+/** Magic number at the beginning of SHM pools ("SBKPOOL1") */
+#define SIMBRICKS_PROTO_POOL_MAGIC 0x314c4f4f504b4253ULL
+/** Space reserved for the pool header at the beginning of each pool */
+#define SIMBRICKS_PROTO_POOL_HDR_SIZE 4096
+/** Maximal number of interfaces listed in a pool header */
+#define SIMBRICKS_PROTO_POOL_MAX_IFS 10
+
+/** Pool directory entry for one listening interface. */
+struct SimbricksProtoPoolIf {
+  /** unix socket path of the listener (truncated if too long) */
+  char sock_path[112];
+  /** upper layer protocol identifier: see SIMBRICKS_PROTO_ID_* */
+  uint64_t upper_layer_proto;
+  /** link latency [picoseconds] */
+  uint64_t link_latency;
+  /** statistics of the listener and the connecter side */
+  struct SimbricksProtoBaseIfStats stats[2];
+};
+
+/**
+ * Header at the beginning of each SHM pool, listing the interfaces in the pool
+ * so that tools can find their statistics blocks. Entries are filled in before
+ * `num_ifs` is incremented.
+ */
+struct SimbricksProtoPoolHeader {
+  /** SIMBRICKS_PROTO_POOL_MAGIC */
+  uint64_t magic;
+  /** process id of the pool's creator */
+  uint32_t pid;
+  /** number of valid entries in `ifs` */
+  uint32_t num_ifs;
+  uint8_t pad[48];
+  struct SimbricksProtoPoolIf ifs[SIMBRICKS_PROTO_POOL_MAX_IFS];
+};
+static_assert(sizeof(struct SimbricksProtoPoolHeader) <=
+                  SIMBRICKS_PROTO_POOL_HDR_SIZE,
+              "SimBricks pool header size check failed");
+
 /** Mask for ownership bit in own_type field */
 #define SIMBRICKS_PROTO_MSG_OWN_MASK 0x80
 /** Message is owned by producer */
@@ -111,21 +275,79 @@ struct SimbricksProtoConnecterIntro {
 #define SIMBRICKS_PROTO_MSG_TYPE_SYNC 0x00
 /** Peer Termination Message, no upper layer data */
 #define SIMBRICKS_PROTO_MSG_TYPE_TERMINATE 0x01
+/**
+ * Synchronization mode switch request or acknowledgement, no upper layer data.
+ * Only sent if both peers support SIMBRICKS_PROTO_FLAGS_LI_SYNC_SWITCH (see
+ * `SimbricksProtoBaseMsgSyncMode`).
+ */
+#define SIMBRICKS_PROTO_MSG_TYPE_SYNC_MODE 0x02
 /* values in between are reserved for future extensions */
 /** first message type reserved for upper layer protocols */
 #define SIMBRICKS_PROTO_MSG_TYPE_UPPER_START 0x40
 
+/**
+ * Maximal number of queue slots a single message can span if multi-slot
+ * messages are enabled (see SIMBRICKS_PROTO_FLAGS_LI_MULTI_SLOT). The first
+ * slot carries the regular message header, the payload then continues
+ * contiguously through the following slots, without any headers in between.
+ * Multi-slot messages never wrap around the end of the queue.
+ */
+#define SIMBRICKS_PROTO_MSG_MAX_SLOTS 256
+
 struct SimbricksProtoBaseMsgHeader {
   uint8_t pad[48];
   uint64_t timestamp;
-  uint8_t pad_[7];
+  uint8_t pad_[6];
+  /** number of continuation slots following this one (multi-slot only) */
+  uint8_t cont_slots;
   uint8_t own_type;
 } __attribute__((packed));
 SIMBRICKS_PROTO_MSG_SZCHECK(struct SimbricksProtoBaseMsgHeader);
 
+struct SimbricksProtoBaseMsgSync {
+  /**
+   * Adaptive sync only: no further messages with a timestamp before this will
+   * be sent. Allows the receiver to advance beyond the sync's own timestamp.
+   */
+  uint64_t promise;
+  uint8_t pad[40];
+  uint64_t timestamp;
+  uint8_t pad_[6];
+  uint8_t cont_slots;
+  uint8_t own_type;
+} __attribute__((packed));
+SIMBRICKS_PROTO_MSG_SZCHECK(struct SimbricksProtoBaseMsgSync);
+
+/** Synchronization is enabled after the switch */
+#define SIMBRICKS_PROTO_SYNC_MODE_ENABLE (1 << 0)
+/** Acknowledgement of the peer's request */
+#define SIMBRICKS_PROTO_SYNC_MODE_ACK (1 << 1)
+
+/**
+ * Switch synchronization on or off. A request proposes the sender's current
+ * time as the switch time, the receiver switches at the later of that and its
+ * own current time and reports the mode and time it switched at in its
+ * acknowledgement. The requester then switches at the same time. If both
+ * peers send a request at the same time, the listener's request wins and the
+ * listener ignores the connecter's.
+ */
+struct SimbricksProtoBaseMsgSyncMode {
+  /** time of the switch (without link latency) */
+  uint64_t switch_ts;
+  /** flags: see SIMBRICKS_PROTO_SYNC_MODE_* */
+  uint8_t flags;
+  uint8_t pad[39];
+  uint64_t timestamp;
+  uint8_t pad_[6];
+  uint8_t cont_slots;
+  uint8_t own_type;
+} __attribute__((packed));
+SIMBRICKS_PROTO_MSG_SZCHECK(struct SimbricksProtoBaseMsgSyncMode);
+
 union SimbricksProtoBaseMsg {
   struct SimbricksProtoBaseMsgHeader header;
-  struct SimbricksProtoBaseMsgHeader sync;
+  struct SimbricksProtoBaseMsgSync sync;
+  struct SimbricksProtoBaseMsgSyncMode sync_mode;
   struct SimbricksProtoBaseMsgHeader terminate;
 } __attribute__((packed));
 SIMBRICKS_PROTO_MSG_SZCHECK(union SimbricksProtoBaseMsg);
@@ -0,0 +1,177 @@
+/*
+ * Copyright 2024 Max Planck Institute for Software Systems, and
+ * National University of Singapore
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "lib/simbricks/base/record.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <simbricks/base/proto.h>
+
+#define RECORD_BUF_SIZE (1 << 20)
+#define RECORD_READS 256
+
+struct SimbricksBaseIfRecordRead {
+  uint64_t req_id;
+  /* data length + 1, 0 if unused */
+  size_t len;
+};
+
+struct SimbricksBaseIfRecorder {
+  FILE *f;
+  char *buf;
+  /* outstanding reads received [0] and sent [1], hashed by request id */
+  struct SimbricksBaseIfRecordRead reads[2][RECORD_READS];
+};
+
+static size_t ReadHash(uint64_t req_id) {
+  return (size_t)((req_id * 0x9e3779b97f4a7c15ULL) >> 56) % RECORD_READS;
+}
+
+int SimbricksBaseIfRecordOpen(struct SimbricksBaseIf *base_if,
+                              const void *intro, size_t intro_len) {
+  struct SimbricksBaseIfParams *params = &base_if->params;
+  struct SimbricksBaseIfRecorder *rec;
+  char path[600];
+
+  const char *name = strrchr(params->sock_path, '/');
+  name = (name != NULL ? name + 1 : params->sock_path);
+  snprintf(path, sizeof(path), "%s/%s.%s.rec", params->record_dir, name,
+           (base_if->listener ? "listener" : "connecter"));
+
+  if ((rec = calloc(1, sizeof(*rec))) == NULL) {
+    perror("SimbricksBaseIfRecordOpen: calloc failed");
+    return -1;
+  }
+  if ((rec->f = fopen(path, "w")) == NULL) {
+    perror("SimbricksBaseIfRecordOpen: fopen failed");
+    free(rec);
+    return -1;
+  }
+  if ((rec->buf = malloc(RECORD_BUF_SIZE)) != NULL)
+    setvbuf(rec->f, rec->buf, _IOFBF, RECORD_BUF_SIZE);
+
+  struct SimbricksRecordHeader hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  hdr.magic = SIMBRICKS_RECORD_MAGIC;
+  hdr.upper_layer_proto = params->upper_layer_proto;
+  hdr.link_latency = params->link_latency;
+  hdr.sync_interval = params->sync_interval;
+  hdr.in_elen = base_if->in_elen;
+  hdr.in_nentries = base_if->in_enum;
+  hdr.out_elen = base_if->out_elen;
+  hdr.out_nentries = base_if->out_enum;
+  if (base_if->listener)
+    hdr.flags |= SIMBRICKS_RECORD_FLAGS_LISTENER;
+  if (base_if->sync)
+    hdr.flags |= SIMBRICKS_RECORD_FLAGS_SYNC;
+  if (base_if->multi_slot)
+    hdr.flags |= SIMBRICKS_RECORD_FLAGS_MULTI_SLOT;
+  if (base_if->adaptive_sync)
+    hdr.flags |= SIMBRICKS_RECORD_FLAGS_ADAPTIVE_SYNC;
+  if (base_if->sync_switch)
+    hdr.flags |= SIMBRICKS_RECORD_FLAGS_SYNC_SWITCH;
+  hdr.intro_len = (uint32_t)intro_len;
+
+  if (fwrite(&hdr, sizeof(hdr), 1, rec->f) != 1 ||
+      fwrite(intro, 1, intro_len, rec->f) != intro_len) {
+    perror("SimbricksBaseIfRecordOpen: writing header failed");
+    fclose(rec->f);
+    free(rec->buf);
+    free(rec);
+    return -1;
+  }
+
+  base_if->record = rec;
+  return 0;
+}
+
+void SimbricksBaseIfRecordClose(struct SimbricksBaseIf *base_if) {
+  struct SimbricksBaseIfRecorder *rec = base_if->record;
+  if (rec == NULL)
+    return;
+
+  base_if->record = NULL;
+  if (fclose(rec->f) != 0)
+    perror("SimbricksBaseIfRecordClose: fclose failed");
+  free(rec->buf);
+  free(rec);
+}
+
+void SimbricksBaseIfRecordMsg(struct SimbricksBaseIf *base_if,
+                              volatile union SimbricksProtoBaseMsg *msg,
+                              uint8_t type, bool out) {
+  struct SimbricksBaseIfRecorder *rec = base_if->record;
+  size_t len = (out ? base_if->out_elen : base_if->in_elen);
+  if (base_if->multi_slot)
+    len *= 1 + msg->header.cont_slots;
+
+  if (type < SIMBRICKS_PROTO_MSG_TYPE_UPPER_START) {
+    len = sizeof(*msg);
+  } else if (base_if->params.record_len != NULL) {
+    size_t ulen = base_if->params.record_len(base_if, msg, type, out);
+    if (ulen != 0 && ulen < len)
+      len = ulen;
+  }
+  if (len < sizeof(*msg))
+    len = sizeof(*msg);
+
+  struct SimbricksRecordEntry ent;
+  ent.timestamp = msg->header.timestamp;
+  ent.len = (uint32_t)(len - SIMBRICKS_RECORD_HDR_SKIP);
+  ent.dir = (out ? SIMBRICKS_RECORD_DIR_OUT : SIMBRICKS_RECORD_DIR_IN);
+  ent.type = type;
+  ent.pad[0] = ent.pad[1] = 0;
+
+  const uint8_t *bytes = (const uint8_t *)(uintptr_t)msg;
+  size_t tail = len - sizeof(*msg);
+  if (fwrite(&ent, sizeof(ent), 1, rec->f) != 1 ||
+      fwrite(bytes, SIMBRICKS_RECORD_HDR_HEAD, 1, rec->f) != 1 ||
+      (tail > 0 && fwrite(bytes + sizeof(*msg), tail, 1, rec->f) != 1)) {
+    perror("SimbricksBaseIfRecordMsg: write failed, recording stopped");
+    SimbricksBaseIfRecordClose(base_if);
+  }
+}
+
+void SimbricksBaseIfRecordReadLen(struct SimbricksBaseIf *base_if, bool out,
+                                  uint64_t req_id, size_t len) {
+  struct SimbricksBaseIfRecordRead *rd =
+      &base_if->record->reads[out][ReadHash(req_id)];
+  rd->req_id = req_id;
+  rd->len = len + 1;
+}
+
+size_t SimbricksBaseIfRecordCompLen(struct SimbricksBaseIf *base_if, bool out,
+                                    uint64_t req_id) {
+  /* completions go in the opposite direction of their read */
+  struct SimbricksBaseIfRecordRead *rd =
+      &base_if->record->reads[!out][ReadHash(req_id)];
+  if (rd->len == 0 || rd->req_id != req_id)
+    return SIZE_MAX;
+
+  size_t len = rd->len - 1;
+  rd->len = 0;
+  return len;
+}
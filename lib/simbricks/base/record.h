@@ -0,0 +1,131 @@
+/*
+ * Copyright 2024 Max Planck Institute for Software Systems, and
+ * National University of Singapore
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef SIMBRICKS_BASE_RECORD_H_
+#define SIMBRICKS_BASE_RECORD_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <simbricks/base/if.h>
+
+/******************************************************************************/
+/* Recording file format */
+
+/*
+ * A recording starts with a `SimbricksRecordHeader`, followed by the upper
+ * layer intro received from the peer and then one `SimbricksRecordEntry` per
+ * message in the order the recording interface received and sent them.
+ */
+
+/** Magic number at the beginning of recordings ("SBKREC01") */
+#define SIMBRICKS_RECORD_MAGIC 0x31304345524b4253ULL
+
+/** Recording interface was the listener */
+#define SIMBRICKS_RECORD_FLAGS_LISTENER (1 << 0)
+/** Synchronization was enabled */
+#define SIMBRICKS_RECORD_FLAGS_SYNC (1 << 1)
+/** Multi-slot messages were enabled */
+#define SIMBRICKS_RECORD_FLAGS_MULTI_SLOT (1 << 2)
+/** Adaptive synchronization was enabled */
+#define SIMBRICKS_RECORD_FLAGS_ADAPTIVE_SYNC (1 << 3)
+/** Runtime sync switches were enabled, SYNC is the initial mode */
+#define SIMBRICKS_RECORD_FLAGS_SYNC_SWITCH (1 << 4)
+
+struct SimbricksRecordHeader {
+  /** SIMBRICKS_RECORD_MAGIC */
+  uint64_t magic;
+  uint64_t upper_layer_proto;
+  /** link latency and sync interval of the recording interface [ps] */
+  uint64_t link_latency;
+  uint64_t sync_interval;
+  /** queue geometry of the recording interface */
+  uint64_t in_elen;
+  uint64_t in_nentries;
+  uint64_t out_elen;
+  uint64_t out_nentries;
+  /** SIMBRICKS_RECORD_FLAGS_* */
+  uint32_t flags;
+  /** length of the upper layer intro following the header */
+  uint32_t intro_len;
+} __attribute__((packed));
+
+/** Message received by the recording interface */
+#define SIMBRICKS_RECORD_DIR_IN 0
+/** Message sent by the recording interface */
+#define SIMBRICKS_RECORD_DIR_OUT 1
+
+/**
+ * Header for a recorded message. Followed by `len` bytes of the message, with
+ * the 16 bytes of timestamp and type at the end of the message header left out
+ * (they are stored in the entry instead).
+ */
+struct SimbricksRecordEntry {
+  /** message timestamp (including link latency) [ps] */
+  uint64_t timestamp;
+  uint32_t len;
+  /** SIMBRICKS_RECORD_DIR_* */
+  uint8_t dir;
+  /** message type without ownership flag */
+  uint8_t type;
+  uint8_t pad[2];
+} __attribute__((packed));
+
+/** Message bytes before the timestamp in the message header */
+#define SIMBRICKS_RECORD_HDR_HEAD 48
+/** Message bytes left out of a recorded message */
+#define SIMBRICKS_RECORD_HDR_SKIP 16
+
+/**
+ * Start recording on a connected interface, called once the intro from the
+ * peer has been received.
+ */
+int SimbricksBaseIfRecordOpen(struct SimbricksBaseIf *base_if,
+                              const void *intro, size_t intro_len);
+
+/** Flush and close the recording, if any. */
+void SimbricksBaseIfRecordClose(struct SimbricksBaseIf *base_if);
+
+/******************************************************************************/
+/* Message lengths for upper layer protocols */
+
+/**
+ * Remember the data length of a read request sent (`out`) or received, so
+ * that the length of its completion can be recorded with
+ * `SimbricksBaseIfRecordCompLen`.
+ */
+void SimbricksBaseIfRecordReadLen(struct SimbricksBaseIf *base_if, bool out,
+                                  uint64_t req_id, size_t len);
+
+/**
+ * Data length of a read completion sent (`out`) or received, as remembered for
+ * the read request in the opposite direction.
+ *
+ * @return Data length, or SIZE_MAX if the request is unknown.
+ */
+size_t SimbricksBaseIfRecordCompLen(struct SimbricksBaseIf *base_if, bool out,
+                                    uint64_t req_id);
+
+#endif  // SIMBRICKS_BASE_RECORD_H_
@@ -24,9 +24,37 @@
 
 #include "lib/simbricks/mem/if.h"
 
+#include <simbricks/base/record.h>
+
+static size_t MemRecordLen(struct SimbricksBaseIf *base_if,
+                           volatile union SimbricksProtoBaseMsg *msg,
+                           uint8_t type, bool out) {
+  volatile union SimbricksProtoMemH2M *h2m =
+      (volatile union SimbricksProtoMemH2M *)msg;
+  volatile union SimbricksProtoMemM2H *m2h =
+      (volatile union SimbricksProtoMemM2H *)msg;
+  size_t len;
+
+  switch (type) {
+    case SIMBRICKS_PROTO_MEM_H2M_MSG_READ:
+      SimbricksBaseIfRecordReadLen(base_if, out, h2m->read.req_id,
+                                   h2m->read.len);
+      return sizeof(h2m->read);
+    case SIMBRICKS_PROTO_MEM_H2M_MSG_WRITE:
+    case SIMBRICKS_PROTO_MEM_H2M_MSG_WRITE_POSTED:
+      return sizeof(h2m->write) + h2m->write.len;
+    case SIMBRICKS_PROTO_MEM_M2H_MSG_READCOMP:
+      len = SimbricksBaseIfRecordCompLen(base_if, out, m2h->readcomp.req_id);
+      return (len == SIZE_MAX ? 0 : sizeof(m2h->readcomp) + len);
+    default:
+      return sizeof(*msg);
+  }
+}
+
 void SimbricksMemIfDefaultParams(struct SimbricksBaseIfParams *params) {
   SimbricksBaseIfDefaultParams(params);
   params->upper_layer_proto = SIMBRICKS_PROTO_ID_MEM;
+  params->record_len = MemRecordLen;
   // fit DMA writes with size 8192
   params->in_entries_size = params->out_entries_size =
       8192 + sizeof(union SimbricksProtoMemH2M);
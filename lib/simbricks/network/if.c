@@ -28,10 +28,21 @@
 #include <stdio.h>
 #include <string.h>
 
+static size_t NetRecordLen(struct SimbricksBaseIf *base_if,
+                           volatile union SimbricksProtoBaseMsg *msg,
+                           uint8_t type, bool out) {
+  volatile union SimbricksProtoNetMsg *net =
+      (volatile union SimbricksProtoNetMsg *)msg;
+  if (type == SIMBRICKS_PROTO_NET_MSG_PACKET)
+    return sizeof(net->packet) + net->packet.len;
+  return sizeof(*msg);
+}
+
 void SimbricksNetIfDefaultParams(struct SimbricksBaseIfParams *params) {
   SimbricksBaseIfDefaultParams(params);
   params->in_entries_size = params->out_entries_size = 1536 + 64;
   params->upper_layer_proto = SIMBRICKS_PROTO_ID_NET;
+  params->record_len = NetRecordLen;
 }
 
 int SimbricksNetIfInit(struct SimbricksNetIf *nsif,
@@ -0,0 +1,125 @@
+/*
+ * Copyright 2024 Max Planck Institute for Software Systems, and
+ * National University of Singapore
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "lib/simbricks/nicbm/event_heap.h"
+
+#include <cassert>
+
+namespace nicbm {
+
+TimedEvent *EventHeap::Meld(TimedEvent *a, TimedEvent *b) {
+  if (Before(b, a)) {
+    TimedEvent *t = a;
+    a = b;
+    b = t;
+  }
+
+  // b becomes the first child of a
+  b->heap_prev_ = a;
+  b->heap_next_ = a->heap_child_;
+  if (a->heap_child_ != nullptr)
+    a->heap_child_->heap_prev_ = b;
+  a->heap_child_ = b;
+  return a;
+}
+
+TimedEvent *EventHeap::MergePairs(TimedEvent *first) {
+  if (first == nullptr)
+    return nullptr;
+
+  // meld siblings pairwise from the left, collecting the results in reverse
+  // order, without recursion as sibling lists can get long
+  TimedEvent *pairs = nullptr;
+  while (first != nullptr) {
+    TimedEvent *a = first;
+    TimedEvent *b = a->heap_next_;
+    a->heap_prev_ = nullptr;
+    if (b == nullptr) {
+      a->heap_next_ = pairs;
+      pairs = a;
+      break;
+    }
+    first = b->heap_next_;
+    b->heap_prev_ = b->heap_next_ = nullptr;
+    a->heap_next_ = nullptr;
+
+    TimedEvent *m = Meld(a, b);
+    m->heap_next_ = pairs;
+    pairs = m;
+  }
+
+  // then meld the results from the right
+  TimedEvent *root = pairs;
+  pairs = root->heap_next_;
+  root->heap_next_ = nullptr;
+  while (pairs != nullptr) {
+    TimedEvent *next = pairs->heap_next_;
+    pairs->heap_next_ = nullptr;
+    root = Meld(root, pairs);
+    pairs = next;
+  }
+  return root;
+}
+
+void EventHeap::Push(TimedEvent *evt) {
+  assert(!evt->heap_queued_ && "EventHeap::Push: already scheduled");
+  evt->heap_child_ = evt->heap_next_ = evt->heap_prev_ = nullptr;
+  evt->heap_seq_ = seq_++;
+  evt->heap_queued_ = true;
+  root_ = (root_ == nullptr ? evt : Meld(root_, evt));
+  size_++;
+}
+
+void EventHeap::Remove(TimedEvent *evt) {
+  assert(evt->heap_queued_ && "EventHeap::Remove: event not scheduled");
+  if (evt == root_) {
+    root_ = MergePairs(evt->heap_child_);
+  } else {
+    // unlink the subtree of evt, then merge its children back into the heap
+    if (evt->heap_prev_->heap_child_ == evt)
+      evt->heap_prev_->heap_child_ = evt->heap_next_;
+    else
+      evt->heap_prev_->heap_next_ = evt->heap_next_;
+    if (evt->heap_next_ != nullptr)
+      evt->heap_next_->heap_prev_ = evt->heap_prev_;
+
+    TimedEvent *sub = MergePairs(evt->heap_child_);
+    if (sub != nullptr)
+      root_ = Meld(root_, sub);
+  }
+
+  evt->heap_child_ = evt->heap_next_ = evt->heap_prev_ = nullptr;
+  evt->heap_queued_ = false;
+  size_--;
+}
+
+TimedEvent *EventHeap::Pop() {
+  TimedEvent *evt = root_;
+  if (evt != nullptr)
+    Remove(evt);
+  return evt;
+}
+
+}  // namespace nicbm
@@ -0,0 +1,138 @@
+/*
+ * Copyright 2024 Max Planck Institute for Software Systems, and
+ * National University of Singapore
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef SIMBRICKS_NICBM_EVENT_HEAP_H_
+#define SIMBRICKS_NICBM_EVENT_HEAP_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace nicbm {
+
+class TimedEvent {
+ public:
+  TimedEvent() : time_(0), priority_(0) {
+  }
+  /* copies never inherit the queue position of the original */
+  TimedEvent(const TimedEvent &other)
+      : time_(other.time_), priority_(other.priority_) {
+  }
+  TimedEvent &operator=(const TimedEvent &other) {
+    time_ = other.time_;
+    priority_ = other.priority_;
+    return *this;
+  }
+  virtual ~TimedEvent() = default;
+
+  /** Returns true if the event is currently scheduled. */
+  bool Scheduled() const {
+    return heap_queued_;
+  }
+
+  uint64_t time_;
+  int priority_;
+
+ private:
+  friend class EventHeap;
+
+  /* pairing heap links: first child, next sibling and previous sibling, or the
+   * parent for the first child */
+  TimedEvent *heap_child_ = nullptr;
+  TimedEvent *heap_next_ = nullptr;
+  TimedEvent *heap_prev_ = nullptr;
+  /* events with equal time and priority execute in the order scheduled */
+  uint64_t heap_seq_ = 0;
+  bool heap_queued_ = false;
+};
+
+/**
+ * Intrusive pairing heap of `TimedEvent`s, ordered by time and priority. The
+ * links are embedded in the events, so scheduling, cancelling and
+ * rescheduling never allocate. Push is O(1), Pop and Remove are O(log n)
+ * amortized.
+ */
+class EventHeap {
+ public:
+  EventHeap() = default;
+  EventHeap(const EventHeap &) = delete;
+  EventHeap &operator=(const EventHeap &) = delete;
+
+  /** Insert an event that is not scheduled yet. */
+  void Push(TimedEvent *evt);
+  /** Remove a scheduled event. */
+  void Remove(TimedEvent *evt);
+  /** Remove and return the earliest event, nullptr if empty. */
+  TimedEvent *Pop();
+
+  /** Returns the earliest event without removing it, nullptr if empty. */
+  TimedEvent *Top() const {
+    return root_;
+  }
+  size_t Size() const {
+    return size_;
+  }
+  bool Empty() const {
+    return root_ == nullptr;
+  }
+
+ private:
+  TimedEvent *root_ = nullptr;
+  size_t size_ = 0;
+  uint64_t seq_ = 0;
+
+  static bool Before(const TimedEvent *a, const TimedEvent *b) {
+    if (a->time_ != b->time_)
+      return a->time_ < b->time_;
+    if (a->priority_ != b->priority_)
+      return a->priority_ < b->priority_;
+    return a->heap_seq_ < b->heap_seq_;
+  }
+  static TimedEvent *Meld(TimedEvent *a, TimedEvent *b);
+  static TimedEvent *MergePairs(TimedEvent *first);
+};
+
+/* Event traces, recorded by the runner to the file named in the environment
+ * variable SIMBRICKS_EVENT_TRACE. */
+enum EventTraceOp : uint8_t {
+  kEventTraceSchedule = 1,
+  kEventTraceCancel = 2,
+  kEventTraceTrigger = 3,
+};
+
+struct EventTraceEntry {
+  /** simulation time of the operation [ps] */
+  uint64_t now;
+  /** event time [ps] */
+  uint64_t time;
+  /** identifies the event object across entries */
+  uint64_t event;
+  int32_t priority;
+  uint8_t op;
+  uint8_t pad[3];
+};
+
+}  // namespace nicbm
+
+#endif  // SIMBRICKS_NICBM_EVENT_HEAP_H_
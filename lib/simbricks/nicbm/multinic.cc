@@ -24,16 +24,199 @@
 
 #include "lib/simbricks/nicbm/multinic.h"
 
+#include <getopt.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include <boost/bind.hpp>
 #include <boost/fiber/all.hpp>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
 #include <thread>
 #include <vector>
 
+extern "C" {
+#include <simbricks/base/affinity.h>
+}
+
 namespace nicbm {
 
+namespace {
+
+class WorkerSched;
+
+/* Per fiber state for the worker schedulers */
+class InstanceProps : public boost::fibers::fiber_properties {
+ public:
+  explicit InstanceProps(boost::fibers::context *ctx)
+      : fiber_properties(ctx) {
+  }
+
+  /* idle flag of the instance running in this fiber, if any */
+  std::atomic<bool> *idle = nullptr;
+  /* detached from its worker and may be stolen, guarded by the queue lock of
+   * the worker holding the fiber */
+  bool detached = false;
+};
+
+/* Fiber scheduler of one worker thread. Fibers stay on their worker, so the
+ * instance state stays in the caches of one core. With stealing, a worker whose
+ * instances are all idle takes over idle instances from workers that also run
+ * busy ones. Only idle instances move, their cache state is cold anyway. */
+class WorkerSched
+    : public boost::fibers::algo::algorithm_with_properties<InstanceProps> {
+ public:
+  WorkerSched(std::vector<WorkerSched *> &workers, unsigned id, bool steal)
+      : workers_(workers), id_(id), steal_(steal) {
+    workers_[id_] = this;
+  }
+
+  void awakened(boost::fibers::context *ctx,
+                InstanceProps &props) noexcept override {
+    std::lock_guard<std::mutex> lk(qmtx_);
+    if (steal_ && !ctx->is_context(boost::fibers::type::pinned_context) &&
+        props.idle != nullptr && props.idle->load(std::memory_order_relaxed)) {
+      ctx->detach();
+      props.detached = true;
+    }
+    rqueue_.push_back(ctx);
+  }
+
+  boost::fibers::context *pick_next() noexcept override {
+    // look for instances to take over from time to time, and when out of work
+    bool empty = !has_ready_fibers();
+    if (steal_ && (empty || ++picks_ % kStealInterval == 0)) {
+      boost::fibers::context *ctx = Steal();
+      if (ctx != nullptr) {
+        boost::fibers::context::active()->attach(ctx);
+        return ctx;
+      }
+    }
+    if (empty)
+      return nullptr;
+
+    std::lock_guard<std::mutex> lk(qmtx_);
+    boost::fibers::context *ctx = rqueue_.front();
+    rqueue_.pop_front();
+    InstanceProps &props = properties(ctx);
+    if (props.detached) {
+      props.detached = false;
+      boost::fibers::context::active()->attach(ctx);
+    }
+    return ctx;
+  }
+
+  bool has_ready_fibers() const noexcept override {
+    std::lock_guard<std::mutex> lk(qmtx_);
+    return !rqueue_.empty();
+  }
+
+  void suspend_until(
+      std::chrono::steady_clock::time_point const &tp) noexcept override {
+    std::chrono::steady_clock::time_point until = tp;
+    // keep looking for idle instances to take over
+    if (steal_) {
+      auto retry = std::chrono::steady_clock::now() +
+                   std::chrono::milliseconds(1);
+      if (retry < until)
+        until = retry;
+    }
+
+    std::unique_lock<std::mutex> lk(mtx_);
+    if (until == std::chrono::steady_clock::time_point::max())
+      cnd_.wait(lk, [this]() { return flag_; });
+    else
+      cnd_.wait_until(lk, until, [this]() { return flag_; });
+    flag_ = false;
+  }
+
+  void notify() noexcept override {
+    std::lock_guard<std::mutex> lk(mtx_);
+    flag_ = true;
+    cnd_.notify_all();
+  }
+
+ private:
+  std::vector<WorkerSched *> &workers_;
+  unsigned id_;
+  bool steal_;
+
+  static constexpr uint64_t kStealInterval = 256;
+  uint64_t picks_ = 0;
+
+  mutable std::mutex qmtx_;
+  std::deque<boost::fibers::context *> rqueue_;
+
+  std::mutex mtx_;
+  std::condition_variable cnd_;
+  bool flag_ = false;
+
+  /* Take over an idle instance from a worker that also has busy ones, if
+   * all instances of this worker are idle. */
+  boost::fibers::context *Steal() {
+    {
+      std::lock_guard<std::mutex> lk(qmtx_);
+      for (boost::fibers::context *ctx : rqueue_) {
+        InstanceProps &props = properties(ctx);
+        if (props.idle != nullptr && !props.detached)
+          return nullptr;
+      }
+    }
+
+    for (size_t i = 1; i < workers_.size(); i++) {
+      WorkerSched *victim = workers_[(id_ + i) % workers_.size()];
+      std::lock_guard<std::mutex> lk(victim->qmtx_);
+      auto stolen = victim->rqueue_.end();
+      bool busy = false;
+      for (auto it = victim->rqueue_.begin(); it != victim->rqueue_.end();
+           ++it) {
+        InstanceProps &props = properties(*it);
+        if (props.detached)
+          stolen = it;
+        else if (props.idle != nullptr)
+          busy = true;
+      }
+      if (stolen == victim->rqueue_.end() || !busy)
+        continue;
+
+      boost::fibers::context *ctx = *stolen;
+      properties(ctx).detached = false;
+      victim->rqueue_.erase(stolen);
+      return ctx;
+    }
+    return nullptr;
+  }
+};
+
+}  // namespace
+
+struct MultiNicRunner::WorkerShared {
+  /* instances assigned to each worker */
+  std::vector<std::vector<CompRunner *>> assigned;
+  std::vector<WorkerSched *> scheds;
+  /* workers only start their instances once all schedulers are registered */
+  std::mutex mtx;
+  std::condition_variable cnd;
+  unsigned registered = 0;
+  std::atomic<size_t> remaining{0};
+};
+
 void MultiNicRunner::CompRunner::YieldPoll() {
+  idle_.store(false, std::memory_order_relaxed);
+  boost::this_fiber::yield();
+}
+
+void MultiNicRunner::CompRunner::WaitIdle() {
+  // blocking would also stop the other instances on this thread
+  if (!shared_thread_) {
+    Runner::WaitIdle();
+    return;
+  }
+  idle_.store(true, std::memory_order_relaxed);
   boost::this_fiber::yield();
 }
 
@@ -59,10 +242,86 @@ MultiNicRunner::CompRunner::CompRunner(Device &dev) : Runner(dev) {
 MultiNicRunner::MultiNicRunner(DeviceFactory &factory) : factory_(factory) {
 }
 
+bool MultiNicRunner::ParseOptions(int argc, char *argv[]) {
+  static const struct option long_opts[] = {
+      {"threads", required_argument, nullptr, 't'},
+      {"affinity", required_argument, nullptr, 'a'},
+      {"steal", no_argument, nullptr, 's'},
+      {nullptr, 0, nullptr, 0}};
+  int c;
+  bool bad_option = false;
+  while ((c = getopt_long(argc, argv, "+", long_opts, nullptr)) != -1) {
+    switch (c) {
+      case 't':
+        num_threads_ = strtoul(optarg, nullptr, 0);
+        break;
+      case 'a': {
+        int cpus[CPU_SETSIZE];
+        int n = SimbricksParseCpuList(optarg, cpus, CPU_SETSIZE);
+        if (n < 0) {
+          fprintf(stderr, "invalid CPU list: %s\n", optarg);
+          bad_option = true;
+          break;
+        }
+        affinity_.insert(affinity_.end(), cpus, cpus + n);
+        break;
+      }
+      case 's':
+        steal_ = true;
+        break;
+      default:
+        bad_option = true;
+    }
+  }
+
+  if (bad_option || optind >= argc) {
+    fprintf(stderr,
+            "Usage: %s [--threads=N] [--affinity=CPUS] [--steal] "
+            "NIC-ARGS [-- NIC-ARGS ...]\n",
+            argv[0]);
+    return false;
+  }
+  return true;
+}
+
+void MultiNicRunner::RunWorker(WorkerShared &shared, unsigned id) {
+  if (!affinity_.empty()) {
+    int ret = SimbricksPinThread(affinity_[id % affinity_.size()]);
+    if (ret != 0)
+      fprintf(stderr, "RunWorker: setting affinity failed: %s\n",
+              strerror(ret));
+  }
+
+  boost::fibers::use_scheduling_algorithm<WorkerSched>(shared.scheds, id,
+                                                       steal_);
+  {
+    std::unique_lock<std::mutex> lk(shared.mtx);
+    shared.registered++;
+    shared.cnd.notify_all();
+    shared.cnd.wait(lk, [&shared, this]() {
+      return shared.registered == num_threads_;
+    });
+  }
+
+  for (CompRunner *r : shared.assigned[id]) {
+    boost::fibers::fiber([r, &shared]() {
+      boost::this_fiber::properties<InstanceProps>().idle = &r->idle_;
+      r->RunMain();
+      shared.remaining--;
+    }).detach();
+  }
+
+  // instances may move between workers, so wait for all of them
+  while (shared.remaining > 0)
+    boost::this_fiber::sleep_for(std::chrono::milliseconds(10));
+}
+
 int MultiNicRunner::RunMain(int argc, char *argv[]) {
-  int start = 0;
-  std::vector<Runner *> runners;
-  std::vector<boost::fibers::fiber *> fibers;
+  if (!ParseOptions(argc, argv))
+    return -1;
+
+  int start = optind - 1;
+  std::vector<CompRunner *> runners;
   do {
     int end;
     for (end = start + 1; end < argc && strcmp(argv[end], "--"); end++) {
@@ -72,18 +331,43 @@ int MultiNicRunner::RunMain(int argc, char *argv[]) {
     CompRunner *r = new CompRunner(factory_.create());
     if (r->ParseArgs(end - start, argv + start))
       return -1;
-
-    auto *f = new boost::fibers::fiber(
-        boost::bind(&CompRunner::RunMain, boost::ref(*r)));
     runners.push_back(r);
-    fibers.push_back(f);
     start = end;
   } while (start < argc);
 
-  for (auto f : fibers) {
-    f->join();
-    delete (f);
+  if (num_threads_ == 0) {
+    std::vector<boost::fibers::fiber *> fibers;
+    for (CompRunner *r : runners) {
+      r->shared_thread_ = runners.size() > 1;
+      fibers.push_back(new boost::fibers::fiber(
+          boost::bind(&CompRunner::RunMain, boost::ref(*r))));
+    }
+
+    for (auto f : fibers) {
+      f->join();
+      delete (f);
+    }
+    return 0;
   }
+
+  // distribute the instances round robin over the workers
+  WorkerShared shared;
+  shared.assigned.resize(num_threads_);
+  shared.scheds.resize(num_threads_);
+  shared.remaining = runners.size();
+  for (size_t i = 0; i < runners.size(); i++)
+    shared.assigned[i % num_threads_].push_back(runners[i]);
+  for (unsigned i = 0; i < num_threads_; i++) {
+    for (CompRunner *r : shared.assigned[i])
+      r->shared_thread_ = steal_ || shared.assigned[i].size() > 1;
+  }
+
+  std::vector<std::thread> workers;
+  for (unsigned i = 0; i < num_threads_; i++)
+    workers.emplace_back(&MultiNicRunner::RunWorker, this, std::ref(shared),
+                         i);
+  for (std::thread &t : workers)
+    t.join();
   return 0;
 }
 
@@ -25,6 +25,9 @@
 #ifndef SIMBRICKS_NICBM_MULTINIC_H_
 #define SIMBRICKS_NICBM_MULTINIC_H_
 
+#include <atomic>
+#include <vector>
+
 #include "lib/simbricks/nicbm/nicbm.h"
 
 namespace nicbm {
@@ -40,18 +43,42 @@ class MultiNicRunner {
   class CompRunner : public Runner {
    protected:
     void YieldPoll() override;
+    void WaitIdle() override;
     int NicIfInit() override;
 
    public:
     explicit CompRunner(Device &dev_);
+
+    /** waiting for a peer, the instance may move to another worker */
+    std::atomic<bool> idle_{false};
+    /** other instances run on the same thread, so never block */
+    bool shared_thread_ = false;
   };
 
   DeviceFactory &factory_;
+  /** worker threads, 0 runs all instances on the main thread */
+  unsigned num_threads_ = 0;
+  /** CPUs to pin the workers to, round robin */
+  std::vector<int> affinity_;
+  /** workers without instances take over idle ones from other workers */
+  bool steal_ = false;
+
+  struct WorkerShared;
+  bool ParseOptions(int argc, char *argv[]);
+  void RunWorker(WorkerShared &shared, unsigned id);
 
  public:
   explicit MultiNicRunner(DeviceFactory &factory);
 
-  /** Run the simulation */
+  /**
+   * Run the simulation. Instance arguments are separated by "--", and may be
+   * preceded by options:
+   *   --threads=N     distribute the instances over N worker threads
+   *   --affinity=CPUS pin the workers to CPUS (e.g. 0-3,8)
+   *   --steal         let workers without instances take over idle ones
+   * Instance arguments that start with options of their own (e.g.
+   * --adaptive-sync) need a "--" in front of the first instance as well.
+   */
   int RunMain(int argc, char *argv[]);
 };
 
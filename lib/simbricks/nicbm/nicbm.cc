@@ -25,6 +25,7 @@
 #include "lib/simbricks/nicbm/nicbm.h"
 
 #include <fcntl.h>
+#include <getopt.h>
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -32,6 +33,7 @@
 #include <sys/socket.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <cassert>
 #include <ctime>
 #include <iostream>
@@ -95,7 +97,7 @@ static void sigusr2_handler(int dummy) {
 }
 #endif
 
-volatile union SimbricksProtoPcieD2H *Runner::D2HAlloc() {
+volatile union SimbricksProtoPcieD2H *Runner::D2HAlloc(size_t len) {
   if (SimbricksBaseIfInTerminated(&nicif_.pcie.base)) {
     fprintf(stderr, "Runner::D2HAlloc: peer already terminated\n");
     abort();
@@ -103,7 +105,8 @@ volatile union SimbricksProtoPcieD2H *Runner::D2HAlloc() {
 
   volatile union SimbricksProtoPcieD2H *msg;
   bool first = true;
-  while ((msg = SimbricksPcieIfD2HOutAlloc(&nicif_.pcie, main_time_)) == NULL) {
+  while ((msg = SimbricksPcieIfD2HOutAllocLen(&nicif_.pcie, main_time_,
+                                              len)) == NULL) {
     if (first) {
       fprintf(stderr, "D2HAlloc: warning waiting for entry (%zu)\n",
               nicif_.pcie.base.out_pos);
@@ -118,10 +121,11 @@ volatile union SimbricksProtoPcieD2H *Runner::D2HAlloc() {
   return msg;
 }
 
-volatile union SimbricksProtoNetMsg *Runner::D2NAlloc() {
+volatile union SimbricksProtoNetMsg *Runner::D2NAlloc(size_t len) {
   volatile union SimbricksProtoNetMsg *msg;
   bool first = true;
-  while ((msg = SimbricksNetIfOutAlloc(&nicif_.net, main_time_)) == NULL) {
+  while ((msg = SimbricksNetIfOutAllocLen(&nicif_.net, main_time_, len)) ==
+         NULL) {
     if (first) {
       fprintf(stderr, "D2NAlloc: warning waiting for entry (%zu)\n",
               nicif_.pcie.base.out_pos);
@@ -137,92 +141,167 @@ volatile union SimbricksProtoNetMsg *Runner::D2NAlloc() {
 }
 
 void Runner::IssueDma(DMAOp &op) {
-  if (dma_pending_ < DMA_MAX_PENDING) {
-    // can directly issue
+  op.issue_ts_ = main_time_;
+  op.start_ts_ = 0;
+  op.reqs_ = 0;
+  op.seg_idx_ = 0;
+  op.seg_off_ = 0;
+  op.outstanding_ = 0;
+  op.issued_ = false;
+
+  dma_ops_++;
+  if (op.segs_) {
+    for (size_t i = 0; i < op.nsegs_; i++)
+      dma_bytes_ += op.segs_[i].len;
+  } else {
+    dma_bytes_ += op.len_;
+  }
+
+  // operations queued earlier go first
+  if (dma_queue_.empty()) {
 #ifdef DEBUG_NICBM
     printf(
         "main_time = %lu: nicbm: issuing dma op %p addr %lx len %zu pending "
         "%zu\n",
         main_time_, &op, op.dma_addr_, op.len_, dma_pending_);
 #endif
-    DmaDo(op);
-  } else {
+    while (dma_pending_ < DMA_MAX_PENDING) {
+      if (DmaDo(op))
+        return;
+    }
+  }
+
 #ifdef DEBUG_NICBM
-    printf(
-        "main_time = %lu: nicbm: enqueuing dma op %p addr %lx len %zu pending "
-        "%zu\n",
-        main_time_, &op, op.dma_addr_, op.len_, dma_pending_);
+  printf(
+      "main_time = %lu: nicbm: enqueuing dma op %p addr %lx len %zu pending "
+      "%zu\n",
+      main_time_, &op, op.dma_addr_, op.len_, dma_pending_);
 #endif
-    dma_queue_.push_back(&op);
-  }
+  dma_queue_.push_back(&op);
 }
 
 void Runner::DmaTrigger() {
-  if (dma_queue_.empty() || dma_pending_ == DMA_MAX_PENDING)
-    return;
-
-  DMAOp *op = dma_queue_.front();
-  dma_queue_.pop_front();
-
-  DmaDo(*op);
+  while (!dma_queue_.empty() && dma_pending_ < DMA_MAX_PENDING) {
+    DMAOp *op = dma_queue_.front();
+    if (DmaDo(*op))
+      dma_queue_.pop_front();
+  }
 }
 
-void Runner::DmaDo(DMAOp &op) {
+bool Runner::DmaDo(DMAOp &op) {
   if (SimbricksBaseIfInTerminated(&nicif_.pcie.base))
-    return;
+    return true;
+
+  // current piece of the operation
+  size_t nsegs = 1;
+  uint64_t addr = op.dma_addr_;
+  size_t len = op.len_;
+  uint8_t *data = static_cast<uint8_t *>(op.data_);
+  if (op.segs_) {
+    assert(op.nsegs_ > 0);
+    const DMASeg &seg = op.segs_[op.seg_idx_];
+    nsegs = op.nsegs_;
+    addr = seg.dma_addr;
+    len = seg.len;
+    data = static_cast<uint8_t *>(seg.data);
+  }
 
-  volatile union SimbricksProtoPcieD2H *msg = D2HAlloc();
+  // split pieces that do not fit into one message
+  size_t maxlen;
+  if (op.write_) {
+    maxlen = SimbricksBaseIfOutMaxMsgLen(&nicif_.pcie.base);
+    maxlen -= std::min(maxlen, sizeof(struct SimbricksProtoPcieD2HWrite));
+  } else {
+    maxlen = SimbricksBaseIfInMaxMsgLen(&nicif_.pcie.base);
+    maxlen -= std::min(maxlen, sizeof(struct SimbricksProtoPcieH2DReadcomp));
+  }
+  if (maxlen == 0) {
+    fprintf(stderr, "issue_dma: messages too small for DMA data\n");
+    abort();
+  }
+  size_t chunk = std::min(len - op.seg_off_, maxlen);
+  addr += op.seg_off_;
+  data += op.seg_off_;
+
+  uint32_t req_id = dma_reqs_free_.back();
+  dma_reqs_free_.pop_back();
+  dma_reqs_[req_id] = {&op, data, chunk};
   dma_pending_++;
+  dma_req_cnt_++;
+
+  if (op.reqs_++ == 0) {
+    op.start_ts_ = main_time_;
+    uint64_t queued = main_time_ - op.issue_ts_;
+    dma_queued_ps_ += queued;
+    if (queued > dma_queued_max_ps_)
+      dma_queued_max_ps_ = queued;
+  }
+  op.outstanding_++;
+  op.seg_off_ += chunk;
+  if (op.seg_off_ == len) {
+    op.seg_idx_++;
+    op.seg_off_ = 0;
+  }
+  op.issued_ = op.seg_idx_ == nsegs;
+
 #ifdef DEBUG_NICBM
   printf(
-      "main_time = %lu: nicbm: executing dma op %p addr %lx len %zu pending "
-      "%zu\n",
-      main_time_, &op, op.dma_addr_, op.len_, dma_pending_);
+      "main_time = %lu: nicbm: executing dma op %p req %u addr %lx len %zu "
+      "pending %zu\n",
+      main_time_, &op, req_id, addr, chunk, dma_pending_);
 #endif
 
-  size_t maxlen = SimbricksBaseIfOutMsgLen(&nicif_.pcie.base);
+  volatile union SimbricksProtoPcieD2H *msg;
   if (op.write_) {
+    msg = D2HAlloc(sizeof(msg->write) + chunk);
     volatile struct SimbricksProtoPcieD2HWrite *write = &msg->write;
-    if (maxlen < sizeof(*write) + op.len_) {
-      fprintf(stderr,
-              "issue_dma: write too big (%zu), can only fit up "
-              "to (%zu)\n",
-              op.len_, maxlen - sizeof(*write));
-      abort();
-    }
 
-    write->req_id = (uintptr_t)&op;
-    write->offset = op.dma_addr_;
-    write->len = op.len_;
-    memcpy((void *)write->data, (void *)op.data_, op.len_);
+    write->req_id = req_id;
+    write->offset = addr;
+    write->len = chunk;
+    memcpy((void *)write->data, data, chunk);
 
 #ifdef DEBUG_NICBM
-    uint8_t *tmp = (uint8_t *)op.data_;
-    int d;
     printf("main_time = %lu: nicbm: dma write data: \n", main_time_);
-    for (d = 0; d < op.len_; d++) {
-      printf("%02X ", *tmp);
-      tmp++;
-    }
+    for (size_t d = 0; d < chunk; d++)
+      printf("%02X ", data[d]);
 #endif
     SimbricksPcieIfD2HOutSend(&nicif_.pcie, msg,
                               SIMBRICKS_PROTO_PCIE_D2H_MSG_WRITE);
   } else {
+    msg = D2HAlloc();
     volatile struct SimbricksProtoPcieD2HRead *read = &msg->read;
-    if (maxlen < sizeof(struct SimbricksProtoPcieH2DReadcomp) + op.len_) {
-      fprintf(stderr,
-              "issue_dma: write too big (%zu), can only fit up "
-              "to (%zu)\n",
-              op.len_, maxlen - sizeof(struct SimbricksProtoPcieH2DReadcomp));
-      abort();
-    }
 
-    read->req_id = (uintptr_t)&op;
-    read->offset = op.dma_addr_;
-    read->len = op.len_;
+    read->req_id = req_id;
+    read->offset = addr;
+    read->len = chunk;
     SimbricksPcieIfD2HOutSend(&nicif_.pcie, msg,
                               SIMBRICKS_PROTO_PCIE_D2H_MSG_READ);
   }
+  return op.issued_;
+}
+
+DMAOp *Runner::DmaReqComplete(uint64_t req_id, const void *data) {
+  assert(req_id < dma_reqs_.size());
+  DmaReq &req = dma_reqs_[req_id];
+  DMAOp *op = req.op;
+
+#ifdef DEBUG_NICBM
+  printf("main_time = %lu: nicbm: completed dma op %p req %lu len %zu\n",
+         main_time_, op, req_id, req.len);
+#endif
+
+  if (data)
+    memcpy(req.data, data, req.len);
+  dma_reqs_free_.push_back(req_id);
+  dma_pending_--;
+
+  // the operation completes with its last request
+  if (--op->outstanding_ > 0 || !op->issued_)
+    return nullptr;
+  dma_ops_done_++;
+  dma_latency_ps_ += main_time_ - op->issue_ts_;
+  return op;
 }
 
 void Runner::MsiIssue(uint8_t vec) {
@@ -277,11 +356,33 @@ void Runner::IntXIssue(bool level) {
 }
 
 void Runner::EventSchedule(TimedEvent &evt) {
-  events_.insert(&evt);
+  if (event_trace_)
+    EventTraceRecord(kEventTraceSchedule, evt);
+  events_.Push(&evt);
 }
 
 void Runner::EventCancel(TimedEvent &evt) {
-  events_.erase(&evt);
+  // cancelling an event that is not scheduled is a no-op
+  if (!evt.Scheduled())
+    return;
+  if (event_trace_)
+    EventTraceRecord(kEventTraceCancel, evt);
+  events_.Remove(&evt);
+}
+
+void Runner::EventTraceRecord(uint8_t op, const TimedEvent &evt) {
+  struct EventTraceEntry ent;
+  memset(&ent, 0, sizeof(ent));
+  ent.now = main_time_;
+  ent.time = evt.time_;
+  ent.event = reinterpret_cast<uintptr_t>(&evt);
+  ent.priority = evt.priority_;
+  ent.op = op;
+  if (fwrite(&ent, sizeof(ent), 1, event_trace_) != 1) {
+    perror("Runner::EventTraceRecord: fwrite failed");
+    fclose(event_trace_);
+    event_trace_ = nullptr;
+  }
 }
 
 void Runner::H2DRead(volatile struct SimbricksProtoPcieH2DRead *read) {
@@ -331,31 +432,16 @@ void Runner::H2DWrite(volatile struct SimbricksProtoPcieH2DWrite *write,
 }
 
 void Runner::H2DReadcomp(volatile struct SimbricksProtoPcieH2DReadcomp *rc) {
-  DMAOp *op = (DMAOp *)(uintptr_t)rc->req_id;
-
-#ifdef DEBUG_NICBM
-  printf("main_time = %lu: nicbm: completed dma read op %p addr %lx len %zu\n",
-         main_time_, op, op->dma_addr_, op->len_);
-#endif
-
-  memcpy(op->data_, (void *)rc->data, op->len_);
-  dev_.DmaComplete(*op);
-
-  dma_pending_--;
+  DMAOp *op = DmaReqComplete(rc->req_id, (const void *)rc->data);
+  if (op)
+    dev_.DmaComplete(*op);
   DmaTrigger();
 }
 
 void Runner::H2DWritecomp(volatile struct SimbricksProtoPcieH2DWritecomp *wc) {
-  DMAOp *op = (DMAOp *)(uintptr_t)wc->req_id;
-
-#ifdef DEBUG_NICBM
-  printf("main_time = %lu: nicbm: completed dma write op %p addr %lx len %zu\n",
-         main_time_, op, op->dma_addr_, op->len_);
-#endif
-
-  dev_.DmaComplete(*op);
-
-  dma_pending_--;
+  DMAOp *op = DmaReqComplete(wc->req_id, nullptr);
+  if (op)
+    dev_.DmaComplete(*op);
   DmaTrigger();
 }
 
@@ -372,19 +458,74 @@ void Runner::EthRecv(volatile struct SimbricksProtoNetMsgPacket *packet) {
   dev_.EthRx(packet->port, (void *)packet->data, packet->len);
 }
 
+void Runner::EthCheckLen(size_t len) {
+  size_t maxlen = SimbricksNetIfOutMaxMsgLen(&nicif_.net);
+  if (maxlen < sizeof(struct SimbricksProtoNetMsgPacket) + len) {
+    fprintf(stderr, "EthSend: packet too big (%zu), can only fit up to (%zu)\n",
+            len, maxlen - sizeof(struct SimbricksProtoNetMsgPacket));
+    abort();
+  }
+}
+
 void Runner::EthSend(const void *data, size_t len) {
+  struct iovec iov = {const_cast<void *>(data), len};
+  EthSendSG(&iov, 1);
+}
+
+void Runner::EthSendSG(const struct iovec *iov, size_t n) {
+  size_t len = 0;
+  for (size_t i = 0; i < n; i++)
+    len += iov[i].iov_len;
+
 #ifdef DEBUG_NICBM
-  printf("main_time = %lu: nicbm: eth tx: len %zu\n", main_time_, len);
+  printf("main_time = %lu: nicbm: eth tx: len %zu (%zu pieces)\n", main_time_,
+         len, n);
 #endif
+  EthCheckLen(len);
 
-  volatile union SimbricksProtoNetMsg *msg = D2NAlloc();
+  volatile union SimbricksProtoNetMsg *msg =
+      D2NAlloc(sizeof(msg->packet) + len);
   volatile struct SimbricksProtoNetMsgPacket *packet = &msg->packet;
   packet->port = 0;  // single port
   packet->len = len;
-  memcpy((void *)packet->data, data, len);
+  uint8_t *dst = (uint8_t *)packet->data;
+  for (size_t i = 0; i < n; i++) {
+    memcpy(dst, iov[i].iov_base, iov[i].iov_len);
+    dst += iov[i].iov_len;
+  }
   SimbricksNetIfOutSend(&nicif_.net, msg, SIMBRICKS_PROTO_NET_MSG_PACKET);
 }
 
+void Runner::EthSendBurst(const struct iovec *frames, size_t n) {
+  struct SimbricksBaseIf *base_if = &nicif_.net.base;
+  size_t pending = 0;
+
+  for (size_t i = 0; i < n; i++) {
+    size_t len = frames[i].iov_len;
+    EthCheckLen(len);
+
+    volatile union SimbricksProtoNetMsg *msg = SimbricksNetIfOutAllocLen(
+        &nicif_.net, main_time_, sizeof(msg->packet) + len);
+    if (msg == nullptr) {
+      // the peer needs to see what we have so far before it can free slots
+      if (pending > 0)
+        SimbricksBaseIfOutDoorbell(base_if);
+      pending = 0;
+      msg = D2NAlloc(sizeof(msg->packet) + len);
+    }
+
+    volatile struct SimbricksProtoNetMsgPacket *packet = &msg->packet;
+    packet->port = 0;  // single port
+    packet->len = len;
+    memcpy((void *)packet->data, frames[i].iov_base, len);
+    SimbricksBaseIfOutHandover(base_if, &msg->base,
+                               SIMBRICKS_PROTO_NET_MSG_PACKET);
+    pending++;
+  }
+  if (pending > 0)
+    SimbricksBaseIfOutDoorbell(base_if);
+}
+
 void Runner::PollH2D() {
   volatile union SimbricksProtoPcieH2D *msg =
       SimbricksPcieIfH2DInPoll(&nicif_.pcie, main_time_);
@@ -446,6 +587,10 @@ void Runner::PollH2D() {
       fprintf(stderr, "poll_h2d: peer terminated\n");
       break;
 
+    case SIMBRICKS_PROTO_MSG_TYPE_SYNC_MODE:
+      SyncSwitch(&nicif_.pcie.base, &nicif_.net.base, &msg->base);
+      break;
+
     default:
       fprintf(stderr, "poll_h2d: unsupported type=%u\n", type);
   }
@@ -490,6 +635,10 @@ void Runner::PollN2D() {
 #endif
       break;
 
+    case SIMBRICKS_PROTO_MSG_TYPE_SYNC_MODE:
+      SyncSwitch(&nicif_.net.base, &nicif_.pcie.base, &msg->base);
+      break;
+
     default:
       fprintf(stderr, "poll_n2d: unsupported type=%u", t);
   }
@@ -497,6 +646,35 @@ void Runner::PollN2D() {
   SimbricksNetIfInDone(&nicif_.net, msg);
 }
 
+void Runner::SyncSwitch(struct SimbricksBaseIf *link,
+                        struct SimbricksBaseIf *other,
+                        volatile union SimbricksProtoBaseMsg *msg) {
+  bool ack = msg->sync_mode.flags & SIMBRICKS_PROTO_SYNC_MODE_ACK;
+  bool enable = msg->sync_mode.flags & SIMBRICKS_PROTO_SYNC_MODE_ENABLE;
+  uint64_t ts = SimbricksBaseIfSyncSwitchHandle(link, msg, main_time_);
+
+  // jump ahead to the switch unless the other link holds us back
+  if (!SimbricksBaseIfSyncEnabled(other))
+    main_time_ = ts;
+  fprintf(stderr, "sync switch %s %s at %lu\n", (enable ? "on" : "off"),
+          (ack ? "acknowledged" : "requested"), main_time_);
+
+  // ask the other link's peer to switch too before acknowledging, the ack is
+  // then held back until it has acknowledged
+  if (!ack && SimbricksBaseIfSyncEnabled(other) != enable &&
+      SimbricksBaseIfSyncSwitchEnabled(other) &&
+      !SimbricksBaseIfSyncSwitchPending(other) &&
+      SimbricksBaseIfSyncSwitch(other, enable, main_time_) != 0)
+    fprintf(stderr, "warn: forwarding sync switch failed\n");
+}
+
+bool Runner::SyncSwitchStalled() {
+  return (SimbricksBaseIfSyncSwitchPending(&nicif_.pcie.base) &&
+          !SimbricksBaseIfSyncEnabled(&nicif_.pcie.base)) ||
+         (SimbricksBaseIfSyncSwitchPending(&nicif_.net.base) &&
+          !SimbricksBaseIfSyncEnabled(&nicif_.net.base));
+}
+
 uint64_t Runner::TimePs() const {
   return main_time_;
 }
@@ -506,40 +684,67 @@ uint64_t Runner::GetMacAddr() const {
 }
 
 bool Runner::EventNext(uint64_t &retval) {
-  if (events_.empty())
+  if (events_.Empty())
     return false;
 
-  retval = (*events_.begin())->time_;
+  retval = events_.Top()->time_;
   return true;
 }
 
 void Runner::EventTrigger() {
-  auto it = events_.begin();
-  if (it == events_.end())
+  TimedEvent *ev = events_.Top();
+  if (ev == nullptr)
     return;
 
-  TimedEvent *ev = *it;
-
   // event is in the future
   if (ev->time_ > main_time_)
     return;
 
-  events_.erase(it);
+  if (event_trace_)
+    EventTraceRecord(kEventTraceTrigger, *ev);
+  events_.Pop();
   dev_.Timed(*ev);
 }
 
 void Runner::YieldPoll() {
 }
 
+void Runner::WaitIdle() {
+  struct SimbricksBaseIf *ifs[2];
+  size_t n = 0;
+
+  if (!SimbricksBaseIfDoorbellEnabled(&nicif_.pcie.base) ||
+      !SimbricksBaseIfDoorbellEnabled(&nicif_.net.base)) {
+    YieldPoll();
+    return;
+  }
+
+  // more events due now, no need to wait
+  uint64_t ev_ts;
+  if (EventNext(ev_ts) && ev_ts <= main_time_)
+    return;
+
+  // only wait for the peers that are holding us back
+  if (SimbricksPcieIfH2DInTimestamp(&nicif_.pcie) <= main_time_)
+    ifs[n++] = &nicif_.pcie.base;
+  if (SimbricksNetIfInTimestamp(&nicif_.net) <= main_time_)
+    ifs[n++] = &nicif_.net.base;
+  if (n > 0)
+    SimbricksBaseIfWaitAny(ifs, n, pcieParams_.doorbell_spin);
+}
+
 int Runner::NicIfInit() {
   return SimbricksNicIfInit(&nicif_, shmPath_, &netParams_, &pcieParams_,
                             &dintro_);
 }
 
-Runner::Runner(Device &dev) : main_time_(0), dev_(dev), events_(EventCmp()) {
+Runner::Runner(Device &dev) : main_time_(0), dev_(dev) {
   // mac_addr = lrand48() & ~(3ULL << 46);
   runners.push_back(this);
   dma_pending_ = 0;
+  dma_reqs_.resize(DMA_MAX_PENDING);
+  for (uint32_t i = DMA_MAX_PENDING; i > 0; i--)
+    dma_reqs_free_.push_back(i - 1);
   dev_.runner_ = this;
 
   int rfd;
@@ -555,12 +760,46 @@ Runner::Runner(Device &dev) : main_time_(0), dev_(dev), events_(EventCmp()) {
 
   SimbricksNetIfDefaultParams(&netParams_);
   SimbricksPcieIfDefaultParams(&pcieParams_);
+
+  // record event operations for benchmarking the event queue offline
+  const char *trace_path = getenv("SIMBRICKS_EVENT_TRACE");
+  if (trace_path && !(event_trace_ = fopen(trace_path, "w")))
+    perror("Runner::Runner: opening event trace failed");
 }
 
 int Runner::ParseArgs(int argc, char *argv[]) {
-  if (argc < 4 || argc > 10) {
+  static const struct option long_opts[] = {
+      {"adaptive-sync", no_argument, nullptr, 'a'},
+      {"multi-slot", no_argument, nullptr, 'm'},
+      {"sync-switch", no_argument, nullptr, 's'},
+      {nullptr, 0, nullptr, 0}};
+  int c;
+  bool bad_option = false;
+  // several instances may parse their arguments in one process
+  optind = 1;
+  while ((c = getopt_long(argc, argv, "+", long_opts, nullptr)) != -1) {
+    switch (c) {
+      case 'a':
+        netParams_.adaptive_sync = pcieParams_.adaptive_sync = true;
+        break;
+      case 'm':
+        netParams_.multi_slot = pcieParams_.multi_slot = true;
+        break;
+      case 's':
+        netParams_.sync_switch = pcieParams_.sync_switch = true;
+        break;
+      default:
+        bad_option = true;
+    }
+  }
+  // positional arguments start at argv[1]
+  argc -= optind - 1;
+  argv += optind - 1;
+
+  if (bad_option || argc < 4 || argc > 10) {
     fprintf(stderr,
-            "Usage: corundum_bm PCI-SOCKET ETH-SOCKET "
+            "Usage: corundum_bm [--adaptive-sync] [--multi-slot] "
+            "[--sync-switch] PCI-SOCKET ETH-SOCKET "
             "SHM [SYNC-MODE] [START-TICK] [SYNC-PERIOD] [PCI-LATENCY] "
             "[ETH-LATENCY] [MAC-ADDR]\n");
     return -1;
@@ -605,10 +844,27 @@ int Runner::RunMain() {
   fprintf(stderr, "mac_addr=%lx\n", mac_addr_);
   fprintf(stderr, "sync_pci=%d sync_eth=%d\n", sync_pcie, sync_net);
 
-  bool is_sync = sync_pcie || sync_net;
-
   while (!exiting) {
-    while (SimbricksNicIfSync(&nicif_, main_time_)) {
+    // messages on either interface or events can trigger sends on both; an
+    // unsynchronized peer can deliver at any time, so nothing can be promised
+    // past the current time then
+    uint64_t lookahead = SimbricksBaseIfSyncEnabled(&nicif_.pcie.base)
+                             ? SimbricksPcieIfH2DInTimestamp(&nicif_.pcie)
+                             : main_time_;
+    uint64_t lookahead_other = SimbricksBaseIfSyncEnabled(&nicif_.net.base)
+                                   ? SimbricksNetIfInTimestamp(&nicif_.net)
+                                   : main_time_;
+    if (lookahead_other < lookahead)
+      lookahead = lookahead_other;
+    if (EventNext(lookahead_other) && lookahead_other < lookahead)
+      lookahead = lookahead_other;
+    SimbricksBaseIfOutLookahead(&nicif_.pcie.base, lookahead);
+    SimbricksBaseIfOutLookahead(&nicif_.net.base, lookahead);
+
+    // while a sync switch we forwarded is pending, time stands still and
+    // acknowledgements on the other link are held back
+    bool stalled = SyncSwitchStalled();
+    while (!stalled && SimbricksNicIfSync(&nicif_, main_time_)) {
       fprintf(stderr, "warn: SimbricksNicIfSync failed (t=%lu)\n", main_time_);
       YieldPoll();
     }
@@ -616,14 +872,19 @@ int Runner::RunMain() {
     bool first = true;
     do {
       if (!first)
-        YieldPoll();
+        WaitIdle();
       first = false;
 
       PollH2D();
       PollN2D();
       EventTrigger();
 
-      if (is_sync) {
+      if (stalled || SyncSwitchStalled()) {
+        next_ts = main_time_;
+        stalled = true;
+        break;
+      } else if (SimbricksBaseIfSyncEnabled(&nicif_.pcie.base) ||
+                 SimbricksBaseIfSyncEnabled(&nicif_.net.base)) {
         next_ts = SimbricksNicIfNextTimestamp(&nicif_);
         if (next_ts > main_time_ + max_step)
           next_ts = main_time_ + max_step;
@@ -635,12 +896,26 @@ int Runner::RunMain() {
       if (EventNext(ev_ts) && ev_ts < next_ts)
         next_ts = ev_ts;
     } while (next_ts <= main_time_ && !exiting);
-    main_time_ = next_ts;
+    if (!stalled)
+      main_time_ = next_ts;
 
     YieldPoll();
   }
 
   fprintf(stderr, "exit main_time: %lu\n", main_time_);
+  fprintf(stderr, "%20s: %22lu %20s: %22lu\n", "d2h_sync_sent",
+          SimbricksBaseIfOutSyncsSent(&nicif_.pcie.base), "d2h_sync_suppressed",
+          SimbricksBaseIfOutSyncsSuppressed(&nicif_.pcie.base));
+  fprintf(stderr, "%20s: %22lu %20s: %22lu\n", "d2n_sync_sent",
+          SimbricksBaseIfOutSyncsSent(&nicif_.net.base), "d2n_sync_suppressed",
+          SimbricksBaseIfOutSyncsSuppressed(&nicif_.net.base));
+  fprintf(stderr, "%20s: %22lu %20s: %22lu\n", "dma_ops", dma_ops_,
+          "dma_reqs", dma_req_cnt_);
+  fprintf(stderr, "%20s: %22lu %20s: %22lu\n", "dma_bytes", dma_bytes_,
+          "dma_queued_max_ps", dma_queued_max_ps_);
+  fprintf(stderr, "%20s: %22lu %20s: %22lu\n", "dma_queued_avg_ps",
+          dma_ops_ ? dma_queued_ps_ / dma_ops_ : 0, "dma_latency_avg_ps",
+          dma_ops_done_ ? dma_latency_ps_ / dma_ops_done_ : 0);
 #ifdef STAT_NICBM
   fprintf(stderr, "%20s: %22lu %20s: %22lu  poll_suc_rate: %f\n",
           "h2d_poll_total", h2d_poll_total, "h2d_poll_suc", h2d_poll_suc,
@@ -683,6 +958,10 @@ int Runner::RunMain() {
 #endif
 
   SimbricksNicIfCleanup(&nicif_);
+  if (event_trace_) {
+    fclose(event_trace_);
+    event_trace_ = nullptr;
+  }
   return 0;
 }
 
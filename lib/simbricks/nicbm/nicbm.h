@@ -25,20 +25,36 @@
 #ifndef SIMBRICKS_NICBM_NICBM_H_
 #define SIMBRICKS_NICBM_NICBM_H_
 
+#include <sys/uio.h>
+
 #include <cassert>
+#include <cstdio>
 #include <cstring>
 #include <deque>
-#include <set>
+#include <vector>
 
 #include <simbricks/base/cxxatomicfix.h>
 extern "C" {
 #include <simbricks/nicif/nicif.h>
 }
+#include "lib/simbricks/nicbm/event_heap.h"
 
 namespace nicbm {
 
 static const size_t kMaxDmaLen = 2048;
 
+/** One piece of a scatter-gather DMA operation. */
+struct DMASeg {
+  uint64_t dma_addr;
+  size_t len;
+  void *data;
+};
+
+/**
+ * A DMA operation for `Runner::IssueDma`. Operations of any length are split
+ * into as many requests as needed, `Device::DmaComplete` is called once all of
+ * them completed.
+ */
 class DMAOp {
  public:
   virtual ~DMAOp() = default;
@@ -46,15 +62,31 @@ class DMAOp {
   uint64_t dma_addr_;
   size_t len_;
   void *data_;
-};
+  /**
+   * Optional scatter-gather list. If set, the `nsegs_` pieces are transferred
+   * in order instead of `dma_addr_`, `len_` and `data_`. The list must stay
+   * valid until the operation completes.
+   */
+  const DMASeg *segs_ = nullptr;
+  size_t nsegs_ = 0;
 
-class TimedEvent {
- public:
-  TimedEvent() : time_(0), priority_(0) {
-  }
-  virtual ~TimedEvent() = default;
-  uint64_t time_;
-  int priority_;
+  /**
+   * Queueing statistics, set by the runner and valid in `DmaComplete`: the
+   * time the operation was issued, the time its first request was sent, and
+   * the number of requests it was split into.
+   */
+  uint64_t issue_ts_ = 0;
+  uint64_t start_ts_ = 0;
+  size_t reqs_ = 0;
+
+ private:
+  friend class Runner;
+  /* next piece to send */
+  size_t seg_idx_ = 0;
+  size_t seg_off_ = 0;
+  /* requests sent but not completed yet */
+  size_t outstanding_ = 0;
+  bool issued_ = false;
 };
 
 /**
@@ -118,18 +150,30 @@ class Runner {
   };
 
  protected:
-  struct EventCmp {
-    bool operator()(TimedEvent *a, TimedEvent *b) const {
-      return a->time_ < b->time_ ||
-             (a->time_ == b->time_ && a->priority_ < b->priority_);
-    }
-  };
-
   uint64_t main_time_;
   Device &dev_;
-  std::multiset<TimedEvent *, EventCmp> events_;
+  EventHeap events_;
+  /* only opened if SIMBRICKS_EVENT_TRACE is set */
+  FILE *event_trace_ = nullptr;
+  /** a request in flight, indexed by its req_id */
+  struct DmaReq {
+    DMAOp *op;
+    void *data;
+    size_t len;
+  };
+  /* operations with pieces that still need to be sent, in issue order */
   std::deque<DMAOp *> dma_queue_;
   size_t dma_pending_;
+  std::vector<DmaReq> dma_reqs_;
+  std::vector<uint32_t> dma_reqs_free_;
+  /* DMA statistics */
+  uint64_t dma_ops_ = 0;
+  uint64_t dma_ops_done_ = 0;
+  uint64_t dma_req_cnt_ = 0;
+  uint64_t dma_bytes_ = 0;
+  uint64_t dma_queued_ps_ = 0;
+  uint64_t dma_queued_max_ps_ = 0;
+  uint64_t dma_latency_ps_ = 0;
   uint64_t mac_addr_;
   struct SimbricksBaseIfParams pcieParams_;
   struct SimbricksBaseIfParams netParams_;
@@ -137,8 +181,11 @@ class Runner {
   struct SimbricksNicIf nicif_;
   struct SimbricksProtoPcieDevIntro dintro_;
 
-  volatile union SimbricksProtoPcieD2H *D2HAlloc();
-  volatile union SimbricksProtoNetMsg *D2NAlloc();
+  volatile union SimbricksProtoPcieD2H *D2HAlloc(
+      size_t len = sizeof(union SimbricksProtoPcieD2H));
+  volatile union SimbricksProtoNetMsg *D2NAlloc(
+      size_t len = sizeof(union SimbricksProtoNetMsg));
+  void EthCheckLen(size_t len);
 
   void H2DRead(volatile struct SimbricksProtoPcieH2DRead *read);
   void H2DWrite(volatile struct SimbricksProtoPcieH2DWrite *write, bool posted);
@@ -150,13 +197,30 @@ class Runner {
   void EthRecv(volatile struct SimbricksProtoNetMsgPacket *packetl);
   void PollN2D();
 
+  /**
+   * Handle a sync mode switch on one link and carry it over to the other, so
+   * that the peers on both sides switch together.
+   */
+  void SyncSwitch(struct SimbricksBaseIf *link, struct SimbricksBaseIf *other,
+                  volatile union SimbricksProtoBaseMsg *msg);
+  /** Waiting for the peer to acknowledge switching on sync on a link. */
+  bool SyncSwitchStalled();
+
   bool EventNext(uint64_t &retval);
   void EventTrigger();
+  void EventTraceRecord(uint8_t op, const TimedEvent &evt);
 
-  void DmaDo(DMAOp &op);
+  /** Send the next request of `op`, returns true once all are sent. */
+  bool DmaDo(DMAOp &op);
   void DmaTrigger();
+  DMAOp *DmaReqComplete(uint64_t req_id, const void *data);
 
   virtual void YieldPoll();
+  /**
+   * Wait until a peer we are waiting for sends something. Blocks on the
+   * doorbells if enabled, otherwise only yields.
+   */
+  virtual void WaitIdle();
   virtual int NicIfInit();
 
  public:
@@ -169,11 +233,25 @@ class Runner {
   int RunMain();
 
   /* these three are for `Runner::Device`. */
+  /**
+   * Issue the DMA operation `op`, contiguous or scatter-gather. `op` must not
+   * be issued again before its `DmaComplete`.
+   */
   void IssueDma(DMAOp &op);
   void MsiIssue(uint8_t vec);
   void MsiXIssue(uint8_t vec);
   void IntXIssue(bool level);
   void EthSend(const void *data, size_t len);
+  /**
+   * Send a packet assembled from the `n` pieces in `iov`, copied directly into
+   * the queue (e.g. headers from one buffer and payload from another).
+   */
+  void EthSendSG(const struct iovec *iov, size_t n);
+  /**
+   * Send `n` packets at once, each contiguous in `frames`. The peer is only
+   * notified once for the whole burst.
+   */
+  void EthSendBurst(const struct iovec *frames, size_t n);
 
   void EventSchedule(TimedEvent &evt);
   void EventCancel(TimedEvent &evt);
@@ -24,7 +24,7 @@ include mk/subdir_pre.mk
 
 lib_nicbm := $(d)libnicbm.a
 
-OBJS := $(addprefix $(d),nicbm.o multinic.o)
+OBJS := $(addprefix $(d),nicbm.o multinic.o event_heap.o)
 
 $(lib_nicbm): $(OBJS)
 
@@ -37,14 +37,10 @@ int SimbricksNicIfInit(struct SimbricksNicIf *nicif, const char *shm_path,
 
   // first allocate pool
   size_t shm_size = 0;
-  if (netParams) {
-    shm_size += netParams->in_num_entries * netParams->in_entries_size;
-    shm_size += netParams->out_num_entries * netParams->out_entries_size;
-  }
-  if (pcieParams) {
-    shm_size += pcieParams->in_num_entries * pcieParams->in_entries_size;
-    shm_size += pcieParams->out_num_entries * pcieParams->out_entries_size;
-  }
+  if (netParams)
+    shm_size += SimbricksBaseIfSHMSize(netParams);
+  if (pcieParams)
+    shm_size += SimbricksBaseIfSHMSize(pcieParams);
   if (SimbricksBaseIfSHMPoolCreate(&nicif->pool, shm_path, shm_size)) {
     perror("SimbricksNicIfInit: SimbricksBaseIfSHMPoolCreate failed");
     return -1;
@@ -52,15 +52,22 @@ static inline int SimbricksNicIfSync(struct SimbricksNicIf *nicif,
               : -1);
 }
 
+/* only synchronized links hold us back, sync can be switched at runtime */
 static inline uint64_t SimbricksNicIfNextTimestamp(
     struct SimbricksNicIf *nicif) {
-  uint64_t net_in = SimbricksNetIfInTimestamp(&nicif->net);
-  uint64_t net_out = SimbricksNetIfOutNextSync(&nicif->net);
-  uint64_t net = (net_in <= net_out ? net_in : net_out);
+  uint64_t net = UINT64_MAX;
+  if (SimbricksBaseIfSyncEnabled(&nicif->net.base)) {
+    uint64_t net_in = SimbricksNetIfInTimestamp(&nicif->net);
+    uint64_t net_out = SimbricksNetIfOutNextSync(&nicif->net);
+    net = (net_in <= net_out ? net_in : net_out);
+  }
 
-  uint64_t pcie_in = SimbricksPcieIfH2DInTimestamp(&nicif->pcie);
-  uint64_t pcie_out = SimbricksPcieIfD2HOutNextSync(&nicif->pcie);
-  uint64_t pcie = (pcie_in <= pcie_out ? pcie_in : pcie_out);
+  uint64_t pcie = UINT64_MAX;
+  if (SimbricksBaseIfSyncEnabled(&nicif->pcie.base)) {
+    uint64_t pcie_in = SimbricksPcieIfH2DInTimestamp(&nicif->pcie);
+    uint64_t pcie_out = SimbricksPcieIfD2HOutNextSync(&nicif->pcie);
+    pcie = (pcie_in <= pcie_out ? pcie_in : pcie_out);
+  }
 
   return (net < pcie ? net : pcie);
 }
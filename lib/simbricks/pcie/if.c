@@ -24,8 +24,45 @@
 
 #include "lib/simbricks/pcie/if.h"
 
+#include <simbricks/base/record.h>
+
+static size_t PcieRecordLen(struct SimbricksBaseIf *base_if,
+                            volatile union SimbricksProtoBaseMsg *msg,
+                            uint8_t type, bool out) {
+  volatile union SimbricksProtoPcieD2H *d2h =
+      (volatile union SimbricksProtoPcieD2H *)msg;
+  volatile union SimbricksProtoPcieH2D *h2d =
+      (volatile union SimbricksProtoPcieH2D *)msg;
+  size_t len;
+
+  switch (type) {
+    case SIMBRICKS_PROTO_PCIE_D2H_MSG_READ:
+      SimbricksBaseIfRecordReadLen(base_if, out, d2h->read.req_id,
+                                   d2h->read.len);
+      return sizeof(d2h->read);
+    case SIMBRICKS_PROTO_PCIE_D2H_MSG_WRITE:
+      return sizeof(d2h->write) + d2h->write.len;
+    case SIMBRICKS_PROTO_PCIE_D2H_MSG_READCOMP:
+      len = SimbricksBaseIfRecordCompLen(base_if, out, d2h->readcomp.req_id);
+      return (len == SIZE_MAX ? 0 : sizeof(d2h->readcomp) + len);
+    case SIMBRICKS_PROTO_PCIE_H2D_MSG_READ:
+      SimbricksBaseIfRecordReadLen(base_if, out, h2d->read.req_id,
+                                   h2d->read.len);
+      return sizeof(h2d->read);
+    case SIMBRICKS_PROTO_PCIE_H2D_MSG_WRITE:
+    case SIMBRICKS_PROTO_PCIE_H2D_MSG_WRITE_POSTED:
+      return sizeof(h2d->write) + h2d->write.len;
+    case SIMBRICKS_PROTO_PCIE_H2D_MSG_READCOMP:
+      len = SimbricksBaseIfRecordCompLen(base_if, out, h2d->readcomp.req_id);
+      return (len == SIZE_MAX ? 0 : sizeof(h2d->readcomp) + len);
+    default:
+      return sizeof(*msg);
+  }
+}
+
 void SimbricksPcieIfDefaultParams(struct SimbricksBaseIfParams *params) {
   SimbricksBaseIfDefaultParams(params);
   params->upper_layer_proto = SIMBRICKS_PROTO_ID_PCIE;
+  params->record_len = PcieRecordLen;
   params->in_entries_size = params->out_entries_size = 9024 + 64;
 }
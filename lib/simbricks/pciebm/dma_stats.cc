@@ -0,0 +1,154 @@
+/*
+ * Copyright 2024 Max Planck Institute for Software Systems, and
+ * National University of Singapore
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "lib/simbricks/pciebm/dma_stats.hh"
+
+#include <algorithm>
+
+namespace pciebm {
+
+uint64_t LogHistogram::BucketLow(size_t b) {
+  if (b < (1ULL << kSubBits))
+    return b;
+  unsigned shift = (b >> kSubBits) - 1;
+  return ((1ULL << kSubBits) | (b & ((1ULL << kSubBits) - 1))) << shift;
+}
+
+uint64_t LogHistogram::BucketHigh(size_t b) {
+  if (b < (1ULL << kSubBits))
+    return b;
+  unsigned shift = (b >> kSubBits) - 1;
+  return BucketLow(b) + ((1ULL << shift) - 1);
+}
+
+uint64_t LogHistogram::Quantile(double p) const {
+  if (count_ == 0)
+    return 0;
+  uint64_t rank = static_cast<uint64_t>(p * count_);
+  if (rank >= count_)
+    rank = count_ - 1;
+
+  uint64_t seen = 0;
+  for (size_t b = 0; b < kBuckets; b++) {
+    seen += counts_[b];
+    if (seen > rank)
+      return std::min(BucketHigh(b), max_);
+  }
+  return max_;
+}
+
+void LogHistogram::WriteJson(FILE *out) const {
+  fprintf(out,
+          "{\"count\": %lu, \"min\": %lu, \"max\": %lu, \"mean\": %.1f, "
+          "\"p50\": %lu, \"p90\": %lu, \"p99\": %lu, \"p999\": %lu, "
+          "\"buckets\": [",
+          count_, (count_ > 0 ? min_ : 0), max_,
+          (count_ > 0 ? static_cast<double>(sum_) / count_ : 0.0),
+          Quantile(0.5), Quantile(0.9), Quantile(0.99), Quantile(0.999));
+  // only non-empty buckets as [low, high, count]
+  bool first = true;
+  for (size_t b = 0; b < kBuckets; b++) {
+    if (counts_[b] == 0)
+      continue;
+    fprintf(out, "%s[%lu, %lu, %lu]", (first ? "" : ", "), BucketLow(b),
+            BucketHigh(b), counts_[b]);
+    first = false;
+  }
+  fprintf(out, "]}");
+}
+
+DmaStats::DmaStats(uint32_t max_pending) {
+  for (Dir &dir : dirs_)
+    dir.occupancy.resize(static_cast<size_t>(max_pending) + 1);
+}
+
+void DmaStats::OpComplete(bool write, uint32_t tag, size_t len,
+                          uint64_t start, uint64_t queued, uint64_t latency,
+                          uint64_t now) {
+  Tag &t = dirs_[write].tags[tag];
+  t.ops++;
+  t.bytes += len;
+  t.first = std::min(t.first, start);
+  t.last = now;
+  t.queued.Record(queued);
+  t.latency.Record(latency);
+}
+
+/* bytes per simulated microsecond between `first` and `last` */
+static double Bandwidth(uint64_t bytes, uint64_t first, uint64_t last) {
+  if (last <= first)
+    return 0;
+  return static_cast<double>(bytes) * 1000000 / (last - first);
+}
+
+void DmaStats::WriteJson(FILE *out, uint64_t now) const {
+  fprintf(out, "{\"time_ps\": %lu", now);
+  for (bool write : {false, true}) {
+    const Dir &dir = dirs_[write];
+
+    uint64_t ops = 0;
+    uint64_t bytes = 0;
+    uint64_t first = UINT64_MAX;
+    uint64_t last = 0;
+    std::vector<uint32_t> tags;
+    for (const auto &it : dir.tags) {
+      ops += it.second.ops;
+      bytes += it.second.bytes;
+      first = std::min(first, it.second.first);
+      last = std::max(last, it.second.last);
+      tags.push_back(it.first);
+    }
+    std::sort(tags.begin(), tags.end());
+
+    fprintf(out,
+            ",\n \"%s\": {\"ops\": %lu, \"bytes\": %lu, "
+            "\"bytes_per_us\": %.3f,\n  \"occupancy_ps\": [",
+            (write ? "write" : "read"), ops, bytes,
+            Bandwidth(bytes, first, last));
+    for (size_t i = 0; i < dir.occupancy.size(); i++) {
+      uint64_t t = dir.occupancy[i];
+      if (i == dir.pending)
+        t += now - dir.since;
+      fprintf(out, "%s%lu", (i == 0 ? "" : ", "), t);
+    }
+    fprintf(out, "],\n  \"tags\": {");
+
+    for (size_t i = 0; i < tags.size(); i++) {
+      const Tag &t = dir.tags.at(tags[i]);
+      fprintf(out,
+              "%s\n   \"%u\": {\"ops\": %lu, \"bytes\": %lu, "
+              "\"bytes_per_us\": %.3f,\n    \"queue_delay_ps\": ",
+              (i == 0 ? "" : ","), tags[i], t.ops, t.bytes,
+              Bandwidth(t.bytes, t.first, t.last));
+      t.queued.WriteJson(out);
+      fprintf(out, ",\n    \"latency_ps\": ");
+      t.latency.WriteJson(out);
+      fprintf(out, "}");
+    }
+    fprintf(out, "}}");
+  }
+  fprintf(out, "}\n");
+}
+
+}  // namespace pciebm
@@ -0,0 +1,121 @@
+/*
+ * Copyright 2024 Max Planck Institute for Software Systems, and
+ * National University of Singapore
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef SIMBRICKS_PCIEBM_DMA_STATS_H_
+#define SIMBRICKS_PCIEBM_DMA_STATS_H_
+
+#include <cstdint>
+#include <cstdio>
+#include <unordered_map>
+#include <vector>
+
+namespace pciebm {
+
+/* Histogram with logarithmic buckets in the style of HdrHistogram: values
+ * below 2^kSubBits are counted exactly, larger values in 2^kSubBits buckets
+ * per power of two, so the relative error stays below 1/2^kSubBits over the
+ * whole 64-bit range. Recording is a few instructions and never allocates. */
+class LogHistogram {
+ public:
+  static constexpr unsigned kSubBits = 3;
+  static constexpr size_t kBuckets = (64 - kSubBits + 1) << kSubBits;
+
+  void Record(uint64_t val) {
+    counts_[BucketOf(val)]++;
+    count_++;
+    sum_ += val;
+    if (val < min_)
+      min_ = val;
+    if (val > max_)
+      max_ = val;
+  }
+
+  uint64_t Count() const {
+    return count_;
+  }
+  /* Returns the upper bound of the bucket holding the `p` quantile. */
+  uint64_t Quantile(double p) const;
+  /* Write the histogram as a JSON object. */
+  void WriteJson(FILE *out) const;
+
+ private:
+  uint64_t counts_[kBuckets] = {};
+  uint64_t count_ = 0;
+  uint64_t sum_ = 0;
+  uint64_t min_ = UINT64_MAX;
+  uint64_t max_ = 0;
+
+  static size_t BucketOf(uint64_t val) {
+    if (val < (1ULL << kSubBits))
+      return val;
+    unsigned shift = 63 - __builtin_clzll(val) - kSubBits;
+    return ((shift + 1) << kSubBits) |
+           ((val >> shift) & ((1ULL << kSubBits) - 1));
+  }
+  static uint64_t BucketLow(size_t b);
+  static uint64_t BucketHigh(size_t b);
+};
+
+/* DMA instrumentation for `PcieBM`, kept per direction and per operation
+ * tag. All times are simulated picoseconds. */
+class DmaStats {
+ public:
+  explicit DmaStats(uint32_t max_pending);
+
+  /* Operation `tag` spent `queued` waiting for a free request slot and
+   * `latency` from its first request until completion. */
+  void OpComplete(bool write, uint32_t tag, size_t len, uint64_t start,
+                  uint64_t queued, uint64_t latency, uint64_t now);
+  /* The number of requests in flight changed to `pending` at `now`. */
+  void Pending(bool write, size_t pending, uint64_t now) {
+    Dir &dir = dirs_[write];
+    dir.occupancy[dir.pending] += now - dir.since;
+    dir.pending = pending;
+    dir.since = now;
+  }
+
+  /* Write all statistics as a JSON object. */
+  void WriteJson(FILE *out, uint64_t now) const;
+
+ private:
+  struct Tag {
+    uint64_t ops = 0;
+    uint64_t bytes = 0;
+    uint64_t first = UINT64_MAX;
+    uint64_t last = 0;
+    LogHistogram queued;
+    LogHistogram latency;
+  };
+  struct Dir {
+    /* time spent with a given number of requests in flight */
+    std::vector<uint64_t> occupancy;
+    size_t pending = 0;
+    uint64_t since = 0;
+    std::unordered_map<uint32_t, Tag> tags;
+  };
+  Dir dirs_[2];
+};
+
+}  // namespace pciebm
+#endif  // SIMBRICKS_PCIEBM_DMA_STATS_H_
@@ -0,0 +1,257 @@
+/*
+ * Copyright 2024 Max Planck Institute for Software Systems, and
+ * National University of Singapore
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "lib/simbricks/pciebm/event_queue.hh"
+
+#include <cassert>
+
+namespace pciebm {
+
+static inline bool EventBefore(const TimedEvent *a, const TimedEvent *b) {
+  return a->time < b->time ||
+         (a->time == b->time && a->priority < b->priority);
+}
+
+EventQueue::EventQueue() : buckets_(kMinBuckets), mask_(kMinBuckets - 1) {
+}
+
+TimedEvent *EventQueue::Alloc() {
+  if (pool_free_ == nullptr) {
+    std::unique_ptr<TimedEvent[]> chunk(new TimedEvent[kPoolChunk]);
+    for (size_t i = 0; i < kPoolChunk; i++) {
+      chunk[i].pooled_ = true;
+      chunk[i].next_ = (i + 1 < kPoolChunk ? &chunk[i + 1] : nullptr);
+    }
+    pool_free_ = &chunk[0];
+    pool_chunks_.push_back(std::move(chunk));
+  }
+
+  TimedEvent *evt = pool_free_;
+  pool_free_ = evt->next_;
+  evt->next_ = nullptr;
+  evt->time = 0;
+  evt->priority = 0;
+  return evt;
+}
+
+void EventQueue::Free(TimedEvent *evt) {
+  assert(evt->pooled_ && !evt->Scheduled() &&
+         "EventQueue::Free: event not pooled or still scheduled");
+  evt->next_ = pool_free_;
+  pool_free_ = evt;
+}
+
+uint64_t EventQueue::TopOf(uint64_t time) const {
+  uint64_t start = time - time % width_;
+  if (UINT64_MAX - start < width_ - 1)
+    return UINT64_MAX;
+  return start + width_ - 1;
+}
+
+void EventQueue::Insert(TimedEvent *evt) {
+  size_t b = BucketOf(evt->time);
+  Bucket &bkt = buckets_[b];
+
+  // events are mostly scheduled in increasing time, so search from the tail
+  TimedEvent *pos = bkt.tail;
+  while (pos != nullptr && EventBefore(evt, pos))
+    pos = pos->prev_;
+
+  evt->prev_ = pos;
+  if (pos == nullptr) {
+    evt->next_ = bkt.head;
+    bkt.head = evt;
+  } else {
+    evt->next_ = pos->next_;
+    pos->next_ = evt;
+  }
+  if (evt->next_ == nullptr)
+    bkt.tail = evt;
+  else
+    evt->next_->prev_ = evt;
+  evt->bucket_ = b;
+  size_++;
+
+  // keep the search position at or before the earliest event
+  uint64_t top = TopOf(evt->time);
+  if (top < cur_top_ || size_ == 1) {
+    cur_ = b;
+    cur_top_ = top;
+  }
+  if (min_ != nullptr && EventBefore(evt, min_))
+    min_ = evt;
+}
+
+void EventQueue::Unlink(TimedEvent *evt) {
+  Bucket &bkt = buckets_[evt->bucket_];
+  if (evt->prev_ == nullptr)
+    bkt.head = evt->next_;
+  else
+    evt->prev_->next_ = evt->next_;
+  if (evt->next_ == nullptr)
+    bkt.tail = evt->prev_;
+  else
+    evt->next_->prev_ = evt->prev_;
+
+  evt->prev_ = evt->next_ = nullptr;
+  evt->bucket_ = TimedEvent::kUnscheduled;
+  if (min_ == evt)
+    min_ = nullptr;
+  size_--;
+}
+
+TimedEvent *EventQueue::FindMin() {
+  if (size_ == 0)
+    return nullptr;
+
+  // scan one year of buckets starting at the search position
+  for (size_t i = 0; i < buckets_.size(); i++) {
+    TimedEvent *head = buckets_[cur_].head;
+    if (head != nullptr && head->time <= cur_top_)
+      return head;
+    cur_ = (cur_ + 1) & mask_;
+    cur_top_ = (UINT64_MAX - cur_top_ < width_ ? UINT64_MAX
+                                               : cur_top_ + width_);
+  }
+
+  // all events are more than a year away, fall back to a direct search
+  TimedEvent *min = nullptr;
+  for (Bucket &bkt : buckets_) {
+    if (bkt.head != nullptr && (min == nullptr || EventBefore(bkt.head, min)))
+      min = bkt.head;
+  }
+  cur_ = min->bucket_;
+  cur_top_ = TopOf(min->time);
+
+  // the bucket width is too small for the current events, re-estimate it
+  if (size_ > 1)
+    Resize(buckets_.size());
+  return min;
+}
+
+void EventQueue::Resize(size_t nbuckets) {
+  // collect the earliest events of the coming year in order, without
+  // removing them
+  uint64_t sample[kSampleSize];
+  size_t nsample = 0;
+  if (Peek() != nullptr) {
+    size_t b = cur_;
+    uint64_t top = cur_top_;
+    for (size_t i = 0; i < buckets_.size() && nsample < kSampleSize; i++) {
+      for (TimedEvent *evt = buckets_[b].head;
+           evt != nullptr && evt->time <= top && nsample < kSampleSize;
+           evt = evt->next_)
+        sample[nsample++] = evt->time;
+      b = (b + 1) & mask_;
+      top = (UINT64_MAX - top < width_ ? UINT64_MAX : top + width_);
+    }
+  }
+
+  // unlink all events in order, so that equal events keep their order
+  TimedEvent *all = nullptr;
+  uint64_t max_time = 0;
+  for (size_t b = buckets_.size(); b-- > 0;) {
+    TimedEvent *evt = buckets_[b].tail;
+    while (evt != nullptr) {
+      TimedEvent *prev = evt->prev_;
+      if (evt->time > max_time)
+        max_time = evt->time;
+      evt->next_ = all;
+      all = evt;
+      evt = prev;
+    }
+  }
+
+  // estimate the bucket width from the average separation of the earliest
+  // events, ignoring outliers (Brown's heuristic)
+  double width = 0;
+  if (nsample >= 2) {
+    double avg = static_cast<double>(sample[nsample - 1] - sample[0]) /
+                 (nsample - 1);
+    double sum = 0;
+    size_t n = 0;
+    for (size_t i = 1; i < nsample; i++) {
+      double sep = static_cast<double>(sample[i] - sample[i - 1]);
+      if (sep <= 2 * avg) {
+        sum += sep;
+        n++;
+      }
+    }
+    width = (n > 0 && sum > 0 ? 3 * sum / n : 3 * avg);
+  } else if (min_ != nullptr && size_ > 1) {
+    // the year was too short to find a sample, spread out all events
+    width = 3 * static_cast<double>(max_time - min_->time) / size_;
+  }
+  if (width >= 1)
+    width_ = (width < kMaxWidth ? static_cast<uint64_t>(width) : kMaxWidth);
+
+  buckets_.assign(nbuckets, Bucket());
+  mask_ = nbuckets - 1;
+
+  size_t n = size_;
+  size_ = 0;
+  while (all != nullptr) {
+    TimedEvent *evt = all;
+    all = evt->next_;
+    Insert(evt);
+  }
+  assert(size_ == n);
+  (void)n;
+
+  if (min_ != nullptr) {
+    cur_ = min_->bucket_;
+    cur_top_ = TopOf(min_->time);
+  }
+}
+
+void EventQueue::Schedule(TimedEvent *evt) {
+  assert(!evt->Scheduled() && "EventQueue::Schedule: already scheduled");
+  Insert(evt);
+  if (size_ > 2 * buckets_.size())
+    Resize(2 * buckets_.size());
+}
+
+void EventQueue::Cancel(TimedEvent *evt) {
+  assert(evt->Scheduled() && "EventQueue::Cancel: event not scheduled");
+  Unlink(evt);
+  if (size_ < buckets_.size() / 2 && buckets_.size() > kMinBuckets)
+    Resize(buckets_.size() / 2);
+}
+
+TimedEvent *EventQueue::Peek() {
+  if (min_ == nullptr)
+    min_ = FindMin();
+  return min_;
+}
+
+TimedEvent *EventQueue::Pop() {
+  TimedEvent *evt = Peek();
+  if (evt == nullptr)
+    return nullptr;
+
+  Cancel(evt);
+  return evt;
+}
+
+}  // namespace pciebm
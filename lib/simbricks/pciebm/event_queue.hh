@@ -0,0 +1,137 @@
+/*
+ * Copyright 2024 Max Planck Institute for Software Systems, and
+ * National University of Singapore
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef SIMBRICKS_PCIEBM_EVENT_QUEUE_H_
+#define SIMBRICKS_PCIEBM_EVENT_QUEUE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace pciebm {
+
+/* An event that can be scheduled on an `EventQueue`. Events are either owned
+ * by the behavioral model (e.g. as class members) or allocated from the pool
+ * of the queue. The queue links events intrusively, so scheduling, cancelling
+ * and rescheduling never allocate. */
+struct TimedEvent {
+  uint64_t time = 0;
+  /* events with the same time execute in ascending priority, and in the order
+   * they were scheduled for equal priorities */
+  int priority = 0;
+
+  /* Returns true if the event is currently scheduled. */
+  bool Scheduled() const {
+    return bucket_ != kUnscheduled;
+  }
+  /* Returns true if the event was allocated from the pool of a queue. */
+  bool Pooled() const {
+    return pooled_;
+  }
+
+ private:
+  friend class EventQueue;
+  static constexpr size_t kUnscheduled = SIZE_MAX;
+
+  TimedEvent *prev_ = nullptr;
+  TimedEvent *next_ = nullptr;
+  size_t bucket_ = kUnscheduled;
+  bool pooled_ = false;
+};
+
+/* Calendar queue (R. Brown, CACM 1988) of `TimedEvent`s. Events are hashed
+ * into buckets of a fixed time width, each bucket is a sorted list. The
+ * number of buckets follows the number of pending events and the width is
+ * re-estimated from the spacing of the earliest events on every resize, so
+ * that all operations take O(1) amortized time for the usual event time
+ * distributions. */
+class EventQueue {
+ public:
+  EventQueue();
+  EventQueue(const EventQueue &) = delete;
+  EventQueue &operator=(const EventQueue &) = delete;
+
+  /* Allocate an unscheduled event from the pool. */
+  TimedEvent *Alloc();
+  /* Return an unscheduled pooled event to the pool. */
+  void Free(TimedEvent *evt);
+
+  /* Schedule `evt` at `evt->time`. The event must not be scheduled yet. */
+  void Schedule(TimedEvent *evt);
+  /* Remove a scheduled event from the queue. */
+  void Cancel(TimedEvent *evt);
+
+  /* Returns the earliest event without removing it, nullptr if empty. */
+  TimedEvent *Peek();
+  /* Remove and return the earliest event, nullptr if empty. */
+  TimedEvent *Pop();
+
+  size_t Size() const {
+    return size_;
+  }
+  bool Empty() const {
+    return size_ == 0;
+  }
+
+ private:
+  struct Bucket {
+    TimedEvent *head = nullptr;
+    TimedEvent *tail = nullptr;
+  };
+
+  static constexpr size_t kMinBuckets = 16;
+  static constexpr size_t kPoolChunk = 256;
+  static constexpr size_t kSampleSize = 25;
+  static constexpr uint64_t kMaxWidth = UINT64_MAX / 4;
+
+  std::vector<Bucket> buckets_;
+  size_t mask_ = 0;
+  /* bucket width [ps] */
+  uint64_t width_ = 1;
+  size_t size_ = 0;
+
+  /* search position: bucket `cur_` holds the events of the current year up to
+   * and including `cur_top_`, no event is earlier than this bucket */
+  size_t cur_ = 0;
+  uint64_t cur_top_ = 0;
+  /* cached earliest event, if known */
+  TimedEvent *min_ = nullptr;
+
+  /* pooled events */
+  std::vector<std::unique_ptr<TimedEvent[]>> pool_chunks_;
+  TimedEvent *pool_free_ = nullptr;
+
+  size_t BucketOf(uint64_t time) const {
+    return static_cast<size_t>(time / width_) & mask_;
+  }
+  uint64_t TopOf(uint64_t time) const;
+  void Insert(TimedEvent *evt);
+  void Unlink(TimedEvent *evt);
+  TimedEvent *FindMin();
+  void Resize(size_t nbuckets);
+};
+
+}  // namespace pciebm
+#endif  // SIMBRICKS_PCIEBM_EVENT_QUEUE_H_
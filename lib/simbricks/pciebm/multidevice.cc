@@ -0,0 +1,145 @@
+/*
+ * Copyright 2024 Max Planck Institute for Software Systems, and
+ * National University of Singapore
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "lib/simbricks/pciebm/multidevice.hh"
+
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <thread>
+
+extern "C" {
+#include <simbricks/base/affinity.h>
+}
+
+namespace pciebm {
+
+MultiDeviceRunner::MultiDeviceRunner(DeviceFactory &factory)
+    : factory_(factory) {
+}
+
+int MultiDeviceRunner::RunDevice(size_t idx, int argc, char *argv[]) {
+  // pin before creating the device, so its memory is allocated locally
+  if (!affinity_.empty()) {
+    int ret = SimbricksPinThread(affinity_[idx % affinity_.size()]);
+    if (ret != 0)
+      fprintf(stderr, "RunDevice: setting affinity failed: %s\n",
+              strerror(ret));
+  }
+
+  std::unique_ptr<PcieBM> dev = factory_.Create();
+
+  {
+    // getopt is not thread-safe, so parse one device at a time
+    std::unique_lock<std::mutex> lk(mx_);
+    if (!dev->ParseArgs(argc, argv))
+      failed_ = true;
+    parsed_++;
+    cv_.notify_all();
+    cv_.wait(lk, [this] { return parsed_ == num_devs_; });
+    if (failed_)
+      return EXIT_FAILURE;
+  }
+
+  running_[idx].store(dev.get());
+  int ret = dev->RunMain();
+  running_[idx].store(nullptr);
+  return ret;
+}
+
+int MultiDeviceRunner::RunMain(int argc, char *argv[]) {
+  // split the arguments into groups, each starting with the program name
+  std::vector<std::vector<char *>> dev_args;
+  int start = 1;
+  if (argc > 1 && strncmp(argv[1], "--affinity=", 11) == 0) {
+    int cpus[CPU_SETSIZE];
+    int n = SimbricksParseCpuList(argv[1] + 11, cpus, CPU_SETSIZE);
+    if (n < 0) {
+      fprintf(stderr, "invalid CPU list: %s\n", argv[1] + 11);
+      return EXIT_FAILURE;
+    }
+    affinity_.assign(cpus, cpus + n);
+    start = 2;
+  }
+  do {
+    int end;
+    for (end = start; end < argc && strcmp(argv[end], "--"); end++) {
+    }
+    std::vector<char *> args{argv[0]};
+    args.insert(args.end(), argv + start, argv + end);
+    args.push_back(nullptr);
+    dev_args.push_back(std::move(args));
+    start = end + 1;
+  } while (start < argc);
+
+  num_devs_ = dev_args.size();
+  running_ = std::make_unique<std::atomic<PcieBM *>[]>(num_devs_);
+  for (size_t i = 0; i < num_devs_; i++)
+    running_[i].store(nullptr);
+
+  std::vector<int> results(num_devs_, EXIT_SUCCESS);
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < num_devs_; i++) {
+    threads.emplace_back([this, i, &dev_args, &results]() {
+      results[i] = RunDevice(i, static_cast<int>(dev_args[i].size() - 1),
+                             dev_args[i].data());
+    });
+  }
+
+  int ret = EXIT_SUCCESS;
+  for (size_t i = 0; i < num_devs_; i++) {
+    threads[i].join();
+    if (results[i] != EXIT_SUCCESS)
+      ret = results[i];
+  }
+  return ret;
+}
+
+void MultiDeviceRunner::SIGINTHandler() {
+  for (size_t i = 0; i < num_devs_; i++) {
+    PcieBM *dev = running_[i].load();
+    if (dev != nullptr)
+      dev->SIGINTHandler();
+  }
+}
+
+void MultiDeviceRunner::SIGUSR1Handler() {
+  for (size_t i = 0; i < num_devs_; i++) {
+    PcieBM *dev = running_[i].load();
+    if (dev != nullptr)
+      dev->SIGUSR1Handler();
+  }
+}
+
+void MultiDeviceRunner::SIGUSR2Handler() {
+  for (size_t i = 0; i < num_devs_; i++) {
+    PcieBM *dev = running_[i].load();
+    if (dev != nullptr)
+      dev->SIGUSR2Handler();
+  }
+}
+
+}  // namespace pciebm
@@ -0,0 +1,84 @@
+/*
+ * Copyright 2024 Max Planck Institute for Software Systems, and
+ * National University of Singapore
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef SIMBRICKS_PCIEBM_MULTIDEVICE_H_
+#define SIMBRICKS_PCIEBM_MULTIDEVICE_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "lib/simbricks/pciebm/pciebm.hh"
+
+namespace pciebm {
+
+/* Runs several `PcieBM` devices in one process, each on its own worker
+ * thread with its own event queue and PCIe interface. Devices are created on
+ * their worker thread, so models may keep per-instance state in thread-local
+ * variables. */
+class MultiDeviceRunner {
+ public:
+  class DeviceFactory {
+   public:
+    virtual ~DeviceFactory() = default;
+    /* Create a new device, invoked on the worker thread of the device. */
+    virtual std::unique_ptr<PcieBM> Create() = 0;
+  };
+
+  explicit MultiDeviceRunner(DeviceFactory &factory);
+
+  /* Run one device for every group of arguments, groups are separated by
+   * "--". The groups may be preceded by --affinity=CPUS (e.g. 0-3,8) to pin
+   * the device threads to CPUS, round robin. Returns once all devices have
+   * exited. */
+  int RunMain(int argc, char *argv[]);
+
+  /* Forward signals to all running devices. */
+  void SIGINTHandler();
+  void SIGUSR1Handler();
+  void SIGUSR2Handler();
+
+ private:
+  DeviceFactory &factory_;
+
+  /* devices that are running, for the signal handlers */
+  std::unique_ptr<std::atomic<PcieBM *>[]> running_;
+  size_t num_devs_ = 0;
+  /* CPUs to pin the device threads to, round robin */
+  std::vector<int> affinity_;
+
+  /* all devices parse their arguments before any starts running */
+  std::mutex mx_;
+  std::condition_variable cv_;
+  size_t parsed_ = 0;
+  bool failed_ = false;
+
+  int RunDevice(size_t idx, int argc, char *argv[]);
+};
+
+}  // namespace pciebm
+#endif  // SIMBRICKS_PCIEBM_MULTIDEVICE_H_
@@ -25,6 +25,8 @@
 #include "lib/simbricks/pciebm/pciebm.hh"
 
 #include <fcntl.h>
+#include <getopt.h>
+#include <sched.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -32,7 +34,9 @@
 #include <sys/socket.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <cstddef>
 #include <cstring>
 #include <ctime>
@@ -60,9 +64,10 @@ void PcieBM::SIGUSR1Handler() {
 
 void PcieBM::SIGUSR2Handler() {
   stat_flag_ = true;
+  dma_stats_dump_ = true;
 }
 
-volatile union SimbricksProtoPcieD2H *PcieBM::D2HAlloc() {
+volatile union SimbricksProtoPcieD2H *PcieBM::D2HAlloc(size_t len) {
   if (SimbricksBaseIfInTerminated(&pcieif_.base)) {
     fprintf(stderr, "PcieBM::D2HAlloc: peer already terminated\n");
     abort();
@@ -70,7 +75,8 @@ volatile union SimbricksProtoPcieD2H *PcieBM::D2HAlloc() {
 
   volatile union SimbricksProtoPcieD2H *msg;
   bool first = true;
-  while ((msg = SimbricksPcieIfD2HOutAlloc(&pcieif_, main_time_)) == nullptr) {
+  while ((msg = SimbricksPcieIfD2HOutAllocLen(&pcieif_, main_time_, len)) ==
+         nullptr) {
     if (first) {
       fprintf(stderr, "D2HAlloc: warning waiting for entry (%zu)\n",
               pcieif_.base.out_pos);
@@ -85,133 +91,210 @@ volatile union SimbricksProtoPcieD2H *PcieBM::D2HAlloc() {
   return msg;
 }
 
+PcieBM::PcieBM(uint32_t dma_max_pending, bool dma_coalesce)
+    : dma_read_max_pending_(dma_max_pending),
+      dma_write_max_pending_(dma_max_pending),
+      dma_coalesce_(dma_coalesce),
+      dma_slots_(2 * static_cast<size_t>(dma_max_pending)) {
+  // read slots come first, followed by the write slots; hand out the lowest
+  // slot numbers first
+  dma_read_free_.reserve(dma_max_pending);
+  dma_write_free_.reserve(dma_max_pending);
+  for (uint32_t i = dma_max_pending; i > 0; i--) {
+    dma_read_free_.push_back(i - 1);
+    dma_write_free_.push_back(dma_max_pending + i - 1);
+  }
+}
+
 void PcieBM::IssueDma(std::unique_ptr<DMAOp> dma_op) {
-  if(dma_op->write){
-    if (dma_write_pending_.size() < dma_write_max_pending_) {
-  // can directly issue
-  #if DEBUG_PCIEBM
-      std::cout << "PcieBM::IssueDma() main_time " << main_time_/1000
-                << " issuing dma " << (dma_op->write ? "write" : "read") << " op "
-                << dma_op.get() << " addr " << dma_op->dma_addr << " len "
-                << dma_op->len << " pending " << dma_write_pending_.size() << std::endl;
-  #endif
-      DmaDo(std::move(dma_op));
-    } else {
-  #if DEBUG_PCIEBM
-      printf(
-          "main_time = %lu: pciebm: enqueuing dma op %p addr %lx len %zu pending "
-          "%zu\n",
-          main_time_/1000, dma_op.get(), dma_op->dma_addr, dma_op->len,
-          dma_write_pending_.size());
-  #endif
-      dma_write_queue_.emplace(std::move(dma_op));
-    }
-  }else{
-        if (dma_read_pending_.size() < dma_read_max_pending_) {
-  // can directly issue
-  #if DEBUG_PCIEBM
-      std::cout << "PcieBM::IssueDma() main_time " << main_time_/1000
-                << " issuing dma " << (dma_op->write ? "write" : "read") << " op "
-                << dma_op.get() << " addr " << dma_op->dma_addr << " len "
-                << dma_op->len << " pending " << dma_read_pending_.size() << std::endl;
-  #endif
-      DmaDo(std::move(dma_op));
-    } else {
-  #if DEBUG_PCIEBM
-      printf(
-          "main_time = %lu: pciebm: enqueuing dma op %p addr %lx len %zu pending "
-          "%zu\n",
-          main_time_/1000, dma_op.get(), dma_op->dma_addr, dma_op->len,
-          dma_read_pending_.size());
-  #endif
-      dma_read_queue_.emplace(std::move(dma_op));
-    }
+#if DEBUG_PCIEBM
+  printf("main_time = %lu: pciebm: enqueuing %s dma op %p addr %lx len %zu\n",
+         main_time_ / 1000, (dma_op->write ? "write" : "read"), dma_op.get(),
+         dma_op->dma_addr, dma_op->len);
+#endif
+  bool write = dma_op->write;
+
+  uint32_t idx;
+  if (dma_logical_free_.empty()) {
+    idx = dma_logical_.size();
+    dma_logical_.emplace_back();
+  } else {
+    idx = dma_logical_free_.back();
+    dma_logical_free_.pop_back();
   }
+  DmaLogical &logical = dma_logical_[idx];
+  logical.op = std::move(dma_op);
+  logical.issued = 0;
+  logical.done = 0;
+  logical.queued_at = main_time_;
+  dma_ops_++;
+
+  if (write)
+    dma_write_queue_.push_back(idx);
+  else
+    dma_read_queue_.push_back(idx);
+  DmaIssue(write);
 }
 
 void PcieBM::DmaTrigger() {
-  if (!(dma_read_queue_.empty() || dma_read_pending_.size() >= dma_read_max_pending_)){
-    std::unique_ptr<DMAOp> dma_op = std::move(dma_read_queue_.front());
-    dma_read_queue_.pop();
-    DmaDo(std::move(dma_op));
-  }
-  if (!(dma_write_queue_.empty() || dma_write_pending_.size() >= dma_write_max_pending_)){
-    std::unique_ptr<DMAOp> dma_op2 = std::move(dma_write_queue_.front());
-    dma_write_queue_.pop();
-    DmaDo(std::move(dma_op2));
-  }
+  DmaIssue(false);
+  DmaIssue(true);
 }
 
-void PcieBM::DmaDo(std::unique_ptr<DMAOp> dma_op) {
-  if (SimbricksBaseIfInTerminated(&pcieif_.base))
-    return;
+void PcieBM::DmaIssue(bool write) {
+  std::deque<uint32_t> &queue = (write ? dma_write_queue_ : dma_read_queue_);
+  std::vector<uint32_t> &free = (write ? dma_write_free_ : dma_read_free_);
+  size_t chunk = (write ? dma_write_chunk_ : dma_read_chunk_);
+
+  while (!queue.empty() && !free.empty()) {
+    if (SimbricksBaseIfInTerminated(&pcieif_.base))
+      return;
+
+    uint32_t slot_id = free.back();
+    free.pop_back();
+    DmaSlot &slot = dma_slots_[slot_id];
+    if (dma_stats_) {
+      dma_stats_->Pending(write, (write ? DmaWritePending() : DmaReadPending()),
+                          main_time_);
+    }
+
+    // next chunk of the logical op at the head of the queue
+    uint32_t idx = queue.front();
+    DmaLogical &first = dma_logical_[idx];
+    uint64_t addr = first.op->dma_addr + first.issued;
+    size_t len = std::min(first.op->len - first.issued, chunk);
+    slot.segs[0] = DmaSegment{idx, first.issued, 0, len};
+    slot.nsegs = 1;
+    if (first.issued == 0)
+      first.issued_at = main_time_;
+    first.issued += len;
+
+    if (first.issued == first.op->len) {
+      queue.pop_front();
+
+      // merge queued reads that start within or right after this request
+      while (!write && dma_coalesce_ && !queue.empty() &&
+             slot.nsegs < kDmaMaxSegs) {
+        uint32_t next_idx = queue.front();
+        DmaLogical &next = dma_logical_[next_idx];
+        if (next.op->dma_addr < addr || next.op->dma_addr > addr + len ||
+            next.op->dma_addr + next.op->len - addr > chunk)
+          break;
+
+        size_t off = next.op->dma_addr - addr;
+        slot.segs[slot.nsegs++] = DmaSegment{next_idx, 0, off, next.op->len};
+        next.issued = next.op->len;
+        next.issued_at = main_time_;
+        len = std::max(len, off + next.op->len);
+        queue.pop_front();
+      }
+    }
 
 #if DEBUG_PCIEBM
-  printf(
-      "main_time = %lu: pciebm: executing %s dma_op %p addr %lx len %zu pending "
-      "(r%zu,w%zu)\n", 
-      main_time_/1000, (dma_op->write ? "write" : "read"), dma_op.get(), dma_op->dma_addr, dma_op->len,
-      dma_read_pending_.size(), dma_write_pending_.size());
+    printf(
+        "main_time = %lu: pciebm: issuing %s request %u addr %lx len %zu "
+        "ops %u pending (r%zu,w%zu)\n",
+        main_time_ / 1000, (write ? "write" : "read"), slot_id, addr, len,
+        slot.nsegs, DmaReadPending(), DmaWritePending());
 #endif
 
-  volatile union SimbricksProtoPcieD2H *msg = D2HAlloc();
+    volatile union SimbricksProtoPcieD2H *msg;
+    if (write) {
+      msg = D2HAlloc(sizeof(msg->write) + len);
+      volatile struct SimbricksProtoPcieD2HWrite *wr = &msg->write;
+      wr->req_id = slot_id;
+      wr->offset = addr;
+      wr->len = len;
+      memcpy(const_cast<uint8_t *>(wr->data),
+             dma_logical_[idx].op->data + slot.segs[0].op_off, len);
+      SimbricksPcieIfD2HOutSend(&pcieif_, msg,
+                                SIMBRICKS_PROTO_PCIE_D2H_MSG_WRITE);
+    } else {
+      msg = D2HAlloc();
+      volatile struct SimbricksProtoPcieD2HRead *read = &msg->read;
+      read->req_id = slot_id;
+      read->offset = addr;
+      read->len = len;
+      SimbricksPcieIfD2HOutSend(&pcieif_, msg,
+                                SIMBRICKS_PROTO_PCIE_D2H_MSG_READ);
+    }
+    dma_reqs_++;
+  }
+}
+
+void PcieBM::DmaRequestComplete(uint64_t req_id, bool write,
+                                const uint8_t *data) {
+  uint64_t first = (write ? dma_read_max_pending_ : 0);
+  uint64_t num = (write ? dma_write_max_pending_ : dma_read_max_pending_);
+  if (req_id < first || req_id - first >= num ||
+      dma_slots_[req_id].nsegs == 0) {
+    fprintf(stderr, "PcieBM: completion for unknown dma %s %lu\n",
+            (write ? "write" : "read"), req_id);
+    abort();
+  }
+
+  // free the slot first, the callbacks may issue new requests
+  DmaSlot slot = dma_slots_[req_id];
+  dma_slots_[req_id].nsegs = 0;
+  if (write)
+    dma_write_free_.push_back(static_cast<uint32_t>(req_id));
+  else
+    dma_read_free_.push_back(static_cast<uint32_t>(req_id));
+  if (dma_stats_) {
+    dma_stats_->Pending(write, (write ? DmaWritePending() : DmaReadPending()),
+                        main_time_);
+  }
 
-  size_t maxlen = SimbricksPcieIfD2HOutMsgLen(&pcieif_);
-  if (dma_op->write) {
-    volatile struct SimbricksProtoPcieD2HWrite *write = &msg->write;
-    if (maxlen < sizeof(*write) + dma_op->len) {
-      fprintf(stderr,
-              "issue_dma: write too big (%zu), can only fit up "
-              "to (%zu)\n",
-              dma_op->len, maxlen - sizeof(*write));
-      abort();
+  for (uint32_t i = 0; i < slot.nsegs; i++) {
+    const DmaSegment &seg = slot.segs[i];
+    if (!write) {
+      DmaReadBorrowed(*dma_logical_[seg.logical].op, seg.op_off,
+                      data + seg.req_off, seg.len);
     }
 
-    write->req_id = reinterpret_cast<uintptr_t>(dma_op.get());
-    write->offset = dma_op->dma_addr;
-    write->len = dma_op->len;
-    memcpy(const_cast<uint8_t *>(write->data), dma_op->data, dma_op->len);
+    // logical ops may have been added by the callback, look up again
+    DmaLogical &logical = dma_logical_[seg.logical];
+    logical.done += seg.len;
+    if (logical.done == logical.op->len) {
+      std::unique_ptr<DMAOp> dma_op = std::move(logical.op);
+      dma_logical_free_.push_back(seg.logical);
+      if (dma_stats_) {
+        dma_stats_->OpComplete(write, dma_op->tag, dma_op->len,
+                               logical.queued_at,
+                               logical.issued_at - logical.queued_at,
+                               main_time_ - logical.issued_at, main_time_);
+      }
 
 #if DEBUG_PCIEBM
-    uint8_t *tmp = static_cast<uint8_t *>(dma_op->data);
-    printf("main_time = %lu: pciebm: dma write data: \n", main_time_/1000);
-    for (size_t i = 0; i < dma_op->len; i++) {
-      printf("%02X ", *tmp);
-      tmp++;
-    }
+      printf(
+          "main_time = %lu: pciebm: completed dma %s op %p addr %lx len %zu\n",
+          main_time_ / 1000, (write ? "write" : "read"), dma_op.get(),
+          dma_op->dma_addr, dma_op->len);
 #endif
-    SimbricksPcieIfD2HOutSend(&pcieif_, msg,
-                              SIMBRICKS_PROTO_PCIE_D2H_MSG_WRITE);
-  } else {
-    volatile struct SimbricksProtoPcieD2HRead *read = &msg->read;
-    if (maxlen < sizeof(struct SimbricksProtoPcieH2DReadcomp) + dma_op->len) {
-      fprintf(
-          stderr, "issue_dma: read too big (%zu), can only fit up to (%zu)\n",
-          dma_op->len, maxlen - sizeof(struct SimbricksProtoPcieH2DReadcomp));
-      abort();
+      DmaComplete(std::move(dma_op));
     }
-
-    read->req_id = reinterpret_cast<uintptr_t>(dma_op.get());
-    read->offset = dma_op->dma_addr;
-    read->len = dma_op->len;
-    SimbricksPcieIfD2HOutSend(&pcieif_, msg, SIMBRICKS_PROTO_PCIE_D2H_MSG_READ);
   }
+  DmaTrigger();
+}
 
-  if(dma_op->write){
-    auto inserted = dma_write_pending_.emplace(
-      reinterpret_cast<uintptr_t>(dma_op.get()), std::move(dma_op));
-    assert(inserted.second &&
-         "PcieBM::DMADo() Inserting dma_op into dma_pending_ failed.");
-    // std::cout << "pcieBM::DmaDo() TimePs()=" << TimePs() << " dma_write_pending.size()=" << dma_write_pending_.size()
-    //         << " dma_write_queue_.size()=" << dma_write_queue_.size() << "\n";
-  }else{
-    auto inserted = dma_read_pending_.emplace(
-      reinterpret_cast<uintptr_t>(dma_op.get()), std::move(dma_op));
-    assert(inserted.second &&
-         "PcieBM::DMADo() Inserting dma_op into dma_pending_ failed.");
-    // std::cout << "pcieBM::DmaDo() TimePs()=" << TimePs() << " dma_read_pending.size()=" << dma_read_pending_.size()
-            // << " dma_read_queue_.size()=" << dma_read_queue_.size() << "\n";
+void PcieBM::DmaStatsDump() {
+  if (!dma_stats_)
+    return;
+
+  FILE *out = stderr;
+  if (strcmp(dma_stats_path_, "-") != 0 &&
+      (out = fopen(dma_stats_path_, "w")) == nullptr) {
+    perror("DmaStatsDump: fopen failed");
+    return;
   }
+  dma_stats_->WriteJson(out, main_time_);
+  if (out != stderr)
+    fclose(out);
+}
+
+void PcieBM::DmaReadBorrowed(DMAOp &dma_op, size_t offset, const void *data,
+                             size_t len) {
+  memcpy(dma_op.data + offset, data, len);
 }
 
 void PcieBM::MsiIssue(uint8_t vec) {
@@ -265,8 +348,29 @@ void PcieBM::IntXIssue(bool level) {
                             SIMBRICKS_PROTO_PCIE_D2H_MSG_INTERRUPT);
 }
 
-void PcieBM::EventSchedule(std::unique_ptr<TimedEvent> evt) {
-  events_.push(std::move(evt));
+TimedEvent *PcieBM::EventAlloc() {
+  return events_.Alloc();
+}
+
+void PcieBM::EventSchedule(TimedEvent &evt) {
+  events_.Schedule(&evt);
+}
+
+void PcieBM::EventCancel(TimedEvent &evt) {
+  if (!evt.Scheduled())
+    return;
+
+  events_.Cancel(&evt);
+  // the executing event is returned to the pool once it has finished
+  if (evt.Pooled() && &evt != event_exec_)
+    events_.Free(&evt);
+}
+
+void PcieBM::EventReschedule(TimedEvent &evt, uint64_t time) {
+  if (evt.Scheduled())
+    events_.Cancel(&evt);
+  evt.time = time;
+  events_.Schedule(&evt);
 }
 
 void PcieBM::H2DRead(volatile struct SimbricksProtoPcieH2DRead *read) {
@@ -322,35 +426,14 @@ void PcieBM::H2DWrite(volatile struct SimbricksProtoPcieH2DWrite *write,
 
 void PcieBM::H2DReadcomp(
     volatile struct SimbricksProtoPcieH2DReadcomp *readcomp) {
-  uintptr_t dma_op_ptr = static_cast<uintptr_t>(readcomp->req_id);
-  // NOLINTNEXTLINE(performance-no-int-to-ptr)
-  std::unique_ptr<DMAOp> dma_op =
-      std::move(dma_read_pending_.extract(dma_op_ptr).mapped());
-
-#if DEBUG_PCIEBM
-  printf("main_time = %lu: pciebm: completed dma read op %p addr %lx len %zu\n",
-         main_time_/1000, dma_op.get(), dma_op->dma_addr, dma_op->len);
-#endif
-
-  memcpy(dma_op->data, const_cast<uint8_t *>(readcomp->data), dma_op->len);
-  DmaComplete(std::move(dma_op));
-  DmaTrigger();
+  // the data stays in the queue until the message is marked as done
+  DmaRequestComplete(readcomp->req_id, false,
+                     const_cast<uint8_t *>(readcomp->data));
 }
 
 void PcieBM::H2DWritecomp(
     volatile struct SimbricksProtoPcieH2DWritecomp *writecomp) {
-  uintptr_t dma_op_ptr = static_cast<uintptr_t>(writecomp->req_id);
-  std::unique_ptr<DMAOp> dma_op =
-      std::move(dma_write_pending_.extract(dma_op_ptr).mapped());
-
-#if DEBUG_PCIEBM
-  printf(
-      "main_time = %lu: pciebm: completed dma write op %p addr %lx len %zu\n",
-      main_time_/1000, dma_op.get(), dma_op->dma_addr, dma_op->len);
-#endif
-
-  DmaComplete(std::move(dma_op));
-  DmaTrigger();
+  DmaRequestComplete(writecomp->req_id, true, nullptr);
 }
 
 void PcieBM::H2DDevctrl(volatile struct SimbricksProtoPcieH2DDevctrl *devctrl) {
@@ -413,6 +496,18 @@ bool PcieBM::PollH2D() {
       fprintf(stderr, "poll_h2d: peer terminated\n");
       break;
 
+    case SIMBRICKS_PROTO_MSG_TYPE_SYNC_MODE:
+      // PCIe is our only link, so we can always jump ahead to the switch
+      main_time_ = SimbricksBaseIfSyncSwitchHandle(&pcieif_.base, &msg->base,
+                                                   main_time_);
+      while (SimbricksPcieIfD2HOutSync(&pcieif_, main_time_)) {
+        YieldPoll();
+      }
+      fprintf(stderr, "poll_h2d: sync %s at %lu\n",
+              SimbricksBaseIfSyncEnabled(&pcieif_.base) ? "on" : "off",
+              main_time_);
+      break;
+
     default:
       fprintf(stderr, "poll_h2d: unsupported type=%u\n", type);
   }
@@ -426,33 +521,87 @@ uint64_t PcieBM::TimePs() const {
 }
 
 std::optional<uint64_t> PcieBM::EventNext() {
-  if (events_.empty())
+  TimedEvent *evt = events_.Peek();
+  if (evt == nullptr)
     return std::nullopt;
 
-  return {events_.top()->time};
+  return {evt->time};
 }
 
 bool PcieBM::EventTrigger() {
-  if (events_.empty())
-    return false;
-
-  if (events_.top()->time > main_time_)
+  TimedEvent *evt = events_.Peek();
+  if (evt == nullptr || evt->time > main_time_)
     return false;
 
-  std::unique_ptr<TimedEvent> evt =
-      // The const_cast here to get rid of the const qualifier from
-      // `events_top()` is only fine because we pop right after. Otherwise we
-      // would violate the invariants of the priority_queue.
-      std::move(const_cast<std::unique_ptr<TimedEvent> &>(events_.top()));
-  events_.pop();
-
-  ExecuteEvent(std::move(evt));
+  events_.Pop();
+  event_exec_ = evt;
+  ExecuteEvent(*evt);
+  event_exec_ = nullptr;
+  if (evt->Pooled() && !evt->Scheduled())
+    events_.Free(evt);
   return true;
 }
 
 void PcieBM::YieldPoll() {
 }
 
+static inline void CpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  asm volatile("yield");
+#endif
+}
+
+void PcieBM::WaitIdle() {
+  // empty polls before yielding the CPU, and before sleeping
+  static constexpr uint64_t kPausePolls = 64;
+  static constexpr uint64_t kYieldPolls = kPausePolls + 64;
+  static constexpr uint64_t kSleepMinNs = 1000;
+  static constexpr uint64_t kSleepMaxNs = 100000;
+
+  if (idle_polls_++ == 0) {
+    idle_start_ = std::chrono::steady_clock::now();
+    idle_sleep_ns_ = kSleepMinNs;
+  }
+
+  WaitPolicy policy = wait_policy_;
+  if (policy == WaitPolicy::kDefault) {
+    policy = (SimbricksBaseIfDoorbellEnabled(&pcieif_.base) ? WaitPolicy::kBlock
+                                                            : WaitPolicy::kSpin);
+  }
+  if (policy == WaitPolicy::kBlock) {
+    if (SimbricksBaseIfDoorbellEnabled(&pcieif_.base)) {
+      struct SimbricksBaseIf *base_if = &pcieif_.base;
+      SimbricksBaseIfWaitAny(&base_if, 1, pcieParams_.doorbell_spin);
+      return;
+    }
+    // explicitly asked to block, but the host cannot wake us up
+    policy = WaitPolicy::kYield;
+  }
+
+  if (policy == WaitPolicy::kSpin)
+    return;
+  if (policy == WaitPolicy::kPause || idle_polls_ <= kPausePolls) {
+    CpuRelax();
+  } else if (policy == WaitPolicy::kYield || idle_polls_ <= kYieldPolls) {
+    sched_yield();
+  } else {
+    struct timespec ts = {0, static_cast<long>(idle_sleep_ns_)};
+    nanosleep(&ts, nullptr);
+    idle_sleep_ns_ = std::min(2 * idle_sleep_ns_, kSleepMaxNs);
+  }
+}
+
+void PcieBM::IdleEnd() {
+  if (idle_polls_ == 0)
+    return;
+  idle_polls_ = 0;
+  idle_ns_ += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                  std::chrono::steady_clock::now() - idle_start_)
+                  .count();
+}
+
 bool PcieBM::PcieIfInit() {
   struct SimbricksBaseIfSHMPool pool;
   struct SimBricksBaseIfEstablishData ests;
@@ -487,27 +636,87 @@ bool PcieBM::PcieIfInit() {
     std::cerr << "PciIfInit: SimBricksBaseIfEstablish failed\n";
     return false;
   }
+
+  // DMAs are split into the largest requests the queues can carry
+  dma_read_chunk_ = SimbricksBaseIfInMaxMsgLen(&pcieif_.base) -
+                    sizeof(struct SimbricksProtoPcieH2DReadcomp);
+  dma_write_chunk_ = SimbricksPcieIfD2HOutMaxMsgLen(&pcieif_) -
+                     sizeof(struct SimbricksProtoPcieD2HWrite);
   return true;
 }
 
 bool PcieBM::ParseArgs(int argc, char *argv[]) {
   SimbricksPcieIfDefaultParams(&pcieParams_);
 
-  if (argc < 3 || argc > 6) {
+  static const struct option long_opts[] = {
+      {"dma-stats", required_argument, nullptr, 'd'},
+      {"wait-policy", required_argument, nullptr, 'w'},
+      {"adaptive-sync", no_argument, nullptr, 'a'},
+      {"multi-slot", no_argument, nullptr, 'm'},
+      {"sync-switch", no_argument, nullptr, 's'},
+      {nullptr, 0, nullptr, 0}};
+  int c;
+  bool bad_option = false;
+  // several devices may parse their arguments in one process
+  optind = 1;
+  while ((c = getopt_long(argc, argv, "+", long_opts, nullptr)) != -1) {
+    switch (c) {
+      case 'd':
+        dma_stats_path_ = optarg;
+        break;
+      case 'w':
+        if (strcmp(optarg, "spin") == 0) {
+          wait_policy_ = WaitPolicy::kSpin;
+        } else if (strcmp(optarg, "pause") == 0) {
+          wait_policy_ = WaitPolicy::kPause;
+        } else if (strcmp(optarg, "yield") == 0) {
+          wait_policy_ = WaitPolicy::kYield;
+        } else if (strcmp(optarg, "sleep") == 0) {
+          wait_policy_ = WaitPolicy::kSleep;
+        } else if (strcmp(optarg, "block") == 0) {
+          wait_policy_ = WaitPolicy::kBlock;
+        } else {
+          fprintf(stderr, "unknown wait policy: %s\n", optarg);
+          bad_option = true;
+        }
+        break;
+      case 'a':
+        pcieParams_.adaptive_sync = true;
+        break;
+      case 'm':
+        pcieParams_.multi_slot = true;
+        break;
+      case 's':
+        pcieParams_.sync_switch = true;
+        break;
+      default:
+        bad_option = true;
+    }
+  }
+
+  int nargs = argc - optind;
+  if (bad_option || nargs < 2 || nargs > 5) {
     fprintf(stderr,
-            "Usage: PcieBM PCI-SOCKET SHM [START-TICK] [SYNC-PERIOD] "
-            "[PCI-LATENCY]\n");
+            "Usage: PcieBM [--dma-stats=FILE] "
+            "[--wait-policy=spin|pause|yield|sleep|block] [--adaptive-sync] "
+            "[--multi-slot] [--sync-switch] PCI-SOCKET SHM "
+            "[START-TICK] [SYNC-PERIOD] [PCI-LATENCY]\n");
     return false;
   }
-  if (argc >= 4)
-    main_time_ = strtoull(argv[3], nullptr, 0);
-  if (argc >= 5)
-    pcieParams_.sync_interval = strtoull(argv[4], nullptr, 0) * 1000ULL;
-  if (argc >= 6)
-    pcieParams_.link_latency = strtoull(argv[5], nullptr, 0) * 1000ULL;
-
-  pcieParams_.sock_path = argv[1];
-  shmPath_ = argv[2];
+  char **args = argv + optind;
+  if (nargs >= 3)
+    main_time_ = strtoull(args[2], nullptr, 0);
+  if (nargs >= 4)
+    pcieParams_.sync_interval = strtoull(args[3], nullptr, 0) * 1000ULL;
+  if (nargs >= 5)
+    pcieParams_.link_latency = strtoull(args[4], nullptr, 0) * 1000ULL;
+
+  pcieParams_.sock_path = args[0];
+  shmPath_ = args[1];
+
+  // dumped at exit and on SIGUSR2, "-" writes to stderr
+  if (dma_stats_path_ != nullptr)
+    dma_stats_ = std::make_unique<DmaStats>(dma_read_max_pending_);
   return true;
 }
 
@@ -523,22 +732,52 @@ int PcieBM::RunMain() {
   }
   bool sync_pci = SimbricksBaseIfSyncEnabled(&pcieif_.base);
   fprintf(stderr, "sync_pci=%d\n", sync_pci);
+  auto run_start = std::chrono::steady_clock::now();
 
   while (!exiting_) {
+    // we only send in response to host messages or from events
+    uint64_t lookahead = SimbricksPcieIfH2DInTimestamp(&pcieif_);
+    std::optional<uint64_t> lookahead_ev = EventNext();
+    if (lookahead_ev && *lookahead_ev < lookahead)
+      lookahead = *lookahead_ev;
+    SimbricksBaseIfOutLookahead(&pcieif_.base, lookahead);
+
     // send sync messages
     while (SimbricksPcieIfD2HOutSync(&pcieif_, main_time_)) {
       YieldPoll();
     }
-    // process everything up to the current timestamp
-    // process all available messages and wait until we actually get one with
-    // a higher timestamp
-    do {
-      PollH2D();
-    } while (SimbricksPcieIfH2DInTimestamp(&pcieif_) <= main_time_);
+    // process all available messages and only poll for more until the host
+    // lets us advance: with synchronization until its next message is stamped
+    // after the current time, without until anything arrives or an event is
+    // pending
+    bool progress = false;
+    while (!exiting_) {
+      if (PollH2D()) {
+        progress = true;
+        IdleEnd();
+        continue;
+      }
+      // the host may stay quiet for a long time, dump while idle
+      if (dma_stats_dump_) {
+        dma_stats_dump_ = false;
+        DmaStatsDump();
+      }
+      // the host can switch synchronization on and off at runtime
+      sync_pci = SimbricksBaseIfSyncEnabled(&pcieif_.base);
+      if (sync_pci ? SimbricksPcieIfH2DInTimestamp(&pcieif_) > main_time_
+                   : progress || EventNext())
+        break;
+      WaitIdle();
+    }
+    IdleEnd();
+    if (exiting_)
+      break;
+
     // process all events that are due
     while (EventTrigger()) {
     }
 
+    // jump to the earliest time anything can happen
     if (sync_pci) {
       next_ts = std::min(SimbricksPcieIfH2DInTimestamp(&pcieif_),
                          SimbricksPcieIfD2HOutNextSync(&pcieif_));
@@ -556,6 +795,20 @@ int PcieBM::RunMain() {
 
   /* print statistics */
   fprintf(stderr, "exit main_time: %lu\n", main_time_);
+  DmaStatsDump();
+  double run_s = std::chrono::duration<double>(
+                     std::chrono::steady_clock::now() - run_start)
+                     .count();
+  double idle_s = idle_ns_ / 1e9;
+  fprintf(stderr, "%20s: %22.6f %20s: %22.6f\n", "wall_busy_s",
+          run_s - idle_s, "wall_idle_s", idle_s);
+  fprintf(stderr, "%20s: %22d\n", "doorbell",
+          SimbricksBaseIfDoorbellEnabled(&pcieif_.base));
+  fprintf(stderr, "%20s: %22lu %20s: %22lu\n", "dma_ops", dma_ops_,
+          "dma_requests", dma_reqs_);
+  fprintf(stderr, "%20s: %22lu %20s: %22lu\n", "d2h_sync_sent",
+          SimbricksBaseIfOutSyncsSent(&pcieif_.base), "d2h_sync_suppressed",
+          SimbricksBaseIfOutSyncsSuppressed(&pcieif_.base));
   fprintf(stderr, "%20s: %22lu %20s: %22lu  poll_suc_rate: %Lf\n",
           "h2d_poll_total", h2d_poll_total_, "h2d_poll_suc", h2d_poll_suc_,
           static_cast<long double>(h2d_poll_suc_) / h2d_poll_total_);
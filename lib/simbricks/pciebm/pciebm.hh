@@ -25,41 +25,37 @@
 #ifndef SIMBRICKS_PCIEBM_PCIEBM_H_
 #define SIMBRICKS_PCIEBM_PCIEBM_H_
 
+#include <chrono>
 #include <cstdint>
+#include <deque>
 #include <functional>
 #include <memory>
 #include <optional>
-#include <queue>
-#include <unordered_set>
 #include <vector>
 
 #include <simbricks/base/cxxatomicfix.h>
 extern "C" {
 #include "simbricks/pcie/if.h"
 }
+#include "lib/simbricks/pciebm/dma_stats.hh"
+#include "lib/simbricks/pciebm/event_queue.hh"
 
 namespace pciebm {
 
 struct DMAOp {
-  uint32_t tag;
-  bool write;
-  uint64_t dma_addr;
-  size_t len;
-  uint8_t *data;
-};
-
-struct TimedEvent {
-  uint64_t time;
-  int priority;
-};
-
-/* This is required for the priority queue of references to `TimedEvent`*/
-struct TimedEventPtrGreater {
-  bool operator()(const std::unique_ptr<TimedEvent> &lhs,
-                  const std::unique_ptr<TimedEvent> &rhs) const {
-    return lhs->time > rhs->time ||
-           (lhs->time == rhs->time && lhs->priority > rhs->priority);
+  DMAOp() = default;
+  DMAOp(uint32_t tag_, bool write_, uint64_t dma_addr_, size_t len_,
+        uint8_t *data_)
+      : tag(tag_), write(write_), dma_addr(dma_addr_), len(len_), data(data_) {
   }
+  /* operations are handed back as `DMAOp`, so subclasses may own resources */
+  virtual ~DMAOp() = default;
+
+  uint32_t tag = 0;
+  bool write = false;
+  uint64_t dma_addr = 0;
+  size_t len = 0;
+  uint8_t *data = nullptr;
 };
 
 /* This is an abstract base for PCIe device simulators that implement a
@@ -91,8 +87,17 @@ class PcieBM {
   /* The previously issued DMA operation `op` has been completed. */
   virtual void DmaComplete(std::unique_ptr<DMAOp> dma_op) = 0;
 
-  /* Callback for executing the previously scheduled event `evt`. */
-  virtual void ExecuteEvent(std::unique_ptr<TimedEvent> evt) = 0;
+  /* Part of the previously issued DMA read `dma_op` has arrived: `len` bytes
+   * at `offset` into the operation. `data` is borrowed from the shared memory
+   * queue and only valid during the call. Override this to consume the data
+   * in place, e.g. for operations without a buffer; the default copies it to
+   * `dma_op.data`. `DmaComplete` follows once all parts have arrived. */
+  virtual void DmaReadBorrowed(DMAOp &dma_op, size_t offset, const void *data,
+                               size_t len);
+
+  /* Callback for executing the previously scheduled event `evt`. Pooled
+   * events return to the pool afterwards unless rescheduled. */
+  virtual void ExecuteEvent(TimedEvent &evt) = 0;
 
   /* Callback for a device control update request. */
   virtual void DevctrlUpdate(struct SimbricksProtoPcieH2DDevctrl &devctrl) = 0;
@@ -102,7 +107,9 @@ class PcieBM {
    * invoking PCIe requests and scheduling events.
    */
 
-  /* Issue a DMA PCIe request with the details in `dma_op`. */
+  /* Issue a DMA operation with the details in `dma_op`. Operations of any
+   * length are split into as few PCIe requests as the queues allow, and
+   * `DmaComplete` is invoked once for the whole operation. */
   void IssueDma(std::unique_ptr<DMAOp> dma_op);
 
   /* Issue an MSI interrupt over PCIe. */
@@ -117,8 +124,21 @@ class PcieBM {
   /* Returns the current timestamp in picoseconds. */
   uint64_t TimePs() const;
 
-  /* Schedule an event to be executed in the future. */
-  void EventSchedule(std::unique_ptr<TimedEvent> evt);
+  /* Allocate a one-shot event from the event pool. The event returns to the
+   * pool once it has been executed or cancelled, so the pointer must not be
+   * used afterwards. Events that are scheduled repeatedly are better kept as
+   * members of the behavioral model. */
+  TimedEvent *EventAlloc();
+
+  /* Schedule `evt` to be executed at `evt.time`. The event must stay valid
+   * until it has been executed or cancelled. */
+  void EventSchedule(TimedEvent &evt);
+
+  /* Cancel a scheduled event. Does nothing if `evt` is not scheduled. */
+  void EventCancel(TimedEvent &evt);
+
+  /* Move `evt` to `time`, scheduling it if it is not scheduled yet. */
+  void EventReschedule(TimedEvent &evt, uint64_t time);
 
   /* Returns the timestamp of the earliest event that's scheduled to be
    * executed. If no scheduled event exists, returns an empty std::optional */
@@ -128,14 +148,63 @@ class PcieBM {
   uint64_t main_time_ = 0;
   uint32_t dma_read_max_pending_;
   uint32_t dma_write_max_pending_;
-  std::priority_queue<std::unique_ptr<TimedEvent>,
-                      std::vector<std::unique_ptr<TimedEvent>>,
-                      TimedEventPtrGreater>
-      events_{};
-  std::queue<std::unique_ptr<DMAOp>> dma_read_queue_{};
-  std::queue<std::unique_ptr<DMAOp>> dma_write_queue_{};
-  std::unordered_map<uintptr_t, std::unique_ptr<DMAOp>> dma_read_pending_{};
-  std::unordered_map<uintptr_t, std::unique_ptr<DMAOp>> dma_write_pending_{};
+  EventQueue events_;
+  /* event currently being executed */
+  TimedEvent *event_exec_ = nullptr;
+  bool dma_coalesce_;
+  /* maximum length of a single read or write request */
+  size_t dma_read_chunk_ = 0;
+  size_t dma_write_chunk_ = 0;
+
+  /* DMA operations issued by the behavioral model */
+  struct DmaLogical {
+    std::unique_ptr<DMAOp> op;
+    /* bytes sent to and completed by the host */
+    size_t issued;
+    size_t done;
+    /* times the operation was queued and its first request was sent */
+    uint64_t queued_at;
+    uint64_t issued_at;
+  };
+  /* part of a DMA operation covered by a PCIe request */
+  struct DmaSegment {
+    uint32_t logical;
+    /* offset into the operation and into the request */
+    size_t op_off;
+    size_t req_off;
+    size_t len;
+  };
+  static constexpr uint32_t kDmaMaxSegs = 8;
+  /* PCIe request in flight, unused if `nsegs` is 0 */
+  struct DmaSlot {
+    uint32_t nsegs = 0;
+    DmaSegment segs[kDmaMaxSegs];
+  };
+  std::vector<DmaLogical> dma_logical_{};
+  std::vector<uint32_t> dma_logical_free_{};
+  /* operations with parts not sent yet */
+  std::deque<uint32_t> dma_read_queue_{};
+  std::deque<uint32_t> dma_write_queue_{};
+  /* requests in flight indexed by request id, reads first */
+  std::vector<DmaSlot> dma_slots_;
+  std::vector<uint32_t> dma_read_free_{};
+  std::vector<uint32_t> dma_write_free_{};
+  uint64_t dma_ops_ = 0;
+  uint64_t dma_reqs_ = 0;
+  /* only allocated if enabled on the command line */
+  std::unique_ptr<DmaStats> dma_stats_;
+  const char *dma_stats_path_ = nullptr;
+
+  /* how to wait for the host while there is nothing to do, by default block
+   * if doorbells were negotiated and spin otherwise */
+  enum class WaitPolicy { kDefault, kSpin, kPause, kYield, kSleep, kBlock };
+  WaitPolicy wait_policy_ = WaitPolicy::kDefault;
+  /* empty polls since we last had something to do */
+  uint64_t idle_polls_ = 0;
+  uint64_t idle_sleep_ns_ = 0;
+  std::chrono::steady_clock::time_point idle_start_;
+  /* wall time spent waiting for the host [ns] */
+  uint64_t idle_ns_ = 0;
 
   struct SimbricksBaseIfParams pcieParams_;
   const char *shmPath_ = nullptr;
@@ -145,6 +214,7 @@ class PcieBM {
   /* for signal handlers */
   volatile bool exiting_ = false;
   volatile bool stat_flag_ = false;
+  volatile bool dma_stats_dump_ = false;
 
   uint64_t h2d_poll_total_ = 0;
   uint64_t h2d_poll_suc_ = 0;
@@ -162,7 +232,8 @@ class PcieBM {
   uint64_t s_n2d_poll_suc_ = 0;
   uint64_t s_n2d_poll_sync_ = 0;
 
-  volatile union SimbricksProtoPcieD2H *D2HAlloc();
+  volatile union SimbricksProtoPcieD2H *D2HAlloc(
+      size_t len = sizeof(union SimbricksProtoPcieD2H));
 
   void H2DRead(volatile struct SimbricksProtoPcieH2DRead *read);
   void H2DWrite(volatile struct SimbricksProtoPcieH2DWrite *write, bool posted);
@@ -173,14 +244,27 @@ class PcieBM {
 
   bool EventTrigger();
 
-  void DmaDo(std::unique_ptr<DMAOp> dma_op);
+  void DmaIssue(bool write);
   void DmaTrigger();
+  void DmaRequestComplete(uint64_t req_id, bool write, const uint8_t *data);
+  void DmaStatsDump();
+  size_t DmaReadPending() const {
+    return dma_read_max_pending_ - dma_read_free_.size();
+  }
+  size_t DmaWritePending() const {
+    return dma_write_max_pending_ - dma_write_free_.size();
+  }
 
   void YieldPoll();
+  void WaitIdle();
+  void IdleEnd();
   bool PcieIfInit();
 
  public:
-  PcieBM(uint32_t dma_max_pending) : dma_read_max_pending_(dma_max_pending), dma_write_max_pending_(dma_max_pending) {}
+  /* `dma_max_pending` limits the PCIe requests in flight per direction. With
+   * `dma_coalesce`, queued reads of adjacent or overlapping regions are merged
+   * into one request; only enable this for side-effect free memory. */
+  explicit PcieBM(uint32_t dma_max_pending, bool dma_coalesce = false);
 
   /** Parse command line arguments. */
   bool ParseArgs(int argc, char *argv[]);
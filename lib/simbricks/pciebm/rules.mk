@@ -24,7 +24,7 @@ include mk/subdir_pre.mk
 
 lib_pciebm := $(d)libpciebm.a
 
-OBJS := $(addprefix $(d),pciebm.o)
+OBJS := $(addprefix $(d),pciebm.o event_queue.o dma_stats.o multidevice.o)
 
 $(lib_pciebm): $(OBJS)
 
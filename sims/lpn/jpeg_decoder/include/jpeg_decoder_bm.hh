@@ -16,7 +16,10 @@ class JpegDecoderBm : public pciebm::PcieBM {
 
   void DmaComplete(std::unique_ptr<pciebm::DMAOp> dma_op) override;
 
-  void ExecuteEvent(std::unique_ptr<pciebm::TimedEvent> evt) override;
+  void DmaReadBorrowed(pciebm::DMAOp &dma_op, size_t offset, const void *data,
+                       size_t len) override;
+
+  void ExecuteEvent(pciebm::TimedEvent &evt) override;
 
   void DevctrlUpdate(struct SimbricksProtoPcieH2DDevctrl &devctrl) override;
 
@@ -24,22 +27,14 @@ class JpegDecoderBm : public pciebm::PcieBM {
   JpegDecoderRegs Registers_{};
   uint64_t BytesRead_ = 0;
   uint64_t BytesWritten_ = 0;
+  /* runs the LPN at its next commit time */
+  pciebm::TimedEvent lpn_evt_;
 
  public:
   JpegDecoderBm() : pciebm::PcieBM(16) {
   }
 };
 
-template <uint64_t BufferLen>
-struct JpegDecoderDmaReadOp : public pciebm::DMAOp {
-  JpegDecoderDmaReadOp(uint64_t dma_addr, size_t len)
-      : pciebm::DMAOp{0, false, dma_addr, len, buffer_} {
-  }
-
- private:
-  uint8_t buffer_[BufferLen];
-};
-
 struct JpegDecoderDmaWriteOp : public pciebm::DMAOp {
   JpegDecoderDmaWriteOp(uint64_t dma_addr, size_t len)
       : pciebm::DMAOp{0, true, dma_addr, len, buffer} {
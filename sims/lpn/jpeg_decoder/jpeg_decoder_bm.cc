@@ -14,7 +14,6 @@
 #include <simbricks/pciebm/pciebm.hh>
 
 #include "../lpn_common/lpn_sim.hh"
-#include "lpn_common.bkp.sbk/lpn_sim.hh"
 #include "lpn_def/lpn_def.hh"
 #include "sims/lpn/jpeg_decoder/include/jpeg_decoder_regs.hh"
 #include "sims/lpn/lpn_common/place_transition.hh"
@@ -152,8 +151,9 @@ void JpegDecoderBm::RegWrite(uint8_t bar, uint64_t addr, const void *src,
     func_thread = std::thread(jpeg_decode_funcsim, src_addr, Registers_.ctrl & CTRL_REG_LEN_MASK, dst_addr, TimePs());
     WaitForSim(ctl_func);
 
-    auto dma_op = std::make_unique<JpegDecoderDmaReadOp<DMA_BLOCK_SIZE>>(
-        src_addr, BytesRead_);
+    // reads have no buffer, the data is consumed in place from the completion
+    auto dma_op = std::make_unique<pciebm::DMAOp>(
+        pciebm::DMAOp{0, false, src_addr, BytesRead_, nullptr});
 
     // IntXIssue(false); // deassert interrupt
     IssueDma(std::move(dma_op));
@@ -165,18 +165,25 @@ void JpegDecoderBm::RegWrite(uint8_t bar, uint64_t addr, const void *src,
   Registers_.isBusy = old_is_busy;
 }
 
+void JpegDecoderBm::DmaReadBorrowed(pciebm::DMAOp &dma_op, size_t offset,
+                                    const void *data, size_t len) {
+  // putData copies the data out of the completion
+  putData(dma_op.dma_addr + offset, len, dma_op.tag, READ_REQ, TimePs(),
+          const_cast<void *>(data));
+}
+
 void JpegDecoderBm::DmaComplete(std::unique_ptr<pciebm::DMAOp> dma_op) {
   // handle response to DMA read request
-  UpdateClk(t_list, T_SIZE, TimePs());
+  UpdateClk(lpn_net, TimePs());
   if (!dma_op->write) {
     // std::cout << "DMA read completed" << " len: " << dma_op->len << std::endl;
-    putData(dma_op->dma_addr, dma_op->len, dma_op->tag, READ_REQ, TimePs(), dma_op->data);
+    // the data has already been passed on to putData from DmaReadBorrowed
 
     KickSim(ctl_func, dma_op->tag);
 
     // produce tokens for the LPN
     // std::cout << "update lpn finishes" << std::endl;
-    uint64_t next_ts = NextCommitTime(t_list, T_SIZE);
+    uint64_t next_ts = NextCommitTime(lpn_net);
 
 #if JPEGD_DEBUG
     std::cerr << "next_ts=" << next_ts << " TimePs=" << TimePs() << "\n";
@@ -184,15 +191,12 @@ void JpegDecoderBm::DmaComplete(std::unique_ptr<pciebm::DMAOp> dma_op) {
     assert(
         next_ts >= TimePs() &&
         "JpegDecoderBm::DmaComplete: Cannot schedule event for past timestamp");
-    auto next_scheduled = EventNext();
     if (next_ts != lpn::LARGE &&
-        (!next_scheduled || next_scheduled.value() > next_ts)) {
+        (!lpn_evt_.Scheduled() || lpn_evt_.time > next_ts)) {
 #if JPEGD_DEBUG
       std::cerr << "schedule next at = " << next_ts << "\n";
 #endif
-      auto evt = std::make_unique<pciebm::TimedEvent>();
-      evt->time = next_ts;
-      EventSchedule(std::move(evt));
+      EventReschedule(lpn_evt_, next_ts);
     }
 
     // issue DMA request for next block
@@ -231,38 +235,34 @@ void JpegDecoderBm::DmaComplete(std::unique_ptr<pciebm::DMAOp> dma_op) {
   }
 }
 
-void JpegDecoderBm::ExecuteEvent(std::unique_ptr<pciebm::TimedEvent> evt) {
+void JpegDecoderBm::ExecuteEvent(pciebm::TimedEvent &evt) {
   // commit all transitions who can commit at evt.time
   // alternatively, commit transitions one by one.
 
-  CommitAtTime(t_list, T_SIZE, evt->time);
-  uint64_t next_ts = NextCommitTime(t_list, T_SIZE);
+  CommitAtTime(lpn_net, evt.time);
+  uint64_t next_ts = NextCommitTime(lpn_net);
 
 #if JPEGD_DEBUG
-  std::cerr << "lpn exec: evt time=" << evt->time << " TimePs=" << TimePs()
+  std::cerr << "lpn exec: evt time=" << evt.time << " TimePs=" << TimePs()
             << " next_ts=" << next_ts << "\n";
 #endif
   // only schedule an event if one doesn't exist yet
   assert(
       next_ts >= TimePs() &&
       "JpegDecoderBm::ExecuteEvent: Cannot schedule event for past timestamp");
-  auto next_scheduled = EventNext();
-
 #if JPEGD_DEBUG
-  if (next_scheduled) {
-    std::cerr << "event scheduled next at = " << next_scheduled.value() << "\n";
+  if (lpn_evt_.Scheduled()) {
+    std::cerr << "event scheduled next at = " << lpn_evt_.time << "\n";
   }
 #endif
 
   if (next_ts != lpn::LARGE &&
-      (!next_scheduled || next_scheduled.value() > next_ts)) {
+      (!lpn_evt_.Scheduled() || lpn_evt_.time > next_ts)) {
 #if JPEGD_DEBUG
     std::cerr << "schedule next at = " << next_ts << "\n";
 #endif
 
-    evt->time = next_ts;
-    evt->priority = 0;
-    EventSchedule(std::move(evt));
+    EventReschedule(lpn_evt_, next_ts);
   }
 
   if(ctl_func.exited == true){
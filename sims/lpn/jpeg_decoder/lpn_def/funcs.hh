@@ -7,46 +7,46 @@
 namespace lpnjpeg {
     uint64_t CYCLEPERIOD = 1'000'000 / 150;
 }
-std::function<uint64_t()> conDelay(int constant){
+auto conDelay(int constant){
     auto delay = [&, constant]() -> int{
         return constant*lpnjpeg::CYCLEPERIOD;
     };
     return delay;
 };
 
-int take1Token(){
+constexpr auto take1Token = []() -> int {
     return 1;
-}
+};
 
-int take0Token(){
+constexpr auto take0Token = []() -> int {
     return 0;
-}
+};
 
-int take4Token(){
+constexpr auto take4Token = []() -> int {
     return 4;
-}
+};
 
-std::function<int()> takeSomeToken(int constant){
+auto takeSomeToken(int constant){
     auto num_tokens = [&, constant]() -> int{
         return constant;
     };
     return num_tokens;
 };
 
-uint64_t mcuDelay(){
+auto mcuDelay = []() -> uint64_t {
     return pvarlatency.tokens[0]->delay*lpnjpeg::CYCLEPERIOD;
 };
 
-std::function<void(BasePlace*)> passEmptyToken() {
-    auto output_token = [&](BasePlace* output_place) -> void {
+auto passEmptyToken() {
+    auto output_token = [&](auto* output_place) -> void {
         NEW_TOKEN(EmptyToken, new_token);
         output_place->pushToken(new_token);
     };
     return output_token;
 };
 
-std::function<void(BasePlace*)> pass4EmptyToken() {
-    auto output_token = [&](BasePlace* output_place) -> void {
+auto pass4EmptyToken() {
+    auto output_token = [&](auto* output_place) -> void {
         for(int i=0; i<4; i++){
             NEW_TOKEN(EmptyToken, new_token);
             output_place->pushToken(new_token);
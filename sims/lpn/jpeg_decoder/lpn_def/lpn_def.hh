@@ -2,15 +2,15 @@
 #define __JPEG_DECODER_LPN_DEF__
 #include <iostream>
 #include "sims/lpn/lpn_common/place_transition.hh"
+#include "sims/lpn/lpn_common/static_net.hh"
 #include "transitions.hh"
 #include "places.hh"
-#define T_SIZE 7
-Transition* t_list[T_SIZE] = {&t0, &t1, &t2, &t3, &t4, &t5, &tfinal};
+auto lpn_net = lpn::MakeNet(t0, t1, t2, t3, t4, t5, tfinal);
 
-void create_empty_queue(QT_type(EmptyToken*)* tokens, int num ){
+void create_empty_queue(Place<>* place, int num ){
   for(int i=0;i<num;i++){
     NEW_TOKEN(EmptyToken, x)
-    tokens->push_back(x);
+    place->pushToken(x);
   }
 }
 
@@ -19,12 +19,12 @@ void lpn_init(){
   if(!init_done){
     std::cerr << "Initializing LPN\n";
     init_done = 1;
-    create_empty_queue(&(p4.tokens), 4);
-    create_empty_queue(&(p5.tokens), 7);
-    create_empty_queue(&(p6.tokens), 4);
-    create_empty_queue(&(p8.tokens), 1);
-    create_empty_queue(&(p11.tokens), 4);
-    create_empty_queue(&(p20.tokens), 4);
+    create_empty_queue(&p4, 4);
+    create_empty_queue(&p5, 7);
+    create_empty_queue(&p6, 4);
+    create_empty_queue(&p8, 1);
+    create_empty_queue(&p11, 4);
+    create_empty_queue(&p20, 4);
   }
 }
 #endif
\ No newline at end of file
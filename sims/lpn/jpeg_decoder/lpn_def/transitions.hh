@@ -1,72 +1,50 @@
 #ifndef __JPEG_DECODER_LPN_TRANSITIONS__
 #define __JPEG_DECODER_LPN_TRANSITIONS__
 #include "../../lpn_common/place_transition.hh"
+#include "../../lpn_common/static_net.hh"
 #include "places.hh"
 #include "funcs.hh"
-Transition t1 = {
-    .id = "1",
-    .delay_f = conDelay(0),
-    .p_input = {&ptasks, &p8},
-    .pi_w = {take1Token, take1Token},
-    .p_output = {&p7},
-    .po_w = {passEmptyToken()},
-};
+using lpn::In;
+using lpn::Inputs;
+using lpn::Out;
+using lpn::Outputs;
 
-Transition t0 = {
-    .id = "0",
-    .delay_f = mcuDelay,
-    .p_input = {&p7, &p4, &pvarlatency},
-    .pi_w = {take1Token, take1Token, take1Token},
-    .p_output = {&p0, &p8},
-    .po_w = {passEmptyToken(),passEmptyToken()},
-};
+auto t1 = lpn::MakeTransition("1",
+    conDelay(0),
+    Inputs(In(ptasks, take1Token), In(p8, take1Token)),
+    Outputs(Out(p7, passEmptyToken())));
 
-Transition t5 = {
-    .id = "5",
-    .delay_f = conDelay(65),
-    .p_input = {&p1, &p2, &p3},
-    .pi_w = {take1Token, take1Token, take1Token},
-    .p_output = {&pbefore_done, &p6},
-    .po_w = {passEmptyToken(),passEmptyToken()},
-};
+auto t0 = lpn::MakeTransition("0",
+    mcuDelay,
+    Inputs(In(p7, take1Token), In(p4, take1Token), In(pvarlatency, take1Token)),
+    Outputs(Out(p0, passEmptyToken()), Out(p8, passEmptyToken())));
 
-Transition tfinal = {
-    .id = "final",
-    .delay_f = conDelay(0),
-    .p_input = {&pbefore_done},
-    .pi_w = {take4Token},
-    .p_output = {&pdone},
-    .po_w = {passEmptyToken()},
-};
+auto t5 = lpn::MakeTransition("5",
+    conDelay(65),
+    Inputs(In(p1, take1Token), In(p2, take1Token), In(p3, take1Token)),
+    Outputs(Out(pbefore_done, passEmptyToken()), Out(p6, passEmptyToken())));
 
-Transition t4 = {
-    .id = "4",
-    .delay_f = conDelay(66),
-    .p_input = {&p0, &p22, &p6},
-    .pi_w = {take1Token, take1Token, take4Token},
-    .pi_w_threshold = {0, 0, 2},
-    .p_output = {&p3, &p20, &p4},
-    .po_w = {pass4EmptyToken(),pass4EmptyToken(), passEmptyToken()},
-};
+auto tfinal = lpn::MakeTransition("final",
+    conDelay(0),
+    Inputs(In(pbefore_done, take4Token)),
+    Outputs(Out(pdone, passEmptyToken())));
 
-Transition t3 = {
-    .id = "3",
-    .delay_f = conDelay(66),
-    .p_input = {&p0, &p21, &p6},
-    .pi_w = {take1Token, take4Token, take0Token},
-    .pi_w_threshold = {0, 0, 2},
-    .p_output = {&p2, &p22, &p4},
-    .po_w = {pass4EmptyToken(),passEmptyToken(), passEmptyToken()},
-};
+auto t4 = lpn::MakeTransition("4",
+    conDelay(66),
+    Inputs(In(p0, take1Token), In(p22, take1Token), In(p6, take4Token, 2)),
+    Outputs(Out(p3, pass4EmptyToken()), Out(p20, pass4EmptyToken()),
+            Out(p4, passEmptyToken())));
 
-Transition t2 = {
-    .id = "2",
-    .delay_f = conDelay(66),
-    .p_input = {&p0, &p20, &p6},
-    .pi_w = {take1Token, take1Token, take0Token},
-    .pi_w_threshold = {0, 0, 2},
-    .p_output = {&p1, &p21, &p4},
-    .po_w = {passEmptyToken(),passEmptyToken(), passEmptyToken()},
-};
+auto t3 = lpn::MakeTransition("3",
+    conDelay(66),
+    Inputs(In(p0, take1Token), In(p21, take4Token), In(p6, take0Token, 2)),
+    Outputs(Out(p2, pass4EmptyToken()), Out(p22, passEmptyToken()),
+            Out(p4, passEmptyToken())));
+
+auto t2 = lpn::MakeTransition("2",
+    conDelay(66),
+    Inputs(In(p0, take1Token), In(p20, take1Token), In(p6, take0Token, 2)),
+    Outputs(Out(p1, passEmptyToken()), Out(p21, passEmptyToken()),
+            Out(p4, passEmptyToken())));
 
 #endif
@@ -410,11 +410,11 @@ static bool DecodeImage(int till_end)
             NEW_TOKEN(mcu_token, new_token);
             new_token->delay = 3*(cnt) + 6;
             new_token->ts = timestamp;
-            pvarlatency.tokens.push_back(new_token);
+            pvarlatency.pushToken(new_token);
             
             NEW_TOKEN(EmptyToken, ne_token);
             ne_token->ts = timestamp;
-            ptasks.tokens.push_back(ne_token);
+            ptasks.pushToken(ne_token);
         }
 
         if(till_end == 0){
@@ -1,32 +1,247 @@
 #include "lpn_sim.hh"
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Worker threads for firing conflict-free groups in parallel. The calling
+// thread takes part in every run, so a pool of n threads has n-1 workers.
+class LpnPool {
+ public:
+  explicit LpnPool(int threads) {
+    for(int i=1; i < threads; i++)
+      workers_.emplace_back([this]{ Worker(); });
+  }
+
+  ~LpnPool() {
+    {
+      std::lock_guard<std::mutex> lk(mtx_);
+      stop_ = true;
+    }
+    cnd_.notify_all();
+    for(auto& w : workers_) w.join();
+  }
+
+  // call job(i) for every i < n, returns once all calls are done
+  void Run(size_t n, const std::function<void(size_t)>& job) {
+    {
+      std::lock_guard<std::mutex> lk(mtx_);
+      job_ = &job;
+      n_jobs_ = n;
+      next_ = 0;
+      busy_ = workers_.size();
+      gen_++;
+    }
+    cnd_.notify_all();
+    Work();
+    std::unique_lock<std::mutex> lk(mtx_);
+    done_cnd_.wait(lk, [this]{ return busy_ == 0; });
+  }
+
+ private:
+  void Work() {
+    size_t i;
+    while((i = next_.fetch_add(1)) < n_jobs_)
+      (*job_)(i);
+  }
+
+  void Worker() {
+    uint64_t seen = 0;
+    while(true){
+      {
+        std::unique_lock<std::mutex> lk(mtx_);
+        cnd_.wait(lk, [&]{ return stop_ || gen_ != seen; });
+        if(stop_) return;
+        seen = gen_;
+      }
+      Work();
+      std::lock_guard<std::mutex> lk(mtx_);
+      if(--busy_ == 0) done_cnd_.notify_one();
+    }
+  }
+
+  std::vector<std::thread> workers_;
+  std::mutex mtx_;
+  std::condition_variable cnd_;
+  std::condition_variable done_cnd_;
+  const std::function<void(size_t)>* job_ = nullptr;
+  size_t n_jobs_ = 0;
+  std::atomic<size_t> next_{0};
+  size_t busy_ = 0;
+  uint64_t gen_ = 0;
+  bool stop_ = false;
+};
+
+LpnSched* LpnSetup(Transition* t_list[], int size){
+  // lives as long as the net
+  LpnSched* s = new LpnSched;
+  s->t_list = t_list;
+  s->size = size;
+  for(int i=0; i < size; i++){
+    Transition* t = t_list[i];
+    t->sched = s;
+    t->idx = i;
+    t->time_seq = 0;
+    t->blocked = 0;
+    t->dirty = 1;
+    s->dirty.push_back(t);
+    if(t->delay_event != lpn::LARGE)
+      s->events.push({t->delay_event, i});
+
+    // guards may look at the output places too (e.g. psDrain_is_empty)
+    auto watch = [t](BasePlace* p){
+      if(std::find(p->watchers.begin(), p->watchers.end(), t) ==
+         p->watchers.end())
+        p->watchers.push_back(t);
+    };
+    for(BasePlace* p : t->p_input) watch(p);
+    for(BasePlace* p : t->p_output) watch(p);
+  }
+
+  std::vector<int> group(size);
+  s->n_groups = detect_conflict_free_groups(t_list, size, group.data());
+  for(int i=0; i < size; i++) t_list[i]->group = group[i];
+  s->group_dirty.resize(s->n_groups);
+  s->group_due.resize(s->n_groups);
+  return s;
+}
+
+
+static LpnSched* GetSched(Transition* t_list[], int size){
+  if(size > 0 && t_list[0]->sched && t_list[0]->sched->t_list == t_list)
+    return t_list[0]->sched;
+  return LpnSetup(t_list, size);
+}
+
+void LpnSetParallel(Transition* t_list[], int size, int threads,
+                    size_t min_parallel){
+  LpnSched* s = GetSched(t_list, size);
+  delete s->pool;
+  s->pool = nullptr;
+  s->min_parallel = min_parallel;
+  // nothing to run side by side in a net that is a single group
+  if(threads > 1 && s->n_groups > 1)
+    s->pool = new LpnPool(threads);
+}
+
+// apply the clock updates since t was last looked at: idle transitions take
+// every update, busy ones only those from UpdateClk
+static void SyncTime(LpnSched* s, Transition* t){
+  if(t->delay_event == lpn::LARGE){
+    if(s->seq > t->time_seq) t->time = s->clk;
+  }else{
+    if(s->upd_seq > t->time_seq) t->time = s->upd_clk;
+  }
+  t->time_seq = s->seq;
+}
+
+static bool IdxLess(const Transition* a, const Transition* b){
+  return a->idx < b->idx;
+}
+
 uint64_t NextCommitTime(Transition* t_list[], int size){
-    LOOP_TS(trigger(t), size);
-    return min_time_g(t_list, size);
-    // if(time == lpn::LARGE){
-    //     // no more event
-    //     return lpn::LARGE;
-    // }
-    // return time;
+  LpnSched* s = GetSched(t_list, size);
+
+  // blocked transitions wait on state outside the net (e.g. DMA data)
+  for(Transition* t : s->blocked){
+    if(t->dirty) continue;
+    t->dirty = 1;
+    s->dirty.push_back(t);
+  }
+  s->blocked.clear();
+
+  // evaluate in list order, as delay functions can have side effects
+  std::vector<Transition*> todo;
+  todo.swap(s->dirty);
+  std::sort(todo.begin(), todo.end(), IdxLess);
+  for(Transition* t : todo){
+    t->dirty = 0;
+    if(t->delay_event != lpn::LARGE) continue;
+    SyncTime(s, t);
+    trigger(t);
+    if(t->delay_event != lpn::LARGE)
+      s->events.push({t->delay_event, t->idx});
+    else if(t->blocked)
+      s->blocked.push_back(t);
+  }
+
+  // drop entries of transitions committed or reset since
+  while(!s->events.empty()){
+    auto& top = s->events.top();
+    if(t_list[top.second]->delay_event == top.first)
+      return top.first;
+    s->events.pop();
+  }
+  return lpn::LARGE;
 }
 
 int CommitAtTime(Transition* t_list[], int size, uint64_t time){
-    for(int i=0;i < size; i++){
-        Transition* t = t_list[i];
-        int fired = sync(t, time);
-        // if(fired == 1){
-            // printf("@%ld sync t done: %s\n", time/1000000, t->id.c_str());
-        // }
-    } 
-    
+  LpnSched* s = GetSched(t_list, size);
+  s->clk = time;
+  s->seq++;
+
+  std::vector<Transition*> due;
+  while(!s->events.empty() && s->events.top().first <= time){
+    auto top = s->events.top();
+    s->events.pop();
+    Transition* t = t_list[top.second];
+    if(t->delay_event == top.first)
+      due.push_back(t);
+  }
+  std::sort(due.begin(), due.end(), IdxLess);
+  due.erase(std::unique(due.begin(), due.end()), due.end());
+  for(Transition* t : due)
+    SyncTime(s, t);
+
+  if(!s->pool || due.size() < s->min_parallel){
+    for(Transition* t : due){
+      sync(t, time);
+      // printf("@%ld sync t done: %s\n", time/1000000, t->id.c_str());
+    }
+    return 0;
+  }
+
+  // Groups share no places, so firing them side by side ends in the same
+  // state as firing everything in list order. Each group keeps list order.
+  std::vector<int> groups;
+  for(Transition* t : due){
+    auto& g = s->group_due[t->group];
+    if(g.empty()) groups.push_back(t->group);
+    g.push_back(t);
+  }
+  if(groups.size() < 2){
+    for(int g : groups) s->group_due[g].clear();
+    for(Transition* t : due) sync(t, time);
     return 0;
+  }
+
+  std::sort(groups.begin(), groups.end());
+  std::function<void(size_t)> job = [s, &groups, time](size_t i){
+    for(Transition* t : s->group_due[groups[i]]) sync(t, time);
+  };
+  s->parallel = true;
+  s->pool->Run(groups.size(), job);
+  s->parallel = false;
+
+  // NextCommitTime sorts the dirty list, merge in group order anyway so the
+  // list does not depend on thread timing
+  for(int g : groups){
+    s->group_due[g].clear();
+    auto& d = s->group_dirty[g];
+    s->dirty.insert(s->dirty.end(), d.begin(), d.end());
+    d.clear();
+  }
+  return 0;
 }
 
 void UpdateClk(Transition* t_list[], int size, uint64_t clk){
-  for(int i=0; i<size; i++){
-      Transition* t = t_list[i];
-      t->time = clk;
-  }
+  LpnSched* s = GetSched(t_list, size);
+  s->clk = s->upd_clk = clk;
+  s->upd_seq = ++s->seq;
 }
     
 void TransitionCountLog(Transition* t_list[], int size){
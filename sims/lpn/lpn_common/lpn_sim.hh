@@ -9,6 +9,20 @@
     
 void TransitionCountLog(Transition* t_list[], int size);
 
+// build the place -> transition index of the net, done by the first call of
+// the functions below otherwise
+LpnSched* LpnSetup(Transition* t_list[], int size);
+
+// Fire the conflict-free transition groups due at the same time on a pool of
+// `threads` threads (including the caller) once at least `min_parallel`
+// transitions are due; smaller steps stay serial. The result is the same as
+// with the serial engine as long as delay, weight, guard and output functions
+// only touch the places of their own transition (in particular no
+// thread_local state). Allocating and freeing pooled tokens is fine, see
+// lpn::TokenPool. threads <= 1 turns it off again.
+void LpnSetParallel(Transition* t_list[], int size, int threads,
+                    size_t min_parallel = 64);
+
 uint64_t NextCommitTime(Transition* t_list[], int size);
 
 int CommitAtTime(Transition* t_list[], int size, uint64_t time);
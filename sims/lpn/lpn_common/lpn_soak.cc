@@ -0,0 +1,121 @@
+// Soak test for token allocation: moves tokens around a set of independent
+// two-place rings, allocating a token in every output function and freeing
+// one on every input, and checks that the resident set size stays flat once
+// the token pools are warmed up. With -t, the lanes fire in parallel on
+// THREADS threads, so tokens are often freed on another thread than they were
+// allocated on, and the thread pool is replaced at every report.
+//
+// usage: lpn_soak [-m MOVES] [-l LANES] [-t THREADS]
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <deque>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "lpn_sim.hh"
+#include "place_transition.hh"
+
+CREATE_TOKEN_TYPE(soak_token, uint64_t payload[4];)
+
+// RSS slack after warm-up, covers stdio buffers and the like [kB]
+static const long kMaxGrowthKb = 1024;
+
+static long RssKb() {
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while (std::getline(status, line)) {
+    if (line.rfind("VmRSS:", 0) == 0)
+      return atol(line.c_str() + 6);
+  }
+  return 0;
+}
+
+static void MoveOne(Transition& t, Place<soak_token>& from,
+                    Place<soak_token>& to) {
+  t.id = from.id + "->" + to.id;
+  t.delay_f = []() -> uint64_t { return 1; };
+  t.p_input = {&from};
+  t.pi_w[0] = []() { return 1; };
+  t.pi_w_threshold[0] = 0;
+  t.p_output = {&to};
+  t.po_w[0] = [&from](BasePlace* output_place) {
+    NEW_TOKEN(soak_token, token);
+    token->payload[0] = from.tokens.front()->payload[0] + 1;
+    output_place->pushToken(token);
+  };
+}
+
+int main(int argc, char* argv[]) {
+  long moves = 10000000;
+  int lanes = 16;
+  int threads = 1;
+  int c;
+  while ((c = getopt(argc, argv, "m:l:t:")) != -1) {
+    switch (c) {
+      case 'm':
+        moves = atol(optarg);
+        break;
+      case 'l':
+        lanes = atoi(optarg);
+        break;
+      case 't':
+        threads = atoi(optarg);
+        break;
+      default:
+        fprintf(stderr, "usage: %s [-m MOVES] [-l LANES] [-t THREADS]\n",
+                argv[0]);
+        return EXIT_FAILURE;
+    }
+  }
+
+  std::deque<Place<soak_token>> places;
+  std::deque<Transition> transitions;
+  std::vector<Transition*> t_list;
+  for (int i = 0; i < lanes; i++) {
+    Place<soak_token>& a = places.emplace_back("a" + std::to_string(i));
+    Place<soak_token>& b = places.emplace_back("b" + std::to_string(i));
+    // a few tokens per lane, so that tokens are alive in both places
+    for (int j = 0; j < 4; j++) {
+      NEW_TOKEN(soak_token, token);
+      token->payload[0] = 0;
+      a.pushToken(token);
+    }
+    MoveOne(transitions.emplace_back(), a, b);
+    MoveOne(transitions.emplace_back(), b, a);
+  }
+  for (Transition& t : transitions)
+    t_list.push_back(&t);
+  int size = t_list.size();
+  LpnSetup(t_list.data(), size);
+  if (threads > 1)
+    LpnSetParallel(t_list.data(), size, threads, 2);
+
+  long done = 0;
+  long next_report = moves / 10;
+  long warm_rss = 0;
+  while (done < moves) {
+    uint64_t ts = NextCommitTime(t_list.data(), size);
+    CommitAtTime(t_list.data(), size, ts);
+    done = 0;
+    for (Transition* t : t_list)
+      done += t->count;
+    if (done >= next_report) {
+      long rss = RssKb();
+      if (warm_rss == 0)
+        warm_rss = rss;
+      printf("moves=%ld rss=%ldkB\n", done, rss);
+      next_report += moves / 10;
+      // worker threads exit with their token caches
+      if (threads > 1)
+        LpnSetParallel(t_list.data(), size, threads, 2);
+    }
+  }
+
+  long growth = RssKb() - warm_rss;
+  printf("rss growth after warm-up: %ldkB\n", growth);
+  return (growth <= kMaxGrowthKb ? EXIT_SUCCESS : EXIT_FAILURE);
+}
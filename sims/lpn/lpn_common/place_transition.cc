@@ -3,7 +3,7 @@
 #include <sys/types.h>
 #include <iostream>
 
-uint64_t lpn::CLK = 0;
+thread_local uint64_t lpn::CLK = 0;
 
 int check_token_requirement(BasePlace* self, int num){
    if (num == -2)
@@ -32,9 +32,8 @@ int able_to_fire_t(Transition* self, uint64_t& enabled_ts){
      } else {
         consume_num_tokens_threshold = self->pi_w_threshold[i]; 
      }
-     self->consume_tokens.push_back(consume_num_tokens_real);
+     self->consume_tokens[i] = consume_num_tokens_real;
      if (! check_token_requirement(p, consume_num_tokens_threshold) ){ 
-        self->consume_tokens.clear();
         return 0; 
      }
     if (consume_num_tokens_threshold > 0){
@@ -45,7 +44,6 @@ int able_to_fire_t(Transition* self, uint64_t& enabled_ts){
     if (self->pi_guard[i] == NULL) continue; 
     int grant = self->pi_guard[i](); 
     if (grant == 0) { 
-      self->consume_tokens.clear();
       return 0; 
     } 
   }
@@ -59,13 +57,9 @@ void fire_t(Transition* self){
    int input_size= self->p_input.size(); 
    for(int i=0; i < input_size; i++){ 
      BasePlace* p = self->p_input[i]; 
-     int consume_num_tokens = self->consume_tokens.front();
-     self->consume_tokens.pop_front(); 
-     fire(p, consume_num_tokens); 
+     fire(p, self->consume_tokens[i]); 
    }
 
-  self->consume_tokens.clear();
-
 }
 
 void accept_t(Transition* self){
@@ -88,6 +82,7 @@ uint64_t delay(Transition* self){
 int trigger(Transition* self){
   ////std::cerr << "trigger " << self->id << std::endl;
   if(self->delay_event != lpn::LARGE) return 1;
+  self->blocked = 0;
   if(self->disable) return 0;
   uint64_t enabled = 0;
   int can_fire = able_to_fire_t(self, enabled);
@@ -95,7 +90,10 @@ int trigger(Transition* self){
   if(self->delay_event == lpn::LARGE && can_fire){
      uint64_t delay_time = delay(self);
      //disabled when the delay is largest
-     if (delay_time == lpn::LARGE) return 0;
+     if (delay_time == lpn::LARGE) {
+       self->blocked = 1;
+       return 0;
+     }
 
      uint64_t enable_time = std::max(enabled, self->pip_ts);
      uint64_t mature_time = enable_time + delay_time; 
@@ -211,3 +209,43 @@ void detect_conflicting_Transition_groups(Transition** t_list, int size, std::se
   }
 
 }
+
+// Partition the net into groups that share no place: transitions sharing an
+// output conflict (see above), and so do transitions sharing an input, since
+// both pop from it. Groups are numbered in order of their first transition in
+// t_list. Returns the number of groups.
+int detect_conflict_free_groups(Transition** t_list, int size, int* group){
+  std::vector<int> parent(size);
+  for(int i=0; i<size; i++) parent[i] = i;
+  auto find = [&parent](int i){
+    while(parent[i] != i){
+      parent[i] = parent[parent[i]];
+      i = parent[i];
+    }
+    return i;
+  };
+
+  std::map<BasePlace*, int> first_user;
+  auto join = [&](BasePlace* p, int i){
+    auto it = first_user.find(p);
+    if(it == first_user.end()){
+      first_user[p] = i;
+      return;
+    }
+    int a = find(it->second), b = find(i);
+    if(a != b) parent[std::max(a, b)] = std::min(a, b);
+  };
+  for(int i=0; i<size; i++){
+    for(auto& p : t_list[i]->p_input) join(p, i);
+    for(auto& p : t_list[i]->p_output) join(p, i);
+  }
+
+  std::map<int, int> ids;
+  for(int i=0; i<size; i++){
+    int root = find(i);
+    auto it = ids.find(root);
+    if(it == ids.end()) it = ids.emplace(root, ids.size()).first;
+    group[i] = it->second;
+  }
+  return ids.size();
+}
@@ -10,21 +10,226 @@
 #include <vector>
 #include <iostream>
 #include <functional>
+#include <queue>
+#include <cstddef>
+#include <cstdlib>
+#include <mutex>
+#include <new>
 
-#define QT_type(T) std::deque<T>
+#define QT_type(T) lpn::TokenRing<T>
 #define NEW_QT(T, x) QT_type(T)* x = new QT_type(T)
 #define NEW_TOKEN(T, x) T* x = new T;
 
 namespace lpn {
 
 const uint64_t LARGE = (1<<63)-1; 
-extern uint64_t CLK;
+extern thread_local uint64_t CLK;
+
+// Freelist allocator for one token type. Tokens are carved out of slabs that
+// are kept for reuse and never handed back. Every thread allocates from and
+// frees to its own cache; caches that grow too long, and the caches of exiting
+// threads, spill into a shared depot that empty caches refill from. Tokens
+// allocated on one thread and freed on another (parallel firing, see
+// LpnSetParallel) are thus reused instead of piling up on the freeing thread
+// or being lost with it.
+template<typename T>
+class TokenPool {
+  struct FreeSlot {
+    FreeSlot* next;
+  };
+  static constexpr size_t kAlign =
+      alignof(T) > alignof(FreeSlot) ? alignof(T) : alignof(FreeSlot);
+  static constexpr size_t kSlotSize =
+      ((sizeof(T) > sizeof(FreeSlot) ? sizeof(T) : sizeof(FreeSlot)) +
+       kAlign - 1) / kAlign * kAlign;
+  static constexpr size_t kSlabSlots = 256;
+  // slots moved between a cache and the depot at once
+  static constexpr size_t kBatch = 256;
+
+  struct Cache {
+    FreeSlot* head = nullptr;
+    size_t len = 0;
+    ~Cache() {
+      if (head)
+        Spill(*this, len);
+    }
+  };
+
+  static inline thread_local Cache cache_;
+  static inline std::mutex depot_mtx_;
+  static inline FreeSlot* depot_ = nullptr;
+
+  // move the first n slots of c to the depot
+  static void Spill(Cache& c, size_t n) {
+    FreeSlot* first = c.head;
+    FreeSlot* last = first;
+    for (size_t i = 1; i < n; i++)
+      last = last->next;
+    c.head = last->next;
+    c.len -= n;
+    std::lock_guard<std::mutex> lk(depot_mtx_);
+    last->next = depot_;
+    depot_ = first;
+  }
+
+  static void Refill(Cache& c) {
+    {
+      std::lock_guard<std::mutex> lk(depot_mtx_);
+      while (depot_ && c.len < kBatch) {
+        FreeSlot* s = depot_;
+        depot_ = s->next;
+        s->next = c.head;
+        c.head = s;
+        c.len++;
+      }
+    }
+    if (c.head)
+      return;
+
+    char* slab = static_cast<char*>(
+        ::operator new(kSlotSize * kSlabSlots, std::align_val_t(kAlign)));
+    for (size_t i = kSlabSlots; i > 0; i--) {
+      FreeSlot* s = reinterpret_cast<FreeSlot*>(slab + (i - 1) * kSlotSize);
+      s->next = c.head;
+      c.head = s;
+    }
+    c.len = kSlabSlots;
+  }
+
+ public:
+  static void* Alloc(size_t size) {
+    // classes derived from a pooled token type fall back to the heap
+    if (size != sizeof(T))
+      return ::operator new(size);
+    Cache& c = cache_;
+    if (!c.head)
+      Refill(c);
+    FreeSlot* s = c.head;
+    c.head = s->next;
+    c.len--;
+    return s;
+  }
+
+  static void Free(void* p, size_t size) {
+    if (size != sizeof(T)) {
+      ::operator delete(p);
+      return;
+    }
+    Cache& c = cache_;
+    FreeSlot* s = static_cast<FreeSlot*>(p);
+    s->next = c.head;
+    c.head = s;
+    if (++c.len >= 2 * kBatch)
+      Spill(c, kBatch);
+  }
+};
+
+// Index and timestamps of a place's token FIFO. The timestamps live in their
+// own contiguous array next to the payloads (kept by TokenRing), so checking
+// whether a transition can fire only reads lengths and timestamps and never
+// dereferences a token.
+class TokenRingBase {
+ protected:
+  uint64_t* ts_ = nullptr;
+  size_t mask_ = 0;
+  size_t head_ = 0;
+  size_t len_ = 0;
+
+  size_t slot(size_t idx) const {
+    return (head_ + idx) & mask_;
+  }
+
+ public:
+  size_t size() const {
+    return len_;
+  }
+  bool empty() const {
+    return len_ == 0;
+  }
+  uint64_t& ts(size_t idx) {
+    return ts_[slot(idx)];
+  }
+  uint64_t ts(size_t idx) const {
+    return ts_[slot(idx)];
+  }
+};
+
+// FIFO of token pointers and their timestamps on a power of two ring, grows
+// by doubling and keeps its storage across pops and clears.
+template<typename T>
+class TokenRing : public TokenRingBase {
+  T* buf_ = nullptr;
+
+  void grow() {
+    size_t cap = buf_ ? (mask_ + 1) * 2 : 16;
+    T* nbuf = static_cast<T*>(std::malloc(cap * sizeof(T)));
+    uint64_t* nts = static_cast<uint64_t*>(std::malloc(cap * sizeof(uint64_t)));
+    if (!nbuf || !nts)
+      throw std::bad_alloc();
+    for (size_t i = 0; i < len_; i++) {
+      nbuf[i] = buf_[slot(i)];
+      nts[i] = ts_[slot(i)];
+    }
+    std::free(buf_);
+    std::free(ts_);
+    buf_ = nbuf;
+    ts_ = nts;
+    mask_ = cap - 1;
+    head_ = 0;
+  }
+
+ public:
+  TokenRing() = default;
+  TokenRing(const TokenRing&) = delete;
+  TokenRing& operator=(const TokenRing&) = delete;
+  ~TokenRing() {
+    std::free(buf_);
+    std::free(ts_);
+  }
+
+  T& operator[](size_t idx) {
+    return buf_[slot(idx)];
+  }
+  const T& operator[](size_t idx) const {
+    return buf_[slot(idx)];
+  }
+  T& front() {
+    return buf_[head_];
+  }
+  void push_back(T x, uint64_t ts) {
+    if (!buf_ || len_ == mask_ + 1)
+      grow();
+    buf_[slot(len_)] = x;
+    ts_[slot(len_)] = ts;
+    len_++;
+  }
+  void push_back(T x) {
+    push_back(x, x->ts);
+  }
+  void pop_front() {
+    head_ = (head_ + 1) & mask_;
+    len_--;
+  }
+  void clear() {
+    head_ = 0;
+    len_ = 0;
+  }
+};
 
 }
 
+struct Transition;
+struct LpnSched;
+struct NetSched;
+class LpnPool;
+
 class BaseToken {
 public:
+  // timestamp the token is pushed with, the place keeps the current one
   uint64_t ts=0;
+  // number of places (and init lists) holding the token, it is deleted when
+  // the last one pops it
+  int refs=0;
   virtual void print_token() {}
   virtual std::map<std::string, int>* asDictionary(){
     return nullptr;
@@ -32,7 +237,23 @@ public:
   virtual ~BaseToken() = default;
 };
 
+// route new/delete of a token type through its lpn::TokenPool
+#define LPN_POOLED_TOKEN(name) \
+  static void* operator new(size_t size) { \
+    return lpn::TokenPool<name>::Alloc(size); \
+  } \
+  static void operator delete(void* p, size_t size) { \
+    lpn::TokenPool<name>::Free(p, size); \
+  }
+
+inline void release_token(BaseToken* token) {
+  if (--token->refs == 0) delete token;
+}
+
 class EmptyToken: public BaseToken{
+public:
+  LPN_POOLED_TOKEN(EmptyToken)
+private:
   std::map<std::string, int>* asDictionary() override{
     return nullptr;
   }
@@ -40,20 +261,29 @@ class EmptyToken: public BaseToken{
 
 #define CREATE_TOKEN_TYPE(name, ...) \
 class name: public BaseToken \
-{ public: __VA_ARGS__  };
+{ public: LPN_POOLED_TOKEN(name) __VA_ARGS__  };
 
 class BasePlace {
 public:
     std::string id;
-    explicit BasePlace(std::string asid) : id(std::move(asid)) {}
+    // transitions to re-evaluate when the tokens change, set up by LpnSetup
+    std::vector<Transition*> watchers;
+    // the same for static nets (lpn::Net), as (scheduler, position in net)
+    std::vector<std::pair<NetSched*, int>> net_watchers;
+    explicit BasePlace(std::string asid, lpn::TokenRingBase* ring)
+        : id(std::move(asid)), ring_(ring) {}
+
+    // mark the watching transitions for re-evaluation
+    inline void touch();
     
-    virtual int tokensLen() const {
-      return 0;
+    int tokensLen() const {
+      return ring_->size();
     }
-    virtual uint64_t tsAt(int idx) const {
-      return 0;
+    uint64_t tsAt(int idx) const {
+      return ring_->ts(idx);
     }
-    virtual void setTokenTs(int idx, uint64_t ts) {
+    void setTokenTs(int idx, uint64_t ts) {
+      ring_->ts(idx) = ts;
     }
     virtual std::string getId() const {
       return "";
@@ -77,22 +307,27 @@ public:
       return nullptr;
     }
     virtual ~BasePlace() = default;
+
+protected:
+    // token storage of the Place
+    lpn::TokenRingBase* ring_;
 };
 
 template<typename TokenType = EmptyToken>
 class Place : public BasePlace
 {
   public:
-  explicit Place(const std::string& asid) : BasePlace(asid) {}
-  std::deque<TokenType*> tokens;
+  QT_type(TokenType*) tokens;
+  explicit Place(const std::string& asid) : BasePlace(asid, &tokens) {}
   std::deque<TokenType*> tokens_init;
   
   bool hasInit() const override{
     return tokens_init.size() > 0;
   }
   void copyToInit() override{
-    for(auto& token: tokens){
-      tokens_init.push_back(token);
+    for(size_t i=0; i<tokens.size(); i++){
+      tokens[i]->refs++;
+      tokens_init.push_back(tokens[i]);
     }
   }
   int initSize() const override{
@@ -101,26 +336,25 @@ class Place : public BasePlace
   BaseToken* initAt(int idx) const override{
     return tokens_init[idx];
   }
-  int tokensLen() const override {
-    return tokens.size();
-  }
-  uint64_t tsAt(int idx) const override{
-    return tokens[idx]->ts;
-  } 
-  void setTokenTs(int idx, uint64_t ts) override{
-    tokens[idx]->ts = ts;
-  }
   std::string getId() const override {
         return id;
   }
   void popToken() final{
+    release_token(tokens.front());
     tokens.pop_front();
+    touch();
   }
   void pushToken(BaseToken* token) final{
+    token->refs++;
     tokens.push_back(static_cast<TokenType*>(token));
+    touch();
   }
   void reset() override{
+      for(size_t i=0; i<tokens.size(); i++){
+        release_token(tokens[i]);
+      }
       tokens.clear();
+      touch();
   }
 };
 
@@ -143,7 +377,8 @@ using Transition = struct Transition
     create_input_guard_vector_list();
     create_output_vector_list();
     
-    std::deque<int> consume_tokens=std::deque<int>(0, 0);
+    // tokens to consume per input, filled by able_to_fire_t
+    int consume_tokens[N_ELEM];
     
     uint64_t delay_event=lpn::LARGE; //-1 if no event
     int disable = 0;
@@ -151,8 +386,90 @@ using Transition = struct Transition
     uint64_t pip_ts = 0;
     int count=0;
     uint64_t time=0;
+
+    // incremental scheduling state, see LpnSched
+    LpnSched* sched = nullptr;
+    int idx = 0;
+    int dirty = 0;
+    // enabled, but delay_f returned LARGE
+    int blocked = 0;
+    // clock update of the scheduler last applied to time
+    uint64_t time_seq = 0;
+    // conflict-free group, see detect_conflict_free_groups
+    int group = 0;
+};
+
+// Scheduling state of a net, built by LpnSetup. Only transitions whose input
+// or output places changed since they were last evaluated (dirty) and those
+// blocked on state outside the net are re-evaluated, enabled transitions are
+// kept in a min-heap of their delay_event.
+struct LpnSched {
+  Transition** t_list = nullptr;
+  int size = 0;
+  std::vector<Transition*> dirty;
+  std::vector<Transition*> blocked;
+  // (delay_event, transition index)
+  std::priority_queue<std::pair<uint64_t, int>,
+                      std::vector<std::pair<uint64_t, int>>,
+                      std::greater<std::pair<uint64_t, int>>> events;
+  // clock updates applied lazily to Transition::time: the latest from
+  // UpdateClk or CommitAtTime, and the latest from UpdateClk only
+  uint64_t clk = 0;
+  uint64_t seq = 0;
+  uint64_t upd_clk = 0;
+  uint64_t upd_seq = 0;
+
+  // parallel commit, see LpnSetParallel
+  int n_groups = 0;
+  LpnPool* pool = nullptr;
+  size_t min_parallel = 0;
+  // set while groups fire on the pool, transitions then go to the dirty list
+  // of their group and are merged in group order afterwards
+  bool parallel = false;
+  std::vector<std::vector<Transition*>> group_dirty;
+  std::vector<std::vector<Transition*>> group_due;
+};
+
+// Scheduling state of a static lpn::Net (see static_net.hh), kept the same
+// way as LpnSched. Transitions are referred to by their position in the net.
+struct NetSched {
+  bool ready = false;
+  std::vector<uint8_t> is_dirty;
+  std::vector<int> dirty;
+  std::vector<int> blocked;
+  // scratch lists of NextCommitTime and CommitAtTime
+  std::vector<int> todo;
+  std::vector<int> due;
+  // (delay_event, position)
+  std::priority_queue<std::pair<uint64_t, int>,
+                      std::vector<std::pair<uint64_t, int>>,
+                      std::greater<std::pair<uint64_t, int>>> events;
+  uint64_t clk = 0;
+  uint64_t seq = 0;
+  uint64_t upd_clk = 0;
+  uint64_t upd_seq = 0;
+
+  void mark(int i) {
+    if (is_dirty[i]) return;
+    is_dirty[i] = 1;
+    dirty.push_back(i);
+  }
 };
 
+inline void BasePlace::touch() {
+  for (Transition* t : watchers) {
+    if (t->dirty) continue;
+    t->dirty = 1;
+    LpnSched* s = t->sched;
+    if (s->parallel)
+      s->group_dirty[t->group].push_back(t);
+    else
+      s->dirty.push_back(t);
+  }
+  for (auto& w : net_watchers)
+    w.first->mark(w.second);
+}
+
 int check_token_requirement(BasePlace* self, int num);
 int able_to_fire_t(Transition* self, uint64_t& enabled_ts);
 void fire(BasePlace* self, int num);
@@ -167,5 +484,6 @@ int sync(Transition* self, uint64_t time);
 int trigger_for_path(Transition* self);
 int sync_for_path(Transition* self);
 void detect_conflicting_Transition_groups(Transition** t_list, int size, std::set<BasePlace*>& p_list, int* conflict_free);
+int detect_conflict_free_groups(Transition** t_list, int size, int* group);
 
 #endif
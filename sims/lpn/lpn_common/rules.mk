@@ -23,10 +23,16 @@
 include mk/subdir_pre.mk
 
 lib_lpnsim := $(d)liblpnsim.a
+bin_lpn_soak := $(d)lpn_soak
 
 OBJS := $(addprefix $(d),lpn_sim.o place_transition.o)
 
 $(lib_lpnsim): $(OBJS)
 
-CLEAN := $(lib_lpnsim) $(OBJS)
+# token pool soak test, run manually
+$(bin_lpn_soak): $(d)lpn_soak.o $(lib_lpnsim) -lpthread
+DEPS := $(d)lpn_soak.d
+
+CLEAN := $(lib_lpnsim) $(bin_lpn_soak) $(OBJS) $(d)lpn_soak.o
+ALL := $(bin_lpn_soak)
 include mk/subdir_post.mk
@@ -0,0 +1,381 @@
+#ifndef __LPN_STATIC_NET__
+#define __LPN_STATIC_NET__
+#include <bits/stdint-uintn.h>
+#include <algorithm>
+#include <string>
+#include <tuple>
+#include <utility>
+#include "place_transition.hh"
+
+// Compile-time specialized counterpart of Transition and the lpn_sim.hh
+// engine. Places, weights, guards, delays and output functions are part of
+// the transition's type, so checking and firing a transition compiles down to
+// direct (inlinable) calls instead of std::function and virtual BasePlace
+// calls. The runtime Transition stays for nets that are still being
+// prototyped.
+//
+// A net is declared as:
+//   auto t1 = lpn::MakeTransition("t1", delay,
+//       lpn::Inputs(lpn::In(p0, weight), lpn::In(p1, weight, 2, guard)),
+//       lpn::Outputs(lpn::Out(p2, output)));
+//   auto net = lpn::MakeNet(t0, t1);
+// and driven with the NextCommitTime/CommitAtTime/UpdateClk overloads below.
+// Output functions should take their place as `auto*` to get the concrete
+// Place type.
+
+namespace lpn {
+
+struct NoGuard {
+  constexpr bool operator()() const {
+    return true;
+  }
+};
+
+// input arc: place, number of tokens taken (weight), number of tokens
+// required to fire if different from the weight (threshold, -2 for "place is
+// empty") and guard
+template<typename P, typename W, typename G>
+struct InArc {
+  P& place;
+  W weight;
+  int threshold;
+  G guard;
+};
+
+template<typename P, typename F>
+struct OutArc {
+  P& place;
+  F output;
+};
+
+template<typename P, typename W>
+InArc<P, W, NoGuard> In(P& place, W weight, int threshold = 0) {
+  return {place, std::move(weight), threshold, NoGuard()};
+}
+
+template<typename P, typename W, typename G>
+InArc<P, W, G> In(P& place, W weight, int threshold, G guard) {
+  return {place, std::move(weight), threshold, std::move(guard)};
+}
+
+template<typename P, typename F>
+OutArc<P, F> Out(P& place, F output) {
+  return {place, std::move(output)};
+}
+
+template<typename... Arcs>
+std::tuple<Arcs...> Inputs(Arcs... arcs) {
+  return std::tuple<Arcs...>(std::move(arcs)...);
+}
+
+template<typename... Arcs>
+std::tuple<Arcs...> Outputs(Arcs... arcs) {
+  return std::tuple<Arcs...>(std::move(arcs)...);
+}
+
+template<typename D, typename Ins, typename Outs>
+struct StaticTransition;
+
+template<typename D, typename... Ins, typename... Outs>
+struct StaticTransition<D, std::tuple<Ins...>, std::tuple<Outs...>> {
+  std::string id;
+  D delay_f;
+  std::tuple<Ins...> p_input;
+  std::tuple<Outs...> p_output;
+
+  // tokens to consume per input, filled by able_to_fire_t
+  int consume_tokens[sizeof...(Ins) > 0 ? sizeof...(Ins) : 1] = {0};
+
+  uint64_t delay_event = LARGE;
+  int disable = 0;
+  int pip = -1;
+  uint64_t pip_ts = 0;
+  int count = 0;
+  uint64_t time = 0;
+
+  // scheduling state, see NetSched
+  // enabled, but delay_f returned LARGE
+  int blocked = 0;
+  // clock update of the scheduler last applied to time
+  uint64_t time_seq = 0;
+};
+
+template<typename D, typename Ins, typename Outs>
+StaticTransition<D, Ins, Outs> MakeTransition(std::string id, D delay_f,
+                                              Ins p_input, Outs p_output) {
+  return {std::move(id), std::move(delay_f), std::move(p_input),
+          std::move(p_output)};
+}
+
+template<typename A>
+inline bool check_input(A& arc, int& consume, uint64_t& max_ts) {
+  int consume_real = arc.weight();
+  int consume_threshold = arc.threshold == 0 ? consume_real : arc.threshold;
+  consume = consume_real;
+  int len = arc.place.tokens.size();
+  if (consume_threshold == -2 ? len != 0 : len < consume_threshold)
+    return false;
+  if (consume_threshold > 0)
+    max_ts = std::max(max_ts, arc.place.tokens.ts(consume_threshold - 1));
+  return arc.guard();
+}
+
+template<typename T, size_t... I>
+inline bool able_to_fire_inputs(T& self, uint64_t& max_ts,
+                                std::index_sequence<I...>) {
+  return (check_input(std::get<I>(self.p_input), self.consume_tokens[I],
+                      max_ts) && ...);
+}
+
+template<typename D, typename... Ins, typename... Outs>
+inline int able_to_fire_t(
+    StaticTransition<D, std::tuple<Ins...>, std::tuple<Outs...>>& self,
+    uint64_t& enabled_ts) {
+  uint64_t max_ts = self.time;
+  if (!able_to_fire_inputs(self, max_ts, std::index_sequence_for<Ins...>()))
+    return 0;
+  enabled_ts = max_ts;
+  return 1;
+}
+
+template<typename T, size_t... I>
+inline void fire_inputs(T& self, std::index_sequence<I...>) {
+  auto fire_one = [](auto& arc, int num) {
+    for (int i = 0; i < num; i++)
+      arc.place.popToken();
+  };
+  (fire_one(std::get<I>(self.p_input), self.consume_tokens[I]), ...);
+}
+
+template<typename D, typename... Ins, typename... Outs>
+inline void fire_t(
+    StaticTransition<D, std::tuple<Ins...>, std::tuple<Outs...>>& self) {
+  fire_inputs(self, std::index_sequence_for<Ins...>());
+}
+
+template<typename D, typename... Ins, typename... Outs>
+inline void accept_t(
+    StaticTransition<D, std::tuple<Ins...>, std::tuple<Outs...>>& self) {
+  uint64_t ts = self.delay_event;
+  auto accept_one = [ts](auto& arc) {
+    size_t ori_size = arc.place.tokens.size();
+    arc.output(&arc.place);
+    size_t new_size = arc.place.tokens.size();
+    for (size_t i = ori_size; i < new_size; i++)
+      arc.place.tokens.ts(i) = ts;
+  };
+  std::apply([&](auto&... arcs) { (accept_one(arcs), ...); }, self.p_output);
+}
+
+template<typename D, typename Ins, typename Outs>
+inline int trigger(StaticTransition<D, Ins, Outs>& self) {
+  if (self.delay_event != LARGE)
+    return 1;
+  self.blocked = 0;
+  if (self.disable)
+    return 0;
+  uint64_t enabled = 0;
+  int can_fire = able_to_fire_t(self, enabled);
+  if (can_fire) {
+    uint64_t delay_time = self.delay_f();
+    // disabled when the delay is largest
+    if (delay_time == LARGE) {
+      self.blocked = 1;
+      return 0;
+    }
+
+    uint64_t enable_time = std::max(enabled, self.pip_ts);
+    uint64_t mature_time = enable_time + delay_time;
+    if (self.pip != -1) {
+      self.pip_ts = enable_time + self.pip;
+    } else {
+      self.pip_ts = mature_time;
+    }
+    self.delay_event = mature_time;
+  }
+  return can_fire;
+}
+
+template<typename D, typename Ins, typename Outs>
+inline int sync(StaticTransition<D, Ins, Outs>& self, uint64_t time) {
+  if (self.delay_event == LARGE) {
+    self.time = time;
+    return 0;
+  }
+  if (time >= self.delay_event) {
+    self.count++;
+    accept_t(self);
+    fire_t(self);
+    self.delay_event = LARGE;
+    return 1;
+  }
+  return 0;
+}
+
+// Fixed set of StaticTransitions, evaluated in declaration order like t_list.
+// Scheduled incrementally like the runtime engine (see LpnSched): only
+// transitions whose places changed and those blocked on state outside the net
+// are re-evaluated, enabled ones wait in a min-heap. The places learn their
+// transitions on first use, so the net must not move once it is driven.
+// Parallel firing (LpnSetParallel) is only available on the runtime engine.
+template<typename... Ts>
+struct Net {
+  std::tuple<Ts&...> t_list;
+  NetSched sched;
+  explicit Net(Ts&... ts) : t_list(ts...) {}
+  Net(const Net&) = delete;
+  Net& operator=(const Net&) = delete;
+};
+
+template<typename... Ts>
+Net<Ts...> MakeNet(Ts&... ts) {
+  return Net<Ts...>(ts...);
+}
+
+// call f on the transition at position i
+template<typename N, typename F, size_t... I>
+inline void visit_at(N& net, int i, F& f, std::index_sequence<I...>) {
+  using Fn = void (*)(N&, F&);
+  static constexpr Fn table[] = {
+      [](N& n, F& g) { g(std::get<I>(n.t_list)); }...};
+  table[i](net, f);
+}
+
+template<typename... Ts, typename F>
+inline void visit_at(Net<Ts...>& net, int i, F& f) {
+  visit_at(net, i, f, std::index_sequence_for<Ts...>());
+}
+
+template<typename... Ts>
+NetSched& get_sched(Net<Ts...>& net) {
+  NetSched& s = net.sched;
+  if (s.ready)
+    return s;
+  s.ready = true;
+  s.is_dirty.assign(sizeof...(Ts), 1);
+  int i = 0;
+  auto setup = [&s, &i](auto& t) {
+    t.time_seq = 0;
+    t.blocked = 0;
+    s.dirty.push_back(i);
+    if (t.delay_event != LARGE)
+      s.events.push({t.delay_event, i});
+
+    // guards may look at the output places too (e.g. psDrain_is_empty)
+    auto watch = [&s, i](auto& arc) {
+      auto& w = arc.place.net_watchers;
+      std::pair<NetSched*, int> e(&s, i);
+      if (std::find(w.begin(), w.end(), e) == w.end())
+        w.push_back(e);
+    };
+    std::apply([&](auto&... arcs) { (watch(arcs), ...); }, t.p_input);
+    std::apply([&](auto&... arcs) { (watch(arcs), ...); }, t.p_output);
+    i++;
+  };
+  std::apply([&](auto&... ts) { (setup(ts), ...); }, net.t_list);
+  return s;
+}
+
+// apply the clock updates since t was last looked at: idle transitions take
+// every update, busy ones only those from UpdateClk
+template<typename T>
+inline void sync_time(NetSched& s, T& t) {
+  if (t.delay_event == LARGE) {
+    if (s.seq > t.time_seq)
+      t.time = s.clk;
+  } else {
+    if (s.upd_seq > t.time_seq)
+      t.time = s.upd_clk;
+  }
+  t.time_seq = s.seq;
+}
+
+template<typename... Ts>
+uint64_t NextCommitTime(Net<Ts...>& net) {
+  NetSched& s = get_sched(net);
+
+  // blocked transitions wait on state outside the net (e.g. DMA data)
+  for (int i : s.blocked)
+    s.mark(i);
+  s.blocked.clear();
+
+  // evaluate in list order, as delay functions can have side effects
+  s.todo.swap(s.dirty);
+  std::sort(s.todo.begin(), s.todo.end());
+  int cur = 0;
+  auto eval = [&s, &cur](auto& t) {
+    if (t.delay_event != LARGE)
+      return;
+    sync_time(s, t);
+    trigger(t);
+    if (t.delay_event != LARGE)
+      s.events.push({t.delay_event, cur});
+    else if (t.blocked)
+      s.blocked.push_back(cur);
+  };
+  for (int i : s.todo) {
+    s.is_dirty[i] = 0;
+    cur = i;
+    visit_at(net, i, eval);
+  }
+  s.todo.clear();
+
+  // drop entries of transitions committed or reset since
+  uint64_t delay_event = LARGE;
+  auto get = [&delay_event](auto& t) { delay_event = t.delay_event; };
+  while (!s.events.empty()) {
+    auto& top = s.events.top();
+    visit_at(net, top.second, get);
+    if (delay_event == top.first)
+      return top.first;
+    s.events.pop();
+  }
+  return LARGE;
+}
+
+template<typename... Ts>
+int CommitAtTime(Net<Ts...>& net, uint64_t time) {
+  NetSched& s = get_sched(net);
+  s.clk = time;
+  s.seq++;
+
+  uint64_t delay_event = LARGE;
+  auto get = [&delay_event](auto& t) { delay_event = t.delay_event; };
+  while (!s.events.empty() && s.events.top().first <= time) {
+    auto top = s.events.top();
+    s.events.pop();
+    visit_at(net, top.second, get);
+    if (delay_event == top.first)
+      s.due.push_back(top.second);
+  }
+  std::sort(s.due.begin(), s.due.end());
+  s.due.erase(std::unique(s.due.begin(), s.due.end()), s.due.end());
+  auto commit = [&s, time](auto& t) {
+    sync_time(s, t);
+    sync(t, time);
+  };
+  for (int i : s.due)
+    visit_at(net, i, commit);
+  s.due.clear();
+  return 0;
+}
+
+// need to let outside world to update lpn clk
+template<typename... Ts>
+void UpdateClk(Net<Ts...>& net, uint64_t clk) {
+  NetSched& s = get_sched(net);
+  s.clk = s.upd_clk = clk;
+  s.upd_seq = ++s.seq;
+}
+
+template<typename... Ts>
+void TransitionCountLog(Net<Ts...>& net) {
+  // std::apply([](auto&... ts) {
+  //   ((std::cerr << "Transition:" << ts.id << " commit count=" << ts.count
+  //               << "\n"), ...);
+  // }, net.t_list);
+}
+
+}  // namespace lpn
+
+#endif
@@ -11,6 +11,8 @@
 #include <memory>
 #include <mutex>
 #include <deque>
+#include <thread>
+#include <utility>
 #include <vector>
 
 // TODO Rename MATCH Interface
@@ -43,8 +45,6 @@ typedef struct MemReq {
 typedef struct DramReq : MemReq {
 } DramReq;
 
-extern std::map<int, std::deque<std::unique_ptr<MemReq>>> io_req_map;
-
 void setupReqQueues(const std::vector<int>& ids);
 void ClearReqQueues(const std::vector<int>& ids);
 
@@ -193,11 +193,28 @@ void getData(CtlVar& ctrl, uint64_t addr, uint32_t len, int tag, int rw);
 int getDataNB(CtlVar& ctrl, uint64_t addr, uint32_t len, int tag, int rw);
 void putData(uint64_t addr, uint32_t len, int tag, int rw, uint64_t ts, void* buffer);
 
+// Request queues of one VTA instance, shared by the behavioral model and its
+// functional simulator threads. Every thread of an instance points req_ctx at
+// the same context, so that several instances can run in one process.
+struct ReqContext {
+  std::map<int, std::deque<std::unique_ptr<MemReq>>> io_req_map;
+  CtlVar ctl_func;
+  CtlVar ctl_iogen;
+  CtlVar ctl_nb_lpn;
+  int num_instr = 0;
+};
 
-extern CtlVar ctl_func;
-extern CtlVar ctl_iogen;
-extern CtlVar ctl_nb_lpn;
-
-extern int num_instr;
+extern thread_local ReqContext* req_ctx;
+
+// Starts a thread that runs f(args...) with the context of the caller.
+template <typename F, typename... Args>
+std::thread ReqContextThread(F&& f, Args&&... args) {
+  return std::thread(
+      [ctx = req_ctx](auto&& fn, auto&&... fn_args) {
+        req_ctx = ctx;
+        fn(std::forward<decltype(fn_args)>(fn_args)...);
+      },
+      std::forward<F>(f), std::forward<Args>(args)...);
+}
 
 #endif
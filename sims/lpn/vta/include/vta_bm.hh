@@ -1,10 +1,21 @@
 #pragma once
 
+#include <thread>
+#include <vector>
+
 #include <simbricks/pciebm/pciebm.hh>
 
+#include "lpn_req_map.hh"
+#include "vta/driver.h"
+#include "vta/io_gen.h"
 #include "vta_regs.hh"
 
-#define DMA_BLOCK_SIZE 2048
+struct VTADmaWriteOp : public pciebm::DMAOp {
+  VTADmaWriteOp(uint64_t dma_addr, size_t len, uint32_t tag=0)
+      : pciebm::DMAOp{tag, true, dma_addr, len, nullptr} {
+  }
+  std::vector<uint8_t> buffer;
+};
 
 class VTABm : public pciebm::PcieBM {
   void SetupIntro(struct SimbricksProtoPcieDevIntro &dev_intro) override;
@@ -16,34 +27,36 @@ class VTABm : public pciebm::PcieBM {
 
   void DmaComplete(std::unique_ptr<pciebm::DMAOp> dma_op) override;
 
-  void ExecuteEvent(std::unique_ptr<pciebm::TimedEvent> evt) override;
+  void DmaReadBorrowed(pciebm::DMAOp &dma_op, size_t offset, const void *data,
+                       size_t len) override;
+
+  void ExecuteEvent(pciebm::TimedEvent &evt) override;
 
   void DevctrlUpdate(struct SimbricksProtoPcieH2DDevctrl &devctrl) override;
 
  private:
   VTARegs Registers_;
   uint64_t BytesRead_;
+  /* request queues shared with the functional simulator threads */
+  ReqContext req_ctx_;
+  VTADeviceHandle func_device_;
+  VTAIOGenHandle io_generator_;
+  std::thread io_generator_thread_;
+  std::thread func_thread_;
+  double start_time_;
+  uint64_t in_flight_write_ = 0;
+  /* runs the LPN at its next commit time */
+  pciebm::TimedEvent lpn_evt_;
+  /* completed DMA operations, reused for new requests. Reads have no buffer
+   * as their data is consumed in place from the completion. */
+  std::vector<std::unique_ptr<pciebm::DMAOp>> read_ops_;
+  std::vector<std::unique_ptr<VTADmaWriteOp>> write_ops_;
+
+  void DmaIssueRead(uint64_t addr, size_t len, uint32_t tag);
+  void DmaIssueWrite(uint64_t addr, size_t len, uint32_t tag,
+                     const void *data);
+  void DmaOpFree(std::unique_ptr<pciebm::DMAOp> dma_op);
 
  public:
-  VTABm() : pciebm::PcieBM(16) {
-  }
-};
-
-template <uint64_t BufferLen>
-struct VTADmaReadOp : public pciebm::DMAOp {
-  VTADmaReadOp(uint64_t dma_addr, size_t len, uint32_t tag=0)
-      : pciebm::DMAOp{tag, false, dma_addr, len, buffer_} {
-  }
-
- private:
-  uint8_t buffer_[BufferLen];
-};
-
-struct VTADmaWriteOp : public pciebm::DMAOp {
-  VTADmaWriteOp(uint64_t dma_addr, size_t len, uint32_t tag=0)
-      : pciebm::DMAOp{tag, true, dma_addr, len, buffer} {
-    assert(len <= sizeof(buffer) && "len must be <= than buffer size");
-  }
-  bool last_block;
-  uint8_t buffer[DMA_BLOCK_SIZE];
+  VTABm();
 };
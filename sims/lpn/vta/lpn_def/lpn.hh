@@ -21,14 +21,14 @@ namespace lpnvta {
 }
 
 
-int outstanding = 0;
-int acc_bytes[10] = {0};
-int end_times[10] = {0};
-int start_times[10] = {0};
+thread_local int outstanding = 0;
+thread_local int acc_bytes[10] = {0};
+thread_local int end_times[10] = {0};
+thread_local int start_times[10] = {0};
 
 
 int issue_mem_op(int tag){
-    auto& reqs = io_req_map[tag];
+    auto& reqs = req_ctx->io_req_map[tag];
     int batch_id = -1;
     auto it = reqs.begin();
     
@@ -114,20 +114,20 @@ int issue_mem_op(int tag){
     new_req->len = len_; \
     enqueueReq(lpn_req_map[id_], std::move(new_req));
 
-std::function<int()> con_edge(int constant) {
+auto con_edge(int constant) {
     auto weight = [&, constant]() -> int {
         return constant;
     };
     return weight;
 };
-std::function<int()> take_1_token() {
+auto take_1_token() {
     auto number_of_token = [&]() -> int {
         return 1;
     };
     return number_of_token;
 };
 template<typename T>
-std::function<int()> take_dep_pop_prev(Place<T>& dependent_place) {
+auto take_dep_pop_prev(Place<T>& dependent_place) {
     auto number_of_token = [&]() -> int {
         auto key = dependent_place.tokens[0]->pop_prev;
         if (key == 1) {
@@ -156,7 +156,7 @@ std::function<int()> take_dep_pop_prev(Place<T>& dependent_place) {
 // };
 
 template<typename T>
-std::function<int()> take_dep_pop_next(Place<T>& dependent_place) {
+auto take_dep_pop_next(Place<T>& dependent_place) {
     auto number_of_token = [&]() -> int {
         auto key = dependent_place.tokens[0]->pop_next;
         if (key == 1) {
@@ -169,21 +169,21 @@ std::function<int()> take_dep_pop_next(Place<T>& dependent_place) {
     return number_of_token;
 };
 template<typename T>
-std::function<int()> take_readLen(Place<T>& dependent_place) {
+auto take_readLen(Place<T>& dependent_place) {
     auto number_of_token = [&]() -> int {
         auto key = dependent_place.tokens[0]->insn_count;
         return key;
     };
     return number_of_token;
 };
-std::function<int()> take_some_token(int number) {
+auto take_some_token(int number) {
     auto number_of_token = [&, number]() -> int {
         return number;
     };
     return number_of_token;
 };
-std::function<void(BasePlace*)> output_insn_read_cmd() {
-    auto output_token = [&](BasePlace* output_place) -> void {
+auto output_insn_read_cmd() {
+    auto output_token = [&](auto* output_place) -> void {
         auto total_insn = plaunch.tokens[0]->total_insn;
         auto max_insn = 128;
         auto ites = (total_insn / max_insn);
@@ -204,8 +204,8 @@ std::function<void(BasePlace*)> output_insn_read_cmd() {
     return output_token;
 };
 template<typename T>
-std::function<void(BasePlace*)> pass_var_token_readLen(Place<T>& from_place) {
-    auto output_token = [&](BasePlace* output_place) -> void {
+auto pass_var_token_readLen(Place<T>& from_place) {
+    auto output_token = [&](auto* output_place) -> void {
         auto num = psReadCmd.tokens[0]->insn_count;
         for (int i = 0; i < num; ++i) {
             auto token = from_place.tokens[i];
@@ -215,8 +215,8 @@ std::function<void(BasePlace*)> pass_var_token_readLen(Place<T>& from_place) {
     return output_token;
 };
 template<typename T>
-std::function<void(BasePlace*)> pass_token(Place<T>& from_place, int num) {
-    auto output_token = [&, num](BasePlace* output_place) -> void {
+auto pass_token(Place<T>& from_place, int num) {
+    auto output_token = [&, num](auto* output_place) -> void {
         for (int i = 0; i < num; ++i) {
             auto token = from_place.tokens[i];
             output_place->pushToken(token);
@@ -224,16 +224,16 @@ std::function<void(BasePlace*)> pass_token(Place<T>& from_place, int num) {
     };
     return output_token;
 };
-std::function<void(BasePlace*)> pass_empty_token() {
-    auto output_token = [&](BasePlace* output_place) -> void {
+auto pass_empty_token() {
+    auto output_token = [&](auto* output_place) -> void {
         NEW_TOKEN(EmptyToken, new_token);
         output_place->pushToken(new_token);
     };
     return output_token;
 };
 template<typename T>
-std::function<void(BasePlace*)> output_dep_push_prev(Place<T>& dependent_place) {
-    auto output_token = [&](BasePlace* output_place) -> void {
+auto output_dep_push_prev(Place<T>& dependent_place) {
+    auto output_token = [&](auto* output_place) -> void {
         auto direc = dependent_place.tokens[0]->push_prev;
         if (direc == 1) {
             NEW_TOKEN(EmptyToken, new_token);
@@ -243,8 +243,8 @@ std::function<void(BasePlace*)> output_dep_push_prev(Place<T>& dependent_place)
     return output_token;
 };
 template<typename T>
-std::function<void(BasePlace*)> output_dep_push_next(Place<T>& dependent_place) {
-    auto output_token = [&](BasePlace* output_place) -> void {
+auto output_dep_push_next(Place<T>& dependent_place) {
+    auto output_token = [&](auto* output_place) -> void {
         auto direc = dependent_place.tokens[0]->push_next;
         if (direc == 1) {
             NEW_TOKEN(EmptyToken, new_token);
@@ -253,14 +253,14 @@ std::function<void(BasePlace*)> output_dep_push_next(Place<T>& dependent_place)
     };
     return output_token;
 };
-std::function<bool()> empty_guard() {
+auto empty_guard() {
     auto guard = [&]() -> bool {
         return true;
     };
     return guard;
 };
 
-std::function<bool()> psDrain_is_empty() {
+auto psDrain_is_empty() {
     auto guard = [&]() -> bool {
         if(psDrain.tokensLen() == 0){
             return true;
@@ -271,7 +271,7 @@ std::function<bool()> psDrain_is_empty() {
 };
 
 template<typename T>
-std::function<bool()> take_opcode_token(Place<T>& dependent_place, int opcode) {
+auto take_opcode_token(Place<T>& dependent_place, int opcode) {
     auto guard = [&, opcode]() -> bool {
         auto key = dependent_place.tokens[0]->opcode;
         if (key != opcode) {
@@ -282,7 +282,7 @@ std::function<bool()> take_opcode_token(Place<T>& dependent_place, int opcode) {
     return guard;
 };
 template<typename T>
-std::function<bool()> take_subopcode_token(Place<T>& dependent_place, int subopcode) {
+auto take_subopcode_token(Place<T>& dependent_place, int subopcode) {
     auto guard = [&, subopcode]() -> bool {
         auto key = dependent_place.tokens[0]->subopcode;
         if (key != subopcode) {
@@ -293,7 +293,7 @@ std::function<bool()> take_subopcode_token(Place<T>& dependent_place, int subopc
     return guard;
 };
 
-std::function<uint64_t()> delay_t9() {
+auto delay_t9() {
     auto delay = [&]() -> uint64_t {
         int ret = issue_mem_op(LOAD_INSN);
         if(ret == 0){
@@ -320,13 +320,13 @@ std::function<uint64_t()> delay_t9() {
 };
 
 template<typename T>
-std::function<uint64_t()> delay_store(Place<T>& dependent_place) {
+auto delay_store(Place<T>& dependent_place) {
     auto delay = [&]() -> uint64_t {
         auto xsize = dependent_place.tokens[0]->xsize;
         auto ysize = dependent_place.tokens[0]->ysize;
         auto subopcode = dependent_place.tokens[0]->subopcode;
         if(subopcode == (int)ALL_ENUM::SYNC){
-            num_instr--;
+            req_ctx->num_instr--;
             return lpnvta::CYCLEPERIOD*2;
         }
 
@@ -355,7 +355,7 @@ std::function<uint64_t()> delay_store(Place<T>& dependent_place) {
 };
 
 
-std::function<uint64_t()> con_delay(uint64_t constant) {
+auto con_delay(uint64_t constant) {
     auto delay = [&, constant]() -> uint64_t {
         return lpnvta::CYCLEPERIOD*constant;
     };
@@ -363,7 +363,7 @@ std::function<uint64_t()> con_delay(uint64_t constant) {
 };
 
 template<typename T>
-std::function<int()> take_start_token(Place<T>& dependent_place) {
+auto take_start_token(Place<T>& dependent_place) {
     auto number_of_token = [&]() -> int {
         return 1;
     };
@@ -371,15 +371,15 @@ std::function<int()> take_start_token(Place<T>& dependent_place) {
 };
 
 template<typename T>
-std::function<void(BasePlace*)> output_launch_token(Place<T>& dependent_place) {
-    auto output_token = [&](BasePlace* output_place) -> void {
+auto output_launch_token(Place<T>& dependent_place) {
+    auto output_token = [&](auto* output_place) -> void {
         NEW_TOKEN(token_class_total_insn, launch_token);
         launch_token->total_insn = pstart.tokens[0]->insn_size/16;
         output_place->pushToken(launch_token);
         //std::cerr << "output_launch_token with length " << launch_token->total_insn << std::endl;
         return;
 
-        auto& reqs = ctl_nb_lpn.req_matcher[LOAD_INSN].reqs;
+        auto& reqs = req_ctx->ctl_nb_lpn.req_matcher[LOAD_INSN].reqs;
         auto& front = reqs.front();
         assert(front->acquired_len == front->len);
         //std::cerr << "output_launch_token with length " << front->len << std::endl;
@@ -393,10 +393,10 @@ std::function<void(BasePlace*)> output_launch_token(Place<T>& dependent_place) {
 };
 
 template<typename T>
-std::function<void(BasePlace*)> output_pnum_insn(Place<T>& dependent_place) {
-    auto output_token = [&](BasePlace* output_place) -> void {
+auto output_pnum_insn(Place<T>& dependent_place) {
+    auto output_token = [&](auto* output_place) -> void {
         auto num = psReadCmd.tokens[0]->insn_count;
-        auto& reqs = ctl_nb_lpn.req_matcher[LOAD_INSN].reqs;
+        auto& reqs = req_ctx->ctl_nb_lpn.req_matcher[LOAD_INSN].reqs;
         auto& front = reqs.front();
         assert(front->acquired_len == front->len);
         auto insn_len = front->len/16;
@@ -409,14 +409,14 @@ std::function<void(BasePlace*)> output_pnum_insn(Place<T>& dependent_place) {
             output_place->pushToken(MakeNumInsnToken(&insn));
         }
         reqs.erase(reqs.begin());
-        // dequeueReq(io_req_map[LOAD_INSN]);
+        // dequeueReq(req_ctx->io_req_map[LOAD_INSN]);
     };
     return output_token;
 };
 
 
 template<typename T>
-std::function<uint64_t()> delay_start(Place<T>& dependent_place) {
+auto delay_start(Place<T>& dependent_place) {
     auto delay = [&]() -> uint64_t {
         auto dram_addr = dependent_place.tokens[0]->addr;
         auto req_len = dependent_place.tokens[0]->insn_size; 
@@ -433,7 +433,7 @@ std::function<uint64_t()> delay_start(Place<T>& dependent_place) {
 }
 
 template<typename T>
-std::function<uint64_t()> delay_load(Place<T>& dependent_place) {
+auto delay_load(Place<T>& dependent_place) {
     auto delay = [&]() -> uint64_t {
         uint64_t insn_ptr = (uint64_t)&(dependent_place.tokens[0]->insn);
         auto subopcode = dependent_place.tokens[0]->subopcode;
@@ -442,7 +442,7 @@ std::function<uint64_t()> delay_load(Place<T>& dependent_place) {
         auto ysize = dependent_place.tokens[0]->ysize;
 
         if (subopcode == (int)ALL_ENUM::SYNC) {
-          num_instr--;
+          req_ctx->num_instr--;
           return lpnvta::CYCLEPERIOD * 2;
         }
 
@@ -486,7 +486,7 @@ uint64_t delay_gemm(Place<T>& dependent_place) {
     auto uop_end = dependent_place.tokens[0]->uop_end;
     auto lp_0 = dependent_place.tokens[0]->lp_0;
     auto lp_1 = dependent_place.tokens[0]->lp_1;
-    num_instr--;
+    req_ctx->num_instr--;
     return lpnvta::CYCLEPERIOD*((1 + 5) + (((uop_end - uop_begin) * lp_1) * lp_0));
 };
 template<typename T>
@@ -544,15 +544,15 @@ uint64_t delay_alu(Place<T>& dependent_place) {
     auto lp_0 = dependent_place.tokens[0]->lp_0;
     auto lp_1 = dependent_place.tokens[0]->lp_1;
     auto use_alu_imm = dependent_place.tokens[0]->use_alu_imm;
-    num_instr--;
+    req_ctx->num_instr--;
     return lpnvta::CYCLEPERIOD*((1 + 5) + ((((uop_end - uop_begin) * lp_1) * lp_0) * (2 - use_alu_imm)));
 };
 template<typename T>
-std::function<uint64_t()> delay_compute(Place<T>& dependent_place) {
+auto delay_compute(Place<T>& dependent_place) {
     auto delay = [&]() -> uint64_t {
         auto subopcode = dependent_place.tokens[0]->subopcode;
         if (subopcode == (int)ALL_ENUM::SYNC) {
-          num_instr--;
+          req_ctx->num_instr--;
           return lpnvta::CYCLEPERIOD * (1 + 1);
         }
         if (subopcode == (int)ALL_ENUM::ALU) {
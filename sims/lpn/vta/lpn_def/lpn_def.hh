@@ -2,13 +2,13 @@
 #define __VTA_LPN_DEF__
 #include <iostream>
 #include "sims/lpn/lpn_common/place_transition.hh"
+#include "sims/lpn/lpn_common/static_net.hh"
 #include "transitions.hh"
 #include "places.hh"
 
-#define T_SIZE 13
 #define P_SIZE 23
-Transition* t_list[T_SIZE] = { &tstart, &t13, &t9, &t12, &t14, &t15, &t16, &tload_launch, &tload_done, &tstore_launch, &tstore_done, &tcompute_launch, &tcompute_done };
-BasePlace* p_list[P_SIZE] = {
+thread_local auto lpn_net = lpn::MakeNet(tstart, t13, t9, t12, t14, t15, t16, tload_launch, tload_done, tstore_launch, tstore_done, tcompute_launch, tcompute_done);
+thread_local BasePlace* p_list[P_SIZE] = {
   &pstart, 
   &pcontrol_prime, 
   &pcontrol, 
@@ -35,14 +35,14 @@ BasePlace* p_list[P_SIZE] = {
 };
 
 
-void create_empty_queue(QT_type(EmptyToken*)* tokens, int num ){
+void create_empty_queue(Place<>* place, int num ){
   for(int i=0;i<num;i++){
     NEW_TOKEN(EmptyToken, x)
-    tokens->push_back(x);
+    place->pushToken(x);
   }
 }
 
-static int total_insn = 0;
+static thread_local int total_insn = 0;
 int lpn_finished(){
   if (pload_done.tokensLen()+pstore_done.tokensLen()+pcompute_done.tokensLen() == total_insn) {
     total_insn = 0;
@@ -51,7 +51,7 @@ int lpn_finished(){
   return 0;
 }
 
-static bool lpn_started = false;
+static thread_local bool lpn_started = false;
 
 void lpn_end(){
   lpn_started = false;
@@ -62,26 +62,26 @@ void lpn_reset(){
   for (int i = 0; i < P_SIZE; i++) {
     p_list[i]->reset();
   }
-  create_empty_queue(&(pcompute_cap.tokens), 512);  
-  create_empty_queue(&(pload_cap.tokens), 512);  
-  create_empty_queue(&(pstore_cap.tokens), 512);  
-  create_empty_queue(&(pcontrol.tokens), 1);  
+  create_empty_queue(&pcompute_cap, 512);  
+  create_empty_queue(&pload_cap, 512);  
+  create_empty_queue(&pstore_cap, 512);  
+  create_empty_queue(&pcontrol, 1);  
 }
 
 void lpn_init(){
-  static int init_done = 0;
+  static thread_local int init_done = 0;
   if (init_done) assert(0);
   if(!init_done){
     init_done = 1;
-    create_empty_queue(&(pcompute_cap.tokens), 512);  
-    create_empty_queue(&(pload_cap.tokens), 512);  
-    create_empty_queue(&(pstore_cap.tokens), 512);  
+    create_empty_queue(&pcompute_cap, 512);  
+    create_empty_queue(&pload_cap, 512);  
+    create_empty_queue(&pstore_cap, 512);  
 //   collect_insns(&(pnumInsn.tokens), benchmark);
 
     // NEW_TOKEN(token_class_total_insn, numInstToken);
     // numInstToken->total_insn = pnumInsn.tokens.size();
     // plaunch.tokens.push_back(numInstToken);
-    create_empty_queue(&(pcontrol.tokens), 1);  
+    create_empty_queue(&pcontrol, 1);  
   }
 }
 
@@ -3,29 +3,29 @@
 #include "sims/lpn/lpn_common/place_transition.hh"
 #include "token_types.hh"
 
-extern Place<token_start> pstart;
+extern thread_local Place<token_start> pstart;
 
-extern Place<> pcontrol_prime;
-extern Place<> pcontrol;
-extern Place<token_class_insn_count> psReadCmd;
-extern Place<token_class_ostxyuullupppp> pnumInsn;
-extern Place<token_class_ostxyuullupppp> psDrain;
-extern Place<token_class_total_insn> plaunch;
-extern Place<> pload_cap;
-extern Place<token_class_ostxyuullupppp> pload_inst_q;
-extern Place<> pcompute_cap;
-extern Place<token_class_ostxyuullupppp> pcompute_inst_q;
-extern Place<> pstore_cap;
-extern Place<token_class_ostxyuullupppp> pstore_inst_q;
-extern Place<> pstore2compute;
-extern Place<> pload2compute;
-extern Place<token_class_ostxyuullupppp> pcompute_process;
-extern Place<> pcompute2store;
-extern Place<token_class_ostxyuullupppp> pstore_process;
-extern Place<> pcompute2load;
-extern Place<token_class_ostxyuullupppp> pload_process;
-extern Place<> pcompute_done;
-extern Place<> pstore_done;
-extern Place<> pload_done;
+extern thread_local Place<> pcontrol_prime;
+extern thread_local Place<> pcontrol;
+extern thread_local Place<token_class_insn_count> psReadCmd;
+extern thread_local Place<token_class_ostxyuullupppp> pnumInsn;
+extern thread_local Place<token_class_ostxyuullupppp> psDrain;
+extern thread_local Place<token_class_total_insn> plaunch;
+extern thread_local Place<> pload_cap;
+extern thread_local Place<token_class_ostxyuullupppp> pload_inst_q;
+extern thread_local Place<> pcompute_cap;
+extern thread_local Place<token_class_ostxyuullupppp> pcompute_inst_q;
+extern thread_local Place<> pstore_cap;
+extern thread_local Place<token_class_ostxyuullupppp> pstore_inst_q;
+extern thread_local Place<> pstore2compute;
+extern thread_local Place<> pload2compute;
+extern thread_local Place<token_class_ostxyuullupppp> pcompute_process;
+extern thread_local Place<> pcompute2store;
+extern thread_local Place<token_class_ostxyuullupppp> pstore_process;
+extern thread_local Place<> pcompute2load;
+extern thread_local Place<token_class_ostxyuullupppp> pload_process;
+extern thread_local Place<> pcompute_done;
+extern thread_local Place<> pstore_done;
+extern thread_local Place<> pload_done;
 
 #endif
\ No newline at end of file
@@ -3,127 +3,83 @@
 #include <stdlib.h>
 #include <functional>
 #include "sims/lpn/lpn_common/place_transition.hh"
+#include "sims/lpn/lpn_common/static_net.hh"
 #include "places.hh"
 #include "lpn.hh"
-Transition tstart = {
-    .id = "tstart",
-    .delay_f = delay_start(pstart), 
-    .p_input = {&pstart},
-    .pi_w = {take_start_token(pstart)},
-    .pi_w_threshold = {1},
-    .p_output = {&plaunch},
-    .po_w = {output_launch_token(pstart)}, 
-};
-Transition t13 = {
-    .id = "t13",
-    .delay_f = con_delay(1),
-    .p_input = {&plaunch},
-    .pi_w = {take_1_token()},
-    .pi_w_threshold = {0},
-    .p_output = {&psReadCmd},
-    .po_w = {output_insn_read_cmd()},
-};
-Transition t9 = {
-    .id = "t9",
-    .delay_f = delay_t9(),
-    .p_input = {&psReadCmd, &pcontrol},
-    .pi_w = {take_1_token(), take_1_token()},
-    .pi_w_threshold = {0, 0, 0},
-    .pi_guard = {psDrain_is_empty(), empty_guard()},
-    .p_output = {&psDrain, &pcontrol_prime},
-    .po_w = {output_pnum_insn(psReadCmd), pass_empty_token()},
-};
-Transition t12 = {
-    .id = "t12",
-    .delay_f = con_delay(1),
-    .p_input = {&pcontrol_prime},
-    .pi_w = {take_1_token()},
-    .pi_w_threshold = {0},
-    .p_output = {&pcontrol},
-    .po_w = {pass_empty_token()},
-};
-Transition t14 = {
-    .id = "t14",
-    .delay_f = con_delay(1),
-    .p_input = {&psDrain, &pload_cap},
-    .pi_w = {take_1_token(), take_1_token()},
-    .pi_w_threshold = {0, 0},
-    .pi_guard = {take_opcode_token(psDrain, (int)ALL_ENUM::LOAD), empty_guard()},
-    .p_output = {&pload_inst_q},
-    .po_w = {pass_token(psDrain, 1)},
-};
-Transition t15 = {
-    .id = "t15",
-    .delay_f = con_delay(1),
-    .p_input = {&psDrain, &pcompute_cap},
-    .pi_w = {take_1_token(), take_1_token()},
-    .pi_w_threshold = {0, 0},
-    .pi_guard = {take_opcode_token(psDrain, (int)ALL_ENUM::COMPUTE), empty_guard()},
-    .p_output = {&pcompute_inst_q},
-    .po_w = {pass_token(psDrain, 1)},
-};
-Transition t16 = {
-    .id = "t16",
-    .delay_f = con_delay(1),
-    .p_input = {&psDrain, &pstore_cap},
-    .pi_w = {take_1_token(), take_1_token()},
-    .pi_w_threshold = {0, 0},
-    .pi_guard = {take_opcode_token(psDrain, (int)ALL_ENUM::STORE), empty_guard()},
-    .p_output = {&pstore_inst_q},
-    .po_w = {pass_token(psDrain, 1)},
-};
-Transition tload_launch = {
-    .id = "tload_launch",
-    .delay_f = con_delay(0),
-    .p_input = {&pload_inst_q, &pcompute2load},
-    .pi_w = {take_1_token(), take_dep_pop_next(pload_inst_q)},
-    .pi_w_threshold = {0, 0},
-    .p_output = {&pload_process},
-    .po_w = {pass_token(pload_inst_q, 1)},
-};
-Transition tload_done = {
-    .id = "load_done",
-    .delay_f = delay_load(pload_process),
-    .p_input = {&pload_process},
-    .pi_w = {take_1_token()},
-    .pi_w_threshold = {0},
-    .p_output = {&pload_done, &pload2compute, &pload_cap},
-    .po_w = {pass_empty_token(), output_dep_push_next(pload_process), pass_empty_token()},
-};
-Transition tstore_launch = {
-    .id = "store_launch",
-    .delay_f = con_delay(0),
-    .p_input = {&pstore_inst_q, &pcompute2store},
-    .pi_w = {take_1_token(), take_dep_pop_prev(pstore_inst_q)},
-    .pi_w_threshold = {0, 0},
-    .p_output = {&pstore_process},
-    .po_w = {pass_token(pstore_inst_q, 1)},
-};
-Transition tstore_done = {
-    .id = "store_done",
-    .delay_f = delay_store(pstore_process),
-    .p_input = {&pstore_process},
-    .pi_w = {take_1_token()},
-    .pi_w_threshold = {0},
-    .p_output = {&pstore_done, &pstore2compute, &pstore_cap},
-    .po_w = {pass_empty_token(), output_dep_push_prev(pstore_process), pass_empty_token()},
-};
-Transition tcompute_launch = {
-    .id = "compute_launch",
-    .delay_f = con_delay(0),
-    .p_input = {&pcompute_inst_q, &pstore2compute, &pload2compute},
-    .pi_w = {take_1_token(), take_dep_pop_next(pcompute_inst_q), take_dep_pop_prev(pcompute_inst_q)},
-    .pi_w_threshold = {0, 0, 0},
-    .p_output = {&pcompute_process},
-    .po_w = {pass_token(pcompute_inst_q, 1)},
-};
-Transition tcompute_done = {
-    .id = "compute_done",
-    .delay_f = delay_compute(pcompute_process),
-    .p_input = {&pcompute_process},
-    .pi_w = {take_1_token()},
-    .pi_w_threshold = {0},
-    .p_output = {&pcompute_done, &pcompute2load, &pcompute2store, &pcompute_cap},
-    .po_w = {pass_empty_token(), output_dep_push_prev(pcompute_process), output_dep_push_next(pcompute_process), pass_empty_token()},
-};
-#endif
\ No newline at end of file
+using lpn::In;
+using lpn::Inputs;
+using lpn::Out;
+using lpn::Outputs;
+
+thread_local auto tstart = lpn::MakeTransition("tstart",
+    delay_start(pstart),
+    Inputs(In(pstart, take_start_token(pstart), 1)),
+    Outputs(Out(plaunch, output_launch_token(pstart))));
+thread_local auto t13 = lpn::MakeTransition("t13",
+    con_delay(1),
+    Inputs(In(plaunch, take_1_token())),
+    Outputs(Out(psReadCmd, output_insn_read_cmd())));
+thread_local auto t9 = lpn::MakeTransition("t9",
+    delay_t9(),
+    Inputs(In(psReadCmd, take_1_token(), 0, psDrain_is_empty()),
+           In(pcontrol, take_1_token(), 0, empty_guard())),
+    Outputs(Out(psDrain, output_pnum_insn(psReadCmd)),
+            Out(pcontrol_prime, pass_empty_token())));
+thread_local auto t12 = lpn::MakeTransition("t12",
+    con_delay(1),
+    Inputs(In(pcontrol_prime, take_1_token())),
+    Outputs(Out(pcontrol, pass_empty_token())));
+thread_local auto t14 = lpn::MakeTransition("t14",
+    con_delay(1),
+    Inputs(In(psDrain, take_1_token(), 0,
+              take_opcode_token(psDrain, (int)ALL_ENUM::LOAD)),
+           In(pload_cap, take_1_token(), 0, empty_guard())),
+    Outputs(Out(pload_inst_q, pass_token(psDrain, 1))));
+thread_local auto t15 = lpn::MakeTransition("t15",
+    con_delay(1),
+    Inputs(In(psDrain, take_1_token(), 0,
+              take_opcode_token(psDrain, (int)ALL_ENUM::COMPUTE)),
+           In(pcompute_cap, take_1_token(), 0, empty_guard())),
+    Outputs(Out(pcompute_inst_q, pass_token(psDrain, 1))));
+thread_local auto t16 = lpn::MakeTransition("t16",
+    con_delay(1),
+    Inputs(In(psDrain, take_1_token(), 0,
+              take_opcode_token(psDrain, (int)ALL_ENUM::STORE)),
+           In(pstore_cap, take_1_token(), 0, empty_guard())),
+    Outputs(Out(pstore_inst_q, pass_token(psDrain, 1))));
+thread_local auto tload_launch = lpn::MakeTransition("tload_launch",
+    con_delay(0),
+    Inputs(In(pload_inst_q, take_1_token()),
+           In(pcompute2load, take_dep_pop_next(pload_inst_q))),
+    Outputs(Out(pload_process, pass_token(pload_inst_q, 1))));
+thread_local auto tload_done = lpn::MakeTransition("load_done",
+    delay_load(pload_process),
+    Inputs(In(pload_process, take_1_token())),
+    Outputs(Out(pload_done, pass_empty_token()),
+            Out(pload2compute, output_dep_push_next(pload_process)),
+            Out(pload_cap, pass_empty_token())));
+thread_local auto tstore_launch = lpn::MakeTransition("store_launch",
+    con_delay(0),
+    Inputs(In(pstore_inst_q, take_1_token()),
+           In(pcompute2store, take_dep_pop_prev(pstore_inst_q))),
+    Outputs(Out(pstore_process, pass_token(pstore_inst_q, 1))));
+thread_local auto tstore_done = lpn::MakeTransition("store_done",
+    delay_store(pstore_process),
+    Inputs(In(pstore_process, take_1_token())),
+    Outputs(Out(pstore_done, pass_empty_token()),
+            Out(pstore2compute, output_dep_push_prev(pstore_process)),
+            Out(pstore_cap, pass_empty_token())));
+thread_local auto tcompute_launch = lpn::MakeTransition("compute_launch",
+    con_delay(0),
+    Inputs(In(pcompute_inst_q, take_1_token()),
+           In(pstore2compute, take_dep_pop_next(pcompute_inst_q)),
+           In(pload2compute, take_dep_pop_prev(pcompute_inst_q))),
+    Outputs(Out(pcompute_process, pass_token(pcompute_inst_q, 1))));
+thread_local auto tcompute_done = lpn::MakeTransition("compute_done",
+    delay_compute(pcompute_process),
+    Inputs(In(pcompute_process, take_1_token())),
+    Outputs(Out(pcompute_done, pass_empty_token()),
+            Out(pcompute2load, output_dep_push_prev(pcompute_process)),
+            Out(pcompute2store, output_dep_push_next(pcompute_process)),
+            Out(pcompute_cap, pass_empty_token())));
+#endif
@@ -36,8 +36,18 @@ $(bin_vta_bm): CPPFLAGS += -O3
 $(bin_vta_bm):$(bm_objs) $(lib_pciebm) $(lib_pcie) $(lib_base) \
 	$(lib_lpnsim) -lpthread
 
-CLEAN := $(bin_vta_bm) $(bm_objs)
+# LPN benchmark on an instruction trace, run manually
+bin_vta_lpn_bench := $(d)vta_lpn_bench
+bench_objs := $(addprefix $(d), vta_lpn_bench.o src/lpn_req_map.o \
+	lpn_def/places.o)
 
-ALL := $(bin_vta_bm)
+$(bin_vta_lpn_bench): CPPFLAGS += -O3
+$(bin_vta_lpn_bench): $(bench_objs) $(lib_lpnsim) -lpthread
+
+OBJS := $(bm_objs) $(d)vta_lpn_bench.o
+
+CLEAN := $(bin_vta_bm) $(bin_vta_lpn_bench) $(OBJS)
+
+ALL := $(bin_vta_bm) $(bin_vta_lpn_bench)
 
 include mk/subdir_post.mk
@@ -179,11 +179,11 @@ static const int kElemBytes = (kBits * kLane + 7) / 8;
       #ifdef DEBUG_FUNC_SIM
       std::cout << "Func-sim request: " << tag << " " << (uint64_t)dram_ptr << " " << kElemBytes * op->x_size << " " << kElemBytes << " "<<  op->x_size<< std::endl;
       #endif
-      getData(ctl_func, (uint64_t)dram_ptr, kElemBytes * op->x_size, tag, READ_REQ);
+      getData(req_ctx->ctl_func, (uint64_t)dram_ptr, kElemBytes * op->x_size, tag, READ_REQ);
       #ifdef DEBUG_FUNC_SIM
       std::cout << "Func-sim request done" << std::endl;
       #endif
-      auto front = ctl_func.req_matcher[tag].Consume(); 
+      auto front = req_ctx->ctl_func.req_matcher[tag].Consume(); 
       // Adapt to code
       auto buffer = reinterpret_cast<uint8_t*>(front->buffer);
       memcpy(sram_ptr, buffer, kElemBytes * op->x_size);
@@ -413,8 +413,8 @@ class Device {
           uint32_t wait_cycles) {
     // Enqueue load request
     std::cout << "Func sim registered" << std::endl;
-    // getData(ctl_func, insn_phy_addr, insn_count * sizeof(VTAGenericInsn), LOAD_INSN, READ_REQ);
-    // auto req = ctl_func.req_matcher[LOAD_INSN].Consume();
+    // getData(req_ctx->ctl_func, insn_phy_addr, insn_count * sizeof(VTAGenericInsn), LOAD_INSN, READ_REQ);
+    // auto req = req_ctx->ctl_func.req_matcher[LOAD_INSN].Consume();
 
     // uint32_t insn_holder = 0;
     // std::cout << "Start Run insn" << std::endl;
@@ -426,8 +426,8 @@ class Device {
 
 
     for (int i = 0; i < ites; ++i) {
-      getData(ctl_func, insn_phy_addr+max_insn*sizeof(VTAGenericInsn)*i, max_insn * sizeof(VTAGenericInsn), LOAD_INSN, READ_REQ);
-      auto req = ctl_func.req_matcher[LOAD_INSN].Consume();
+      getData(req_ctx->ctl_func, insn_phy_addr+max_insn*sizeof(VTAGenericInsn)*i, max_insn * sizeof(VTAGenericInsn), LOAD_INSN, READ_REQ);
+      auto req = req_ctx->ctl_func.req_matcher[LOAD_INSN].Consume();
       uint32_t insn_holder = 0;
       // std::cout << "Funsim : Start Run insn" << std::endl;
       while (1) {
@@ -442,8 +442,8 @@ class Device {
     }
 
     if (remain > 0) {
-      getData(ctl_func, insn_phy_addr+max_insn*sizeof(VTAGenericInsn)*ites, remain * sizeof(VTAGenericInsn), LOAD_INSN, READ_REQ);
-      auto req = ctl_func.req_matcher[LOAD_INSN].Consume();
+      getData(req_ctx->ctl_func, insn_phy_addr+max_insn*sizeof(VTAGenericInsn)*ites, remain * sizeof(VTAGenericInsn), LOAD_INSN, READ_REQ);
+      auto req = req_ctx->ctl_func.req_matcher[LOAD_INSN].Consume();
       uint32_t insn_holder = 0;
       // std::cout << "Funsim : Start Run insn" << std::endl;
       while (1) {
@@ -459,11 +459,11 @@ class Device {
 
     // Notify wrapper of end
     {
-      std::unique_lock<std::mutex> lk(ctl_func.mx);
+      std::unique_lock<std::mutex> lk(req_ctx->ctl_func.mx);
       std::cout << "Funcsim Set finish to True!" << std::endl;
-      ctl_func.finished = true; 
-      ctl_func.blocked = false;
-      ctl_func.cv.notify_one();
+      req_ctx->ctl_func.finished = true; 
+      req_ctx->ctl_func.blocked = false;
+      req_ctx->ctl_func.cv.notify_one();
     }
 
     return 0;
@@ -722,8 +722,8 @@ VTADeviceHandle VTADeviceAlloc() {
 }
 
 void VTADeviceFree(VTADeviceHandle handle) {
-  ctl_func.finished = false;
-  ctl_func.blocked = false;
+  req_ctx->ctl_func.finished = false;
+  req_ctx->ctl_func.blocked = false;
   delete static_cast<vta::sim::Device*>(handle);
 }
 
@@ -44,7 +44,7 @@
 
 // #define DEBUG_IO_GEN
 
-static int id_counter = 0;
+static thread_local int id_counter = 0;
 namespace vta {
 namespace iogen {
 
@@ -370,8 +370,8 @@ class Device {
     }
 
     for (int i = 0; i < ites; ++i) {
-      getData(ctl_iogen, insn_phy_addr+max_insn*sizeof(VTAGenericInsn)*i, max_insn * sizeof(VTAGenericInsn), LOAD_INSN, READ_REQ);
-      auto req = ctl_iogen.req_matcher[LOAD_INSN].Consume();
+      getData(req_ctx->ctl_iogen, insn_phy_addr+max_insn*sizeof(VTAGenericInsn)*i, max_insn * sizeof(VTAGenericInsn), LOAD_INSN, READ_REQ);
+      auto req = req_ctx->ctl_iogen.req_matcher[LOAD_INSN].Consume();
       uint32_t insn_holder = 0;
       // std::cout << "Start Run insn" << std::endl;
       while (1) {
@@ -386,8 +386,8 @@ class Device {
     }
 
     if (remain > 0) {
-      getData(ctl_iogen, insn_phy_addr+max_insn*sizeof(VTAGenericInsn)*ites, remain * sizeof(VTAGenericInsn), LOAD_INSN, READ_REQ);
-      auto req = ctl_iogen.req_matcher[LOAD_INSN].Consume();
+      getData(req_ctx->ctl_iogen, insn_phy_addr+max_insn*sizeof(VTAGenericInsn)*ites, remain * sizeof(VTAGenericInsn), LOAD_INSN, READ_REQ);
+      auto req = req_ctx->ctl_iogen.req_matcher[LOAD_INSN].Consume();
       uint32_t insn_holder = 0;
       // std::cout << "Start Run insn" << std::endl;
       while (1) {
@@ -404,11 +404,11 @@ class Device {
     // enqueueReq(id_counter, insn_phy_addr, insn_count * sizeof(VTAGenericInsn), LOAD_INSN, READ_REQ);
 
     {
-      std::unique_lock<std::mutex> lk(ctl_iogen.mx);
+      std::unique_lock<std::mutex> lk(req_ctx->ctl_iogen.mx);
       std::cout << "IOGen Set finish to True!" << std::endl;
-      ctl_iogen.finished = true; 
-      ctl_iogen.blocked = false;
-      ctl_iogen.cv.notify_one();
+      req_ctx->ctl_iogen.finished = true; 
+      req_ctx->ctl_iogen.blocked = false;
+      req_ctx->ctl_iogen.cv.notify_one();
     }
 
     return 0;
@@ -652,8 +652,8 @@ VTAIOGenHandle VTAIOGenAlloc() {
 }
 
 void VTAIOGenFree(VTAIOGenHandle handle) {
-  ctl_iogen.finished = false;
-  ctl_iogen.blocked = false;
+  req_ctx->ctl_iogen.finished = false;
+  req_ctx->ctl_iogen.blocked = false;
   delete static_cast<vta::iogen::Device*>(handle);
 }
 
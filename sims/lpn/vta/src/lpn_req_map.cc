@@ -1,26 +1,22 @@
 #include "sims/lpn/vta/include/lpn_req_map.hh"
 #include "sims/lpn/vta/include/vta/driver.h"
 
-std::map<int, std::deque<std::unique_ptr<MemReq>>> io_req_map;
-CtlVar ctl_func;
-CtlVar ctl_iogen;
-CtlVar ctl_nb_lpn;
-int num_instr;
+thread_local ReqContext* req_ctx = nullptr;
 
 void setupReqQueues(const std::vector<int>& ids) {
   for (const auto& id : ids) {
-    io_req_map[id] = std::deque<std::unique_ptr<MemReq>>();
-    ctl_func.req_matcher[id] = Matcher(id);
-    ctl_iogen.req_matcher[id] = Matcher(id);
+    req_ctx->io_req_map[id] = std::deque<std::unique_ptr<MemReq>>();
+    req_ctx->ctl_func.req_matcher[id] = Matcher(id);
+    req_ctx->ctl_iogen.req_matcher[id] = Matcher(id);
   }
 }
 
 
 void ClearReqQueues(const std::vector<int>& ids) {
   for (const auto& id : ids) {
-    io_req_map[id].clear();
-    ctl_func.req_matcher[id].Clear();
-    ctl_iogen.req_matcher[id].Clear();
+    req_ctx->io_req_map[id].clear();
+    req_ctx->ctl_func.req_matcher[id].Clear();
+    req_ctx->ctl_iogen.req_matcher[id].Clear();
   }
 }
 
@@ -38,7 +34,7 @@ std::unique_ptr<MemReq>& enqueueReq(int id, uint64_t addr, uint32_t len, int tag
   req->len = len;
   req->buffer = calloc(1, len);
   // Register Request to be Matched
-  auto& reqQueue = io_req_map[tag];
+  auto& reqQueue = req_ctx->io_req_map[tag];
   reqQueue.push_back(std::move(req));
   return reqQueue.back();
 }
@@ -101,7 +97,7 @@ int getDataNB(CtlVar& ctrl, uint64_t addr, uint32_t len, int tag, int rw) {
 
 void putData(uint64_t addr, uint32_t len, int tag, int rw, uint64_t ts, void* buffer) {
   // std::cerr << "Matching write request" << " tag:" << writeReq->tag << "rw:" << writeReq->rw  << std::endl;
-  std::deque<std::unique_ptr<MemReq>>& reqs = io_req_map[tag];
+  std::deque<std::unique_ptr<MemReq>>& reqs = req_ctx->io_req_map[tag];
   auto it = reqs.begin();
   while (it != reqs.end()) {
     auto req = it->get();
@@ -129,14 +125,14 @@ void putData(uint64_t addr, uint32_t len, int tag, int rw, uint64_t ts, void* bu
           copy2->buffer = calloc(1, req->len);
           memcpy(copy2->buffer, req->buffer, req->len);
 
-          ctl_func.req_matcher[tag].Produce(std::move(copy1));
-          ctl_iogen.req_matcher[tag].Produce(std::move(copy2));
+          req_ctx->ctl_func.req_matcher[tag].Produce(std::move(copy1));
+          req_ctx->ctl_iogen.req_matcher[tag].Produce(std::move(copy2));
           if(tag == LOAD_INSN){
             auto copy3 = std::make_unique<MemReq>(*req);
             copy3->buffer = calloc(1, req->len);
             memcpy(copy3->buffer, req->buffer, req->len);
             // std::cerr << "!!! Producing LPN request for tag: " << tag << std::endl;
-            ctl_nb_lpn.req_matcher[tag].Produce(std::move(copy3));
+            req_ctx->ctl_nb_lpn.req_matcher[tag].Produce(std::move(copy3));
           }          
         }
       }
@@ -14,6 +14,7 @@
 #include <thread>
 #include <sys/time.h>
 
+#include <simbricks/pciebm/multidevice.hh>
 #include <simbricks/pciebm/pciebm.hh>
 
 #include "sims/lpn/vta/include/vta_regs.hh"
@@ -31,8 +32,6 @@
 
 #define VTA_DEBUG 0
 
-uint64_t in_flight_write = 0;
-
 void KickSim(CtlVar& ctrl, int tag){
   std::unique_lock lk(ctrl.mx);
   if(ctrl.finished){
@@ -62,28 +61,38 @@ void WaitForSim(CtlVar& ctrl){
 }
 
 namespace {
-VTABm vta_sim{};
-VTADeviceHandle vta_func_device;
-VTAIOGenHandle vta_io_generator;
-std::thread io_generator_thread;
-std::thread func_thread;
-double start_time;
-std::vector<int> ids = {LOAD_INSN, LOAD_INP_ID, LOAD_WGT_ID, LOAD_ACC_ID, LOAD_UOP_ID, STORE_ID};
+const std::vector<int> ids = {LOAD_INSN, LOAD_INP_ID, LOAD_WGT_ID, LOAD_ACC_ID, LOAD_UOP_ID, STORE_ID};
+
+class VTAFactory : public pciebm::MultiDeviceRunner::DeviceFactory {
+ public:
+  std::unique_ptr<pciebm::PcieBM> Create() override {
+    return std::make_unique<VTABm>();
+  }
+};
+
+VTAFactory vta_factory;
+pciebm::MultiDeviceRunner vta_runner{vta_factory};
 
 void sigint_handler(int dummy) {
-  vta_sim.SIGINTHandler();
+  vta_runner.SIGINTHandler();
 }
 
 void sigusr1_handler(int dummy) {
-  vta_sim.SIGUSR1Handler();
+  vta_runner.SIGUSR1Handler();
 }
 
 void sigusr2_handler(int dummy) {
-  vta_sim.SIGUSR2Handler();
+  vta_runner.SIGUSR2Handler();
 }
 
 }  // namespace
 
+VTABm::VTABm() : pciebm::PcieBM(16) {
+  // the LPN and the functional simulators of this instance find their
+  // request queues through the context of the current thread
+  req_ctx = &req_ctx_;
+}
+
 void VTABm::SetupIntro(struct SimbricksProtoPcieDevIntro &dev_intro) {
 
   std::cout << "VTABm::SetupIntro" << std::endl;
@@ -159,31 +168,28 @@ void VTABm::RegWrite(uint8_t bar, uint64_t addr, const void *src,
 
     struct timeval tp;
     gettimeofday(&tp, NULL);
-    start_time = double(tp.tv_sec) + tp.tv_usec / double(1000000);
+    start_time_ = double(tp.tv_sec) + tp.tv_usec / double(1000000);
 
     std::cerr << "LAUNCHING IO GENERATOR THREAD " << std::endl;
-    vta_io_generator = VTAIOGenAlloc();
-    io_generator_thread = std::thread(VTAIOGenRun, vta_io_generator, insn_phy_addr, insn_count, 10000000);
+    io_generator_ = VTAIOGenAlloc();
+    io_generator_thread_ = ReqContextThread(VTAIOGenRun, io_generator_, insn_phy_addr, insn_count, 10000000);
 
     // this is not fully correct, actually need to reset the finish states !!!
      
-    WaitForSim(ctl_iogen);
+    WaitForSim(req_ctx->ctl_iogen);
 
     // Start func simulator thread
     std::cerr << "LAUNCHING FUNC SIM THREAD " << std::endl;
-    vta_func_device = VTADeviceAlloc();
-    func_thread = std::thread(VTADeviceRun, vta_func_device, insn_phy_addr, insn_count, 10000000);
-    WaitForSim(ctl_func);
+    func_device_ = VTADeviceAlloc();
+    func_thread_ = ReqContextThread(VTADeviceRun, func_device_, insn_phy_addr, insn_count, 10000000);
+    WaitForSim(req_ctx->ctl_func);
 
-    num_instr = insn_count;
-    std::cerr << "LAUNCHING LPN with insns: " << num_instr << std::endl;
+    req_ctx->num_instr = insn_count;
+    std::cerr << "LAUNCHING LPN with insns: " << req_ctx->num_instr << std::endl;
     lpn_start(insn_phy_addr, insn_count, sizeof(VTAGenericInsn));
 
     // Start simulating the LPN immediately
-    auto evt = std::make_unique<pciebm::TimedEvent>();
-    evt->time = TimePs();
-    evt->priority = 0;
-    EventSchedule(std::move(evt));
+    EventReschedule(lpn_evt_, TimePs());
   }
 }
 
@@ -194,10 +200,10 @@ void VTABm::RegWrite(uint8_t bar, uint64_t addr, const void *src,
 // 4. Issue new DMA ops 
 void VTABm::DmaComplete(std::unique_ptr<pciebm::DMAOp> dma_op) {
   
-  UpdateClk(t_list, T_SIZE, TimePs());
-  // handle response to DMA read request
+  UpdateClk(lpn_net, TimePs());
+  // handle response to DMA read request, the data has already been passed on
+  // to putData from DmaReadBorrowed
   if (!dma_op->write) {
-    putData(dma_op->dma_addr, dma_op->len, dma_op->tag, dma_op->write, TimePs(), dma_op->data);
     #ifdef VTA_DEBUG_DMA
       std::cerr << "DMA Complete: " << dma_op->tag << " " << dma_op->dma_addr << " " << dma_op->len << std::endl;
     #endif
@@ -205,38 +211,40 @@ void VTABm::DmaComplete(std::unique_ptr<pciebm::DMAOp> dma_op) {
   // handle response to DMA write request
   else {
     putData(dma_op->dma_addr, dma_op->len, dma_op->tag, dma_op->write, TimePs(), dma_op->data);
-    in_flight_write--;
+    in_flight_write_--;
     #ifdef VTA_DEBUG_DMA
       std::cerr << "DMA Write Complete: " << dma_op->tag << " " << dma_op->dma_addr << " " << dma_op->len << std::endl;
     #endif
     // Process Write
     // lpn_req->acquired_len += dma_op->len;
   }
+  uint32_t tag = dma_op->tag;
+  DmaOpFree(std::move(dma_op));
 
 
   // Run LPN to process received memory
-  uint64_t next_ts = NextCommitTime(t_list, T_SIZE); 
+  uint64_t next_ts = NextCommitTime(lpn_net); 
 
-  KickSim(ctl_iogen, dma_op->tag);
-  KickSim(ctl_func, dma_op->tag);
+  KickSim(req_ctx->ctl_iogen, tag);
+  KickSim(req_ctx->ctl_func, tag);
   
   // Check for end condition
-  if (in_flight_write == 0 && ctl_iogen.finished && ctl_func.finished && lpn_finished() && next_ts == lpn::LARGE) {
+  if (in_flight_write_ == 0 && req_ctx->ctl_iogen.finished && req_ctx->ctl_func.finished && lpn_finished() && next_ts == lpn::LARGE) {
     std::cerr << "DMAcomplete: VTADeviceRun finished " << std::endl;
-    func_thread.join();
-    io_generator_thread.join();
-    VTADeviceFree(vta_func_device);
-    VTAIOGenFree(vta_io_generator);
+    func_thread_.join();
+    io_generator_thread_.join();
+    VTADeviceFree(func_device_);
+    VTAIOGenFree(io_generator_);
     lpn_end();
     ClearReqQueues(ids);
 
     struct timeval tp;
     gettimeofday(&tp, NULL);
     double end = double(tp.tv_sec) + (tp.tv_usec / double(1000000));
-    std::cerr << "EXECUTION TIME: " << (end - start_time) << " seconds" << std::endl;
+    std::cerr << "EXECUTION TIME: " << (end - start_time_) << " seconds" << std::endl;
 
     Registers_.status = 0x2;
-    TransitionCountLog(t_list, T_SIZE);
+    TransitionCountLog(lpn_net);
     return ;
   }
 
@@ -246,19 +254,16 @@ void VTABm::DmaComplete(std::unique_ptr<pciebm::DMAOp> dma_op) {
   #endif
       assert(next_ts >= TimePs() &&
              "VTABm::DmaComplete: Cannot schedule event for past timestamp");
-      auto next_scheduled = EventNext();
       if (next_ts != lpn::LARGE &&
-          (!next_scheduled || next_scheduled.value() > next_ts)) {
+          (!lpn_evt_.Scheduled() || lpn_evt_.time > next_ts)) {
   #if VTA_DEBUG
         std::cerr << "schedule next at = " << next_ts << "\n";
   #endif
-        auto evt = std::make_unique<pciebm::TimedEvent>();
-        evt->time = next_ts;
-        EventSchedule(std::move(evt));
+        EventReschedule(lpn_evt_, next_ts);
       }
 
   // Issue requests enqueued by LPN
-  for (auto &kv : io_req_map) {
+  for (auto &kv : req_ctx->io_req_map) {
     if (kv.second.empty()) continue;
     for(auto &req : kv.second){
       if (req->issue == 0 || req->issue == 2){
@@ -271,93 +276,127 @@ void VTABm::DmaComplete(std::unique_ptr<pciebm::DMAOp> dma_op) {
           }
         }
         req->issue = 2;
-        auto total_bytes = req->len;
-        auto sent_bytes = 0;
-        while(total_bytes > 0){
-          auto bytes_to_req = std::min<uint64_t>(total_bytes, DMA_BLOCK_SIZE);
-          if (req->rw == READ_REQ) {
-            auto dma_op = std::make_unique<VTADmaReadOp<DMA_BLOCK_SIZE>>(req->addr + sent_bytes, bytes_to_req, req->tag);
-            #ifdef VTA_DEBUG_DMA
-              std::cerr << "Issue DMA Read: " << req->tag << " " << req->addr + sent_bytes << " " << bytes_to_req << std::endl;
-            #endif
-            IssueDma(std::move(dma_op));
-          } else {
-            // reset the len to record for completion
-            req->acquired_len = 0;
-            auto dma_op = std::make_unique<VTADmaWriteOp>(req->addr + sent_bytes, bytes_to_req, req->tag);
-            std::memcpy(dma_op->buffer, req->buffer, bytes_to_req);
-            in_flight_write++;
-            #ifdef VTA_DEBUG_DMA
-              std::cerr << "Issue DMA Write: " << req->tag << " " << req->addr + sent_bytes << " " << bytes_to_req  << " is_write " << dma_op->write<< std::endl;
-            #endif
-            IssueDma(std::move(dma_op));
-          }
-          total_bytes -= bytes_to_req;
-          sent_bytes += bytes_to_req;
+        if (req->len == 0) continue;
+        // PcieBM splits the request into PCIe requests as needed
+        if (req->rw == READ_REQ) {
+          #ifdef VTA_DEBUG_DMA
+            std::cerr << "Issue DMA Read: " << req->tag << " " << req->addr << " " << req->len << std::endl;
+          #endif
+          DmaIssueRead(req->addr, req->len, req->tag);
+        } else {
+          // reset the len to record for completion
+          req->acquired_len = 0;
+          in_flight_write_++;
+          #ifdef VTA_DEBUG_DMA
+            std::cerr << "Issue DMA Write: " << req->tag << " " << req->addr << " " << req->len << std::endl;
+          #endif
+          DmaIssueWrite(req->addr, req->len, req->tag, req->buffer);
         }
       }
     }
   }
 }
 
-void VTABm::ExecuteEvent(std::unique_ptr<pciebm::TimedEvent> evt) {
+void VTABm::DmaReadBorrowed(pciebm::DMAOp &dma_op, size_t offset,
+                            const void *data, size_t len) {
+  // putData copies the data out of the completion
+  putData(dma_op.dma_addr + offset, len, dma_op.tag, dma_op.write, TimePs(),
+          const_cast<void *>(data));
+}
+
+void VTABm::DmaIssueRead(uint64_t addr, size_t len, uint32_t tag) {
+  std::unique_ptr<pciebm::DMAOp> dma_op;
+  if (read_ops_.empty()) {
+    dma_op = std::make_unique<pciebm::DMAOp>();
+  } else {
+    dma_op = std::move(read_ops_.back());
+    read_ops_.pop_back();
+  }
+  *dma_op = pciebm::DMAOp{tag, false, addr, len, nullptr};
+  IssueDma(std::move(dma_op));
+}
+
+void VTABm::DmaIssueWrite(uint64_t addr, size_t len, uint32_t tag,
+                          const void *data) {
+  std::unique_ptr<VTADmaWriteOp> dma_op;
+  if (write_ops_.empty()) {
+    dma_op = std::make_unique<VTADmaWriteOp>(addr, len, tag);
+  } else {
+    dma_op = std::move(write_ops_.back());
+    write_ops_.pop_back();
+    dma_op->tag = tag;
+    dma_op->dma_addr = addr;
+    dma_op->len = len;
+  }
+  dma_op->buffer.resize(len);
+  dma_op->data = dma_op->buffer.data();
+  std::memcpy(dma_op->data, data, len);
+  IssueDma(std::move(dma_op));
+}
+
+void VTABm::DmaOpFree(std::unique_ptr<pciebm::DMAOp> dma_op) {
+  if (dma_op->write) {
+    write_ops_.emplace_back(static_cast<VTADmaWriteOp *>(dma_op.release()));
+  } else {
+    dma_op->data = nullptr;
+    read_ops_.emplace_back(std::move(dma_op));
+  }
+}
+
+void VTABm::ExecuteEvent(pciebm::TimedEvent &evt) {
   // commit all transitions who can commit at evt.time
   // alternatively, commit transitions one by one.
   // UpdateClk(TimePs());‘
   uint64_t next_ts = lpn::LARGE;
   while(1){
-    CommitAtTime(t_list, T_SIZE, evt->time);
-    // TransitionCountLog(t_list, T_SIZE);
-    next_ts = NextCommitTime(t_list, T_SIZE);
-    if (next_ts > evt->time) break;
+    CommitAtTime(lpn_net, evt.time);
+    // TransitionCountLog(lpn_net);
+    next_ts = NextCommitTime(lpn_net);
+    if (next_ts > evt.time) break;
   }
 
 #if VTA_DEBUG
-  std::cerr << "lpn exec: evt time=" << evt->time << " TimePs=" << TimePs()
+  std::cerr << "lpn exec: evt time=" << evt.time << " TimePs=" << TimePs()
             << " next_ts=" << next_ts <<  " lpnLarge=" << lpn::LARGE << "\n";
 #endif
   // only schedule an event if one doesn't exist yet
   assert(next_ts >= TimePs() &&
       "VTABm::ExecuteEvent: Cannot schedule event for past timestamp");
-  auto next_scheduled = EventNext();
-
   if (next_ts != lpn::LARGE &&
-      (!next_scheduled || next_scheduled.value() > next_ts)) {
+      (!lpn_evt_.Scheduled() || lpn_evt_.time > next_ts)) {
 #if VTA_DEBUG
     std::cerr << "schedule next at = " << next_ts << "\n";
 #endif
-    evt->time = next_ts;
-    evt->priority = 0;
-    EventSchedule(std::move(evt));
+    EventReschedule(lpn_evt_, next_ts);
   }
 
   uint64_t insn_phy_addr = Registers_.insn_phy_addr_hh; 
   insn_phy_addr = insn_phy_addr << 32 | Registers_.insn_phy_addr_lh;
   // uint32_t insn_count = NUM_INSN;//Registers_.insn_count;
   // std::cerr << "insn_phy_addr: " << insn_phy_addr << " insn_count: " << insn_count << std::endl;
-  // std::cerr << "Remaining insns " << num_instr << std::endl;
-  if (in_flight_write == 0 && ctl_func.finished && ctl_iogen.finished && lpn_finished() && next_ts == lpn::LARGE) {
-      std::cerr << "Size of ctrl_func " <<  ctl_func.req_matcher[STORE_ID].reqs.size() << std::endl;
+  // std::cerr << "Remaining insns " << req_ctx->num_instr << std::endl;
+  if (in_flight_write_ == 0 && req_ctx->ctl_func.finished && req_ctx->ctl_iogen.finished && lpn_finished() && next_ts == lpn::LARGE) {
+      std::cerr << "Size of ctrl_func " <<  req_ctx->ctl_func.req_matcher[STORE_ID].reqs.size() << std::endl;
       std::cerr << "VTADeviceRun finished " << std::endl;
-      func_thread.join();
-      io_generator_thread.join();
-      VTADeviceFree(vta_func_device);
-      VTAIOGenFree(vta_io_generator);
+      func_thread_.join();
+      io_generator_thread_.join();
+      VTADeviceFree(func_device_);
+      VTAIOGenFree(io_generator_);
       ClearReqQueues(ids);
       lpn_end();
 
       struct timeval tp;
       gettimeofday(&tp, NULL);
       double end = double(tp.tv_sec) + (tp.tv_usec / double(1000000));
-      std::cerr << "EXECUTION TIME: " << (end - start_time) << " seconds" << std::endl;
+      std::cerr << "EXECUTION TIME: " << (end - start_time_) << " seconds" << std::endl;
 
       Registers_.status = 0x2;
-      TransitionCountLog(t_list, T_SIZE);
+      TransitionCountLog(lpn_net);
       return;
   }
 
   // Issue requests enqueued by IOGen
-  for (auto &kv : io_req_map) {
+  for (auto &kv : req_ctx->io_req_map) {
     if (kv.second.empty()) continue;
     for(auto &req : kv.second){
       if (req->issue == 0 || req->issue == 2){
@@ -373,29 +412,21 @@ void VTABm::ExecuteEvent(std::unique_ptr<pciebm::TimedEvent> evt) {
       if (req->issue == 1){
         
         req->issue = 2;
-        auto total_bytes = req->len;
-        auto sent_bytes = 0;
-        while(total_bytes > 0){
-          auto bytes_to_req = std::min<uint64_t>(total_bytes, DMA_BLOCK_SIZE);
-          if (req->rw == READ_REQ) {
-            auto dma_op = std::make_unique<VTADmaReadOp<DMA_BLOCK_SIZE>>(req->addr + sent_bytes, bytes_to_req, req->tag);
-            #ifdef VTA_DEBUG_DMA
-              std::cerr << "Issue DMA Read: " << req->tag << " " << req->addr + sent_bytes << " " << bytes_to_req << std::endl;
-            #endif
-            IssueDma(std::move(dma_op));
-          } else {
-            // reset the len to record for completion
-            req->acquired_len = 0;
-            auto dma_op = std::make_unique<VTADmaWriteOp>(req->addr + sent_bytes, bytes_to_req, req->tag);
-            std::memcpy(dma_op->buffer, req->buffer, bytes_to_req);
-            in_flight_write++;
-            #ifdef VTA_DEBUG_DMA
-              std::cerr << "Issue DMA Write: " << req->tag << " " << req->addr + sent_bytes << " " << bytes_to_req << std::endl;
-            #endif
-            IssueDma(std::move(dma_op));
-          }
-          total_bytes -= bytes_to_req;
-          sent_bytes += bytes_to_req;
+        if (req->len == 0) continue;
+        // PcieBM splits the request into PCIe requests as needed
+        if (req->rw == READ_REQ) {
+          #ifdef VTA_DEBUG_DMA
+            std::cerr << "Issue DMA Read: " << req->tag << " " << req->addr << " " << req->len << std::endl;
+          #endif
+          DmaIssueRead(req->addr, req->len, req->tag);
+        } else {
+          // reset the len to record for completion
+          req->acquired_len = 0;
+          in_flight_write_++;
+          #ifdef VTA_DEBUG_DMA
+            std::cerr << "Issue DMA Write: " << req->tag << " " << req->addr << " " << req->len << std::endl;
+          #endif
+          DmaIssueWrite(req->addr, req->len, req->tag, req->buffer);
         }
       }
     }
@@ -403,7 +434,7 @@ void VTABm::ExecuteEvent(std::unique_ptr<pciebm::TimedEvent> evt) {
   
   // if (next_ts == lpn::LARGE && Registers_.status == 0x4 && !next_scheduled) {
   //   Registers_.status = 0x2;
-  //   TransitionCountLog(t_list, T_SIZE);
+  //   TransitionCountLog(lpn_net);
   //   return;
   // }
 }
@@ -419,8 +450,6 @@ int main(int argc, char *argv[]) {
   signal(SIGINT, sigint_handler);
   signal(SIGUSR1, sigusr1_handler);
   signal(SIGUSR2, sigusr2_handler);
-  if (!vta_sim.ParseArgs(argc, argv)) {
-    return EXIT_FAILURE;
-  }
-  return vta_sim.RunMain();
+  // devices are separated by "--" on the command line
+  return vta_runner.RunMain(argc, argv);
 }
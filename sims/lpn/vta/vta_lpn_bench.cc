@@ -0,0 +1,284 @@
+// Benchmark for the VTA LPN: runs the lpn_net of the behavioral model on an
+// instruction trace (in the format of reference.insns) without a host. The
+// benchmark stands in for the IO generator, enqueueing the memory requests of
+// every instruction up front, and for the host memory, completing every issued
+// request after a fixed latency plus transfer time. The LPN is driven through
+// UpdateClk/NextCommitTime/CommitAtTime in the same order as VTABm does.
+//
+// usage: vta_lpn_bench [-i TRACE] [-r RUNS] 2>/dev/null
+
+#include <getopt.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <queue>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "sims/lpn/lpn_common/lpn_sim.hh"
+#include "sims/lpn/lpn_common/place_transition.hh"
+#include "sims/lpn/vta/include/lpn_req_map.hh"
+#include "sims/lpn/vta/include/vta/driver.h"
+#include "sims/lpn/vta/include/vta/hw_spec.h"
+#include "sims/lpn/vta/lpn_def/lpn_def.hh"
+
+namespace {
+
+const std::vector<int> ids = {LOAD_INSN,   LOAD_INP_ID, LOAD_WGT_ID,
+                              LOAD_ACC_ID, LOAD_UOP_ID, STORE_ID};
+
+// memory model: fixed latency plus transfer time [ps]
+const uint64_t kMemLatency = 500 * 1000;
+const uint64_t kMemPsPerByte = 250;
+const uint64_t kInsnAddr = 0x1000;
+const uint32_t kMaxInsnPerReq = 128;
+
+// parse one line of an instruction trace, see collect_insns in setup.hpp
+bool ParseInsn(const std::string& line, VTAGenericInsn* out) {
+  std::vector<std::string> f;
+  std::stringstream ss(line);
+  std::string field;
+  while (std::getline(ss, field, ',')) {
+    field.erase(0, field.find_first_not_of(' '));
+    f.push_back(field);
+  }
+  if (f.size() < 15 || f[0] != "insn")
+    return false;
+
+  auto num = [&f](int i) { return std::strtoul(f[i].c_str(), nullptr, 0); };
+  union VTAInsn c;
+  std::memset(&c, 0, sizeof(c));
+  const std::string& op = f[1];
+  const std::string& subop = f[2];
+  const std::string& tstype = f[3];
+
+  if (subop == "gemm" || subop == "alu") {
+    c.gemm.opcode = (subop == "gemm" ? VTA_OPCODE_GEMM : VTA_OPCODE_ALU);
+    c.gemm.uop_bgn = num(6);
+    c.gemm.uop_end = num(7);
+    c.gemm.iter_out = num(8);
+    c.gemm.iter_in = num(9);
+    if (subop == "alu")
+      c.alu.use_imm = num(10);
+  } else if (tstype == "finish") {
+    c.mem.opcode = VTA_OPCODE_FINISH;
+  } else {
+    c.mem.opcode = (op == "store" ? VTA_OPCODE_STORE : VTA_OPCODE_LOAD);
+    if (op == "store")
+      c.mem.memory_type = VTA_MEM_ID_OUT;
+    else if (subop == "loadUop" || (op == "compute" && subop == "sync"))
+      c.mem.memory_type = VTA_MEM_ID_UOP;
+    else if (subop == "loadAcc")
+      c.mem.memory_type = VTA_MEM_ID_ACC;
+    else if (tstype == "wgt")
+      c.mem.memory_type = VTA_MEM_ID_WGT;
+    else
+      c.mem.memory_type = VTA_MEM_ID_INP;
+    if (subop != "sync") {
+      c.mem.x_size = num(4);
+      c.mem.y_size = num(5);
+      c.mem.x_stride = num(4);
+    }
+  }
+  c.mem.pop_prev_dep = num(11);
+  c.mem.pop_next_dep = num(12);
+  c.mem.push_prev_dep = num(13);
+  c.mem.push_next_dep = num(14);
+  *out = c.generic;
+  return true;
+}
+
+// enqueue the requests the IO generator would issue for the trace
+void EnqueueRequests(const std::vector<VTAGenericInsn>& insns) {
+  uint32_t id = 0;
+  for (size_t i = 0; i < insns.size(); i += kMaxInsnPerReq) {
+    size_t n = std::min<size_t>(kMaxInsnPerReq, insns.size() - i);
+    auto& req = enqueueReq(++id, kInsnAddr + i * sizeof(VTAGenericInsn),
+                           n * sizeof(VTAGenericInsn), LOAD_INSN, READ_REQ);
+    std::memcpy(req->buffer, &insns[i], n * sizeof(VTAGenericInsn));
+  }
+
+  for (const VTAGenericInsn& insn : insns) {
+    union VTAInsn c;
+    c.generic = insn;
+    const VTAMemInsn& mem = c.mem;
+    if ((mem.opcode != VTA_OPCODE_LOAD && mem.opcode != VTA_OPCODE_STORE) ||
+        mem.x_size == 0)
+      continue;
+
+    id++;
+    if (mem.opcode == VTA_OPCODE_STORE) {
+      uint32_t len =
+          memOpHelper.store_._kLane * memOpHelper.store_._target_bits / 8;
+      for (uint32_t n = 0; n < mem.x_size * mem.y_size; n++) {
+        // the functional simulator provides the data before the write issues
+        auto& req = enqueueReq(id, 0, len, STORE_ID, WRITE_REQ);
+        req->acquired_len = len;
+      }
+      continue;
+    }
+
+    int tag = 0;
+    uint32_t elem_bytes = 0;
+    if (mem.memory_type == VTA_MEM_ID_INP) {
+      tag = LOAD_INP_ID;
+      elem_bytes = memOpHelper.inp_.kElemBytes;
+    } else if (mem.memory_type == VTA_MEM_ID_WGT) {
+      tag = LOAD_WGT_ID;
+      elem_bytes = memOpHelper.wgt_.kElemBytes;
+    } else if (mem.memory_type == VTA_MEM_ID_ACC) {
+      tag = LOAD_ACC_ID;
+      elem_bytes = memOpHelper.acc_.kElemBytes;
+    } else {
+      tag = LOAD_UOP_ID;
+      elem_bytes = memOpHelper.uop_.kElemBytes;
+    }
+    for (uint32_t y = 0; y < mem.y_size; y++)
+      enqueueReq(id, 0, elem_bytes * mem.x_size, tag, READ_REQ);
+  }
+}
+
+struct Completion {
+  uint64_t time;
+  MemReq* req;
+  bool operator>(const Completion& other) const {
+    return time > other.time;
+  }
+};
+
+using CompletionQueue = std::priority_queue<Completion, std::vector<Completion>,
+                                            std::greater<Completion>>;
+
+// issue the requests the LPN marked as ready, like VTABm::ExecuteEvent
+void IssueRequests(CompletionQueue& completions, uint64_t now) {
+  for (auto& kv : req_ctx->io_req_map) {
+    for (auto& req : kv.second) {
+      // requests are marked ready in queue order
+      if (req->issue == 0)
+        break;
+      if (req->issue != 1)
+        continue;
+      req->issue = 2;
+      completions.push(
+          {now + kMemLatency + req->len * kMemPsPerByte, req.get()});
+    }
+  }
+}
+
+void CompleteRequest(MemReq* req, uint64_t now) {
+  req->acquired_len = req->len;
+  req->issue = 3;
+  req->complete_ts = now;
+  if (req->tag == LOAD_INSN) {
+    // instructions are handed to the LPN through its matcher
+    auto copy = std::make_unique<MemReq>(*req);
+    copy->buffer = std::malloc(req->len);
+    std::memcpy(copy->buffer, req->buffer, req->len);
+    req_ctx->ctl_nb_lpn.req_matcher[LOAD_INSN].Produce(std::move(copy));
+  }
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  const char* trace = "sims/lpn/vta/reference.insns";
+  int runs = 1000;
+  int c;
+  while ((c = getopt(argc, argv, "i:r:")) != -1) {
+    switch (c) {
+      case 'i':
+        trace = optarg;
+        break;
+      case 'r':
+        runs = std::atoi(optarg);
+        break;
+      default:
+        std::cerr << "usage: " << argv[0] << " [-i TRACE] [-r RUNS]\n";
+        return EXIT_FAILURE;
+    }
+  }
+
+  std::vector<VTAGenericInsn> insns;
+  std::ifstream fin(trace);
+  std::string line;
+  while (std::getline(fin, line)) {
+    VTAGenericInsn insn;
+    if (ParseInsn(line, &insn))
+      insns.push_back(insn);
+  }
+  if (insns.empty()) {
+    std::cerr << "no instructions in " << trace << "\n";
+    return EXIT_FAILURE;
+  }
+
+  ReqContext ctx;
+  req_ctx = &ctx;
+  setupReqQueues(ids);
+  lpn_init();
+
+  using Clock = std::chrono::steady_clock;
+  Clock::duration lpn_time{};
+  uint64_t steps = 0;
+  uint64_t now = 0;
+  Clock::time_point start = Clock::now();
+
+  for (int run = 0; run < runs; run++) {
+    EnqueueRequests(insns);
+    lpn_start(kInsnAddr, insns.size(), sizeof(VTAGenericInsn));
+    CompletionQueue completions;
+    uint64_t next_lpn = now;
+
+    while (true) {
+      Clock::time_point t0 = Clock::now();
+      if (!completions.empty() && completions.top().time <= next_lpn) {
+        // DMA completion, see VTABm::DmaComplete
+        now = completions.top().time;
+        CompleteRequest(completions.top().req, now);
+        completions.pop();
+        UpdateClk(lpn_net, now);
+        next_lpn = std::min(next_lpn, NextCommitTime(lpn_net));
+      } else if (next_lpn != lpn::LARGE) {
+        // LPN event, see VTABm::ExecuteEvent
+        now = next_lpn;
+        do {
+          CommitAtTime(lpn_net, now);
+          next_lpn = NextCommitTime(lpn_net);
+        } while (next_lpn <= now);
+      } else {
+        break;
+      }
+      lpn_time += Clock::now() - t0;
+      steps++;
+      IssueRequests(completions, now);
+    }
+
+    if (!lpn_finished()) {
+      std::cerr << "run " << run << ": LPN stuck at " << now << " ps\n";
+      return EXIT_FAILURE;
+    }
+    lpn_end();
+    // start every run from the same state, as after a device reset; the trace
+    // leaves dependency tokens behind
+    lpn_reset();
+  }
+
+  double total_s = std::chrono::duration<double>(Clock::now() - start).count();
+  double lpn_s = std::chrono::duration<double>(lpn_time).count();
+  uint64_t firings = 0;
+  std::apply([&firings](auto&... ts) { ((firings += ts.count), ...); },
+             lpn_net.t_list);
+
+  std::cout << runs << " runs of " << insns.size() << " instructions, "
+            << now / runs / 1000 << " ns simulated per run\n";
+  std::cout << "events: " << steps << ", transitions fired: " << firings
+            << "\n";
+  std::cout << "total: " << total_s << " s, in LPN: " << lpn_s << " s ("
+            << lpn_s * 1e9 / steps << " ns/event, " << lpn_s * 1e9 / firings
+            << " ns/firing)\n";
+  return EXIT_SUCCESS;
+}
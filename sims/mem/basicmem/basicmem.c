@@ -23,6 +23,7 @@
  */
 
 #include <fcntl.h>
+#include <getopt.h>
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -193,10 +194,25 @@ int main(int argc, char *argv[]) {
 
   SimbricksMemIfDefaultParams(&memParams);
 
-  if (argc < 6 || argc > 10) {
+  static const struct option long_opts[] = {
+      {"adaptive-sync", no_argument, NULL, 'a'}, {NULL, 0, NULL, 0}};
+  int c;
+  int bad_option = 0;
+  while ((c = getopt_long(argc, argv, "+", long_opts, NULL)) != -1) {
+    if (c == 'a')
+      memParams.adaptive_sync = true;
+    else
+      bad_option = 1;
+  }
+  // positional arguments start at argv[1]
+  argc -= optind - 1;
+  argv += optind - 1;
+
+  if (bad_option || argc < 6 || argc > 10) {
     fprintf(stderr,
-            "Usage: basicmem [SIZE] [BASE-ADDR] [ASID] [MEM-SOCKET] "
-            "SHM [SYNC-MODE] [START-TICK] [SYNC-PERIOD] [MEM-LATENCY]\n");
+            "Usage: basicmem [--adaptive-sync] [SIZE] [BASE-ADDR] [ASID] "
+            "[MEM-SOCKET] SHM [SYNC-MODE] [START-TICK] [SYNC-PERIOD] "
+            "[MEM-LATENCY]\n");
     return -1;
   }
   if (argc >= 8)
@@ -223,13 +239,24 @@ int main(int argc, char *argv[]) {
     return EXIT_FAILURE;
   }
 
+  struct SimbricksBaseIf *membase = &memif.base;
+  bool doorbell = SimbricksBaseIfDoorbellEnabled(membase);
+
   printf("start polling\n");
   while (!exiting) {
+    // we only respond to host requests
+    SimbricksBaseIfOutLookahead(membase, SimbricksMemIfH2MInTimestamp(&memif));
     while (SimbricksMemIfM2HOutSync(&memif, cur_ts)) {
       fprintf(stderr, "warn: SimbricksMemIfSync failed (t=%lu)\n", cur_ts);
     }
 
+    bool first = true;
     do {
+      // sleep till the host sends us something
+      if (!first && doorbell)
+        SimbricksBaseIfWaitAny(&membase, 1, memParams.doorbell_spin);
+      first = false;
+
       PollH2M(&memif, cur_ts);
 
       if (sync_mem) {
@@ -70,14 +70,10 @@ bool MemNicIfInit(struct SimbricksMemIf *memif, struct SimbricksNetIf *netif,
 
   // first allocate pool
   size_t shm_size = 0;
-  if (memParams) {
-    shm_size += memParams->in_num_entries * memParams->in_entries_size;
-    shm_size += memParams->out_num_entries * memParams->out_entries_size;
-  }
-  if (netParams) {
-    shm_size += netParams->in_num_entries * netParams->in_entries_size;
-    shm_size += netParams->out_num_entries * netParams->out_entries_size;
-  }
+  if (memParams)
+    shm_size += SimbricksBaseIfSHMSize(memParams);
+  if (netParams)
+    shm_size += SimbricksBaseIfSHMSize(netParams);
 
   struct SimbricksBaseIfSHMPool pool_;
   memset(&pool_, 0, sizeof(pool_));
@@ -244,9 +244,7 @@ int main(int argc, char *argv[]) {
     perror("no array allocated\n");
   }
 
-  size_t shm_size = 0;
-  shm_size += netParams.in_num_entries * netParams.in_entries_size;
-  shm_size += netParams.out_num_entries * netParams.out_entries_size;
+  size_t shm_size = SimbricksBaseIfSHMSize(&netParams);
 
   struct SimbricksBaseIfSHMPool pool_;
   memset(&pool_, 0, sizeof(pool_));
@@ -23,6 +23,7 @@
  */
 
 #include <arpa/inet.h>
+#include <getopt.h>
 #include <linux/if_ether.h>
 #include <linux/ip.h>
 #include <pcap/pcap.h>
@@ -101,11 +102,15 @@ class NetPort {
     kRxPollSuccess = 0,
     kRxPollFail = 1,
     kRxPollSync = 2,
+    kRxPollSyncMode = 3,
   };
+  /** Maximum number of packets received with one poll */
+  static const size_t kRxBurst = 32;
   struct SimbricksNetIf netif_;
 
  protected:
-  volatile union SimbricksProtoNetMsg *rx_;
+  volatile union SimbricksProtoNetMsg *rx_[kRxBurst];
+  size_t rx_num_;
   int sync_;
   const char *path_;
 
@@ -125,15 +130,16 @@ class NetPort {
   }
 
  public:
-  NetPort(const char *path, int sync) : rx_(nullptr), sync_(sync), path_(path) {
+  NetPort(const char *path, int sync) : rx_num_(0), sync_(sync), path_(path) {
     memset(&netif_, 0, sizeof(netif_));
   }
 
   NetPort(const NetPort &other)
       : netif_(other.netif_),
-        rx_(other.rx_),
+        rx_num_(other.rx_num_),
         sync_(other.sync_),
         path_(other.path_) {
+    memcpy(rx_, other.rx_, sizeof(rx_));
   }
 
   virtual bool Prepare() {
@@ -153,10 +159,35 @@ class NetPort {
   }
 
   bool IsSync() {
-    return sync_;
+    return SimbricksBaseIfSyncEnabled(&netif_.base);
   }
 
-  void Sync(uint64_t cur_ts) {
+  /** Handle sync mode message `i` of the current burst */
+  uint64_t SyncSwitchHandle(size_t i, uint64_t cur_ts, bool &enable,
+                            bool &ack) {
+    volatile union SimbricksProtoNetMsg *rx = rx_[i];
+    enable = rx->base.sync_mode.flags & SIMBRICKS_PROTO_SYNC_MODE_ENABLE;
+    ack = rx->base.sync_mode.flags & SIMBRICKS_PROTO_SYNC_MODE_ACK;
+    return SimbricksBaseIfSyncSwitchHandle(&netif_.base, &rx->base, cur_ts);
+  }
+
+  /** Ask the peer to switch sync on or off too, if it supports that */
+  void SyncSwitch(bool enable, uint64_t cur_ts) {
+    if (IsSync() == enable ||
+        !SimbricksBaseIfSyncSwitchEnabled(&netif_.base) ||
+        SimbricksBaseIfSyncSwitchPending(&netif_.base))
+      return;
+    if (SimbricksBaseIfSyncSwitch(&netif_.base, enable, cur_ts) != 0)
+      fprintf(stderr, "SyncSwitch: forwarding sync switch failed\n");
+  }
+
+  /** Waiting for the peer to acknowledge switching on sync */
+  bool SyncSwitchStalled() {
+    return SimbricksBaseIfSyncSwitchPending(&netif_.base) && !IsSync();
+  }
+
+  void Sync(uint64_t cur_ts, uint64_t lookahead) {
+    SimbricksBaseIfOutLookahead(&netif_.base, lookahead);
     while (SimbricksNetIfOutSync(&netif_, cur_ts)) {
     }
   }
@@ -165,20 +196,26 @@ class NetPort {
     return SimbricksNetIfInTimestamp(&netif_);
   }
 
-  enum RxPollState RxPacket(const void *&data, size_t &len, uint64_t cur_ts) {
-    assert(rx_ == nullptr);
+  size_t RxBurst(uint64_t cur_ts) {
+    assert(rx_num_ == 0);
 
-    rx_ = SimbricksNetIfInPoll(&netif_, cur_ts);
-    if (!rx_)
-      return kRxPollFail;
+    rx_num_ = SimbricksNetIfInPollBurst(&netif_, cur_ts, rx_, kRxBurst);
+    return rx_num_;
+  }
+
+  enum RxPollState RxPacket(size_t i, const void *&data, size_t &len) {
+    assert(i < rx_num_);
 
-    uint8_t type = SimbricksNetIfInType(&netif_, rx_);
+    volatile union SimbricksProtoNetMsg *rx = rx_[i];
+    uint8_t type = SimbricksNetIfInType(&netif_, rx);
     if (type == SIMBRICKS_PROTO_NET_MSG_PACKET) {
-      data = (const void *)rx_->packet.data;
-      len = rx_->packet.len;
+      data = (const void *)rx->packet.data;
+      len = rx->packet.len;
       return kRxPollSuccess;
     } else if (type == SIMBRICKS_PROTO_MSG_TYPE_SYNC) {
       return kRxPollSync;
+    } else if (type == SIMBRICKS_PROTO_MSG_TYPE_SYNC_MODE) {
+      return kRxPollSyncMode;
     } else {
       fprintf(stderr, "switch_pkt: unsupported type=%u\n", type);
       abort();
@@ -186,20 +223,24 @@ class NetPort {
   }
 
   void RxDone() {
-    assert(rx_ != nullptr);
+    assert(rx_num_ != 0);
 
-    SimbricksNetIfInDone(&netif_, rx_);
-    rx_ = nullptr;
+    SimbricksNetIfInDoneBurst(&netif_, rx_, rx_num_);
+    rx_num_ = 0;
   }
 
   bool TxPacket(const void *data, size_t len, uint64_t cur_ts) {
+    size_t msg_len = sizeof(struct SimbricksProtoNetMsgPacket) + len;
+    if (msg_len > SimbricksNetIfOutMaxMsgLen(&netif_))
+      return false;
+
     volatile union SimbricksProtoNetMsg *msg_to =
-        SimbricksNetIfOutAlloc(&netif_, cur_ts);
-    if (!msg_to && !sync_) {
+        SimbricksNetIfOutAllocLen(&netif_, cur_ts, msg_len);
+    if (!msg_to && !IsSync()) {
       return false;
-    } else if (!msg_to && sync_) {
+    } else if (!msg_to && IsSync()) {
       while (!msg_to)
-        msg_to = SimbricksNetIfOutAlloc(&netif_, cur_ts);
+        msg_to = SimbricksNetIfOutAllocLen(&netif_, cur_ts, msg_len);
     }
     volatile struct SimbricksProtoNetMsgPacket *rx;
     rx = &msg_to->packet;
@@ -351,6 +392,38 @@ static void forward_pkt(const void *pkt_data, size_t pkt_len, size_t port_id,
     fprintf(stderr, "forward_pkt: dropping packet on port %zu\n", port_id);
 }
 
+static bool sync_switch_stalled() {
+  for (auto port : ports) {
+    if (port->SyncSwitchStalled())
+      return true;
+  }
+  return false;
+}
+
+static void sync_switch(NetPort &port, size_t i, size_t iport) {
+  bool enable, ack;
+  uint64_t ts = port.SyncSwitchHandle(i, cur_ts, enable, ack);
+
+  // jump ahead to the switch unless other ports hold us back
+  bool held = false;
+  for (size_t p = 0; p < ports.size(); p++)
+    held = held || (p != iport && ports[p]->IsSync());
+  if (!held)
+    cur_ts = ts;
+  fprintf(stderr, "sync switch %s %s on port %zu at %lu\n",
+          (enable ? "on" : "off"), (ack ? "acknowledged" : "requested"),
+          iport, cur_ts);
+
+  // ask all other ports to switch too, our ack is held back until they have
+  // acknowledged
+  if (!ack) {
+    for (size_t p = 0; p < ports.size(); p++) {
+      if (p != iport)
+        ports[p]->SyncSwitch(enable, cur_ts);
+    }
+  }
+}
+
 static void switch_pkt(NetPort &port, size_t iport) {
   const void *pkt_data;
   size_t pkt_len;
@@ -362,50 +435,55 @@ static void switch_pkt(NetPort &port, size_t iport) {
   }
 #endif
 
-  enum NetPort::RxPollState poll = port.RxPacket(pkt_data, pkt_len, cur_ts);
-  if (poll == NetPort::kRxPollFail) {
+  size_t n = port.RxBurst(cur_ts);
+  if (n == 0) {
     return;
   }
 
 #ifdef NETSWITCH_STAT
-  d2n_poll_suc += 1;
+  d2n_poll_suc += n;
   if (stat_flag) {
-    s_d2n_poll_suc += 1;
+    s_d2n_poll_suc += n;
   }
 #endif
 
-  if (poll == NetPort::kRxPollSuccess) {
-    // Get MAC addresses
-    MAC dst((const uint8_t *)pkt_data), src((const uint8_t *)pkt_data + 6);
-    // MAC learning
-    if (!(src == bcast_addr)) {
-      mac_table[src] = iport;
-    }
-    // L2 forwarding
-    auto i = mac_table.find(dst);
-    if (i != mac_table.end()) {
-      size_t eport = i->second;
-      if (eport != iport)
-        forward_pkt(pkt_data, pkt_len, eport, iport);
-    } else {
-      // Broadcast
-      for (size_t eport = 0; eport < ports.size(); eport++) {
-        if (eport != iport) {
-          // Do not forward to ingress port
+  for (size_t i = 0; i < n; i++) {
+    enum NetPort::RxPollState poll = port.RxPacket(i, pkt_data, pkt_len);
+    if (poll == NetPort::kRxPollSuccess) {
+      // Get MAC addresses
+      MAC dst((const uint8_t *)pkt_data), src((const uint8_t *)pkt_data + 6);
+      // MAC learning
+      if (!(src == bcast_addr)) {
+        mac_table[src] = iport;
+      }
+      // L2 forwarding
+      auto it = mac_table.find(dst);
+      if (it != mac_table.end()) {
+        size_t eport = it->second;
+        if (eport != iport)
           forward_pkt(pkt_data, pkt_len, eport, iport);
+      } else {
+        // Broadcast
+        for (size_t eport = 0; eport < ports.size(); eport++) {
+          if (eport != iport) {
+            // Do not forward to ingress port
+            forward_pkt(pkt_data, pkt_len, eport, iport);
+          }
         }
       }
-    }
-  } else if (poll == NetPort::kRxPollSync) {
+    } else if (poll == NetPort::kRxPollSyncMode) {
+      sync_switch(port, i, iport);
+    } else if (poll == NetPort::kRxPollSync) {
 #ifdef NETSWITCH_STAT
-    d2n_poll_sync += 1;
-    if (stat_flag) {
-      s_d2n_poll_sync += 1;
-    }
+      d2n_poll_sync += 1;
+      if (stat_flag) {
+        s_d2n_poll_sync += 1;
+      }
 #endif
-  } else {
-    fprintf(stderr, "switch_pkt: unsupported poll result=%u\n", poll);
-    abort();
+    } else {
+      fprintf(stderr, "switch_pkt: unsupported poll result=%u\n", poll);
+      abort();
+    }
   }
   port.RxDone();
 }
@@ -418,8 +496,16 @@ int main(int argc, char *argv[]) {
 
   SimbricksNetIfDefaultParams(&netParams);
 
+  static const struct option long_opts[] = {
+      {"adaptive-sync", no_argument, nullptr, 'a'},
+      {"multi-slot", no_argument, nullptr, 'm'},
+      {"sync-switch", no_argument, nullptr, 'w'},
+      {nullptr, 0, nullptr, 0}};
+
   // Parse command line argument
-  while ((c = getopt(argc, argv, "s:h:uS:E:p:")) != -1 && !bad_option) {
+  while ((c = getopt_long(argc, argv, "s:h:uS:E:p:", long_opts, nullptr)) !=
+             -1 &&
+         !bad_option) {
     switch (c) {
       case 's': {
         NetPort *port = new NetPort(optarg, sync_eth);
@@ -458,6 +544,18 @@ int main(int argc, char *argv[]) {
         dumpfile = pcap_dump_open(pc, optarg);
         break;
 
+      case 'a':
+        netParams.adaptive_sync = true;
+        break;
+
+      case 'm':
+        netParams.multi_slot = true;
+        break;
+
+      case 'w':
+        netParams.sync_switch = true;
+        break;
+
       default:
         fprintf(stderr, "unknown option %c\n", c);
         bad_option = 1;
@@ -468,6 +566,7 @@ int main(int argc, char *argv[]) {
   if (ports.empty() || bad_option) {
     fprintf(stderr,
             "Usage: net_switch [-S SYNC-PERIOD] [-E ETH-LATENCY] "
+            "[--adaptive-sync] [--multi-slot] [--sync-switch] "
             "-s SOCKET-A [-s SOCKET-B ...]\n");
     return EXIT_FAILURE;
   }
@@ -483,15 +582,44 @@ int main(int argc, char *argv[]) {
   if (!ConnectAll(ports))
     return EXIT_FAILURE;
 
+  bool doorbell = true;
+  for (auto port : ports)
+    doorbell = doorbell && SimbricksBaseIfDoorbellEnabled(&port->netif_.base);
+  std::vector<struct SimbricksBaseIf *> wait_ifs;
+
   printf("start polling\n");
   while (!exiting) {
-    // Sync all interfaces
-    for (auto port : ports)
-      port->Sync(cur_ts);
+    // Packets are forwarded right away, so we can only promise not to send
+    // anything before the next packet can arrive on any port
+    uint64_t lookahead = ULLONG_MAX;
+    for (auto port : ports) {
+      uint64_t ts = (port->IsSync() ? port->NextTimestamp() : cur_ts);
+      lookahead = ts < lookahead ? ts : lookahead;
+    }
+
+    // Sync all interfaces, unless a sync switch we forwarded is pending: time
+    // then stands still and acknowledgements are held back
+    if (!sync_switch_stalled()) {
+      for (auto port : ports)
+        port->Sync(cur_ts, lookahead);
+    }
 
     // Switch packets
-    uint64_t min_ts;
+    uint64_t min_ts = ULLONG_MAX;
+    bool first = true;
     do {
+      // sleep till one of the ports holding us back receives something
+      if (!first && doorbell) {
+        wait_ifs.clear();
+        for (auto port : ports) {
+          if (port->IsSync() && port->NextTimestamp() <= cur_ts)
+            wait_ifs.push_back(&port->netif_.base);
+        }
+        SimbricksBaseIfWaitAny(wait_ifs.data(), wait_ifs.size(),
+                               netParams.doorbell_spin);
+      }
+      first = false;
+
       min_ts = ULLONG_MAX;
       for (size_t port_i = 0; port_i < ports.size(); port_i++) {
         auto &port = *ports[port_i];
@@ -504,7 +632,7 @@ int main(int argc, char *argv[]) {
     } while (!exiting && (min_ts <= cur_ts));
 
     // Update cur_ts
-    if (min_ts < ULLONG_MAX) {
+    if (min_ts < ULLONG_MAX && !sync_switch_stalled()) {
       cur_ts = min_ts;
     }
   }
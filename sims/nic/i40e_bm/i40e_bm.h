@@ -29,6 +29,7 @@
 #include <deque>
 #include <sstream>
 #include <string>
+#include <vector>
 extern "C" {
 #include <simbricks/pcie/proto.h>
 }
@@ -391,6 +392,8 @@ class lan_queue_tx : public lan_queue_base {
   uint8_t pktbuf[MTU];
   uint32_t tso_off;
   uint32_t tso_len;
+  // packet pieces: headers in pktbuf, then payload in the descriptor buffers
+  std::vector<struct iovec> tx_iov;
   std::deque<tx_desc_ctx *> ready_segments;
 
   bool hwb;
@@ -629,6 +632,9 @@ void xsum_udp(void *udpphdr, size_t l4len);
 // calculates the full ipv4 & tcp checksum without assuming any pseudo header
 // xsums
 void xsum_tcpip_tso(void *iphdr, uint8_t iplen, uint8_t l4len, uint16_t paylen);
+// same, with the payload in the `n` pieces of `pay` instead of after the header
+void xsum_tcpip_tso_sg(void *iphdr, uint8_t iplen, uint8_t l4len,
+                       const struct iovec *pay, size_t n, uint16_t paylen);
 
 void tso_postupdate_header(void *iphdr, uint8_t iplen, uint8_t l4len,
                            uint16_t paylen);
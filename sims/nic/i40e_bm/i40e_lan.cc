@@ -553,8 +553,18 @@ bool lan_queue_tx::trigger_tx_packet() {
   (void)iipt;
 #endif
 
+  // bytes below copy_limit are staged in pktbuf since the checksum offloads
+  // modify them, the rest is sent directly from the descriptor buffers
+  uint32_t copy_limit = 0;
+  if (tso)
+    copy_limit = maclen + iplen + l4len;
+  else if (l4t == I40E_TX_DESC_CMD_L4T_EOFT_TCP ||
+           l4t == I40E_TX_DESC_CMD_L4T_EOFT_UDP)
+    copy_limit = data_limit;
+
   // copy data for this segment
-  uint32_t off = 0;
+  tx_iov.resize(1);
+  uint32_t off = 0, pay_len = 0;
   for (dcnt = d_skip; dcnt < n && off < data_limit; dcnt++) {
     tx_desc_ctx *rd = ready_segments.at(dcnt);
     d1 = rd->d->cmd_type_offset_bsz;
@@ -573,16 +583,25 @@ bool lan_queue_tx::trigger_tx_packet() {
           << logger::endl;
 #endif
 
-      memcpy(pktbuf + tso_len, (uint8_t *)rd->data + (start - off),
-             end - start);
+      if (start < copy_limit) {
+        uint32_t copy_end = (end < copy_limit ? end : copy_limit);
+        memcpy(pktbuf + tso_len, (uint8_t *)rd->data + (start - off),
+               copy_end - start);
+        tso_len += copy_end - start;
+        start = copy_end;
+      }
+      if (start < end) {
+        tx_iov.push_back({(uint8_t *)rd->data + (start - off), end - start});
+        pay_len += end - start;
+      }
       tso_off = end;
-      tso_len += end - start;
     }
 
     off += pkt_len;
   }
 
-  assert(tso_len <= MTU);
+  assert(tso_len + pay_len <= MTU);
+  tx_iov[0] = {pktbuf, tso_len};
 
   if (!tso) {
 #ifdef DEBUG_LAN
@@ -597,24 +616,23 @@ bool lan_queue_tx::trigger_tx_packet() {
       xsum_udp(pktbuf + udp_off, tso_len - udp_off);
     }
 
-    dev.runner_->EthSend(pktbuf, tso_len);
+    dev.runner_->EthSendSG(tx_iov.data(), tx_iov.size());
   } else {
 #ifdef DEBUG_LAN
-    log << "    tso packet off=" << tso_off << " len=" << tso_len
+    log << "    tso packet off=" << tso_off << " len=" << tso_len + pay_len
         << logger::endl;
 #endif
 
     // TSO gets hairier
     uint16_t hdrlen = maclen + iplen + l4len;
 
-    // calculate payload size
-    tso_paylen = tso_len - hdrlen;
-    if (tso_paylen > tso_mss)
-      tso_paylen = tso_mss;
+    // payload of this segment, at most tso_mss as bounded by data_limit
+    tso_paylen = pay_len;
 
-    xsum_tcpip_tso(pktbuf + maclen, iplen, l4len, tso_paylen);
+    xsum_tcpip_tso_sg(pktbuf + maclen, iplen, l4len, tx_iov.data() + 1,
+                      tx_iov.size() - 1, tso_paylen);
 
-    dev.runner_->EthSend(pktbuf, tso_len);
+    dev.runner_->EthSendSG(tx_iov.data(), tx_iov.size());
 
     tso_postupdate_header(pktbuf + maclen, iplen, l4len, tso_paylen);
 
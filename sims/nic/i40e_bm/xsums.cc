@@ -132,6 +132,12 @@ void xsum_tcp(void *tcphdr, size_t l4_len) {
 
 void xsum_tcpip_tso(void *iphdr, uint8_t iplen, uint8_t l4len,
                     uint16_t paylen) {
+  struct iovec pay = {(uint8_t *)iphdr + iplen + l4len, paylen};
+  xsum_tcpip_tso_sg(iphdr, iplen, l4len, &pay, 1, paylen);
+}
+
+void xsum_tcpip_tso_sg(void *iphdr, uint8_t iplen, uint8_t l4len,
+                       const struct iovec *pay, size_t n, uint16_t paylen) {
   struct ipv4_hdr *ih = (struct ipv4_hdr *)iphdr;
   struct rte_tcp_hdr *tcph = (struct rte_tcp_hdr *)((uint8_t *)iphdr + iplen);
   uint32_t cksum;
@@ -144,11 +150,21 @@ void xsum_tcpip_tso(void *iphdr, uint8_t iplen, uint8_t l4len,
   cksum = (~cksum) & 0xffff;
   ih->hdr_checksum = cksum;
 
-  // calculate tcp xsum
+  // calculate tcp xsum, pieces starting at an odd offset contribute their sum
+  // byte swapped
   tcph->cksum = 0;
-  cksum = rte_raw_cksum(tcph, l4len + paylen);
+  cksum = rte_raw_cksum(tcph, l4len);
+  size_t off = l4len;
+  for (size_t i = 0; i < n; i++) {
+    uint16_t sum = rte_raw_cksum(pay[i].iov_base, pay[i].iov_len);
+    if (off & 1)
+      sum = (uint16_t)((sum << 8) | (sum >> 8));
+    cksum += sum;
+    off += pay[i].iov_len;
+  }
   cksum += rte_ipv4_phdr_cksum(ih);
   cksum = ((cksum & 0xffff0000) >> 16) + (cksum & 0xffff);
+  cksum = ((cksum & 0xffff0000) >> 16) + (cksum & 0xffff);
   cksum = (~cksum) & 0xffff;
   tcph->cksum = cksum;
 }
@@ -0,0 +1,250 @@
+/*
+ * Copyright 2024 Max Planck Institute for Software Systems, and
+ * National University of Singapore
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+/*
+ * nicbm-evbench: replay an event trace recorded by a nicbm device (see
+ * SIMBRICKS_EVENT_TRACE) against the runner's event heap and against the
+ * ordered multiset it replaced, and report the time per operation. Without a
+ * trace file, a trace is generated that mimics the interrupt throttling timers
+ * of i40e_bm: vectors are re-armed sooner on every interrupt and fire once
+ * their throttling interval expired.
+ */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <set>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include "lib/simbricks/nicbm/event_heap.h"
+
+using nicbm::EventTraceEntry;
+using nicbm::TimedEvent;
+
+struct Op {
+  uint8_t op;
+  uint32_t event;
+  uint64_t time;
+  int priority;
+};
+
+struct EventCmp {
+  bool operator()(TimedEvent *a, TimedEvent *b) const {
+    return a->time_ < b->time_ ||
+           (a->time_ == b->time_ && a->priority_ < b->priority_);
+  }
+};
+
+static bool LoadTrace(const char *path, std::vector<Op> &ops,
+                      size_t &num_events) {
+  FILE *f = fopen(path, "r");
+  if (!f) {
+    perror("LoadTrace: fopen failed");
+    return false;
+  }
+
+  std::unordered_map<uint64_t, uint32_t> ids;
+  EventTraceEntry ent;
+  while (fread(&ent, sizeof(ent), 1, f) == 1) {
+    auto it = ids.emplace(ent.event, ids.size()).first;
+    ops.push_back({ent.op, it->second, ent.time, ent.priority});
+  }
+  fclose(f);
+  num_events = ids.size();
+  return true;
+}
+
+static void GenerateTrace(size_t num_ops, size_t vectors, std::vector<Op> &ops,
+                          size_t &num_events) {
+  std::vector<bool> armed(vectors, false);
+  std::vector<uint64_t> at(vectors, 0);
+  std::vector<uint64_t> seq(vectors, 0);
+  uint64_t now = 0;
+  uint64_t itr = 2000000;  // 2us throttling interval
+  // equal times fire in the order scheduled, like in the runner
+  std::set<std::tuple<uint64_t, uint64_t, uint32_t>> due;
+
+  srand48(42);
+  while (ops.size() < num_ops) {
+    now += lrand48() % 50000;
+    // fire everything that is due
+    while (!due.empty() && std::get<0>(*due.begin()) <= now) {
+      uint32_t v = std::get<2>(*due.begin());
+      due.erase(due.begin());
+      armed[v] = false;
+      ops.push_back({nicbm::kEventTraceTrigger, v, at[v], 0});
+    }
+
+    // interrupt on a vector, sometimes with a lower delay (e.g. link events)
+    uint32_t v = lrand48() % vectors;
+    uint64_t t = now + (lrand48() % 8 == 0 ? 0 : itr);
+    if (armed[v] && at[v] <= t)
+      continue;
+    if (armed[v]) {
+      ops.push_back({nicbm::kEventTraceCancel, v, at[v], 0});
+      due.erase({at[v], seq[v], v});
+    }
+    armed[v] = true;
+    at[v] = t;
+    seq[v] = ops.size();
+    due.insert({t, seq[v], v});
+    ops.push_back({nicbm::kEventTraceSchedule, v, t, 0});
+  }
+  num_events = vectors;
+}
+
+static double ReplayHeap(const std::vector<Op> &ops,
+                         std::vector<TimedEvent> &evs, size_t &mismatch) {
+  nicbm::EventHeap heap;
+  auto start = std::chrono::steady_clock::now();
+  for (const Op &op : ops) {
+    TimedEvent &ev = evs[op.event];
+    switch (op.op) {
+      case nicbm::kEventTraceSchedule:
+        if (ev.Scheduled())
+          heap.Remove(&ev);
+        ev.time_ = op.time;
+        ev.priority_ = op.priority;
+        heap.Push(&ev);
+        break;
+      case nicbm::kEventTraceCancel:
+        if (ev.Scheduled())
+          heap.Remove(&ev);
+        break;
+      case nicbm::kEventTraceTrigger:
+        if (heap.Top() != &ev)
+          mismatch++;
+        if (ev.Scheduled())
+          heap.Remove(&ev);
+        break;
+    }
+  }
+  auto end = std::chrono::steady_clock::now();
+  while (heap.Pop()) {
+  }
+  return std::chrono::duration<double, std::nano>(end - start).count();
+}
+
+static double ReplaySet(const std::vector<Op> &ops,
+                        std::vector<TimedEvent> &evs, size_t &mismatch) {
+  std::multiset<TimedEvent *, EventCmp> set;
+  std::vector<bool> queued(evs.size(), false);
+  auto erase = [&set](TimedEvent *ev) {
+    auto range = set.equal_range(ev);
+    for (auto it = range.first; it != range.second; ++it) {
+      if (*it == ev) {
+        set.erase(it);
+        return;
+      }
+    }
+  };
+
+  auto start = std::chrono::steady_clock::now();
+  for (const Op &op : ops) {
+    TimedEvent &ev = evs[op.event];
+    switch (op.op) {
+      case nicbm::kEventTraceSchedule:
+        if (queued[op.event])
+          erase(&ev);
+        ev.time_ = op.time;
+        ev.priority_ = op.priority;
+        set.insert(&ev);
+        queued[op.event] = true;
+        break;
+      case nicbm::kEventTraceCancel:
+      case nicbm::kEventTraceTrigger:
+        if (op.op == nicbm::kEventTraceTrigger &&
+            (set.empty() || *set.begin() != &ev))
+          mismatch++;
+        if (queued[op.event])
+          erase(&ev);
+        queued[op.event] = false;
+        break;
+    }
+  }
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(end - start).count();
+}
+
+int main(int argc, char *argv[]) {
+  size_t num_ops = 10000000;
+  size_t vectors = 64;
+  unsigned rounds = 5;
+  int c;
+  while ((c = getopt(argc, argv, "n:v:r:")) != -1) {
+    switch (c) {
+      case 'n':
+        num_ops = strtoull(optarg, nullptr, 0);
+        break;
+      case 'v':
+        vectors = strtoull(optarg, nullptr, 0);
+        break;
+      case 'r':
+        rounds = strtoul(optarg, nullptr, 0);
+        break;
+      default:
+        fprintf(stderr,
+                "Usage: nicbm-evbench [-n OPS] [-v VECTORS] [-r ROUNDS] "
+                "[TRACE]\n");
+        return EXIT_FAILURE;
+    }
+  }
+
+  std::vector<Op> ops;
+  size_t num_events;
+  if (optind < argc) {
+    if (!LoadTrace(argv[optind], ops, num_events))
+      return EXIT_FAILURE;
+  } else {
+    GenerateTrace(num_ops, vectors, ops, num_events);
+  }
+  if (ops.empty()) {
+    fprintf(stderr, "empty trace\n");
+    return EXIT_FAILURE;
+  }
+  printf("%zu operations on %zu events\n", ops.size(), num_events);
+
+  std::vector<TimedEvent> evs(num_events);
+  double best_heap = 0, best_set = 0;
+  size_t mis_heap = 0, mis_set = 0;
+  for (unsigned r = 0; r < rounds; r++) {
+    double t = ReplayHeap(ops, evs, mis_heap);
+    if (r == 0 || t < best_heap)
+      best_heap = t;
+    t = ReplaySet(ops, evs, mis_set);
+    if (r == 0 || t < best_set)
+      best_set = t;
+  }
+
+  printf("%-10s %10.2f ns/op  trigger mismatches: %zu\n", "heap",
+         best_heap / ops.size(), mis_heap / rounds);
+  printf("%-10s %10.2f ns/op  trigger mismatches: %zu\n", "multiset",
+         best_set / ops.size(), mis_set / rounds);
+  return EXIT_SUCCESS;
+}
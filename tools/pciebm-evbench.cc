@@ -0,0 +1,189 @@
+/*
+ * Copyright 2024 Max Planck Institute for Software Systems, and
+ * National University of Singapore
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+/*
+ * pciebm-evbench: hold-model benchmark for the event queue of pciebm. The
+ * queue is filled with PENDING events, then every operation pops the earliest
+ * event and schedules a new one a random increment later, the way one-shot
+ * events allocated with PcieBM::EventAlloc() are used. The calendar queue is
+ * compared against the priority queue of heap-allocated events it replaced.
+ */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <queue>
+#include <vector>
+
+#include "lib/simbricks/pciebm/event_queue.hh"
+
+struct OldEvent {
+  uint64_t time;
+  int priority;
+};
+
+struct OldEventPtrGreater {
+  bool operator()(const std::unique_ptr<OldEvent> &lhs,
+                  const std::unique_ptr<OldEvent> &rhs) const {
+    return lhs->time > rhs->time ||
+           (lhs->time == rhs->time && lhs->priority > rhs->priority);
+  }
+};
+
+/* table of increments [ps], cycled through so that both queues see the same
+ * sequence and drawing random numbers is not part of the measurement */
+static const size_t kIncrements = 1 << 16;
+
+static std::vector<uint64_t> MakeIncrements(bool exponential, double mean) {
+  std::vector<uint64_t> incs(kIncrements);
+  srand48(42);
+  for (uint64_t &inc : incs) {
+    double x = drand48();
+    inc = static_cast<uint64_t>(exponential ? -mean * std::log(1 - x)
+                                            : 2 * mean * x);
+  }
+  return incs;
+}
+
+static double HoldCalendar(size_t pending, size_t num_ops,
+                           const std::vector<uint64_t> &incs,
+                           uint64_t &checksum) {
+  pciebm::EventQueue queue;
+  size_t i = 0;
+  for (; i < pending; i++) {
+    pciebm::TimedEvent *evt = queue.Alloc();
+    evt->time = incs[i % kIncrements];
+    queue.Schedule(evt);
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  for (size_t n = 0; n < num_ops; n++, i++) {
+    pciebm::TimedEvent *evt = queue.Pop();
+    uint64_t now = evt->time;
+    checksum += now;
+    queue.Free(evt);
+
+    evt = queue.Alloc();
+    evt->time = now + incs[i % kIncrements];
+    queue.Schedule(evt);
+  }
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double>(end - start).count();
+}
+
+static double HoldPrioQueue(size_t pending, size_t num_ops,
+                            const std::vector<uint64_t> &incs,
+                            uint64_t &checksum) {
+  std::priority_queue<std::unique_ptr<OldEvent>,
+                      std::vector<std::unique_ptr<OldEvent>>,
+                      OldEventPtrGreater>
+      queue;
+  size_t i = 0;
+  for (; i < pending; i++)
+    queue.push(std::make_unique<OldEvent>(OldEvent{incs[i % kIncrements], 0}));
+
+  auto start = std::chrono::steady_clock::now();
+  for (size_t n = 0; n < num_ops; n++, i++) {
+    // move the event out of the const top() like PcieBM::EventTrigger() did
+    std::unique_ptr<OldEvent> evt =
+        std::move(const_cast<std::unique_ptr<OldEvent> &>(queue.top()));
+    queue.pop();
+    uint64_t now = evt->time;
+    checksum += now;
+    evt.reset();
+
+    queue.push(
+        std::make_unique<OldEvent>(OldEvent{now + incs[i % kIncrements], 0}));
+  }
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double>(end - start).count();
+}
+
+int main(int argc, char *argv[]) {
+  size_t pending = 1000000;
+  size_t num_ops = 10000000;
+  double mean = 1000000;  // 1us
+  bool exponential = true;
+  unsigned rounds = 3;
+  int c;
+  while ((c = getopt(argc, argv, "p:n:m:ur:")) != -1) {
+    switch (c) {
+      case 'p':
+        pending = strtoull(optarg, nullptr, 0);
+        break;
+      case 'n':
+        num_ops = strtoull(optarg, nullptr, 0);
+        break;
+      case 'm':
+        mean = strtod(optarg, nullptr);
+        break;
+      case 'u':
+        exponential = false;
+        break;
+      case 'r':
+        rounds = strtoul(optarg, nullptr, 0);
+        break;
+      default:
+        fprintf(stderr,
+                "Usage: pciebm-evbench [-p PENDING] [-n OPS] [-m MEAN_PS] "
+                "[-u] [-r ROUNDS]\n");
+        return EXIT_FAILURE;
+    }
+  }
+  if (pending == 0 || rounds == 0) {
+    fprintf(stderr, "need at least one pending event and one round\n");
+    return EXIT_FAILURE;
+  }
+
+  std::vector<uint64_t> incs = MakeIncrements(exponential, mean);
+  printf("%zu operations on %zu pending events, %s increments, mean %.0f ps\n",
+         num_ops, pending, exponential ? "exponential" : "uniform", mean);
+
+  double best_cal = 0, best_pq = 0;
+  uint64_t sum_cal = 0, sum_pq = 0;
+  for (unsigned r = 0; r < rounds; r++) {
+    double t = HoldCalendar(pending, num_ops, incs, sum_cal);
+    if (r == 0 || t < best_cal)
+      best_cal = t;
+    t = HoldPrioQueue(pending, num_ops, incs, sum_pq);
+    if (r == 0 || t < best_pq)
+      best_pq = t;
+  }
+
+  printf("%-15s %8.2f M events/s\n", "calendar queue",
+         num_ops / best_cal / 1e6);
+  printf("%-15s %8.2f M events/s\n", "priority_queue", num_ops / best_pq / 1e6);
+  // equal times may pop in a different order, but the times must match
+  if (sum_cal != sum_pq) {
+    fprintf(stderr, "error: queues popped different event times\n");
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,44 @@
+# Copyright 2024 Max Planck Institute for Software Systems, and
+# National University of Singapore
+#
+# Permission is hereby granted, free of charge, to any person obtaining
+# a copy of this software and associated documentation files (the
+# "Software"), to deal in the Software without restriction, including
+# without limitation the rights to use, copy, modify, merge, publish,
+# distribute, sublicense, and/or sell copies of the Software, and to
+# permit persons to whom the Software is furnished to do so, subject to
+# the following conditions:
+#
+# The above copyright notice and this permission notice shall be
+# included in all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+# EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+# MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+# IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+# CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+# TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+# SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+include mk/subdir_pre.mk
+
+bin_simbricks_top := $(d)simbricks-top
+bin_simbricks_replay := $(d)simbricks-replay
+bin_nicbm_evbench := $(d)nicbm-evbench
+bin_simbricks_ringbench := $(d)simbricks-ringbench
+bin_pciebm_evbench := $(d)pciebm-evbench
+
+OBJS := $(d)simbricks-top.o $(d)simbricks-replay.o $(d)nicbm-evbench.o \
+    $(d)simbricks-ringbench.o $(d)pciebm-evbench.o
+
+$(bin_simbricks_top): $(d)simbricks-top.o
+$(bin_simbricks_replay): $(d)simbricks-replay.o $(lib_base)
+$(bin_nicbm_evbench): $(d)nicbm-evbench.o $(lib_nicbm)
+$(bin_simbricks_ringbench): $(d)simbricks-ringbench.o $(lib_base)
+$(bin_pciebm_evbench): $(d)pciebm-evbench.o $(lib_pciebm)
+
+CLEAN := $(bin_simbricks_top) $(bin_simbricks_replay) $(bin_nicbm_evbench) \
+    $(bin_simbricks_ringbench) $(bin_pciebm_evbench) $(OBJS)
+ALL := $(bin_simbricks_top) $(bin_simbricks_replay) $(bin_nicbm_evbench) \
+    $(bin_simbricks_ringbench) $(bin_pciebm_evbench)
+include mk/subdir_post.mk
@@ -0,0 +1,489 @@
+/*
+ * Copyright 2024 Max Planck Institute for Software Systems, and
+ * National University of Singapore
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * simbricks-replay: stand in for the peer of a recorded interface (see
+ * SIMBRICKS_RECORD_DIR). Connects to (or listens for) the component under test,
+ * feeds it the recorded incoming messages as fast as it accepts them, and
+ * checks the messages it sends against the recording.
+ *
+ * Inputs are only held back as far as needed to reproduce the recording:
+ * without synchronization an input is sent once all outputs recorded before it
+ * have been seen, with synchronization the component only acts on input
+ * timestamps and inputs are sent right away. Request ids chosen by the
+ * component (e.g. DMA requests) differ between runs, so they are excluded from
+ * the comparison and translated in the completions sent back. Sync mode
+ * switches are replayed like other messages, the rules above then follow the
+ * mode recorded for each message.
+ */
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <simbricks/base/if.h>
+#include <simbricks/base/proto.h>
+#include <simbricks/base/record.h>
+#include <simbricks/mem/proto.h>
+#include <simbricks/network/proto.h>
+#include <simbricks/pcie/proto.h>
+
+#define REQ_MAP_SIZE (1 << 16)
+#define MSG_HDR_LEN sizeof(union SimbricksProtoBaseMsg)
+
+/* comparison rules for a message type */
+struct TypeInfo {
+  /* header bytes defined by the protocol, the rest is padding */
+  size_t hdr_len;
+  /* starts with a request id chosen by the sender */
+  bool req;
+  /* starts with the request id of the request it completes */
+  bool comp;
+};
+
+struct ReqMap {
+  uint64_t rec_id;
+  uint64_t id;
+  bool valid;
+};
+
+static const struct SimbricksRecordHeader *hdr;
+static const struct SimbricksRecordEntry **ents;
+static size_t num_ents;
+/* synchronization in effect at each entry, changes with sync mode switches */
+static bool *ents_sync;
+static struct ReqMap req_map[REQ_MAP_SIZE];
+
+static size_t max_reports = 10;
+static uint64_t mismatches = 0;
+
+static uint64_t TimeNs(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static struct TypeInfo GetTypeInfo(uint8_t type) {
+  struct TypeInfo ti = {SIMBRICKS_RECORD_HDR_HEAD, false, false};
+
+  if (hdr->upper_layer_proto == SIMBRICKS_PROTO_ID_PCIE) {
+    switch (type) {
+      case SIMBRICKS_PROTO_PCIE_D2H_MSG_READ:
+      case SIMBRICKS_PROTO_PCIE_D2H_MSG_WRITE:
+        ti.hdr_len = 18;
+        ti.req = true;
+        break;
+      case SIMBRICKS_PROTO_PCIE_D2H_MSG_INTERRUPT:
+        ti.hdr_len = 3;
+        break;
+      case SIMBRICKS_PROTO_PCIE_D2H_MSG_READCOMP:
+      case SIMBRICKS_PROTO_PCIE_D2H_MSG_WRITECOMP:
+      case SIMBRICKS_PROTO_PCIE_H2D_MSG_READCOMP:
+      case SIMBRICKS_PROTO_PCIE_H2D_MSG_WRITECOMP:
+        ti.hdr_len = 8;
+        ti.comp = true;
+        break;
+      case SIMBRICKS_PROTO_PCIE_H2D_MSG_READ:
+      case SIMBRICKS_PROTO_PCIE_H2D_MSG_WRITE:
+      case SIMBRICKS_PROTO_PCIE_H2D_MSG_WRITE_POSTED:
+        ti.hdr_len = 19;
+        ti.req = true;
+        break;
+      case SIMBRICKS_PROTO_PCIE_H2D_MSG_DEVCTRL:
+        ti.hdr_len = 8;
+        break;
+    }
+  } else if (hdr->upper_layer_proto == SIMBRICKS_PROTO_ID_MEM) {
+    switch (type) {
+      case SIMBRICKS_PROTO_MEM_H2M_MSG_READ:
+      case SIMBRICKS_PROTO_MEM_H2M_MSG_WRITE:
+      case SIMBRICKS_PROTO_MEM_H2M_MSG_WRITE_POSTED:
+        ti.hdr_len = 26;
+        ti.req = true;
+        break;
+      case SIMBRICKS_PROTO_MEM_M2H_MSG_READCOMP:
+      case SIMBRICKS_PROTO_MEM_M2H_MSG_WRITECOMP:
+        ti.hdr_len = 8;
+        ti.comp = true;
+        break;
+    }
+  } else if (hdr->upper_layer_proto == SIMBRICKS_PROTO_ID_NET) {
+    if (type == SIMBRICKS_PROTO_NET_MSG_PACKET)
+      ti.hdr_len = 3;
+  }
+  return ti;
+}
+
+static struct ReqMap *ReqMapSlot(uint64_t rec_id) {
+  return &req_map[(rec_id * 0x9e3779b97f4a7c15ULL) >> 48];
+}
+
+static const uint8_t *EntryData(const struct SimbricksRecordEntry *ent) {
+  return (const uint8_t *)(ent + 1);
+}
+
+static uint64_t EntryReqId(const struct SimbricksRecordEntry *ent) {
+  uint64_t id;
+  memcpy(&id, EntryData(ent), sizeof(id));
+  return id;
+}
+
+/* outputs of the component that are compared against the recording */
+static bool IsComparedOut(const struct SimbricksRecordEntry *ent) {
+  return ent->dir == SIMBRICKS_RECORD_DIR_OUT &&
+         ent->type >= SIMBRICKS_PROTO_MSG_TYPE_UPPER_START;
+}
+
+static int LoadRecording(const char *path) {
+  int fd;
+  struct stat st;
+
+  if ((fd = open(path, O_RDONLY)) < 0 || fstat(fd, &st) != 0) {
+    perror("LoadRecording: open failed");
+    return -1;
+  }
+  const uint8_t *base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) {
+    perror("LoadRecording: mmap failed");
+    return -1;
+  }
+
+  const uint8_t *end = base + st.st_size;
+  hdr = (const struct SimbricksRecordHeader *)base;
+  if ((size_t)st.st_size < sizeof(*hdr) ||
+      hdr->magic != SIMBRICKS_RECORD_MAGIC ||
+      (size_t)st.st_size < sizeof(*hdr) + hdr->intro_len) {
+    fprintf(stderr, "LoadRecording: %s is not a SimBricks recording\n", path);
+    return -1;
+  }
+
+  /* index entries, ignoring a truncated last one */
+  const uint8_t *first = base + sizeof(*hdr) + hdr->intro_len;
+  const uint8_t *p;
+  size_t n = 0;
+  for (p = first; p + sizeof(**ents) <= end;) {
+    const struct SimbricksRecordEntry *ent =
+        (const struct SimbricksRecordEntry *)p;
+    if (ent->len < SIMBRICKS_RECORD_HDR_HEAD ||
+        p + sizeof(*ent) + ent->len > end)
+      break;
+    p += sizeof(*ent) + ent->len;
+    n++;
+  }
+
+  if ((ents = calloc(n + 1, sizeof(*ents))) == NULL ||
+      (ents_sync = calloc(n + 1, sizeof(*ents_sync))) == NULL) {
+    perror("LoadRecording: calloc failed");
+    return -1;
+  }
+  bool sync = (hdr->flags & SIMBRICKS_RECORD_FLAGS_SYNC);
+  for (p = first; num_ents < n; num_ents++) {
+    const struct SimbricksRecordEntry *ent =
+        (const struct SimbricksRecordEntry *)p;
+    ents[num_ents] = ent;
+    ents_sync[num_ents] = sync;
+    p += sizeof(**ents) + ent->len;
+
+    /* both sides switch once the request is acknowledged */
+    const struct SimbricksProtoBaseMsgSyncMode *sm =
+        (const struct SimbricksProtoBaseMsgSyncMode *)EntryData(ent);
+    if (ent->type == SIMBRICKS_PROTO_MSG_TYPE_SYNC_MODE &&
+        (sm->flags & SIMBRICKS_PROTO_SYNC_MODE_ACK))
+      sync = (sm->flags & SIMBRICKS_PROTO_SYNC_MODE_ENABLE);
+  }
+  return 0;
+}
+
+/* check if the next input may be sent yet */
+static bool InputReady(const struct SimbricksRecordEntry *ent, size_t pos,
+                       size_t cmp_pos) {
+  /* all outputs recorded before have been seen */
+  if (cmp_pos > pos)
+    return true;
+  if (!ents_sync[pos])
+    return false;
+
+  /* a completion must wait for the request id of its request */
+  if (!GetTypeInfo(ent->type).comp)
+    return true;
+  struct ReqMap *rm = ReqMapSlot(EntryReqId(ent));
+  return rm->valid && rm->rec_id == EntryReqId(ent);
+}
+
+static bool SendInput(struct SimbricksBaseIf *bif,
+                      const struct SimbricksRecordEntry *ent) {
+  size_t len = ent->len + SIMBRICKS_RECORD_HDR_SKIP;
+  uint64_t ts = ent->timestamp;
+  ts = (ts >= hdr->link_latency ? ts - hdr->link_latency : 0);
+
+  volatile union SimbricksProtoBaseMsg *msg =
+      SimbricksBaseIfOutAllocLen(bif, ts, len);
+  if (msg == NULL)
+    return false;
+
+  uint8_t *bytes = (uint8_t *)(uintptr_t)msg;
+  memcpy(bytes, EntryData(ent), SIMBRICKS_RECORD_HDR_HEAD);
+  memcpy(bytes + MSG_HDR_LEN, EntryData(ent) + SIMBRICKS_RECORD_HDR_HEAD,
+         len - MSG_HDR_LEN);
+
+  if (GetTypeInfo(ent->type).comp) {
+    struct ReqMap *rm = ReqMapSlot(EntryReqId(ent));
+    if (rm->valid && rm->rec_id == EntryReqId(ent)) {
+      memcpy(bytes, &rm->id, sizeof(rm->id));
+      rm->valid = false;
+    }
+  }
+
+  SimbricksBaseIfOutSend(bif, msg, ent->type);
+  return true;
+}
+
+/* report a mismatch in a field or, if `off` is not SIZE_MAX, a byte */
+static void Mismatch(size_t idx, const char *what, size_t off,
+                     uint64_t expected, uint64_t actual) {
+  if (mismatches++ >= max_reports)
+    return;
+  fprintf(stderr, "mismatch at entry %zu: %s", idx, what);
+  if (off != SIZE_MAX)
+    fprintf(stderr, " %zu", off);
+  fprintf(stderr, " expected %#lx got %#lx\n", expected, actual);
+}
+
+static void CheckOutput(size_t idx, volatile union SimbricksProtoBaseMsg *msg,
+                        uint8_t type) {
+  const struct SimbricksRecordEntry *ent = ents[idx];
+  const uint8_t *rec = EntryData(ent);
+  const uint8_t *bytes = (const uint8_t *)(uintptr_t)msg;
+  size_t i;
+
+  if (type != ent->type) {
+    Mismatch(idx, "type", SIZE_MAX, ent->type, type);
+    return;
+  }
+  if (ents_sync[idx] && msg->header.timestamp != ent->timestamp)
+    Mismatch(idx, "timestamp", SIZE_MAX, ent->timestamp,
+             msg->header.timestamp);
+
+  struct TypeInfo ti = GetTypeInfo(type);
+  for (i = (ti.req ? sizeof(uint64_t) : 0); i < ti.hdr_len; i++) {
+    if (bytes[i] != rec[i]) {
+      Mismatch(idx, "header byte", i, rec[i], bytes[i]);
+      return;
+    }
+  }
+  size_t data_len = ent->len - SIMBRICKS_RECORD_HDR_HEAD;
+  for (i = 0; i < data_len; i++) {
+    if (bytes[MSG_HDR_LEN + i] != rec[SIMBRICKS_RECORD_HDR_HEAD + i]) {
+      Mismatch(idx, "data byte", i, rec[SIMBRICKS_RECORD_HDR_HEAD + i],
+               bytes[MSG_HDR_LEN + i]);
+      return;
+    }
+  }
+
+  if (ti.req) {
+    struct ReqMap *rm = ReqMapSlot(EntryReqId(ent));
+    rm->rec_id = EntryReqId(ent);
+    memcpy(&rm->id, bytes, sizeof(rm->id));
+    rm->valid = true;
+  }
+}
+
+static size_t NextCompared(size_t pos) {
+  while (pos < num_ents && !IsComparedOut(ents[pos]))
+    pos++;
+  return pos;
+}
+
+static void Usage(const char *prog) {
+  fprintf(stderr,
+          "Usage: %s [-t IDLE_MS] [-m MAX_REPORTS] RECORDING SOCKET [SHM]\n"
+          "  -t  give up after this long without progress (default 1000)\n"
+          "  -m  number of mismatches to report in detail (default 10)\n"
+          "  SHM is required if the recording was made by a connecter, the\n"
+          "  replay then listens on SOCKET for the component under test.\n",
+          prog);
+}
+
+int main(int argc, char *argv[]) {
+  uint64_t idle_ms = 1000;
+  int c;
+
+  while ((c = getopt(argc, argv, "t:m:h")) != -1) {
+    switch (c) {
+      case 't':
+        idle_ms = strtoull(optarg, NULL, 0);
+        break;
+      case 'm':
+        max_reports = strtoull(optarg, NULL, 0);
+        break;
+      default:
+        Usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+  }
+  if (argc - optind < 2 || LoadRecording(argv[optind]) != 0) {
+    Usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  bool do_connect = (hdr->flags & SIMBRICKS_RECORD_FLAGS_LISTENER);
+  if (!do_connect && argc - optind < 3) {
+    Usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  struct SimbricksBaseIfParams params;
+  SimbricksBaseIfDefaultParams(&params);
+  params.sock_path = argv[optind + 1];
+  params.upper_layer_proto = hdr->upper_layer_proto;
+  params.link_latency = hdr->link_latency;
+  params.sync_interval = hdr->sync_interval;
+  bool sync_mode = (hdr->flags & SIMBRICKS_RECORD_FLAGS_SYNC);
+  params.sync_mode =
+      (sync_mode ? kSimbricksBaseIfSyncRequired : kSimbricksBaseIfSyncDisabled);
+  params.multi_slot = (hdr->flags & SIMBRICKS_RECORD_FLAGS_MULTI_SLOT);
+  params.adaptive_sync = (hdr->flags & SIMBRICKS_RECORD_FLAGS_ADAPTIVE_SYNC);
+  params.sync_switch = (hdr->flags & SIMBRICKS_RECORD_FLAGS_SYNC_SWITCH);
+  params.blocking_conn = true;
+  params.record_dir = NULL;
+  /* as the listener we set up the queues the way the recording saw them */
+  params.in_num_entries = hdr->out_nentries;
+  params.in_entries_size = hdr->out_elen;
+  params.out_num_entries = hdr->in_nentries;
+  params.out_entries_size = hdr->in_elen;
+
+  struct SimbricksBaseIf bif;
+  struct SimbricksBaseIfSHMPool pool;
+  if (SimbricksBaseIfInit(&bif, &params)) {
+    fprintf(stderr, "SimbricksBaseIfInit failed\n");
+    return EXIT_FAILURE;
+  }
+  if (do_connect) {
+    if (SimbricksBaseIfConnect(&bif)) {
+      fprintf(stderr, "SimbricksBaseIfConnect failed\n");
+      return EXIT_FAILURE;
+    }
+  } else {
+    memset(&pool, 0, sizeof(pool));
+    if (SimbricksBaseIfSHMPoolCreate(&pool, argv[optind + 2],
+                                     SimbricksBaseIfSHMSize(&params)) ||
+        SimbricksBaseIfListen(&bif, &pool)) {
+      fprintf(stderr, "SimbricksBaseIfListen failed\n");
+      return EXIT_FAILURE;
+    }
+  }
+
+  uint8_t rx_intro[2048];
+  struct SimBricksBaseIfEstablishData ests = {
+      .base_if = &bif,
+      .tx_intro = hdr + 1,
+      .tx_intro_len = hdr->intro_len,
+      .rx_intro = rx_intro,
+      .rx_intro_len = sizeof(rx_intro),
+  };
+  if (SimBricksBaseIfEstablish(&ests, 1)) {
+    fprintf(stderr, "SimBricksBaseIfEstablish failed\n");
+    return EXIT_FAILURE;
+  }
+
+  uint64_t sent = 0, received = 0, extra = 0;
+  size_t send_pos = 0;
+  size_t cmp_pos = NextCompared(0);
+  bool terminated = false, timeout = false;
+  uint64_t start = TimeNs();
+  uint64_t last_progress = start;
+
+  while (!terminated) {
+    bool progress = false;
+
+    while (send_pos < num_ents) {
+      const struct SimbricksRecordEntry *ent = ents[send_pos];
+      if (ent->dir == SIMBRICKS_RECORD_DIR_IN &&
+          ent->type != SIMBRICKS_PROTO_MSG_TYPE_TERMINATE) {
+        if (!InputReady(ent, send_pos, cmp_pos) || !SendInput(&bif, ent))
+          break;
+        sent++;
+        progress = true;
+      }
+      send_pos++;
+    }
+
+    volatile union SimbricksProtoBaseMsg *msg;
+    while ((msg = SimbricksBaseIfInPoll(&bif, UINT64_MAX)) != NULL) {
+      uint8_t type = SimbricksBaseIfInType(&bif, msg);
+      if (type == SIMBRICKS_PROTO_MSG_TYPE_TERMINATE) {
+        terminated = true;
+      } else if (type >= SIMBRICKS_PROTO_MSG_TYPE_UPPER_START) {
+        received++;
+        if (cmp_pos < num_ents) {
+          CheckOutput(cmp_pos, msg, type);
+          cmp_pos = NextCompared(cmp_pos + 1);
+        } else {
+          extra++;
+        }
+      }
+      SimbricksBaseIfInDone(&bif, msg);
+      progress = true;
+    }
+
+    if (send_pos == num_ents && cmp_pos == num_ents)
+      break;
+
+    uint64_t now = TimeNs();
+    if (progress) {
+      last_progress = now;
+    } else if (now - last_progress > idle_ms * 1000000ULL) {
+      timeout = true;
+      break;
+    } else {
+      /* let the component run if it shares our core */
+      sched_yield();
+    }
+  }
+
+  double secs = ((timeout ? last_progress : TimeNs()) - start) / 1e9;
+  size_t missing = 0;
+  for (; cmp_pos < num_ents; cmp_pos = NextCompared(cmp_pos + 1))
+    missing++;
+
+  printf("replayed %lu inputs, received %lu outputs in %.3f s (%.0f msgs/s)\n",
+         sent, received, secs, (secs > 0 ? (sent + received) / secs : 0));
+  printf("mismatches: %lu, missing outputs: %zu, extra outputs: %lu%s\n",
+         mismatches, missing, extra, (timeout ? " (timed out)" : ""));
+
+  SimbricksBaseIfClose(&bif);
+  if (!do_connect)
+    SimbricksBaseIfSHMPoolUnlink(&pool);
+  return (mismatches == 0 && missing == 0 && extra == 0 ? EXIT_SUCCESS
+                                                         : EXIT_FAILURE);
+}
@@ -0,0 +1,230 @@
+/*
+ * Copyright 2024 Max Planck Institute for Software Systems, and
+ * National University of Singapore
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * simbricks-ringbench: two-process producer/consumer throughput benchmark for
+ * the base interface queues. Forks a producer that connects to a listening
+ * consumer, streams messages through one queue as fast as the consumer takes
+ * them, and reports messages per second for the v1 and the v2 queue layout
+ * (see `SimbricksBaseIfParams.ring_v2`). Pin the two processes to different
+ * cores (-p) to include cross-core cache traffic in the measurement.
+ */
+
+#define _GNU_SOURCE
+#include <getopt.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <simbricks/base/if.h>
+#include <simbricks/base/proto.h>
+
+static uint64_t num_msgs = 2000000;
+static size_t num_entries = 1024;
+static size_t entry_size = 128;
+static int cpu_prod = -1;
+static int cpu_cons = -1;
+
+static uint64_t TimeNs(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void Pin(int cpu) {
+  if (cpu < 0)
+    return;
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  if (sched_setaffinity(0, sizeof(set), &set))
+    perror("sched_setaffinity");
+}
+
+static void Usage(const char *prog) {
+  fprintf(stderr,
+          "Usage: %s [-n MSGS] [-e ENTRIES] [-s ENTRY_SIZE] [-p PROD_CPU,"
+          "CONS_CPU] [-1|-2]\n",
+          prog);
+}
+
+static int Establish(struct SimbricksBaseIf *bif) {
+  uint8_t tx_intro = 0;
+  uint8_t rx_intro[64];
+  struct SimBricksBaseIfEstablishData ests = {
+      .base_if = bif,
+      .tx_intro = &tx_intro,
+      .tx_intro_len = sizeof(tx_intro),
+      .rx_intro = rx_intro,
+      .rx_intro_len = sizeof(rx_intro),
+  };
+  return SimBricksBaseIfEstablish(&ests, 1);
+}
+
+static int Producer(struct SimbricksBaseIfParams *params) {
+  Pin(cpu_prod);
+  struct SimbricksBaseIf bif;
+  if (SimbricksBaseIfInit(&bif, params) || SimbricksBaseIfConnect(&bif) ||
+      Establish(&bif)) {
+    fprintf(stderr, "producer: connecting failed\n");
+    return EXIT_FAILURE;
+  }
+
+  for (uint64_t i = 0; i < num_msgs; i++) {
+    volatile union SimbricksProtoBaseMsg *msg;
+    while ((msg = SimbricksBaseIfOutAlloc(&bif, i)) == NULL) {
+      /* let the consumer run if it shares our core */
+      if (cpu_prod < 0 || cpu_prod == cpu_cons)
+        sched_yield();
+    }
+    msg->header.pad[0] = (uint8_t)i;
+    SimbricksBaseIfOutSend(&bif, msg, SIMBRICKS_PROTO_MSG_TYPE_UPPER_START);
+  }
+
+  SimbricksBaseIfClose(&bif);
+  return EXIT_SUCCESS;
+}
+
+static int Run(bool ring_v2, const char *sock_path, const char *shm_path) {
+  struct SimbricksBaseIfParams params;
+  SimbricksBaseIfDefaultParams(&params);
+  params.sock_path = sock_path;
+  params.sync_mode = kSimbricksBaseIfSyncDisabled;
+  params.in_num_entries = params.out_num_entries = num_entries;
+  params.in_entries_size = params.out_entries_size = entry_size;
+  params.ring_v2 = ring_v2;
+  params.record_dir = NULL;
+
+  struct SimbricksBaseIf bif;
+  struct SimbricksBaseIfSHMPool pool;
+  memset(&pool, 0, sizeof(pool));
+  if (SimbricksBaseIfInit(&bif, &params) ||
+      SimbricksBaseIfSHMPoolCreate(&pool, shm_path,
+                                   SimbricksBaseIfSHMSize(&params)) ||
+      SimbricksBaseIfListen(&bif, &pool)) {
+    fprintf(stderr, "consumer: listening failed\n");
+    return -1;
+  }
+
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid < 0) {
+    perror("fork");
+    return -1;
+  } else if (pid == 0) {
+    exit(Producer(&params));
+  }
+
+  Pin(cpu_cons);
+  if (Establish(&bif)) {
+    fprintf(stderr, "consumer: establishing connection failed\n");
+    return -1;
+  }
+
+  uint64_t start = TimeNs();
+  uint64_t received = 0;
+  uint8_t check = 0;
+  while (received < num_msgs) {
+    volatile union SimbricksProtoBaseMsg *msg =
+        SimbricksBaseIfInPoll(&bif, UINT64_MAX);
+    if (msg == NULL) {
+      if (cpu_cons < 0 || cpu_prod == cpu_cons)
+        sched_yield();
+      continue;
+    }
+    check ^= msg->header.pad[0] ^ (uint8_t)received;
+    SimbricksBaseIfInDone(&bif, msg);
+    received++;
+  }
+  uint64_t elapsed = TimeNs() - start;
+  bool negotiated_v2 = bif.ring_v2;
+
+  SimbricksBaseIfClose(&bif);
+  SimbricksBaseIfSHMPoolUnlink(&pool);
+  unlink(sock_path);
+  int status;
+  waitpid(pid, &status, 0);
+
+  printf("%s: %lu msgs in %.3f s, %.2f Mmsg/s, %.2f ns/msg%s\n",
+         (negotiated_v2 ? "v2" : "v1"), received, elapsed / 1e9,
+         received * 1e3 / elapsed, (double)elapsed / received,
+         (check != 0 ? " (payload mismatch)" : ""));
+  return (check == 0 && WIFEXITED(status) &&
+                  WEXITSTATUS(status) == EXIT_SUCCESS
+              ? 0
+              : -1);
+}
+
+int main(int argc, char *argv[]) {
+  bool run_v1 = true, run_v2 = true;
+  int c;
+  while ((c = getopt(argc, argv, "n:e:s:p:12h")) != -1) {
+    switch (c) {
+      case 'n':
+        num_msgs = strtoull(optarg, NULL, 0);
+        break;
+      case 'e':
+        num_entries = strtoull(optarg, NULL, 0);
+        break;
+      case 's':
+        entry_size = strtoull(optarg, NULL, 0);
+        break;
+      case 'p':
+        if (sscanf(optarg, "%d,%d", &cpu_prod, &cpu_cons) != 2) {
+          Usage(argv[0]);
+          return EXIT_FAILURE;
+        }
+        break;
+      case '1':
+        run_v2 = false;
+        break;
+      case '2':
+        run_v1 = false;
+        break;
+      default:
+        Usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+  }
+
+  char sock_path[64], shm_path[64];
+  snprintf(sock_path, sizeof(sock_path), "/tmp/simbricks-ringbench.%d.sock",
+           getpid());
+  snprintf(shm_path, sizeof(shm_path), "/tmp/simbricks-ringbench.%d.shm",
+           getpid());
+
+  printf("%lu msgs, %zu entries of %zu bytes\n", num_msgs, num_entries,
+         entry_size);
+  int ret = 0;
+  if (run_v1)
+    ret |= Run(false, sock_path, shm_path);
+  if (run_v2)
+    ret |= Run(true, sock_path, shm_path);
+  return (ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+}
@@ -0,0 +1,337 @@
+/*
+ * Copyright 2024 Max Planck Institute for Software Systems, and
+ * National University of Singapore
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * simbricks-top: live view of the queue statistics of all SimBricks
+ * interfaces in a run. Maps the header of every SHM pool found under the given
+ * directories (and optionally of memfd pools of running processes) read-only
+ * and periodically prints message and sync rates, queue-full stalls, poll
+ * success rates, and simulation time progress per link.
+ */
+
+#define _GNU_SOURCE
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <getopt.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <simbricks/base/proto.h>
+
+#define MAX_POOLS 1024
+
+struct Sample {
+  struct SimbricksProtoBaseIfStats stats[2];
+};
+
+struct Pool {
+  dev_t dev;
+  ino_t ino;
+  const volatile struct SimbricksProtoPoolHeader *hdr;
+  struct Sample prev[SIMBRICKS_PROTO_POOL_MAX_IFS];
+  bool have_prev[SIMBRICKS_PROTO_POOL_MAX_IFS];
+};
+
+static struct Pool pools[MAX_POOLS];
+static size_t num_pools = 0;
+static volatile sig_atomic_t exiting = 0;
+
+static void sigint_handler(int dummy) {
+  exiting = 1;
+}
+
+static uint64_t TimeNs(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* map pool header if fd refers to a SimBricks pool we have not seen yet */
+static void PoolAdd(int fd) {
+  struct stat st;
+  uint64_t magic;
+  size_t i;
+
+  if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) ||
+      st.st_size < SIMBRICKS_PROTO_POOL_HDR_SIZE)
+    return;
+  for (i = 0; i < num_pools; i++) {
+    if (pools[i].dev == st.st_dev && pools[i].ino == st.st_ino)
+      return;
+  }
+  if (num_pools >= MAX_POOLS ||
+      pread(fd, &magic, sizeof(magic), 0) != sizeof(magic) ||
+      magic != SIMBRICKS_PROTO_POOL_MAGIC)
+    return;
+
+  void *p =
+      mmap(NULL, SIMBRICKS_PROTO_POOL_HDR_SIZE, PROT_READ, MAP_SHARED, fd, 0);
+  if (p == MAP_FAILED) {
+    perror("PoolAdd: mmap failed");
+    return;
+  }
+
+  struct Pool *pool = &pools[num_pools++];
+  memset(pool, 0, sizeof(*pool));
+  pool->dev = st.st_dev;
+  pool->ino = st.st_ino;
+  pool->hdr = p;
+}
+
+static int ScanFile(const char *path, const struct stat *st, int type,
+                    struct FTW *ftw) {
+  if (type != FTW_F || !S_ISREG(st->st_mode) ||
+      st->st_size < SIMBRICKS_PROTO_POOL_HDR_SIZE)
+    return 0;
+
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return 0;
+  PoolAdd(fd);
+  close(fd);
+  return 0;
+}
+
+/* find memfd pools through the fd tables of all processes we can access */
+static void ScanProc(void) {
+  DIR *proc = opendir("/proc");
+  struct dirent *pe;
+
+  if (proc == NULL) {
+    perror("ScanProc: opendir /proc failed");
+    return;
+  }
+
+  while ((pe = readdir(proc)) != NULL) {
+    char path[600];
+    char link[256];
+    DIR *fds;
+    struct dirent *fe;
+
+    if (pe->d_name[0] < '0' || pe->d_name[0] > '9')
+      continue;
+    snprintf(path, sizeof(path), "/proc/%s/fd", pe->d_name);
+    if ((fds = opendir(path)) == NULL)
+      continue;
+
+    while ((fe = readdir(fds)) != NULL) {
+      if (fe->d_name[0] == '.')
+        continue;
+      snprintf(path, sizeof(path), "/proc/%s/fd/%s", pe->d_name, fe->d_name);
+      ssize_t len = readlink(path, link, sizeof(link) - 1);
+      if (len <= 0)
+        continue;
+      link[len] = 0;
+      if (strncmp(link, "/memfd:", 7) != 0)
+        continue;
+
+      int fd = open(path, O_RDONLY);
+      if (fd < 0)
+        continue;
+      PoolAdd(fd);
+      close(fd);
+    }
+    closedir(fds);
+  }
+  closedir(proc);
+}
+
+static void ReadStats(const volatile struct SimbricksProtoBaseIfStats *src,
+                      struct SimbricksProtoBaseIfStats *dst) {
+  dst->msgs_in = src->msgs_in;
+  dst->msgs_out = src->msgs_out;
+  dst->syncs_in = src->syncs_in;
+  dst->syncs_out = src->syncs_out;
+  dst->out_full = src->out_full;
+  dst->polls_empty = src->polls_empty;
+  dst->in_timestamp = src->in_timestamp;
+  dst->out_timestamp = src->out_timestamp;
+}
+
+static const char *ProtoName(uint64_t proto) {
+  switch (proto) {
+    case SIMBRICKS_PROTO_ID_BASE:
+      return "base";
+    case SIMBRICKS_PROTO_ID_NET:
+      return "net";
+    case SIMBRICKS_PROTO_ID_PCIE:
+      return "pcie";
+    case SIMBRICKS_PROTO_ID_MEM:
+      return "mem";
+    default:
+      return "?";
+  }
+}
+
+static double Rate(uint64_t cur, uint64_t prev, double secs) {
+  return (cur >= prev ? (double)(cur - prev) / secs : 0);
+}
+
+static void PrintSide(const char *side,
+                      const struct SimbricksProtoBaseIfStats *cur,
+                      const struct SimbricksProtoBaseIfStats *prev,
+                      double secs) {
+  uint64_t rx =
+      (cur->msgs_in - prev->msgs_in) + (cur->syncs_in - prev->syncs_in);
+  uint64_t polls = rx + (cur->polls_empty - prev->polls_empty);
+  double poll_ok = (polls > 0 ? 100.0 * rx / polls : 0);
+  printf(
+      "    %s %10.0f %10.0f %10.0f %10.0f %8.0f %6.1f%% %14.3f %12.3f\n", side,
+      Rate(cur->msgs_in, prev->msgs_in, secs),
+      Rate(cur->msgs_out, prev->msgs_out, secs),
+      Rate(cur->syncs_in, prev->syncs_in, secs),
+      Rate(cur->syncs_out, prev->syncs_out, secs),
+      Rate(cur->out_full, prev->out_full, secs), poll_ok,
+      cur->out_timestamp / 1e6,
+      Rate(cur->out_timestamp, prev->out_timestamp, secs) / 1e6);
+}
+
+static void Print(double secs, bool clear) {
+  size_t i, j;
+  uint64_t min_ts = UINT64_MAX;
+  char min_name[160] = "";
+
+  if (clear)
+    printf("\033[H\033[2J");
+  printf("%zu pools, rates per second over the last %.2f s, times in us\n",
+         num_pools, secs);
+  printf("    %s %10s %10s %10s %10s %8s %7s %14s %12s\n", " ", "msgs_in",
+         "msgs_out", "syncs_in", "syncs_out", "full", "poll_ok", "sim_time",
+         "sim_us/s");
+
+  for (i = 0; i < num_pools; i++) {
+    struct Pool *pool = &pools[i];
+    uint32_t n = pool->hdr->num_ifs;
+    bool alive = kill(pool->hdr->pid, 0) == 0 || errno != ESRCH;
+    if (n > SIMBRICKS_PROTO_POOL_MAX_IFS)
+      n = SIMBRICKS_PROTO_POOL_MAX_IFS;
+
+    for (j = 0; j < n; j++) {
+      const volatile struct SimbricksProtoPoolIf *pif = &pool->hdr->ifs[j];
+      struct Sample cur;
+      char sock_path[sizeof(pif->sock_path) + 1];
+
+      ReadStats(&pif->stats[0], &cur.stats[0]);
+      ReadStats(&pif->stats[1], &cur.stats[1]);
+      memcpy(sock_path, (const char *)pif->sock_path, sizeof(pif->sock_path));
+      sock_path[sizeof(pif->sock_path)] = 0;
+
+      if (!pool->have_prev[j]) {
+        pool->prev[j] = cur;
+        pool->have_prev[j] = true;
+      }
+
+      printf("%s [%s, pid %u%s]\n", sock_path,
+             ProtoName(pif->upper_layer_proto), pool->hdr->pid,
+             (alive ? "" : ", exited"));
+      PrintSide("L", &cur.stats[0], &pool->prev[j].stats[0], secs);
+      PrintSide("C", &cur.stats[1], &pool->prev[j].stats[1], secs);
+
+      if (alive && cur.stats[0].out_timestamp < min_ts) {
+        min_ts = cur.stats[0].out_timestamp;
+        snprintf(min_name, sizeof(min_name), "%s (listener, pid %u)",
+                 sock_path, pool->hdr->pid);
+      }
+      if (alive && cur.stats[1].out_timestamp < min_ts) {
+        min_ts = cur.stats[1].out_timestamp;
+        snprintf(min_name, sizeof(min_name), "%s (connecter)", sock_path);
+      }
+      pool->prev[j] = cur;
+    }
+  }
+
+  if (min_ts != UINT64_MAX)
+    printf("furthest behind: %s at %.3f us\n", min_name, min_ts / 1e6);
+  fflush(stdout);
+}
+
+static void Usage(const char *prog) {
+  fprintf(stderr,
+          "Usage: %s [-i INTERVAL_MS] [-n ITERATIONS] [-p] [RUN_DIR...]\n"
+          "  -i  refresh interval in milliseconds (default 1000)\n"
+          "  -n  exit after this many refreshes (default: run until ^C)\n"
+          "  -p  also find memfd pools through /proc\n",
+          prog);
+}
+
+int main(int argc, char *argv[]) {
+  uint64_t interval_ms = 1000;
+  long iterations = -1;
+  bool scan_proc = false;
+  int c, i;
+
+  while ((c = getopt(argc, argv, "i:n:ph")) != -1) {
+    switch (c) {
+      case 'i':
+        interval_ms = strtoull(optarg, NULL, 0);
+        break;
+      case 'n':
+        iterations = strtol(optarg, NULL, 0);
+        break;
+      case 'p':
+        scan_proc = true;
+        break;
+      default:
+        Usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+  }
+  if (optind == argc && !scan_proc) {
+    Usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  signal(SIGINT, sigint_handler);
+  signal(SIGTERM, sigint_handler);
+
+  bool clear = isatty(STDOUT_FILENO);
+  uint64_t last = TimeNs();
+  while (!exiting && iterations != 0) {
+    /* pick up pools of components that started since the last refresh */
+    for (i = optind; i < argc; i++)
+      nftw(argv[i], ScanFile, 16, FTW_PHYS);
+    if (scan_proc)
+      ScanProc();
+
+    struct timespec ts = {.tv_sec = interval_ms / 1000,
+                          .tv_nsec = (interval_ms % 1000) * 1000000};
+    nanosleep(&ts, NULL);
+
+    uint64_t now = TimeNs();
+    Print((now - last) / 1e9, clear);
+    last = now;
+    if (iterations > 0)
+      iterations--;
+  }
+  return EXIT_SUCCESS;
+}